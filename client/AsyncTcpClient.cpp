@@ -0,0 +1,499 @@
+// client/AsyncTcpClient.cpp
+#include "AsyncTcpClient.h"
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+namespace {
+
+std::string server_error(const char* op, const NetworkProtocol::ResponseHeader& header, const std::vector<char>& payload) {
+    try {
+        NetworkProtocol::ErrorResponsePayload err_resp = NetworkProtocol::ErrorResponsePayload::deserialize(payload.data(), payload.size());
+        return std::string("Server error (") + op + "): " + err_resp.error_message + " (Status: " + std::to_string(static_cast<int>(header.status)) + ")";
+    } catch (const std::exception&) {
+        return std::string("Server error (") + op + "), and failed to parse error message. Status: " + std::to_string(static_cast<int>(header.status));
+    }
+}
+
+// Adapts a typed handler to a raw response: checks the status and response type, then decodes the payload
+template <typename T, typename Decode>
+AsyncTcpClient::ResponseHandler expect(const char* op, NetworkProtocol::CommandType expected_type,
+                                       AsyncTcpClient::Handler<T> handler, Decode decode) {
+    return [op, expected_type, handler = std::move(handler), decode = std::move(decode)](
+               const std::string& error, const NetworkProtocol::ResponseHeader& header, std::vector<char> payload) {
+        if (!error.empty()) {
+            handler(error, T{});
+            return;
+        }
+        if (header.status != NetworkProtocol::StatusCode::SUCCESS) {
+            handler(server_error(op, header, payload), T{});
+            return;
+        }
+        if (header.type != expected_type) {
+            handler(std::string("Unexpected response type for ") + op + ".", T{});
+            return;
+        }
+        T result;
+        try {
+            result = decode(payload);
+        } catch (const std::exception& e) {
+            handler(std::string("Failed to deserialize ") + op + " response: " + e.what(), T{});
+            return;
+        }
+        handler(std::string(), std::move(result));
+    };
+}
+
+// Handler that fulfils a future: the error becomes a std::runtime_error thrown by get()
+template <typename T>
+std::pair<AsyncTcpClient::Handler<T>, std::future<T>> future_handler() {
+    auto promise = std::make_shared<std::promise<T>>();
+    std::future<T> future = promise->get_future();
+    auto handler = [promise](const std::string& error, T result) {
+        if (!error.empty()) {
+            promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+        } else {
+            promise->set_value(std::move(result));
+        }
+    };
+    return {std::move(handler), std::move(future)};
+}
+
+std::pair<AsyncTcpClient::DoneHandler, std::future<void>> future_done_handler() {
+    auto promise = std::make_shared<std::promise<void>>();
+    std::future<void> future = promise->get_future();
+    auto handler = [promise](const std::string& error) {
+        if (!error.empty()) {
+            promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+        } else {
+            promise->set_value();
+        }
+    };
+    return {std::move(handler), std::move(future)};
+}
+
+// Operations without a result value report through a Handler<bool> internally
+AsyncTcpClient::Handler<bool> as_bool_handler(AsyncTcpClient::DoneHandler handler) {
+    return [handler = std::move(handler)](const std::string& error, bool) { handler(error); };
+}
+
+std::vector<char> topic_payload(const std::string& topic) {
+    std::vector<char> payload;
+    NetworkProtocol::write_string_to_buffer(payload, topic);
+    return payload;
+}
+
+} // namespace
+
+std::shared_ptr<AsyncTcpClient> AsyncTcpClient::create(boost::asio::io_context& io_context, const std::string& host, short port) {
+    return std::shared_ptr<AsyncTcpClient>(new AsyncTcpClient(io_context, host, port));
+}
+
+AsyncTcpClient::AsyncTcpClient(boost::asio::io_context& io_context, const std::string& host, short port)
+    : strand_(boost::asio::make_strand(io_context)), socket_(strand_), resolver_(strand_), host_(host), port_(port) {}
+
+AsyncTcpClient::~AsyncTcpClient() = default; // Pending handlers hold a reference, so none are left here
+
+void AsyncTcpClient::async_connect(DoneHandler handler) {
+    auto self = shared_from_this();
+    // The socket and resolver live on strand_, so their completions run there too
+    resolver_.async_resolve(host_, std::to_string(port_),
+        [this, self, handler = std::move(handler)](boost::system::error_code ec, tcp::resolver::results_type endpoints) mutable {
+        if (ec) {
+            handler("Resolve failed: " + ec.message());
+            return;
+        }
+        boost::asio::async_connect(socket_, endpoints,
+            [this, self, handler = std::move(handler)](boost::system::error_code connect_ec, const tcp::endpoint& /*endpoint*/) {
+            if (connect_ec) {
+                handler("Connect failed: " + connect_ec.message());
+                return;
+            }
+            boost::system::error_code ignored;
+            socket_.set_option(tcp::no_delay(true), ignored); // Requests are batched by the outbound queue
+            connected_ = true;
+            std::cout << "Async client connected to " << host_ << ":" << port_ << std::endl;
+            do_read_header();
+            handler(std::string());
+        });
+    });
+}
+
+std::future<void> AsyncTcpClient::connect() {
+    auto [handler, future] = future_done_handler();
+    async_connect(std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::close() {
+    auto self = shared_from_this();
+    boost::asio::dispatch(strand_, [this, self]() {
+        if (socket_.is_open()) {
+            boost::system::error_code ignored;
+            socket_.shutdown(tcp::socket::shutdown_both, ignored);
+            socket_.close(ignored);
+        }
+        fail_all("Connection closed.");
+    });
+}
+
+void AsyncTcpClient::async_request(NetworkProtocol::CommandType type, std::vector<char> payload, ResponseHandler handler) {
+    NetworkProtocol::RequestHeader header;
+    header.type = type;
+    header.v2 = true;
+    header.payload_length = static_cast<uint32_t>(payload.size());
+    auto self = shared_from_this();
+    boost::asio::dispatch(strand_, [this, self, header, payload = std::move(payload), handler = std::move(handler)]() mutable {
+        send_frame(header, std::move(payload), std::move(handler));
+    });
+}
+
+void AsyncTcpClient::send_frame(NetworkProtocol::RequestHeader header, std::vector<char> payload, ResponseHandler handler) {
+    if (!connected_) {
+        if (handler) handler("Not connected.", NetworkProtocol::ResponseHeader{}, {});
+        return;
+    }
+    // Ids wrap around; skip 0 and any id still waiting for its response
+    do {
+        header.correlation_id = next_correlation_id_++;
+    } while (header.correlation_id == 0 || pending_.count(header.correlation_id));
+    if (handler) { // Null for frames the server doesn't answer (SUBSCRIPTION_CREDIT)
+        pending_.emplace(header.correlation_id, std::move(handler));
+    }
+
+    std::vector<char> frame(header.size()); // Header patched in below, once the payload length is final
+    if (codec_ != NetworkProtocol::CompressionCodec::NONE && payload.size() >= compression_threshold_ &&
+        Compression::compress_payload(codec_, 0, payload.data(), payload.size(), frame)) {
+        header.flags |= NetworkProtocol::FLAG_COMPRESSED;
+        header.payload_length = static_cast<uint32_t>(frame.size() - header.size());
+    } else {
+        frame.insert(frame.end(), payload.begin(), payload.end());
+    }
+    header.serialize_into(frame.data());
+    outbound_.push_back(std::move(frame));
+    if (writing_.empty()) {
+        do_write();
+    }
+}
+
+void AsyncTcpClient::do_write() {
+    // Everything queued since the last write goes out in one gathered write
+    while (!outbound_.empty()) {
+        writing_.push_back(std::move(outbound_.front()));
+        outbound_.pop_front();
+    }
+    write_buffers_.clear();
+    for (const auto& frame : writing_) {
+        write_buffers_.push_back(boost::asio::buffer(frame));
+    }
+
+    auto self = shared_from_this();
+    boost::asio::async_write(socket_, write_buffers_, [this, self](boost::system::error_code ec, std::size_t /*length*/) {
+        writing_.clear();
+        if (ec) {
+            fail_all("Send request failed: " + ec.message());
+            return;
+        }
+        if (!outbound_.empty()) {
+            do_write();
+        }
+    });
+}
+
+void AsyncTcpClient::do_read_header() {
+    // Every request is v2, so every frame from the server carries the header extension
+    auto self = shared_from_this();
+    boost::asio::async_read(socket_, boost::asio::buffer(header_buffer_), [this, self](boost::system::error_code ec, std::size_t /*length*/) {
+        if (ec) {
+            fail_all(ec == boost::asio::error::eof ? std::string("Connection closed by server.")
+                                                   : "Read response header failed: " + ec.message());
+            return;
+        }
+        NetworkProtocol::ResponseHeader header = NetworkProtocol::ResponseHeader::deserialize(header_buffer_.data());
+        header.deserialize_extension(header_buffer_.data() + NetworkProtocol::ResponseHeader::SIZE);
+        if (header.payload_length > NetworkProtocol::MAX_PAYLOAD_SIZE) {
+            // The stream can't be resynchronised without reading the payload, so give up on the connection
+            fail_all("Server response payload too large: " + std::to_string(header.payload_length));
+            boost::system::error_code ignored;
+            socket_.close(ignored);
+            return;
+        }
+        do_read_payload(header);
+    });
+}
+
+void AsyncTcpClient::do_read_payload(NetworkProtocol::ResponseHeader header) {
+    payload_buffer_.resize(header.payload_length);
+    if (header.payload_length == 0) {
+        dispatch_response(header, std::move(payload_buffer_));
+        do_read_header();
+        return;
+    }
+    auto self = shared_from_this();
+    boost::asio::async_read(socket_, boost::asio::buffer(payload_buffer_), [this, self, header](boost::system::error_code ec, std::size_t /*length*/) {
+        if (ec) {
+            fail_all("Read response payload failed: " + ec.message());
+            return;
+        }
+        dispatch_response(header, std::move(payload_buffer_));
+        do_read_header();
+    });
+}
+
+void AsyncTcpClient::dispatch_response(const NetworkProtocol::ResponseHeader& header, std::vector<char> payload) {
+    if (header.flags & NetworkProtocol::FLAG_COMPRESSED) {
+        std::vector<char> plain;
+        try {
+            Compression::decompress_payload(codec_, payload.data(), payload.size(), plain);
+        } catch (const std::exception& e) {
+            std::cerr << "Async client: Failed to decompress response: " << e.what() << std::endl;
+            auto it = pending_.find(header.correlation_id);
+            if (it != pending_.end() && header.type != NetworkProtocol::CommandType::MESSAGE_PUSH) {
+                ResponseHandler handler = std::move(it->second);
+                pending_.erase(it);
+                handler("Failed to decompress response: " + std::string(e.what()), header, {});
+            }
+            return;
+        }
+        payload.swap(plain);
+    }
+    if (header.type == NetworkProtocol::CommandType::MESSAGE_PUSH) {
+        // Pushes carry the SUBSCRIBE request's correlation id but don't complete it
+        if (!push_handler_) return;
+        try {
+            NetworkProtocol::MessagePush push = NetworkProtocol::MessagePush::deserialize(payload.data(), payload.size());
+            push_handler_(push.topic_name, std::move(push.messages));
+        } catch (const std::exception& e) {
+            std::cerr << "Async client: Failed to deserialize MESSAGE_PUSH: " << e.what() << std::endl;
+        }
+        return;
+    }
+    auto it = pending_.find(header.correlation_id);
+    if (it == pending_.end()) {
+        std::cerr << "Async client: Response for unknown correlation id " << header.correlation_id << std::endl;
+        return;
+    }
+    ResponseHandler handler = std::move(it->second);
+    pending_.erase(it);
+    handler(std::string(), header, std::move(payload));
+}
+
+void AsyncTcpClient::fail_all(const std::string& error) {
+    connected_ = false;
+    outbound_.clear();
+    // Handlers may issue new requests, which now fail straight away instead of joining this map
+    std::unordered_map<uint32_t, ResponseHandler> pending;
+    pending.swap(pending_);
+    for (auto& entry : pending) {
+        entry.second(error, NetworkProtocol::ResponseHeader{}, {});
+    }
+}
+
+// --- Typed operations ---
+
+void AsyncTcpClient::async_negotiate_compression(std::vector<NetworkProtocol::CompressionCodec> codecs,
+                                                 Handler<NetworkProtocol::CompressionCodec> handler) {
+    NetworkProtocol::HandshakeRequest req;
+    for (auto codec : codecs) {
+        if (Compression::is_available(codec)) req.codecs.push_back(codec); // Only offer what we can decode
+    }
+    auto self = shared_from_this();
+    // Runs on the strand, before any later response can be decoded
+    Handler<NetworkProtocol::HandshakeResponse> on_response =
+        [this, self, handler = std::move(handler)](const std::string& error, NetworkProtocol::HandshakeResponse resp) {
+        if (error.empty() && resp.codec != NetworkProtocol::CompressionCodec::NONE && !Compression::is_available(resp.codec)) {
+            handler("Server chose a codec that was not offered.", NetworkProtocol::CompressionCodec::NONE);
+            return;
+        }
+        if (error.empty()) {
+            codec_ = resp.codec;
+            compression_threshold_ = resp.compression_threshold;
+        }
+        handler(error, resp.codec);
+    };
+    async_request(NetworkProtocol::CommandType::HANDSHAKE_REQUEST, req.serialize(),
+        expect<NetworkProtocol::HandshakeResponse>("HANDSHAKE", NetworkProtocol::CommandType::HANDSHAKE_RESPONSE, std::move(on_response),
+            [](const std::vector<char>& payload_bytes) {
+                return NetworkProtocol::HandshakeResponse::deserialize(payload_bytes.data(), payload_bytes.size());
+            }));
+}
+
+std::future<NetworkProtocol::CompressionCodec> AsyncTcpClient::negotiate_compression(std::vector<NetworkProtocol::CompressionCodec> codecs) {
+    auto [handler, future] = future_handler<NetworkProtocol::CompressionCodec>();
+    async_negotiate_compression(std::move(codecs), std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::async_produce(const std::string& topic, std::string_view payload, Handler<uint64_t> handler) {
+    std::vector<char> req_payload;
+    NetworkProtocol::BufferWriter writer(req_payload);
+    writer.reserve(sizeof(uint16_t) + topic.size() + sizeof(uint32_t) + payload.size());
+    writer.put_string(topic);
+    writer.put_string(payload, false);
+    async_request(NetworkProtocol::CommandType::PRODUCE_REQUEST, std::move(req_payload),
+        expect<uint64_t>("PRODUCE", NetworkProtocol::CommandType::PRODUCE_RESPONSE, std::move(handler),
+            [](const std::vector<char>& payload_bytes) {
+                return NetworkProtocol::ProduceResponse::deserialize(payload_bytes.data(), payload_bytes.size()).offset;
+            }));
+}
+
+std::future<uint64_t> AsyncTcpClient::produce(const std::string& topic, std::string_view payload) {
+    auto [handler, future] = future_handler<uint64_t>();
+    async_produce(topic, payload, std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::async_consume(const std::string& topic, uint64_t start_offset, uint32_t max_messages,
+                                   Handler<std::vector<Message>> handler,
+                                   uint32_t max_wait_ms, uint32_t min_bytes, uint32_t max_bytes) {
+    NetworkProtocol::ConsumeRequest req;
+    req.topic_name = topic;
+    req.start_offset = start_offset;
+    req.max_messages = max_messages;
+    req.max_wait_ms = max_wait_ms;
+    req.min_bytes = min_bytes;
+    req.max_bytes = max_bytes;
+    std::vector<char> req_payload;
+    req.serialize_into(req_payload);
+    async_request(NetworkProtocol::CommandType::CONSUME_REQUEST, std::move(req_payload),
+        expect<std::vector<Message>>("CONSUME", NetworkProtocol::CommandType::CONSUME_RESPONSE, std::move(handler),
+            [topic](const std::vector<char>& payload_bytes) {
+                return NetworkProtocol::ConsumeResponse::deserialize(payload_bytes.data(), payload_bytes.size(), topic).messages;
+            }));
+}
+
+std::future<std::vector<Message>> AsyncTcpClient::consume(const std::string& topic, uint64_t start_offset, uint32_t max_messages,
+                                                          uint32_t max_wait_ms, uint32_t min_bytes, uint32_t max_bytes) {
+    auto [handler, future] = future_handler<std::vector<Message>>();
+    async_consume(topic, start_offset, max_messages, std::move(handler), max_wait_ms, min_bytes, max_bytes);
+    return std::move(future);
+}
+
+void AsyncTcpClient::async_get_topic_offset(const std::string& topic, Handler<uint64_t> handler) {
+    async_request(NetworkProtocol::CommandType::GET_TOPIC_OFFSET_REQUEST, topic_payload(topic),
+        expect<uint64_t>("GET_TOPIC_OFFSET", NetworkProtocol::CommandType::GET_TOPIC_OFFSET_RESPONSE, std::move(handler),
+            [](const std::vector<char>& payload_bytes) {
+                NetworkProtocol::BufferReader reader(payload_bytes.data(), payload_bytes.size());
+                return reader.get_u64();
+            }));
+}
+
+std::future<uint64_t> AsyncTcpClient::get_topic_offset(const std::string& topic) {
+    auto [handler, future] = future_handler<uint64_t>();
+    async_get_topic_offset(topic, std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::async_create_topic(const std::string& topic, DoneHandler handler) {
+    async_request(NetworkProtocol::CommandType::CREATE_TOPIC_REQUEST, topic_payload(topic),
+        expect<bool>("CREATE_TOPIC", NetworkProtocol::CommandType::CREATE_TOPIC_RESPONSE, as_bool_handler(std::move(handler)),
+            [](const std::vector<char>&) { return true; }));
+}
+
+std::future<void> AsyncTcpClient::create_topic(const std::string& topic) {
+    auto [handler, future] = future_done_handler();
+    async_create_topic(topic, std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::async_list_topics(Handler<std::vector<std::string>> handler) {
+    async_request(NetworkProtocol::CommandType::LIST_TOPICS_REQUEST, {},
+        expect<std::vector<std::string>>("LIST_TOPICS", NetworkProtocol::CommandType::LIST_TOPICS_RESPONSE, std::move(handler),
+            [](const std::vector<char>& payload_bytes) {
+                NetworkProtocol::BufferReader reader(payload_bytes.data(), payload_bytes.size());
+                uint32_t num_topics = reader.get_u32();
+                std::vector<std::string> topics;
+                for (uint32_t i = 0; i < num_topics; ++i) {
+                    topics.emplace_back(reader.get_string());
+                }
+                return topics;
+            }));
+}
+
+std::future<std::vector<std::string>> AsyncTcpClient::list_topics() {
+    auto [handler, future] = future_handler<std::vector<std::string>>();
+    async_list_topics(std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::async_produce_batch(const NetworkProtocol::ProduceBatchRequest& request,
+                                         Handler<std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>> handler) {
+    async_request(NetworkProtocol::CommandType::PRODUCE_BATCH_REQUEST, request.serialize(),
+        expect<std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>>(
+            "PRODUCE_BATCH", NetworkProtocol::CommandType::PRODUCE_BATCH_RESPONSE, std::move(handler),
+            [](const std::vector<char>& payload_bytes) {
+                return NetworkProtocol::ProduceBatchResponse::deserialize(payload_bytes.data(), payload_bytes.size()).results;
+            }));
+}
+
+std::future<std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>> AsyncTcpClient::produce_batch(
+    const NetworkProtocol::ProduceBatchRequest& request) {
+    auto [handler, future] = future_handler<std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>>();
+    async_produce_batch(request, std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::async_fetch(const std::vector<NetworkProtocol::FetchRequest::Entry>& entries,
+                                 Handler<std::vector<NetworkProtocol::FetchResponse::Entry>> handler) {
+    async_request(NetworkProtocol::CommandType::FETCH_REQUEST, NetworkProtocol::FetchRequest{entries}.serialize(),
+        expect<std::vector<NetworkProtocol::FetchResponse::Entry>>(
+            "FETCH", NetworkProtocol::CommandType::FETCH_RESPONSE, std::move(handler),
+            [](const std::vector<char>& payload_bytes) {
+                return NetworkProtocol::FetchResponse::deserialize(payload_bytes.data(), payload_bytes.size()).entries;
+            }));
+}
+
+std::future<std::vector<NetworkProtocol::FetchResponse::Entry>> AsyncTcpClient::fetch(
+    const std::vector<NetworkProtocol::FetchRequest::Entry>& entries) {
+    auto [handler, future] = future_handler<std::vector<NetworkProtocol::FetchResponse::Entry>>();
+    async_fetch(entries, std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::set_push_handler(PushHandler handler) {
+    auto self = shared_from_this();
+    boost::asio::dispatch(strand_, [this, self, handler = std::move(handler)]() mutable {
+        push_handler_ = std::move(handler);
+    });
+}
+
+void AsyncTcpClient::async_subscribe(const std::string& topic, uint64_t start_offset, uint32_t credit_bytes, Handler<uint64_t> handler) {
+    NetworkProtocol::SubscribeRequest req;
+    req.topic_name = topic;
+    req.start_offset = start_offset;
+    req.credit_bytes = credit_bytes;
+    async_request(NetworkProtocol::CommandType::SUBSCRIBE_REQUEST, req.serialize(),
+        expect<uint64_t>("SUBSCRIBE", NetworkProtocol::CommandType::SUBSCRIBE_RESPONSE, std::move(handler),
+            [](const std::vector<char>& payload_bytes) {
+                NetworkProtocol::BufferReader reader(payload_bytes.data(), payload_bytes.size());
+                return reader.get_u64();
+            }));
+}
+
+std::future<uint64_t> AsyncTcpClient::subscribe(const std::string& topic, uint64_t start_offset, uint32_t credit_bytes) {
+    auto [handler, future] = future_handler<uint64_t>();
+    async_subscribe(topic, start_offset, credit_bytes, std::move(handler));
+    return std::move(future);
+}
+
+void AsyncTcpClient::add_subscription_credit(const std::string& topic, uint32_t credit_bytes) {
+    NetworkProtocol::SubscriptionCredit credit;
+    credit.topic_name = topic;
+    credit.credit_bytes = credit_bytes;
+    async_request(NetworkProtocol::CommandType::SUBSCRIPTION_CREDIT, credit.serialize(), nullptr);
+}
+
+void AsyncTcpClient::async_unsubscribe(const std::string& topic, DoneHandler handler) {
+    async_request(NetworkProtocol::CommandType::UNSUBSCRIBE_REQUEST, topic_payload(topic),
+        expect<bool>("UNSUBSCRIBE", NetworkProtocol::CommandType::UNSUBSCRIBE_RESPONSE, as_bool_handler(std::move(handler)),
+            [](const std::vector<char>&) { return true; }));
+}
+
+std::future<void> AsyncTcpClient::unsubscribe(const std::string& topic) {
+    auto [handler, future] = future_done_handler();
+    async_unsubscribe(topic, std::move(handler));
+    return std::move(future);
+}
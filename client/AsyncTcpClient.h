@@ -0,0 +1,125 @@
+// client/AsyncTcpClient.h
+#pragma once
+#include <boost/asio.hpp>
+#include <array>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../network/NetworkProtocol.h" // For structures and enums
+#include "../network/Compression.h"
+#include "../event_queue_core/Message.h" // For Message struct
+
+using boost::asio::ip::tcp;
+
+// Pipelining TCP client. Every request is sent as a v2 frame with its own correlation id, so any
+// number of requests can be in flight on one connection; responses are matched to their requests as
+// they arrive, in whatever order the server completes them.
+//
+// Socket work runs on a strand of the caller's io_context, which may be run by any number of threads.
+// Each operation comes in two forms: async_xxx() takes a completion handler, called on the io_context
+// with an empty error on success; xxx() returns a std::future whose get() throws std::runtime_error
+// with the error. Don't block on a future from a thread that runs the io_context.
+// For one-request-at-a-time tools, the blocking TcpClient is simpler.
+class AsyncTcpClient : public std::enable_shared_from_this<AsyncTcpClient> {
+public:
+    template <typename T>
+    using Handler = std::function<void(const std::string& error, T result)>;
+    using DoneHandler = std::function<void(const std::string& error)>;
+    // Raw response; a non-SUCCESS status is not an error here (the payload is then an ErrorResponsePayload)
+    using ResponseHandler = std::function<void(const std::string& error, const NetworkProtocol::ResponseHeader& header,
+                                               std::vector<char> payload)>;
+    // MESSAGE_PUSH batches for this connection's subscriptions
+    using PushHandler = std::function<void(const std::string& topic, std::vector<Message> messages)>;
+
+    static std::shared_ptr<AsyncTcpClient> create(boost::asio::io_context& io_context, const std::string& host, short port);
+    ~AsyncTcpClient();
+
+    void async_connect(DoneHandler handler);
+    std::future<void> connect();
+    // Closes the socket; requests still waiting for a response fail with "Connection closed."
+    void close();
+
+    // Wire compression (see HANDSHAKE_REQUEST): offers `codecs`, most preferred first, and resolves
+    // with the codec the server picked (NONE if none). Afterwards payloads from the server's threshold
+    // up are compressed both ways. Wait for it before sending anything else on the connection.
+    void async_negotiate_compression(std::vector<NetworkProtocol::CompressionCodec> codecs,
+                                     Handler<NetworkProtocol::CompressionCodec> handler);
+    std::future<NetworkProtocol::CompressionCodec> negotiate_compression(
+        std::vector<NetworkProtocol::CompressionCodec> codecs = Compression::available_codecs());
+
+    // Sends any command; the building block for the typed operations below
+    void async_request(NetworkProtocol::CommandType type, std::vector<char> payload, ResponseHandler handler);
+
+    void async_produce(const std::string& topic, std::string_view payload, Handler<uint64_t> handler);
+    std::future<uint64_t> produce(const std::string& topic, std::string_view payload);
+
+    // max_wait_ms > 0 makes this a long-poll; other requests on the connection keep flowing meanwhile
+    void async_consume(const std::string& topic, uint64_t start_offset, uint32_t max_messages,
+                       Handler<std::vector<Message>> handler,
+                       uint32_t max_wait_ms = 0, uint32_t min_bytes = 0, uint32_t max_bytes = 0);
+    std::future<std::vector<Message>> consume(const std::string& topic, uint64_t start_offset, uint32_t max_messages,
+                                              uint32_t max_wait_ms = 0, uint32_t min_bytes = 0, uint32_t max_bytes = 0);
+
+    void async_get_topic_offset(const std::string& topic, Handler<uint64_t> handler);
+    std::future<uint64_t> get_topic_offset(const std::string& topic);
+
+    void async_create_topic(const std::string& topic, DoneHandler handler);
+    std::future<void> create_topic(const std::string& topic);
+
+    void async_list_topics(Handler<std::vector<std::string>> handler);
+    std::future<std::vector<std::string>> list_topics();
+
+    void async_produce_batch(const NetworkProtocol::ProduceBatchRequest& request,
+                             Handler<std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>> handler);
+    std::future<std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>> produce_batch(
+        const NetworkProtocol::ProduceBatchRequest& request);
+
+    void async_fetch(const std::vector<NetworkProtocol::FetchRequest::Entry>& entries,
+                     Handler<std::vector<NetworkProtocol::FetchResponse::Entry>> handler);
+    std::future<std::vector<NetworkProtocol::FetchResponse::Entry>> fetch(
+        const std::vector<NetworkProtocol::FetchRequest::Entry>& entries);
+
+    // Push subscriptions. Pushed batches go to the push handler (set it before subscribing); the
+    // subscription stops once credit_bytes are used up until add_subscription_credit() grants more.
+    void set_push_handler(PushHandler handler);
+    void async_subscribe(const std::string& topic, uint64_t start_offset, uint32_t credit_bytes, Handler<uint64_t> handler);
+    std::future<uint64_t> subscribe(const std::string& topic, uint64_t start_offset, uint32_t credit_bytes);
+    void add_subscription_credit(const std::string& topic, uint32_t credit_bytes); // No response
+    void async_unsubscribe(const std::string& topic, DoneHandler handler);
+    std::future<void> unsubscribe(const std::string& topic);
+
+private:
+    AsyncTcpClient(boost::asio::io_context& io_context, const std::string& host, short port);
+
+    // Strand only
+    void send_frame(NetworkProtocol::RequestHeader header, std::vector<char> payload, ResponseHandler handler);
+    void do_write();
+    void do_read_header();
+    void do_read_payload(NetworkProtocol::ResponseHeader header);
+    void dispatch_response(const NetworkProtocol::ResponseHeader& header, std::vector<char> payload);
+    void fail_all(const std::string& error);
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    tcp::socket socket_;
+    tcp::resolver resolver_;
+    std::string host_;
+    short port_;
+
+    // Strand state
+    bool connected_ = false;
+    uint32_t next_correlation_id_ = 1;
+    NetworkProtocol::CompressionCodec codec_ = NetworkProtocol::CompressionCodec::NONE;
+    uint32_t compression_threshold_ = 0;
+    std::unordered_map<uint32_t, ResponseHandler> pending_; // By correlation id
+    PushHandler push_handler_;
+    std::deque<std::vector<char>> outbound_;  // Frames waiting for the next write
+    std::vector<std::vector<char>> writing_;  // Frames owned by the write in flight
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    std::array<char, NetworkProtocol::ResponseHeader::SIZE + NetworkProtocol::ResponseHeader::EXTENSION_SIZE> header_buffer_;
+    std::vector<char> payload_buffer_;
+};
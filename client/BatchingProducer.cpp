@@ -0,0 +1,180 @@
+// client/BatchingProducer.cpp
+#include "BatchingProducer.h"
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+std::string status_error(NetworkProtocol::StatusCode status, const std::string& message, uint32_t throttle_ms) {
+    std::string error = "Server error (PRODUCE_BATCH): " + message + " (Status: " + std::to_string(static_cast<int>(status)) + ")";
+    if (throttle_ms > 0) {
+        error += ", retry after " + std::to_string(throttle_ms) + " ms";
+    }
+    return error;
+}
+
+// The error for every record of a batch, or empty with `result` set on success
+std::string decode_batch_response(const std::string& error, const NetworkProtocol::ResponseHeader& header,
+                                  const std::vector<char>& payload,
+                                  NetworkProtocol::ProduceBatchResponse::TopicResult& result) {
+    if (!error.empty()) return error;
+    if (header.status != NetworkProtocol::StatusCode::SUCCESS) {
+        try {
+            auto err_resp = NetworkProtocol::ErrorResponsePayload::deserialize(payload.data(), payload.size());
+            return status_error(header.status, err_resp.error_message, err_resp.throttle_ms);
+        } catch (const std::exception&) {
+            return status_error(header.status, "failed to parse error message", 0);
+        }
+    }
+    if (header.type != NetworkProtocol::CommandType::PRODUCE_BATCH_RESPONSE) {
+        return "Unexpected response type for PRODUCE_BATCH.";
+    }
+    try {
+        auto resp = NetworkProtocol::ProduceBatchResponse::deserialize(payload.data(), payload.size());
+        if (resp.results.size() != 1) return "Unexpected result count for PRODUCE_BATCH.";
+        result = std::move(resp.results[0]);
+    } catch (const std::exception& e) {
+        return std::string("Failed to deserialize PRODUCE_BATCH response: ") + e.what();
+    }
+    if (result.status != NetworkProtocol::StatusCode::SUCCESS) {
+        return status_error(result.status, "batch for topic '" + result.topic_name + "' rejected", result.throttle_ms);
+    }
+    return std::string();
+}
+
+} // namespace
+
+std::shared_ptr<BatchingProducer> BatchingProducer::create(std::shared_ptr<AsyncTcpClient> client,
+                                                           boost::asio::io_context& io_context, Config config) {
+    return std::shared_ptr<BatchingProducer>(new BatchingProducer(std::move(client), io_context, std::move(config)));
+}
+
+BatchingProducer::BatchingProducer(std::shared_ptr<AsyncTcpClient> client, boost::asio::io_context& io_context, Config config)
+    : client_(std::move(client)),
+      strand_(boost::asio::make_strand(io_context)),
+      linger_timer_(strand_),
+      config_(std::move(config)),
+      started_(config_.compression.empty()) {}
+
+std::future<void> BatchingProducer::start() {
+    auto promise = std::make_shared<std::promise<void>>();
+    std::future<void> future = promise->get_future();
+    if (config_.compression.empty()) {
+        promise->set_value();
+        return future;
+    }
+    auto self = shared_from_this();
+    client_->async_negotiate_compression(config_.compression,
+        [this, self, promise](const std::string& error, NetworkProtocol::CompressionCodec) {
+            boost::asio::dispatch(strand_, [this, self, promise, error]() {
+                started_ = true;
+                send_due_batches(false);
+                arm_linger_timer();
+                if (!error.empty()) {
+                    promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+                } else {
+                    promise->set_value();
+                }
+            });
+        });
+    return future;
+}
+
+void BatchingProducer::send(const std::string& topic, std::string payload, AsyncTcpClient::Handler<uint64_t> handler) {
+    boost::asio::dispatch(strand_, [this, self = shared_from_this(), topic, payload = std::move(payload),
+                                    handler = std::move(handler)]() mutable {
+        append(topic, std::move(payload), std::move(handler));
+    });
+}
+
+std::future<uint64_t> BatchingProducer::send(const std::string& topic, std::string payload) {
+    auto promise = std::make_shared<std::promise<uint64_t>>();
+    std::future<uint64_t> future = promise->get_future();
+    send(topic, std::move(payload), [promise](const std::string& error, uint64_t offset) {
+        if (!error.empty()) {
+            promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+        } else {
+            promise->set_value(offset);
+        }
+    });
+    return future;
+}
+
+void BatchingProducer::flush() {
+    boost::asio::dispatch(strand_, [this, self = shared_from_this()]() { send_due_batches(true); });
+}
+
+void BatchingProducer::append(const std::string& topic, std::string payload, AsyncTcpClient::Handler<uint64_t> handler) {
+    auto it = batches_.find(topic);
+    if (it == batches_.end()) {
+        it = batches_.emplace(topic, Batch()).first;
+        Batch& batch = it->second;
+        batch.payload.reserve(config_.batch_size_bytes + topic.size() + 64);
+        NetworkProtocol::write_uint32_to_buffer(batch.payload, 1);
+        NetworkProtocol::write_string_to_buffer(batch.payload, topic);
+        batch.count_offset = batch.payload.size();
+        NetworkProtocol::write_uint32_to_buffer(batch.payload, 0);
+        batch.deadline = std::chrono::steady_clock::now() + config_.linger;
+    }
+    Batch& batch = it->second;
+    NetworkProtocol::write_string_to_buffer(batch.payload, payload, false);
+    batch.handlers.push_back(std::move(handler));
+
+    if (started_ && batch.payload.size() - batch.count_offset >= config_.batch_size_bytes) {
+        Batch full = std::move(batch);
+        batches_.erase(it);
+        send_batch(std::move(full));
+    } else {
+        arm_linger_timer();
+    }
+}
+
+void BatchingProducer::send_batch(Batch batch) {
+    NetworkProtocol::detail::store<uint32_t>(batch.payload.data() + batch.count_offset,
+                                             static_cast<uint32_t>(batch.handlers.size()));
+    client_->async_request(NetworkProtocol::CommandType::PRODUCE_BATCH_REQUEST, std::move(batch.payload),
+        [handlers = std::move(batch.handlers)](const std::string& error, const NetworkProtocol::ResponseHeader& header,
+                                               std::vector<char> payload) {
+            NetworkProtocol::ProduceBatchResponse::TopicResult result;
+            std::string batch_error = decode_batch_response(error, header, payload, result);
+            for (size_t i = 0; i < handlers.size(); ++i) {
+                if (batch_error.empty()) {
+                    handlers[i](std::string(), result.base_offset + i);
+                } else {
+                    handlers[i](batch_error, 0);
+                }
+            }
+        });
+}
+
+void BatchingProducer::send_due_batches(bool all) {
+    if (!started_) return;
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = batches_.begin(); it != batches_.end();) {
+        Batch& batch = it->second;
+        if (all || batch.deadline <= now || batch.payload.size() - batch.count_offset >= config_.batch_size_bytes) {
+            Batch due = std::move(batch);
+            it = batches_.erase(it);
+            send_batch(std::move(due));
+        } else {
+            ++it;
+        }
+    }
+}
+
+void BatchingProducer::arm_linger_timer() {
+    if (!started_ || batches_.empty()) return;
+    auto earliest = std::chrono::steady_clock::time_point::max();
+    for (const auto& [topic, batch] : batches_) {
+        if (batch.deadline < earliest) earliest = batch.deadline;
+    }
+    if (earliest >= timer_deadline_) return; // The armed timer fires first
+    timer_deadline_ = earliest;
+    linger_timer_.expires_at(earliest); // Cancels the later wait, if any
+    linger_timer_.async_wait([this, self = shared_from_this()](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted) return;
+        timer_deadline_ = std::chrono::steady_clock::time_point::max();
+        send_due_batches(false);
+        arm_linger_timer();
+    });
+}
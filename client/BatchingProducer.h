@@ -0,0 +1,73 @@
+// client/BatchingProducer.h
+#pragma once
+#include <boost/asio.hpp>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AsyncTcpClient.h"
+
+// Accumulates records per topic and sends each topic's records as one PRODUCE_BATCH_REQUEST once
+// the batch reaches batch_size_bytes or its oldest record has waited linger, so steady producers pay
+// one request (and one append on the server) per batch instead of per record. Batches go out on an
+// AsyncTcpClient, pipelined, so several can be in flight at once.
+//
+// Every batch names a single topic: the server then runs it on that topic's shard, in send order, so
+// a topic's records are appended in the order they were handed to send().
+//
+// send() may be called from any thread. Its future (or handler) resolves with the record's offset, or
+// fails with the batch's error; throttled batches fail with the server's retry delay in the message.
+class BatchingProducer : public std::enable_shared_from_this<BatchingProducer> {
+public:
+    struct Config {
+        size_t batch_size_bytes = 64 * 1024;         // batch.size: encoded record bytes that trigger a send
+        std::chrono::milliseconds linger{5};         // linger.ms: longest a record waits for its batch to fill
+        // Codecs to negotiate on start(), most preferred first; empty sends batches uncompressed.
+        // Batches at or above the server's threshold are then compressed as a whole.
+        std::vector<NetworkProtocol::CompressionCodec> compression;
+    };
+
+    // `client` must be connected, and not yet used for other requests if compression is configured
+    static std::shared_ptr<BatchingProducer> create(std::shared_ptr<AsyncTcpClient> client,
+                                                    boost::asio::io_context& io_context, Config config);
+
+    // Negotiates compression if configured; until it completes, records wait in their batches. Fails
+    // if the negotiation does, after which batches go out uncompressed. Without compression, a no-op.
+    std::future<void> start();
+
+    void send(const std::string& topic, std::string payload, AsyncTcpClient::Handler<uint64_t> handler);
+    std::future<uint64_t> send(const std::string& topic, std::string payload);
+
+    // Sends every non-empty batch now, without waiting for size or linger
+    void flush();
+
+private:
+    BatchingProducer(std::shared_ptr<AsyncTcpClient> client, boost::asio::io_context& io_context, Config config);
+
+    struct Batch {
+        // The request payload, built as records arrive: topic count (1), topic name, record count
+        // (patched at send), then each record's u32 length and bytes
+        std::vector<char> payload;
+        size_t count_offset = 0;
+        std::vector<AsyncTcpClient::Handler<uint64_t>> handlers; // One per record, in order
+        std::chrono::steady_clock::time_point deadline; // First record's arrival + linger
+    };
+
+    // Strand only
+    void append(const std::string& topic, std::string payload, AsyncTcpClient::Handler<uint64_t> handler);
+    void send_batch(Batch batch);
+    void send_due_batches(bool all);
+    void arm_linger_timer();
+
+    std::shared_ptr<AsyncTcpClient> client_;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::steady_timer linger_timer_;
+    Config config_;
+
+    // Strand state
+    bool started_; // Batches are held until start() has negotiated compression
+    std::map<std::string, Batch> batches_; // Open batch per topic
+    std::chrono::steady_clock::time_point timer_deadline_ = std::chrono::steady_clock::time_point::max();
+};
@@ -0,0 +1,150 @@
+// client/StreamingConsumer.cpp
+#include "StreamingConsumer.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+std::shared_ptr<StreamingConsumer> StreamingConsumer::create(std::shared_ptr<AsyncTcpClient> client,
+                                                             boost::asio::io_context& io_context,
+                                                             const std::string& topic, uint64_t start_offset, Config config) {
+    return std::shared_ptr<StreamingConsumer>(
+        new StreamingConsumer(std::move(client), io_context, topic, start_offset, std::move(config)));
+}
+
+StreamingConsumer::StreamingConsumer(std::shared_ptr<AsyncTcpClient> client, boost::asio::io_context& io_context,
+                                     const std::string& topic, uint64_t start_offset, Config config)
+    : client_(std::move(client)),
+      strand_(boost::asio::make_strand(io_context)),
+      topic_(topic),
+      config_(std::move(config)),
+      received_offset_(start_offset),
+      next_fetch_offset_(start_offset),
+      position_(start_offset) {
+    if (config_.max_in_flight == 0) config_.max_in_flight = 1;
+    if (config_.max_messages_per_fetch == 0) config_.max_messages_per_fetch = 1;
+}
+
+void StreamingConsumer::start() {
+    boost::asio::dispatch(strand_, [this, self = shared_from_this()]() { fill(); });
+}
+
+void StreamingConsumer::stop() {
+    boost::asio::dispatch(strand_, [this, self = shared_from_this()]() {
+        stopped_ = true;
+        ++generation_;
+        in_flight_.clear();
+    });
+}
+
+std::vector<Message> StreamingConsumer::poll(std::chrono::milliseconds timeout, size_t max_messages) {
+    std::vector<Message> messages;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait_for(lock, timeout, [this]() { return !buffer_.empty() || !error_.empty(); });
+        if (buffer_.empty()) {
+            if (!error_.empty()) throw std::runtime_error(error_);
+            return messages;
+        }
+        size_t count = std::min(max_messages, buffer_.size());
+        messages.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            buffered_bytes_ -= buffer_.front().payload.size();
+            messages.push_back(std::move(buffer_.front()));
+            buffer_.pop_front();
+        }
+        position_ = messages.back().offset + 1;
+    }
+    // Room was freed: let the strand fetch further ahead
+    boost::asio::post(strand_, [this, self = shared_from_this()]() { fill(); });
+    return messages;
+}
+
+uint64_t StreamingConsumer::position() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return position_;
+}
+
+void StreamingConsumer::fill() {
+    if (stopped_) return;
+    size_t buffered;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_.empty()) return;
+        buffered = buffered_bytes_;
+    }
+    size_t limit = at_tail_ ? 1 : config_.max_in_flight;
+    while (in_flight_.size() < limit) {
+        // Budget each fetch at its byte limit, but always keep one going while there's any room
+        size_t reserved = buffered + in_flight_.size() * config_.max_bytes_per_fetch;
+        if (!in_flight_.empty() && reserved + config_.max_bytes_per_fetch > config_.max_buffered_bytes) break;
+        if (reserved >= config_.max_buffered_bytes) break;
+        issue_fetch();
+    }
+}
+
+void StreamingConsumer::issue_fetch() {
+    in_flight_.push_back(std::make_unique<Fetch>());
+    Fetch* fetch = in_flight_.back().get();
+    fetch->start_offset = next_fetch_offset_;
+    next_fetch_offset_ += config_.max_messages_per_fetch;
+
+    client_->async_consume(topic_, fetch->start_offset, config_.max_messages_per_fetch,
+        [this, self = shared_from_this(), generation = generation_, fetch](const std::string& error, std::vector<Message> messages) {
+            boost::asio::dispatch(strand_, [this, self, generation, fetch, error, messages = std::move(messages)]() mutable {
+                on_fetch(generation, fetch, error, std::move(messages));
+            });
+        },
+        config_.max_wait_ms, 0, config_.max_bytes_per_fetch);
+}
+
+void StreamingConsumer::on_fetch(uint64_t generation, Fetch* fetch, const std::string& error, std::vector<Message> messages) {
+    if (generation != generation_) return; // Dropped; `fetch` is gone
+    fetch->done = true;
+    fetch->error = error;
+    fetch->messages = std::move(messages);
+    deliver_completed();
+    fill();
+}
+
+void StreamingConsumer::deliver_completed() {
+    // Responses may arrive out of order; hand them to the buffer in offset order
+    while (!in_flight_.empty() && in_flight_.front()->done) {
+        std::unique_ptr<Fetch> fetch = std::move(in_flight_.front());
+        in_flight_.pop_front();
+
+        if (!fetch->error.empty()) {
+            stopped_ = true;
+            ++generation_;
+            in_flight_.clear();
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = fetch->error;
+            ready_.notify_all();
+            return;
+        }
+        if (fetch->start_offset != received_offset_) {
+            // The guessed start was wrong (the previous batch spanned an offset gap): refetch from its end
+            ++generation_;
+            in_flight_.clear();
+            next_fetch_offset_ = received_offset_;
+            return;
+        }
+
+        bool full = fetch->messages.size() >= config_.max_messages_per_fetch;
+        if (!fetch->messages.empty()) {
+            received_offset_ = fetch->messages.back().offset + 1;
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& message : fetch->messages) {
+                buffered_bytes_ += message.payload.size();
+                buffer_.push_back(std::move(message));
+            }
+            ready_.notify_all();
+        }
+        at_tail_ = !full;
+        if (!full) {
+            // Whatever was fetched beyond this one was guessed from a full batch
+            ++generation_;
+            in_flight_.clear();
+        }
+        if (in_flight_.empty()) next_fetch_offset_ = received_offset_;
+    }
+}
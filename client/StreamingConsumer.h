@@ -0,0 +1,88 @@
+// client/StreamingConsumer.h
+#pragma once
+#include <boost/asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "AsyncTcpClient.h"
+
+// Reads a topic ahead of the application: keeps up to max_in_flight consumes outstanding on an
+// AsyncTcpClient and buffers their messages, up to max_buffered_bytes, so poll() usually returns
+// from memory while the next fetches are already on the wire.
+//
+// Fetches ahead of the delivered position are speculative: fetch k asks for the max_messages_per_fetch
+// offsets after fetch k-1. When a fetch comes back short (the consumer has caught up, or the batch hit
+// max_bytes), the speculative fetches behind it are dropped and fetching resumes, one long-poll at a
+// time, from the first offset not yet received. Messages are always delivered once each, in offset order.
+//
+// poll() is meant for one application thread, which must not be one that runs the io_context.
+class StreamingConsumer : public std::enable_shared_from_this<StreamingConsumer> {
+public:
+    struct Config {
+        size_t max_buffered_bytes = 4 * 1024 * 1024; // Payload bytes buffered plus requested by fetches in flight
+        size_t max_in_flight = 2;                    // Concurrent fetches while behind the end of the topic
+        uint32_t max_messages_per_fetch = 500;
+        uint32_t max_bytes_per_fetch = 1024 * 1024;  // Per-fetch max_bytes (0 = no byte limit)
+        uint32_t max_wait_ms = 500;                  // Long-poll wait once caught up; keep > 0 to avoid spinning
+    };
+
+    static std::shared_ptr<StreamingConsumer> create(std::shared_ptr<AsyncTcpClient> client,
+                                                     boost::asio::io_context& io_context,
+                                                     const std::string& topic, uint64_t start_offset, Config config);
+
+    // Begins fetching; call once
+    void start();
+    // Stops issuing fetches. Responses still in flight are discarded.
+    void stop();
+
+    // Waits up to `timeout` for messages and returns up to max_messages of them (empty on timeout).
+    // Throws std::runtime_error with the fetch error once the messages received before it are drained.
+    std::vector<Message> poll(std::chrono::milliseconds timeout,
+                              size_t max_messages = std::numeric_limits<size_t>::max());
+
+    // Offset of the next message poll() will return
+    uint64_t position() const;
+
+private:
+    StreamingConsumer(std::shared_ptr<AsyncTcpClient> client, boost::asio::io_context& io_context,
+                      const std::string& topic, uint64_t start_offset, Config config);
+
+    struct Fetch {
+        uint64_t start_offset;
+        bool done = false;
+        std::string error;
+        std::vector<Message> messages;
+    };
+
+    // Strand only
+    void fill();
+    void issue_fetch();
+    void on_fetch(uint64_t generation, Fetch* fetch, const std::string& error, std::vector<Message> messages);
+    void deliver_completed();
+
+    std::shared_ptr<AsyncTcpClient> client_;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    std::string topic_;
+    Config config_;
+
+    // Strand state
+    bool stopped_ = false;
+    bool at_tail_ = false;           // The last fetch came back short: fetch one at a time
+    uint64_t generation_ = 0;        // Bumped when in-flight fetches are dropped
+    uint64_t received_offset_;       // Next offset to append to the buffer
+    uint64_t next_fetch_offset_;     // Start offset for the next fetch issued
+    std::deque<std::unique_ptr<Fetch>> in_flight_; // In issue (= offset) order
+
+    // Shared with poll(), under mutex_
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Message> buffer_;
+    size_t buffered_bytes_ = 0;
+    uint64_t position_;
+    std::string error_;
+};
@@ -1,5 +1,6 @@
 // client/TcpClient.cpp
 #include "TcpClient.h"
+#include <array>
 #include <iostream>
 #include <boost/asio/read.hpp>
 #include <boost/asio/write.hpp>
@@ -38,6 +39,13 @@ bool TcpClient::send_request_receive_response(
     std::vector<char>& out_resp_payload,
     std::string& out_error_string)
 {
+    return write_request(req_header_struct, req_payload, out_error_string) &&
+           read_response(out_resp_header_struct, out_resp_payload, out_error_string);
+}
+
+bool TcpClient::write_request(const NetworkProtocol::RequestHeader& req_header_struct,
+                              const std::vector<char>& req_payload,
+                              std::string& out_error_string) {
     if (!socket_.is_open()) {
         out_error_string = "Socket not connected.";
         return false;
@@ -45,33 +53,61 @@ bool TcpClient::send_request_receive_response(
 
     boost::system::error_code ec;
 
-    // 1. Send request header
-    std::vector<char> req_header_bytes = req_header_struct.serialize();
-    boost::asio::write(socket_, boost::asio::buffer(req_header_bytes), ec);
+    // After a compression handshake every request is v2, so the payload can be flagged as compressed
+    NetworkProtocol::RequestHeader header = req_header_struct;
+    const std::vector<char>* payload = &req_payload;
+    if (codec_ != NetworkProtocol::CompressionCodec::NONE) {
+        header.v2 = true;
+        header.correlation_id = next_correlation_id_++;
+        compress_buffer_.clear();
+        if (req_payload.size() >= compression_threshold_ &&
+            Compression::compress_payload(codec_, 0, req_payload.data(), req_payload.size(), compress_buffer_)) {
+            header.flags |= NetworkProtocol::FLAG_COMPRESSED;
+            header.payload_length = static_cast<uint32_t>(compress_buffer_.size());
+            payload = &compress_buffer_;
+        }
+    }
+
+    // 1-2. Send request header and payload (if any) in one gathered write
+    std::array<char, NetworkProtocol::RequestHeader::SIZE + NetworkProtocol::RequestHeader::EXTENSION_SIZE> req_header_bytes;
+    header.serialize_into(req_header_bytes.data());
+    std::array<boost::asio::const_buffer, 2> buffers = {
+        boost::asio::buffer(req_header_bytes.data(), header.size()),
+        boost::asio::buffer(*payload)
+    };
+    boost::asio::write(socket_, buffers, ec);
     if (ec) {
-        out_error_string = "Send request header failed: " + ec.message();
+        out_error_string = "Send request failed: " + ec.message();
         return false;
     }
+    return true;
+}
 
-    // 2. Send request payload (if any)
-    if (!req_payload.empty()) {
-        boost::asio::write(socket_, boost::asio::buffer(req_payload), ec);
-        if (ec) {
-            out_error_string = "Send request payload failed: " + ec.message();
-            return false;
-        }
-    }
+bool TcpClient::read_response(NetworkProtocol::ResponseHeader& out_resp_header_struct,
+                              std::vector<char>& out_resp_payload,
+                              std::string& out_error_string) {
+    boost::system::error_code ec;
 
     // 3. Read response header
-    std::vector<char> resp_header_bytes(NetworkProtocol::ResponseHeader::SIZE);
+    std::array<char, NetworkProtocol::ResponseHeader::SIZE> resp_header_bytes;
     boost::asio::read(socket_, boost::asio::buffer(resp_header_bytes), ec);
     if (ec) {
         out_error_string = "Read response header failed: " + ec.message();
         return false;
     }
     out_resp_header_struct = NetworkProtocol::ResponseHeader::deserialize(resp_header_bytes.data());
+    if (codec_ != NetworkProtocol::CompressionCodec::NONE) { // Replies to v2 requests carry the extension
+        std::array<char, NetworkProtocol::ResponseHeader::EXTENSION_SIZE> extension_bytes;
+        boost::asio::read(socket_, boost::asio::buffer(extension_bytes), ec);
+        if (ec) {
+            out_error_string = "Read response header extension failed: " + ec.message();
+            return false;
+        }
+        out_resp_header_struct.deserialize_extension(extension_bytes.data());
+    }
 
     // 4. Read response payload (if any)
+    out_resp_payload.clear();
     if (out_resp_header_struct.payload_length > 0) {
         if (out_resp_header_struct.payload_length > NetworkProtocol::MAX_PAYLOAD_SIZE) {
             out_error_string = "Server response payload too large: " + std::to_string(out_resp_header_struct.payload_length);
@@ -85,16 +121,30 @@ bool TcpClient::send_request_receive_response(
             out_error_string = "Read response payload failed: " + ec.message();
             return false;
         }
+        if (out_resp_header_struct.flags & NetworkProtocol::FLAG_COMPRESSED) {
+            try {
+                Compression::decompress_payload(codec_, out_resp_payload.data(), out_resp_payload.size(), compress_buffer_);
+            } catch (const std::exception& e) {
+                out_error_string = "Failed to decompress response: " + std::string(e.what());
+                return false;
+            }
+            out_resp_payload.swap(compress_buffer_);
+            out_resp_header_struct.flags &= static_cast<uint8_t>(~NetworkProtocol::FLAG_COMPRESSED);
+            out_resp_header_struct.payload_length = static_cast<uint32_t>(out_resp_payload.size());
+        }
     }
     return true;
 }
 
 
 bool TcpClient::produce(const std::string& topic, const std::string& payload, uint64_t& out_offset, std::string& out_error) {
-    NetworkProtocol::ProduceRequest req_payload_struct;
-    req_payload_struct.topic_name = topic;
-    req_payload_struct.message_payload = payload;
-    std::vector<char> req_payload_bytes = req_payload_struct.serialize();
+    // Encoded straight into the reused request buffer, without copying into a ProduceRequest first
+    std::vector<char>& req_payload_bytes = request_buffer_;
+    req_payload_bytes.clear();
+    NetworkProtocol::BufferWriter writer(req_payload_bytes);
+    writer.reserve(sizeof(uint16_t) + topic.size() + sizeof(uint32_t) + payload.size());
+    writer.put_string(topic);
+    writer.put_string(payload, false);
 
     NetworkProtocol::RequestHeader req_header;
     req_header.type = NetworkProtocol::CommandType::PRODUCE_REQUEST;
@@ -131,12 +181,18 @@ bool TcpClient::produce(const std::string& topic, const std::string& payload, ui
 }
 
 bool TcpClient::consume(const std::string& topic, uint64_t start_offset, uint32_t max_messages, 
-                        std::vector<Message>& out_messages, std::string& out_error) {
+                        std::vector<Message>& out_messages, std::string& out_error,
+                        uint32_t max_wait_ms, uint32_t min_bytes, uint32_t max_bytes) {
     NetworkProtocol::ConsumeRequest req_payload_struct;
     req_payload_struct.topic_name = topic;
     req_payload_struct.start_offset = start_offset;
     req_payload_struct.max_messages = max_messages;
-    std::vector<char> req_payload_bytes = req_payload_struct.serialize();
+    req_payload_struct.max_wait_ms = max_wait_ms;
+    req_payload_struct.min_bytes = min_bytes;
+    req_payload_struct.max_bytes = max_bytes;
+    std::vector<char>& req_payload_bytes = request_buffer_;
+    req_payload_bytes.clear();
+    req_payload_struct.serialize_into(req_payload_bytes);
 
     NetworkProtocol::RequestHeader req_header;
     req_header.type = NetworkProtocol::CommandType::CONSUME_REQUEST;
@@ -280,3 +336,234 @@ bool TcpClient::list_topics(std::vector<std::string>& out_topics, std::string& o
         return false;
     }
 }
+
+bool TcpClient::produce_batch(const NetworkProtocol::ProduceBatchRequest& request,
+                              std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>& out_results, std::string& out_error) {
+    std::vector<char> req_payload_bytes = request.serialize();
+
+    NetworkProtocol::RequestHeader req_header;
+    req_header.type = NetworkProtocol::CommandType::PRODUCE_BATCH_REQUEST;
+    req_header.payload_length = static_cast<uint32_t>(req_payload_bytes.size());
+
+    NetworkProtocol::ResponseHeader resp_header;
+    std::vector<char> resp_payload_bytes;
+
+    if (!send_request_receive_response(req_header, req_payload_bytes, resp_header, resp_payload_bytes, out_error)) {
+        return false;
+    }
+
+    if (resp_header.status == NetworkProtocol::StatusCode::SUCCESS) {
+        if (resp_header.type != NetworkProtocol::CommandType::PRODUCE_BATCH_RESPONSE) {
+             out_error = "Unexpected response type for PRODUCE_BATCH."; return false;
+        }
+        try {
+            out_results = NetworkProtocol::ProduceBatchResponse::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size()).results;
+            return true;
+        } catch (const std::exception& e) {
+            out_error = "Failed to deserialize PRODUCE_BATCH response: " + std::string(e.what());
+            return false;
+        }
+    } else {
+         try {
+            NetworkProtocol::ErrorResponsePayload err_resp = NetworkProtocol::ErrorResponsePayload::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size());
+            out_error = "Server error (PRODUCE_BATCH): " + err_resp.error_message + " (Status: " + std::to_string(static_cast<int>(resp_header.status)) + ")";
+        } catch (const std::exception& e) {
+            out_error = "Server error (PRODUCE_BATCH), and failed to parse error message. Status: " + std::to_string(static_cast<int>(resp_header.status));
+        }
+        return false;
+    }
+}
+
+bool TcpClient::fetch(const std::vector<NetworkProtocol::FetchRequest::Entry>& entries,
+                      std::vector<NetworkProtocol::FetchResponse::Entry>& out_entries, std::string& out_error) {
+    std::vector<char> req_payload_bytes = NetworkProtocol::FetchRequest{entries}.serialize();
+
+    NetworkProtocol::RequestHeader req_header;
+    req_header.type = NetworkProtocol::CommandType::FETCH_REQUEST;
+    req_header.payload_length = static_cast<uint32_t>(req_payload_bytes.size());
+
+    NetworkProtocol::ResponseHeader resp_header;
+    std::vector<char> resp_payload_bytes;
+
+    if (!send_request_receive_response(req_header, req_payload_bytes, resp_header, resp_payload_bytes, out_error)) {
+        return false;
+    }
+
+    if (resp_header.status == NetworkProtocol::StatusCode::SUCCESS) {
+        if (resp_header.type != NetworkProtocol::CommandType::FETCH_RESPONSE) {
+             out_error = "Unexpected response type for FETCH."; return false;
+        }
+        try {
+            out_entries = NetworkProtocol::FetchResponse::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size()).entries;
+            return true;
+        } catch (const std::exception& e) {
+            out_error = "Failed to deserialize FETCH response: " + std::string(e.what());
+            return false;
+        }
+    } else {
+         try {
+            NetworkProtocol::ErrorResponsePayload err_resp = NetworkProtocol::ErrorResponsePayload::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size());
+            out_error = "Server error (FETCH): " + err_resp.error_message + " (Status: " + std::to_string(static_cast<int>(resp_header.status)) + ")";
+        } catch (const std::exception& e) {
+            out_error = "Server error (FETCH), and failed to parse error message. Status: " + std::to_string(static_cast<int>(resp_header.status));
+        }
+        return false;
+    }
+}
+
+bool TcpClient::subscribe(const std::string& topic, uint64_t start_offset, uint32_t credit_bytes,
+                          uint64_t& out_next_offset, std::string& out_error) {
+    NetworkProtocol::SubscribeRequest req_payload_struct;
+    req_payload_struct.topic_name = topic;
+    req_payload_struct.start_offset = start_offset;
+    req_payload_struct.credit_bytes = credit_bytes;
+    std::vector<char> req_payload_bytes = req_payload_struct.serialize();
+
+    NetworkProtocol::RequestHeader req_header;
+    req_header.type = NetworkProtocol::CommandType::SUBSCRIBE_REQUEST;
+    req_header.payload_length = static_cast<uint32_t>(req_payload_bytes.size());
+
+    NetworkProtocol::ResponseHeader resp_header;
+    std::vector<char> resp_payload_bytes;
+
+    if (!send_request_receive_response(req_header, req_payload_bytes, resp_header, resp_payload_bytes, out_error)) {
+        return false;
+    }
+
+    if (resp_header.status == NetworkProtocol::StatusCode::SUCCESS) {
+        if (resp_header.type != NetworkProtocol::CommandType::SUBSCRIBE_RESPONSE) {
+             out_error = "Unexpected response type for SUBSCRIBE."; return false;
+        }
+        try {
+            size_t offset = 0;
+            out_next_offset = NetworkProtocol::read_uint64_from_buffer(resp_payload_bytes.data(), offset);
+            return true;
+        } catch (const std::exception& e) {
+            out_error = "Failed to deserialize SUBSCRIBE response: " + std::string(e.what());
+            return false;
+        }
+    } else {
+         try {
+            NetworkProtocol::ErrorResponsePayload err_resp = NetworkProtocol::ErrorResponsePayload::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size());
+            out_error = "Server error (SUBSCRIBE): " + err_resp.error_message + " (Status: " + std::to_string(static_cast<int>(resp_header.status)) + ")";
+        } catch (const std::exception& e) {
+            out_error = "Server error (SUBSCRIBE), and failed to parse error message. Status: " + std::to_string(static_cast<int>(resp_header.status));
+        }
+        return false;
+    }
+}
+
+bool TcpClient::add_subscription_credit(const std::string& topic, uint32_t credit_bytes, std::string& out_error) {
+    NetworkProtocol::SubscriptionCredit credit;
+    credit.topic_name = topic;
+    credit.credit_bytes = credit_bytes;
+    std::vector<char> req_payload_bytes = credit.serialize();
+
+    NetworkProtocol::RequestHeader req_header;
+    req_header.type = NetworkProtocol::CommandType::SUBSCRIPTION_CREDIT;
+    req_header.payload_length = static_cast<uint32_t>(req_payload_bytes.size());
+    return write_request(req_header, req_payload_bytes, out_error); // No response is sent for credit
+}
+
+bool TcpClient::read_push(std::string& out_topic, std::vector<Message>& out_messages, std::string& out_error) {
+    NetworkProtocol::ResponseHeader resp_header;
+    std::vector<char> resp_payload_bytes;
+    if (!read_response(resp_header, resp_payload_bytes, out_error)) {
+        return false;
+    }
+    if (resp_header.type != NetworkProtocol::CommandType::MESSAGE_PUSH) {
+        out_error = "Unexpected frame type while waiting for MESSAGE_PUSH: " + std::to_string(static_cast<int>(resp_header.type));
+        return false;
+    }
+    try {
+        NetworkProtocol::MessagePush push = NetworkProtocol::MessagePush::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size());
+        out_topic = std::move(push.topic_name);
+        out_messages = std::move(push.messages);
+        return true;
+    } catch (const std::exception& e) {
+        out_error = "Failed to deserialize MESSAGE_PUSH: " + std::string(e.what());
+        return false;
+    }
+}
+
+bool TcpClient::unsubscribe(const std::string& topic, std::string& out_error) {
+    std::vector<char> req_payload_bytes;
+    NetworkProtocol::write_string_to_buffer(req_payload_bytes, topic);
+
+    NetworkProtocol::RequestHeader req_header;
+    req_header.type = NetworkProtocol::CommandType::UNSUBSCRIBE_REQUEST;
+    req_header.payload_length = static_cast<uint32_t>(req_payload_bytes.size());
+    if (!write_request(req_header, req_payload_bytes, out_error)) {
+        return false;
+    }
+
+    NetworkProtocol::ResponseHeader resp_header;
+    std::vector<char> resp_payload_bytes;
+    do { // Skip pushes the server sent before it saw the request
+        if (!read_response(resp_header, resp_payload_bytes, out_error)) {
+            return false;
+        }
+    } while (resp_header.type == NetworkProtocol::CommandType::MESSAGE_PUSH);
+
+    if (resp_header.status == NetworkProtocol::StatusCode::SUCCESS) {
+        if (resp_header.type != NetworkProtocol::CommandType::UNSUBSCRIBE_RESPONSE) {
+             out_error = "Unexpected response type for UNSUBSCRIBE."; return false;
+        }
+        return true;
+    } else {
+         try {
+            NetworkProtocol::ErrorResponsePayload err_resp = NetworkProtocol::ErrorResponsePayload::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size());
+            out_error = "Server error (UNSUBSCRIBE): " + err_resp.error_message + " (Status: " + std::to_string(static_cast<int>(resp_header.status)) + ")";
+        } catch (const std::exception& e) {
+            out_error = "Server error (UNSUBSCRIBE), and failed to parse error message. Status: " + std::to_string(static_cast<int>(resp_header.status));
+        }
+        return false;
+    }
+}
+
+bool TcpClient::negotiate_compression(NetworkProtocol::CompressionCodec& out_codec, std::string& out_error,
+                                      const std::vector<NetworkProtocol::CompressionCodec>& codecs) {
+    NetworkProtocol::HandshakeRequest req;
+    for (auto codec : codecs) {
+        if (Compression::is_available(codec)) req.codecs.push_back(codec); // Only offer what we can decode
+    }
+    std::vector<char> req_payload_bytes = req.serialize();
+
+    NetworkProtocol::RequestHeader req_header;
+    req_header.type = NetworkProtocol::CommandType::HANDSHAKE_REQUEST;
+    req_header.payload_length = static_cast<uint32_t>(req_payload_bytes.size());
+
+    NetworkProtocol::ResponseHeader resp_header;
+    std::vector<char> resp_payload_bytes;
+    if (!send_request_receive_response(req_header, req_payload_bytes, resp_header, resp_payload_bytes, out_error)) {
+        return false;
+    }
+
+    if (resp_header.status == NetworkProtocol::StatusCode::SUCCESS) {
+        if (resp_header.type != NetworkProtocol::CommandType::HANDSHAKE_RESPONSE) {
+             out_error = "Unexpected response type for HANDSHAKE."; return false;
+        }
+        try {
+            NetworkProtocol::HandshakeResponse resp = NetworkProtocol::HandshakeResponse::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size());
+            if (resp.codec != NetworkProtocol::CompressionCodec::NONE && !Compression::is_available(resp.codec)) {
+                out_error = "Server chose a codec that was not offered.";
+                return false;
+            }
+            codec_ = resp.codec;
+            compression_threshold_ = resp.compression_threshold;
+            out_codec = resp.codec;
+            return true;
+        } catch (const std::exception& e) {
+            out_error = "Failed to deserialize HANDSHAKE response: " + std::string(e.what());
+            return false;
+        }
+    } else {
+         try {
+            NetworkProtocol::ErrorResponsePayload err_resp = NetworkProtocol::ErrorResponsePayload::deserialize(resp_payload_bytes.data(), resp_payload_bytes.size());
+            out_error = "Server error (HANDSHAKE): " + err_resp.error_message + " (Status: " + std::to_string(static_cast<int>(resp_header.status)) + ")";
+        } catch (const std::exception& e) {
+            out_error = "Server error (HANDSHAKE), and failed to parse error message. Status: " + std::to_string(static_cast<int>(resp_header.status));
+        }
+        return false;
+    }
+}
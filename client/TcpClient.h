@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include "../network/NetworkProtocol.h" // For structures and enums
+#include "../network/Compression.h"
 #include "../event_queue_core/Message.h" // For Message struct
 
 using boost::asio::ip::tcp;
@@ -18,11 +19,36 @@ public:
 
     // Methods for each command
     bool produce(const std::string& topic, const std::string& payload, uint64_t& out_offset, std::string& out_error);
+    // max_wait_ms > 0 makes this a long-poll: the server answers once min_bytes are available or the wait elapses.
+    // max_bytes bounds the response size (0 = server default).
     bool consume(const std::string& topic, uint64_t start_offset, uint32_t max_messages, 
-                 std::vector<Message>& out_messages, std::string& out_error);
+                 std::vector<Message>& out_messages, std::string& out_error,
+                 uint32_t max_wait_ms = 0, uint32_t min_bytes = 0, uint32_t max_bytes = 0);
     bool get_topic_offset(const std::string& topic, uint64_t& out_offset, std::string& out_error);
     bool create_topic(const std::string& topic, std::string& out_error);
     bool list_topics(std::vector<std::string>& out_topics, std::string& out_error);
+    // One round trip for many messages across topics; out_results holds one entry per topic (check each status)
+    bool produce_batch(const NetworkProtocol::ProduceBatchRequest& request,
+                       std::vector<NetworkProtocol::ProduceBatchResponse::TopicResult>& out_results, std::string& out_error);
+    // Reads several (topic, offset, max_bytes) entries at once; out_entries is in request order
+    bool fetch(const std::vector<NetworkProtocol::FetchRequest::Entry>& entries,
+               std::vector<NetworkProtocol::FetchResponse::Entry>& out_entries, std::string& out_error);
+
+    // Push subscriptions. After subscribe(), call read_push() to receive message batches and
+    // add_subscription_credit() to let more through; pushes stop once credit_bytes are used up.
+    // A subscribed connection should not be used for other requests until unsubscribe().
+    bool subscribe(const std::string& topic, uint64_t start_offset, uint32_t credit_bytes,
+                   uint64_t& out_next_offset, std::string& out_error);
+    bool add_subscription_credit(const std::string& topic, uint32_t credit_bytes, std::string& out_error);
+    bool read_push(std::string& out_topic, std::vector<Message>& out_messages, std::string& out_error);
+    // Pushes that arrive before the server's reply are discarded
+    bool unsubscribe(const std::string& topic, std::string& out_error);
+
+    // Wire compression. Offers `codecs` (most preferred first) in a HANDSHAKE; if the server picks one,
+    // every later request is sent as a v2 frame and payloads from the server's threshold up are
+    // compressed both ways. Call right after connect(). out_codec is NONE if nothing was agreed.
+    bool negotiate_compression(NetworkProtocol::CompressionCodec& out_codec, std::string& out_error,
+                               const std::vector<NetworkProtocol::CompressionCodec>& codecs = Compression::available_codecs());
 
 
 private:
@@ -34,10 +60,20 @@ private:
         std::vector<char>& out_resp_payload,
         std::string& out_error_string
     );
+    bool write_request(const NetworkProtocol::RequestHeader& req_header, const std::vector<char>& req_payload,
+                       std::string& out_error_string);
+    bool read_response(NetworkProtocol::ResponseHeader& out_resp_header, std::vector<char>& out_resp_payload,
+                       std::string& out_error_string);
 
     boost::asio::io_context& io_context_;
     tcp::socket socket_;
     tcp::resolver::results_type endpoints_;
+    std::vector<char> request_buffer_; // Request payloads are encoded here; reused so steady-state requests don't allocate
+    // Negotiated compression; once set, requests use v2 framing so they can carry FLAG_COMPRESSED
+    NetworkProtocol::CompressionCodec codec_ = NetworkProtocol::CompressionCodec::NONE;
+    uint32_t compression_threshold_ = 0;
+    uint32_t next_correlation_id_ = 1;
+    std::vector<char> compress_buffer_; // Reused for compressed request payloads and compressed responses
     std::string host_;
     short port_;
 };
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 
 namespace BinaryUtils {
@@ -29,7 +30,9 @@ namespace BinaryUtils {
     }
 
     // DECLARATIONS for non-template functions
-    void write_string(std::ofstream& ofs, const std::string& str);
+    void write_string(std::ofstream& ofs, std::string_view str);
     std::string read_string(std::ifstream& ifs);
+    // Reads `len` bytes of string data (length prefix already consumed) into `out`, reusing its capacity
+    void read_string_data(std::ifstream& ifs, uint32_t len, std::string& out);
 
 }
\ No newline at end of file
@@ -1,6 +1,13 @@
 #include <iostream>
 #include "EventQueue.h"
 
+std::vector<Message> EventQueue::consume(std::string_view topic_name, uint64_t start_offset, uint32_t max_messages,
+                                         std::chrono::milliseconds max_wait, uint32_t min_bytes, uint64_t max_bytes) {
+    std::vector<Message> messages;
+    consume_into(topic_name, start_offset, max_messages, max_bytes, messages, max_wait, min_bytes);
+    return messages;
+}
+
 void EventQueue::add_listener(INewMessageListener* listener) {
     if (listener) {
         std::lock_guard<std::mutex> lock(listeners_mutex_);
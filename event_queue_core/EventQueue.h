@@ -1,26 +1,73 @@
+// EventQueue.h
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <cstdint>
 #include "INewMessageListener.h"
 
 class EventQueue {
 public:
-    virtual std::vector<std::string> list_topics();
+    // Invoked once when a long-poll waiter's condition is met. Runs on the producing thread,
+    // so implementations should only hand off (e.g. post to their own executor).
+    using DataReadyCallback = std::function<void()>;
+
+    virtual ~EventQueue() = default;
+
+    virtual std::vector<std::string> list_topics() = 0;
 
     // Explicitly creates a topic if it doesn't exist.
     // Produce also creates topics on demand.
-    virtual bool create_topic(const std::string& topic_name);
+    virtual bool create_topic(std::string_view topic_name) = 0;
+
+    // Returns the offset of the produced message.
+    // Topic names and payloads are taken as views so network layers can pass slices of their
+    // receive buffers without copying; implementations copy only what they keep.
+    virtual uint64_t produce(std::string_view topic_name, std::string_view payload) = 0;
+
+    // Appends several messages to one topic in a single write. Offsets are contiguous;
+    // returns the offset of the first message.
+    virtual uint64_t produce_batch(std::string_view topic_name, const std::vector<std::string_view>& payloads) = 0;
+
+    // Consumes messages from a specific topic starting at start_offset into a caller-owned buffer,
+    // which is overwritten in place (so a buffer reused across calls stops allocating once warm)
+    // and resized to the number of messages returned.
+    // max_bytes bounds the total size of the returned log records (0 = unbounded); at least one
+    // message is returned if any is available.
+    // If max_wait is non-zero and fewer than min_bytes (at least one message) are available,
+    // blocks the calling thread until enough data arrives or max_wait elapses.
+    virtual size_t consume_into(std::string_view topic_name, uint64_t start_offset, uint32_t max_messages,
+                                uint64_t max_bytes, std::vector<Message>& out,
+                                std::chrono::milliseconds max_wait = std::chrono::milliseconds::zero(),
+                                uint32_t min_bytes = 0) = 0;
+
+    // Convenience wrapper around consume_into that returns a fresh vector.
+    std::vector<Message> consume(std::string_view topic_name, uint64_t start_offset, uint32_t max_messages = 100,
+                                 std::chrono::milliseconds max_wait = std::chrono::milliseconds::zero(),
+                                 uint32_t min_bytes = 0, uint64_t max_bytes = 0);
 
-    // Returns the offset of the produced message
-    virtual uint64_t produce(const std::string& topic_name, const std::string& payload);
+    // Returns the offset that will be assigned to the next message produced to the topic.
+    virtual uint64_t get_next_topic_offset(std::string_view topic_name) = 0;
 
-    // Consumes messages from a specific topic starting at start_offset
-    virtual std::vector<Message> consume(const std::string& topic_name, uint64_t start_offset, uint32_t max_messages = 100);
+    // Non-blocking variant of the long-poll wait for event-loop callers.
+    // Registers a one-shot waiter that fires once min_bytes (at least one message) are available
+    // at or after start_offset. Returns 0 if data is already available (the callback is not stored),
+    // otherwise an id that can be passed to cancel_wait().
+    virtual uint64_t wait_for_messages_async(std::string_view topic_name, uint64_t start_offset,
+                                             uint32_t min_bytes, DataReadyCallback on_ready) = 0;
+    virtual void cancel_wait(std::string_view topic_name, uint64_t waiter_id) = 0;
 
     void add_listener(INewMessageListener* listener);
     void remove_listener(INewMessageListener* listener);
 
 protected:
-    void notify_new_message(Message new_msg); 
+    void notify_new_message(Message new_msg);
 
 private:
     std::set<INewMessageListener*> listeners_;
     std::mutex listeners_mutex_;
-};
\ No newline at end of file
+};
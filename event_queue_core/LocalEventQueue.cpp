@@ -41,7 +41,7 @@ void LocalEventQueue::load_existing_topics() {
 }
 
 
-Topic* LocalEventQueue::get_or_create_topic(const std::string& topic_name) {
+Topic* LocalEventQueue::get_or_create_topic(std::string_view topic_name) {
     // First, try read-only access to avoid locking if topic exists
     {
         // No lock here for the read, relying on map's thread-safety for find if elements are not modified.
@@ -65,9 +65,19 @@ Topic* LocalEventQueue::get_or_create_topic(const std::string& topic_name) {
     std::cout << "Creating new topic: " << topic_name << std::endl;
     fs::path topic_dir_path = fs::path(base_data_dir_) / topic_name;
     try {
-        auto new_topic = std::make_unique<Topic>(topic_name, topic_dir_path.string());
+        auto new_topic = std::make_unique<Topic>(std::string(topic_name), topic_dir_path.string());
         Topic* new_topic_ptr = new_topic.get();
-        topics_[topic_name] = std::move(new_topic);
+        topics_.emplace(std::string(topic_name), std::move(new_topic));
+
+        // Long polls that were waiting for the topic to exist now wait for its data
+        auto parked = parked_waiters_.find(topic_name);
+        if (parked != parked_waiters_.end()) {
+            for (auto& [waiter_id, waiter] : parked->second) {
+                new_topic_ptr->add_data_waiter(waiter_id, waiter.start_offset, waiter.min_bytes, std::move(waiter.on_ready));
+            }
+            parked_waiters_.erase(parked);
+        }
+        topic_created_cv_.notify_all();
         return new_topic_ptr;
     } catch (const std::exception& e) {
         std::cerr << "Failed to create topic " << topic_name << ": " << e.what() << std::endl;
@@ -75,47 +85,133 @@ Topic* LocalEventQueue::get_or_create_topic(const std::string& topic_name) {
     }
 }
 
-bool LocalEventQueue::create_topic(const std::string& topic_name) {
+bool LocalEventQueue::create_topic(std::string_view topic_name) {
     return get_or_create_topic(topic_name) != nullptr;
 }
 
 
-uint64_t LocalEventQueue::produce(const std::string& topic_name, const std::string& payload) {
+uint64_t LocalEventQueue::produce(std::string_view topic_name, std::string_view payload) {
     if (topic_name.empty() || payload.empty()) {
         throw std::invalid_argument("Topic name and payload cannot be empty.");
     }
     Topic* topic = get_or_create_topic(topic_name);
     if (!topic) {
-        throw std::runtime_error("Failed to get or create topic: " + topic_name);
+        throw std::runtime_error("Failed to get or create topic: " + std::string(topic_name));
     }
 
     uint64_t offset = topic->append_message(payload);
 
-    Message new_msg(offset, topic_name, payload);
+    Message new_msg(offset, std::string(topic_name), std::string(payload));
     notify_new_message(new_msg);
 
     return offset;
 }
 
-std::vector<Message> LocalEventQueue::consume(const std::string& topic_name, uint64_t start_offset, uint32_t max_messages) {
+uint64_t LocalEventQueue::produce_batch(std::string_view topic_name, const std::vector<std::string_view>& payloads) {
+    if (topic_name.empty() || payloads.empty()) {
+        throw std::invalid_argument("Topic name and batch cannot be empty.");
+    }
+    for (const auto& payload : payloads) {
+        if (payload.empty()) {
+            throw std::invalid_argument("Payload cannot be empty.");
+        }
+    }
+    Topic* topic = get_or_create_topic(topic_name);
+    if (!topic) {
+        throw std::runtime_error("Failed to get or create topic: " + std::string(topic_name));
+    }
+
+    uint64_t first_offset = topic->append_messages(payloads);
+
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        notify_new_message(Message(first_offset + i, std::string(topic_name), std::string(payloads[i])));
+    }
+    return first_offset;
+}
+
+Topic* LocalEventQueue::find_topic(std::string_view topic_name) {
+    std::lock_guard<std::mutex> lock(topics_map_mutex_); // Protect map access during find
+    auto it = topics_.find(topic_name);
+    if (it == topics_.end()) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+size_t LocalEventQueue::consume_into(std::string_view topic_name, uint64_t start_offset, uint32_t max_messages,
+                                     uint64_t max_bytes, std::vector<Message>& out,
+                                     std::chrono::milliseconds max_wait, uint32_t min_bytes) {
     if (topic_name.empty()) {
         throw std::invalid_argument("Topic name cannot be empty.");
     }
-    Topic* topic = nullptr;
-    {
-        std::lock_guard<std::mutex> lock(topics_map_mutex_); // Protect map access during find
-        auto it = topics_.find(topic_name);
-        if (it == topics_.end()) {
-            // Option 1: Topic doesn't exist, return empty
-            // std::cerr << "Consume warning: Topic " << topic_name << " does not exist." << std::endl;
-            return {}; 
-            // Option 2: Throw error
-            // throw std::runtime_error("Topic not found: " + topic_name);
+    Topic* topic = find_topic(topic_name);
+    if (max_wait > std::chrono::milliseconds::zero()) {
+        // Long-poll. A topic that doesn't exist yet is waited for without creating it: a read must
+        // not create topics.
+        auto deadline = std::chrono::steady_clock::now() + max_wait;
+        if (!topic) {
+            std::unique_lock<std::mutex> lock(topics_map_mutex_);
+            topic_created_cv_.wait_until(lock, deadline, [&]() {
+                auto it = topics_.find(topic_name);
+                topic = it != topics_.end() ? it->second.get() : nullptr;
+                return topic != nullptr;
+            });
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (topic && remaining > std::chrono::milliseconds::zero()) {
+            topic->wait_for_data(start_offset, min_bytes, remaining);
         }
-        topic = it->second.get();
+    }
+    if (!topic) {
+        // Option 1: Topic doesn't exist, return empty
+        // std::cerr << "Consume warning: Topic " << topic_name << " does not exist." << std::endl;
+        out.clear();
+        return 0;
+        // Option 2: Throw error
+        // throw std::runtime_error("Topic not found: " + topic_name);
     }
     // Topic object itself has its own mutex for file operations
-    return topic->get_messages(start_offset, max_messages);
+    return topic->read_messages(start_offset, max_messages, max_bytes, out);
+}
+
+uint64_t LocalEventQueue::get_next_topic_offset(std::string_view topic_name) {
+    Topic* topic = find_topic(topic_name);
+    return topic ? topic->get_next_offset() : 0;
+}
+
+uint64_t LocalEventQueue::wait_for_messages_async(std::string_view topic_name, uint64_t start_offset,
+                                                  uint32_t min_bytes, DataReadyCallback on_ready) {
+    if (topic_name.empty()) {
+        throw std::invalid_argument("Topic name cannot be empty.");
+    }
+    uint64_t waiter_id = next_waiter_id_++;
+    // Under the map lock, so the topic can't be created between the lookup and parking the waiter
+    std::lock_guard<std::mutex> lock(topics_map_mutex_);
+    auto it = topics_.find(topic_name);
+    if (it != topics_.end()) {
+        return it->second->add_data_waiter(waiter_id, start_offset, min_bytes, std::move(on_ready)) ? waiter_id : 0;
+    }
+    auto parked = parked_waiters_.find(topic_name);
+    if (parked == parked_waiters_.end()) {
+        parked = parked_waiters_.emplace(std::string(topic_name), std::map<uint64_t, ParkedWaiter>{}).first;
+    }
+    parked->second.emplace(waiter_id, ParkedWaiter{start_offset, min_bytes, std::move(on_ready)});
+    return waiter_id;
+}
+
+void LocalEventQueue::cancel_wait(std::string_view topic_name, uint64_t waiter_id) {
+    if (waiter_id == 0) return;
+    std::lock_guard<std::mutex> lock(topics_map_mutex_);
+    auto it = topics_.find(topic_name);
+    if (it != topics_.end()) {
+        it->second->remove_data_waiter(waiter_id);
+        return;
+    }
+    auto parked = parked_waiters_.find(topic_name);
+    if (parked != parked_waiters_.end()) {
+        parked->second.erase(waiter_id);
+        if (parked->second.empty()) parked_waiters_.erase(parked);
+    }
 }
 
 std::vector<std::string> LocalEventQueue::list_topics() {
@@ -6,6 +6,8 @@
 #include <set>
 #include <map>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <memory> // For std::unique_ptr
 #include <filesystem>
 #include "INewMessageListener.h" 
@@ -19,24 +21,52 @@ public:
     LocalEventQueue(const LocalEventQueue&) = delete;
     LocalEventQueue& operator=(const LocalEventQueue&) = delete;
 
-    std::vector<std::string> list_topics();
+    std::vector<std::string> list_topics() override;
 
     // Explicitly creates a topic if it doesn't exist.
     // Produce also creates topics on demand.
-    bool create_topic(const std::string& topic_name);
+    bool create_topic(std::string_view topic_name) override;
 
     // Returns the offset of the produced message
-    uint64_t produce(const std::string& topic_name, const std::string& payload);
+    uint64_t produce(std::string_view topic_name, std::string_view payload) override;
+    uint64_t produce_batch(std::string_view topic_name, const std::vector<std::string_view>& payloads) override;
 
     // Consumes messages from a specific topic starting at start_offset
-    std::vector<Message> consume(const std::string& topic_name, uint64_t start_offset, uint32_t max_messages = 100);
-    
+    // (optionally long-polling for up to max_wait, see EventQueue::consume_into)
+    size_t consume_into(std::string_view topic_name, uint64_t start_offset, uint32_t max_messages,
+                        uint64_t max_bytes, std::vector<Message>& out,
+                        std::chrono::milliseconds max_wait = std::chrono::milliseconds::zero(),
+                        uint32_t min_bytes = 0) override;
+    using EventQueue::consume;
+
+    uint64_t get_next_topic_offset(std::string_view topic_name) override;
+
+    // Long-poll waiters are kept per topic. Waiting on a topic that does not exist yet doesn't create
+    // it: the waiter is parked under the name and moved onto the topic when a produce or
+    // CREATE_TOPIC creates it.
+    uint64_t wait_for_messages_async(std::string_view topic_name, uint64_t start_offset,
+                                     uint32_t min_bytes, DataReadyCallback on_ready) override;
+    void cancel_wait(std::string_view topic_name, uint64_t waiter_id) override;
+
 
 private:
-    Topic* get_or_create_topic(const std::string& topic_name);
+    Topic* get_or_create_topic(std::string_view topic_name);
+    Topic* find_topic(std::string_view topic_name);
     void load_existing_topics();
 
     std::string base_data_dir_;
-    std::map<std::string, std::unique_ptr<Topic>> topics_;
-    std::mutex topics_map_mutex_; // Mutex for accessing the topics_ map
+    // std::less<> makes lookups by string_view work without building a std::string key
+    std::map<std::string, std::unique_ptr<Topic>, std::less<>> topics_;
+    std::mutex topics_map_mutex_; // Mutex for accessing the topics_ map (and the waiters below)
+
+    // Long-poll waiters for topics that don't exist yet, adopted by the topic when it is created.
+    // Blocking waiters wait on topic_created_cv_ instead.
+    struct ParkedWaiter {
+        uint64_t start_offset;
+        uint32_t min_bytes;
+        DataReadyCallback on_ready;
+    };
+    std::map<std::string, std::map<uint64_t, ParkedWaiter>, std::less<>> parked_waiters_;
+    std::condition_variable topic_created_cv_;
+    std::atomic<uint64_t> next_waiter_id_{1}; // Waiter ids are unique across topics
 };
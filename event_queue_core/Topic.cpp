@@ -31,6 +31,9 @@ Topic::~Topic() {
     if (index_writer_.is_open()) {
         index_writer_.close();
     }
+    if (data_reader_.is_open()) {
+        data_reader_.close();
+    }
     // Metadata is saved on each append or explicitly
 }
 
@@ -50,6 +53,7 @@ void Topic::load_or_create_files() {
     }
     
     rebuild_index_if_needed(); // Important recovery step
+    log_end_pos_ = fs::exists(data_file_path_) ? fs::file_size(data_file_path_) : 0;
 }
 
 void Topic::load_metadata() {
@@ -235,8 +239,8 @@ void Topic::rebuild_index_if_needed() {
 }
 
 
-uint64_t Topic::append_message(const std::string& payload) {
-    std::lock_guard<std::mutex> lock(topic_mutex_);
+uint64_t Topic::append_message(std::string_view payload) {
+    std::unique_lock<std::mutex> lock(topic_mutex_);
 
     uint64_t current_offset = next_offset_;
     uint64_t current_byte_pos = data_writer_.tellp(); // Position before writing this message
@@ -253,25 +257,66 @@ uint64_t Topic::append_message(const std::string& payload) {
 
     // Update in-memory state
     offset_to_byte_pos_[current_offset] = current_byte_pos;
+    log_end_pos_ = current_byte_pos + sizeof(uint64_t) + sizeof(uint32_t) + payload.size();
     next_offset_++;
     save_metadata(); // Persist new next_offset_
 
+    wake_waiters(lock);
     return current_offset;
 }
 
-std::vector<Message> Topic::get_messages(uint64_t start_offset, uint32_t max_messages) {
-    std::lock_guard<std::mutex> lock(topic_mutex_);
+uint64_t Topic::append_messages(const std::vector<std::string_view>& payloads) {
+    std::unique_lock<std::mutex> lock(topic_mutex_);
+
+    uint64_t first_offset = next_offset_;
+    uint64_t current_byte_pos = data_writer_.tellp();
+
+    for (const auto& payload : payloads) {
+        uint64_t current_offset = next_offset_;
+        BinaryUtils::write_binary(data_writer_, current_offset);
+        BinaryUtils::write_string(data_writer_, payload);
+        BinaryUtils::write_binary(index_writer_, current_offset);
+        BinaryUtils::write_binary(index_writer_, current_byte_pos);
+
+        offset_to_byte_pos_[current_offset] = current_byte_pos;
+        current_byte_pos += sizeof(uint64_t) + sizeof(uint32_t) + payload.size();
+        next_offset_++;
+    }
+    // One flush per file for the whole batch instead of one per message
+    data_writer_.flush();
+    index_writer_.flush();
+    log_end_pos_ = current_byte_pos;
+    save_metadata();
+
+    wake_waiters(lock);
+    return first_offset;
+}
+
+std::vector<Message> Topic::get_messages(uint64_t start_offset, uint32_t max_messages, uint64_t max_bytes) {
     std::vector<Message> messages;
+    read_messages(start_offset, max_messages, max_bytes, messages);
+    return messages;
+}
+
+size_t Topic::read_messages(uint64_t start_offset, uint32_t max_messages, uint64_t max_bytes, std::vector<Message>& out) {
+    std::lock_guard<std::mutex> lock(topic_mutex_);
+    size_t count = 0;
+    uint64_t bytes_read = 0;
 
     if (start_offset >= next_offset_ || max_messages == 0) {
-        return messages; // No messages at or after this offset, or no messages requested
+        out.clear();
+        return 0; // No messages at or after this offset, or no messages requested
     }
 
-    std::ifstream data_reader(data_file_path_, std::ios::binary);
-    if (!data_reader.is_open()) {
-        std::cerr << "Error: Failed to open data file for reading: " << data_file_path_ << std::endl;
-        return messages; // Or throw
+    if (!data_reader_.is_open()) {
+        data_reader_.open(data_file_path_, std::ios::binary);
+        if (!data_reader_.is_open()) {
+            std::cerr << "Error: Failed to open data file for reading: " << data_file_path_ << std::endl;
+            out.clear();
+            return 0; // Or throw
+        }
     }
+    data_reader_.clear(); // Reset EOF from a previous read; the writer may have appended since
 
     // Find the actual starting byte position using the index
     // We want the first entry with offset >= start_offset
@@ -280,21 +325,21 @@ std::vector<Message> Topic::get_messages(uint64_t start_offset, uint32_t max_mes
         // start_offset is beyond any known offset, but less than next_offset_
         // This state should ideally not happen if next_offset_ is accurate.
         // Or it could mean start_offset is for a message not yet fully committed (rare).
-        data_reader.close();
-        return messages;
+        out.clear();
+        return 0;
     }
 
     uint64_t current_read_offset = it->first;
-    data_reader.seekg(it->second); // Seek to the byte position of the message with current_read_offset
+    data_reader_.seekg(it->second); // Seek to the byte position of the message with current_read_offset
 
-    while (messages.size() < max_messages && current_read_offset < next_offset_) {
-        if (data_reader.peek() == EOF) break; // End of file
+    while (count < max_messages && current_read_offset < next_offset_) {
+        if (data_reader_.peek() == EOF) break; // End of file
 
         try {
             // We expect the message at current_read_offset to be here.
             // Read and verify offset from data.log itself
-            uint64_t file_msg_offset = BinaryUtils::read_binary<uint64_t>(data_reader);
-            std::string payload = BinaryUtils::read_string(data_reader); // read_string reads length first
+            uint64_t file_msg_offset = BinaryUtils::read_binary<uint64_t>(data_reader_);
+            uint32_t payload_len = BinaryUtils::read_binary<uint32_t>(data_reader_);
 
             if (file_msg_offset != current_read_offset) {
                 // This is a serious inconsistency between index and data file!
@@ -304,9 +349,25 @@ std::vector<Message> Topic::get_messages(uint64_t start_offset, uint32_t max_mes
                 // Consider stopping or trying to resync. For now, we stop.
                 break;
             }
-            
-            messages.emplace_back(current_read_offset, name_, payload);
-            
+
+            uint64_t record_size = sizeof(uint64_t) + sizeof(uint32_t) + payload_len;
+            if (max_bytes > 0 && count > 0 && bytes_read + record_size > max_bytes) {
+                break; // Byte budget exhausted; the next consume starts at this offset
+            }
+
+            // Reuse the caller's elements (and their string buffers) where possible
+            if (count < out.size()) {
+                Message& msg = out[count];
+                msg.offset = current_read_offset;
+                msg.topic.assign(name_);
+                BinaryUtils::read_string_data(data_reader_, payload_len, msg.payload);
+            } else {
+                out.emplace_back(current_read_offset, name_, std::string());
+                BinaryUtils::read_string_data(data_reader_, payload_len, out.back().payload);
+            }
+            ++count;
+            bytes_read += record_size;
+
             // Advance to the next offset
             current_read_offset++;
             // If there's an index entry for the next offset, we could use it.
@@ -315,14 +376,14 @@ std::vector<Message> Topic::get_messages(uint64_t start_offset, uint32_t max_mes
             // The initial seek got us to the right spot.
             if (offset_to_byte_pos_.count(current_read_offset)) {
                  // If the next message isn't immediately sequential in the file (e.g. due to compaction, not implemented here)
-                 // then seek to its indexed position. Otherwise, we've already advanced data_reader.
+                 // then seek to its indexed position. Otherwise, we've already advanced data_reader_.
                  // For simple append-only log, this is mostly redundant unless there's a file corruption and jump.
-                uint64_t expected_next_byte_pos = data_reader.tellg();
+                uint64_t expected_next_byte_pos = data_reader_.tellg();
                 if (offset_to_byte_pos_[current_read_offset] != expected_next_byte_pos && current_read_offset < next_offset_) {
                      // This implies a gap or non-sequential data, which our current append logic doesn't create.
                      // But if it did, this seek would be necessary.
                      // std::cerr << "Adjusting seek for non-sequential message " << current_read_offset << std::endl;
-                     data_reader.seekg(offset_to_byte_pos_[current_read_offset]);
+                     data_reader_.seekg(offset_to_byte_pos_[current_read_offset]);
                 }
             } else if (current_read_offset < next_offset_) {
                 // Next message is expected, but not in index? This is an error.
@@ -338,8 +399,8 @@ std::vector<Message> Topic::get_messages(uint64_t start_offset, uint32_t max_mes
             break; // Stop reading on error
         }
     }
-    data_reader.close();
-    return messages;
+    out.erase(out.begin() + count, out.end());
+    return count;
 }
 
 uint64_t Topic::get_next_offset() const {
@@ -349,3 +410,57 @@ uint64_t Topic::get_next_offset() const {
     std::lock_guard<std::mutex> lock(topic_mutex_); // Added for safety
     return next_offset_;
 }
+
+bool Topic::has_data_locked(uint64_t start_offset, uint32_t min_bytes) const {
+    if (start_offset >= next_offset_) return false;
+    if (min_bytes == 0) return true;
+    auto it = offset_to_byte_pos_.lower_bound(start_offset);
+    if (it == offset_to_byte_pos_.end()) return false;
+    return log_end_pos_ - it->second >= min_bytes;
+}
+
+void Topic::wake_waiters(std::unique_lock<std::mutex>& lock) {
+    // Blocking waiters re-check their own condition.
+    data_available_cv_.notify_all();
+
+    if (data_waiters_.empty()) return;
+    std::vector<DataWaiter> ready;
+    for (auto it = data_waiters_.begin(); it != data_waiters_.end(); /* manual increment */) {
+        if (has_data_locked(it->second.start_offset, it->second.min_bytes)) {
+            ready.push_back(std::move(it->second.on_ready));
+            it = data_waiters_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    lock.unlock(); // Never call out while holding the topic lock
+
+    for (auto& on_ready : ready) {
+        try {
+            on_ready();
+        } catch (const std::exception& e) {
+            std::cerr << "Topic " << name_ << ": Exception from data waiter: " << e.what() << std::endl;
+        }
+    }
+}
+
+bool Topic::wait_for_data(uint64_t start_offset, uint32_t min_bytes, std::chrono::milliseconds max_wait) {
+    std::unique_lock<std::mutex> lock(topic_mutex_);
+    return data_available_cv_.wait_for(lock, max_wait, [&]() {
+        return has_data_locked(start_offset, min_bytes);
+    });
+}
+
+bool Topic::add_data_waiter(uint64_t waiter_id, uint64_t start_offset, uint32_t min_bytes, DataWaiter on_ready) {
+    std::lock_guard<std::mutex> lock(topic_mutex_);
+    if (has_data_locked(start_offset, min_bytes)) {
+        return false;
+    }
+    data_waiters_.emplace(waiter_id, PendingWaiter{start_offset, min_bytes, std::move(on_ready)});
+    return true;
+}
+
+bool Topic::remove_data_waiter(uint64_t waiter_id) {
+    std::lock_guard<std::mutex> lock(topic_mutex_);
+    return data_waiters_.erase(waiter_id) > 0;
+}
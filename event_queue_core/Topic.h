@@ -9,6 +9,9 @@
 #include <map> // For in-memory index
 #include <filesystem> // C++17 for path manipulation
 #include <iostream>   // For cerr
+#include <condition_variable>
+#include <functional>
+#include <chrono>
 
 // Forward declaration
 class EventQueue;
@@ -24,10 +27,31 @@ public:
     Topic& operator=(Topic&&) = default;
 
     std::string get_name() const { return name_; }
-    uint64_t append_message(const std::string& payload);
-    std::vector<Message> get_messages(uint64_t start_offset, uint32_t max_messages);
+    uint64_t append_message(std::string_view payload);
+    // Appends all payloads under one lock with a single flush of data, index and metadata.
+    // Offsets are contiguous; returns the offset of the first message.
+    uint64_t append_messages(const std::vector<std::string_view>& payloads);
+    // max_bytes bounds the total size of the returned log records (12-byte record header + payload);
+    // 0 means unbounded. The first message is always returned, even if it alone exceeds max_bytes.
+    std::vector<Message> get_messages(uint64_t start_offset, uint32_t max_messages, uint64_t max_bytes = 0);
+    // Same as get_messages, but fills a caller-owned buffer. Existing elements are overwritten in place so
+    // their string capacity is reused across calls; `out` is resized to the number of messages read.
+    size_t read_messages(uint64_t start_offset, uint32_t max_messages, uint64_t max_bytes, std::vector<Message>& out);
     uint64_t get_next_offset() const;
 
+    // --- Long-poll support ---
+    // A waiter is satisfied once at least min_bytes of log data (and at least one message)
+    // exist at or after its start offset. Waiters are woken by append_message.
+    using DataWaiter = std::function<void()>;
+
+    // Blocks until the waiter condition holds or max_wait elapses. Returns true if data is available.
+    bool wait_for_data(uint64_t start_offset, uint32_t min_bytes, std::chrono::milliseconds max_wait);
+    // Registers a one-shot callback under the caller's waiter_id, invoked outside the topic lock by
+    // the appending thread. Returns false (and does not store the callback) if the condition
+    // already holds.
+    bool add_data_waiter(uint64_t waiter_id, uint64_t start_offset, uint32_t min_bytes, DataWaiter on_ready);
+    bool remove_data_waiter(uint64_t waiter_id);
+
 
 private:
     void load_or_create_files();
@@ -35,6 +59,14 @@ private:
     void save_metadata();
     void load_index();
     void rebuild_index_if_needed(); // In case of crash before index write
+    bool has_data_locked(uint64_t start_offset, uint32_t min_bytes) const; // Assumes topic_mutex_ is held
+    void wake_waiters(std::unique_lock<std::mutex>& lock); // Releases the lock before invoking callbacks
+
+    struct PendingWaiter {
+        uint64_t start_offset;
+        uint32_t min_bytes;
+        DataWaiter on_ready;
+    };
 
     std::string name_;
     std::string dir_path_;
@@ -44,10 +76,14 @@ private:
 
     std::ofstream data_writer_;
     std::ofstream index_writer_;
-    // Reader streams are opened on demand in get_messages
+    std::ifstream data_reader_; // Opened lazily by read_messages and kept open; guarded by topic_mutex_
 
     uint64_t next_offset_ = 0;
     std::map<uint64_t, uint64_t> offset_to_byte_pos_; // In-memory index: message_offset -> file_byte_offset
+    uint64_t log_end_pos_ = 0; // Size of data.log, used to answer "how many bytes after offset X" for waiters
+
+    std::condition_variable data_available_cv_; // Blocking long-poll waiters
+    std::map<uint64_t, PendingWaiter> data_waiters_; // Async long-poll waiters, keyed by waiter id
 
     mutable std::mutex topic_mutex_; // Protects file access and next_offset_
 };
@@ -17,10 +17,16 @@
 #include <fstream>         // For reading YAML file
 
 #include "event_queue_core/EventQueue.h"
+#include "event_queue_core/LocalEventQueue.h"
 #include "event_queue_core/INewMessageListener.h" // Core interface
 #include "network/SubscriptionManager.h"       // Network layer, implements listener
 #include "network/TcpServer.h"
+#include "network/BufferPool.h"
+#include "network/Compression.h"
+#include "network/ShardPool.h"
+#include "network/QuotaManager.h"
 #include "network/HttpServer.h"       // Assumes this uses cpp-httplib
+#include "network/BeastHttpServer.h"
 #include "network/WebSocketServer.h"  // Assumes this uses Boost.Beast
 
 namespace po = boost::program_options;
@@ -32,11 +38,18 @@ struct ServerConfig {
     std::string log_level = "info";
     std::string data_directory = "./event_queue_server_data";
     int thread_pool_size = 0; // 0 means std::thread::hardware_concurrency()
+    // "shared": all TCP sessions run on the common I/O thread pool.
+    // "sharded": thread-per-core; each shard thread owns its connections and a hash-partition of the topics.
+    std::string execution_mode = "shared";
+    int shard_count = 0; // 0 means std::thread::hardware_concurrency()
+    bool pin_shard_threads = true;
 
     struct TcpConfig {
         bool enabled = false;
         std::string host = "0.0.0.0";
         unsigned short port = 12345;
+        int acceptors = 1; // >1: SO_REUSEPORT listeners; 0 means one per shard (sharded) or I/O thread
+        Compression::Settings compression; // Codecs offered in the HANDSHAKE, threshold and level
     } tcp;
 
     struct HttpConfig {
@@ -45,15 +58,34 @@ struct ServerConfig {
         unsigned short port = 8080;
         std::string ssl_cert_path;
         std::string ssl_key_path;
+        // "beast": async HTTP/1.1 on the shared io_context; "httplib": cpp-httplib on its own thread pool.
+        // HTTPS (ssl_cert_path/ssl_key_path set) always uses httplib.
+        std::string engine = "beast";
+        int acceptors = 1; // Beast engine only: >1 SO_REUSEPORT listeners; 0 means one per I/O thread
+        Compression::HttpSettings compression; // Content-Encodings offered, threshold and level
     } http;
 
     struct WebSocketConfig {
         bool enabled = false;
         std::string host = "0.0.0.0";
         unsigned short port = 9090;
+        int acceptors = 1; // >1: SO_REUSEPORT listeners; 0 means one per I/O thread
+        size_t max_outbound_bytes = 16 * 1024 * 1024; // Unsent bytes per session before it's closed as a slow consumer
+        Compression::WebSocketSettings deflate; // permessage-deflate offer (off by default)
     } websocket;
+
+    QuotaConfig quotas;
+    BufferPool::Limits buffer_pool; // Caps for the per-thread network buffer pools
 };
 
+// --- Helper to read one quota entry (missing keys stay unlimited) ---
+QuotaLimits load_quota_limits(const YAML::Node& node, QuotaLimits limits = {}) {
+    if (node["produce_bytes_per_sec"]) limits.produce_bytes_per_sec = node["produce_bytes_per_sec"].as<double>();
+    if (node["consume_bytes_per_sec"]) limits.consume_bytes_per_sec = node["consume_bytes_per_sec"].as<double>();
+    if (node["requests_per_sec"]) limits.requests_per_sec = node["requests_per_sec"].as<double>();
+    return limits;
+}
+
 // --- Helper to load configuration from YAML ---
 bool load_config_from_yaml(const std::string& filepath, ServerConfig& config) {
     try {
@@ -64,12 +96,34 @@ bool load_config_from_yaml(const std::string& filepath, ServerConfig& config) {
         if (yaml_config["log_level"]) config.log_level = yaml_config["log_level"].as<std::string>();
         if (yaml_config["data_directory"]) config.data_directory = yaml_config["data_directory"].as<std::string>();
         if (yaml_config["thread_pool_size"]) config.thread_pool_size = yaml_config["thread_pool_size"].as<int>();
+        if (yaml_config["execution_mode"]) config.execution_mode = yaml_config["execution_mode"].as<std::string>();
+        if (yaml_config["shard_count"]) config.shard_count = yaml_config["shard_count"].as<int>();
+        if (yaml_config["pin_shard_threads"]) config.pin_shard_threads = yaml_config["pin_shard_threads"].as<bool>();
 
         if (yaml_config["tcp_server"]) {
             const auto& tcp_node = yaml_config["tcp_server"];
             if (tcp_node["enabled"]) config.tcp.enabled = tcp_node["enabled"].as<bool>();
             if (tcp_node["host"]) config.tcp.host = tcp_node["host"].as<std::string>();
             if (tcp_node["port"]) config.tcp.port = tcp_node["port"].as<unsigned short>();
+            if (tcp_node["acceptors"]) config.tcp.acceptors = tcp_node["acceptors"].as<int>();
+            if (tcp_node["compression"]) {
+                const auto& comp_node = tcp_node["compression"];
+                if (comp_node["codecs"]) {
+                    config.tcp.compression.codecs.clear();
+                    for (const auto& name_node : comp_node["codecs"]) {
+                        std::string name = name_node.as<std::string>();
+                        auto codec = Compression::codec_from_name(name);
+                        if (!Compression::is_available(codec)) {
+                            std::cerr << "Warning: compression codec '" << name << "' is not available in this build, ignoring." << std::endl;
+                            continue;
+                        }
+                        config.tcp.compression.codecs.push_back(codec);
+                    }
+                }
+                if (comp_node["threshold_bytes"]) config.tcp.compression.threshold_bytes = comp_node["threshold_bytes"].as<uint32_t>();
+                if (comp_node["level"]) config.tcp.compression.level = comp_node["level"].as<int>();
+                if (comp_node["max_decompressed_bytes"]) config.tcp.compression.max_decompressed_bytes = comp_node["max_decompressed_bytes"].as<uint32_t>();
+            }
         }
 
         if (yaml_config["http_server"]) {
@@ -79,6 +133,26 @@ bool load_config_from_yaml(const std::string& filepath, ServerConfig& config) {
             if (http_node["port"]) config.http.port = http_node["port"].as<unsigned short>();
             if (http_node["ssl_cert_path"]) config.http.ssl_cert_path = http_node["ssl_cert_path"].as<std::string>();
             if (http_node["ssl_key_path"]) config.http.ssl_key_path = http_node["ssl_key_path"].as<std::string>();
+            if (http_node["engine"]) config.http.engine = http_node["engine"].as<std::string>();
+            if (http_node["acceptors"]) config.http.acceptors = http_node["acceptors"].as<int>();
+            if (http_node["compression"]) {
+                const auto& comp_node = http_node["compression"];
+                if (comp_node["encodings"]) {
+                    config.http.compression.encodings.clear();
+                    auto available = Compression::available_encodings();
+                    for (const auto& name_node : comp_node["encodings"]) {
+                        std::string name = name_node.as<std::string>();
+                        auto encoding = Compression::encoding_from_name(name);
+                        if (std::find(available.begin(), available.end(), encoding) == available.end()) {
+                            std::cerr << "Warning: content encoding '" << name << "' is not available in this build, ignoring." << std::endl;
+                            continue;
+                        }
+                        config.http.compression.encodings.push_back(encoding);
+                    }
+                }
+                if (comp_node["threshold_bytes"]) config.http.compression.threshold_bytes = comp_node["threshold_bytes"].as<uint32_t>();
+                if (comp_node["level"]) config.http.compression.level = comp_node["level"].as<int>();
+            }
         }
 
         if (yaml_config["websocket_server"]) {
@@ -86,6 +160,60 @@ bool load_config_from_yaml(const std::string& filepath, ServerConfig& config) {
             if (ws_node["enabled"]) config.websocket.enabled = ws_node["enabled"].as<bool>();
             if (ws_node["host"]) config.websocket.host = ws_node["host"].as<std::string>();
             if (ws_node["port"]) config.websocket.port = ws_node["port"].as<unsigned short>();
+            if (ws_node["acceptors"]) config.websocket.acceptors = ws_node["acceptors"].as<int>();
+            if (ws_node["max_outbound_bytes"]) config.websocket.max_outbound_bytes = ws_node["max_outbound_bytes"].as<size_t>();
+            if (ws_node["permessage_deflate"]) {
+                const auto& pmd_node = ws_node["permessage_deflate"];
+                auto& deflate = config.websocket.deflate;
+                if (pmd_node["enabled"]) deflate.enabled = pmd_node["enabled"].as<bool>();
+                if (pmd_node["window_bits"]) deflate.window_bits = pmd_node["window_bits"].as<int>();
+                if (pmd_node["mem_level"]) deflate.mem_level = pmd_node["mem_level"].as<int>();
+                if (pmd_node["level"]) deflate.level = pmd_node["level"].as<int>();
+                if (pmd_node["threshold_bytes"]) deflate.threshold_bytes = pmd_node["threshold_bytes"].as<uint32_t>();
+                if (pmd_node["context_takeover"]) deflate.context_takeover = pmd_node["context_takeover"].as<bool>();
+                if (deflate.window_bits < 9 || deflate.window_bits > 15) {
+                    std::cerr << "Warning: permessage_deflate.window_bits must be 9..15, using 15." << std::endl;
+                    deflate.window_bits = 15;
+                }
+                if (deflate.mem_level < 1 || deflate.mem_level > 9) {
+                    std::cerr << "Warning: permessage_deflate.mem_level must be 1..9, using 4." << std::endl;
+                    deflate.mem_level = 4;
+                }
+                if (deflate.level < 0 || deflate.level > 9) {
+                    std::cerr << "Warning: permessage_deflate.level must be 0..9, using Beast's default." << std::endl;
+                    deflate.level = 0;
+                }
+            }
+        }
+
+        if (yaml_config["quotas"]) {
+            const auto& quota_node = yaml_config["quotas"];
+            if (quota_node["enabled"]) config.quotas.enabled = quota_node["enabled"].as<bool>();
+            if (quota_node["burst_seconds"]) config.quotas.burst_seconds = quota_node["burst_seconds"].as<double>();
+            if (quota_node["max_throttle_ms"]) config.quotas.max_throttle_ms = quota_node["max_throttle_ms"].as<uint32_t>();
+            if (quota_node["default_client"]) config.quotas.default_client = load_quota_limits(quota_node["default_client"]);
+            if (quota_node["default_topic"]) config.quotas.default_topic = load_quota_limits(quota_node["default_topic"]);
+            // Per-client / per-topic entries override the matching default field by field
+            if (quota_node["clients"]) {
+                for (const auto& entry : quota_node["clients"]) {
+                    config.quotas.clients[entry.first.as<std::string>()] = load_quota_limits(entry.second, config.quotas.default_client);
+                }
+            }
+            if (quota_node["topics"]) {
+                for (const auto& entry : quota_node["topics"]) {
+                    config.quotas.topics[entry.first.as<std::string>()] = load_quota_limits(entry.second, config.quotas.default_topic);
+                }
+            }
+            if (quota_node["trusted_proxies"]) {
+                for (const auto& proxy : quota_node["trusted_proxies"]) {
+                    config.quotas.trusted_proxies.insert(proxy.as<std::string>());
+                }
+            }
+        }
+        if (yaml_config["buffer_pool"]) {
+            const auto& pool_node = yaml_config["buffer_pool"];
+            if (pool_node["max_pooled_bytes"]) config.buffer_pool.max_pooled_bytes = pool_node["max_pooled_bytes"].as<size_t>();
+            if (pool_node["max_buffers_per_class"]) config.buffer_pool.max_buffers_per_class = pool_node["max_buffers_per_class"].as<size_t>();
         }
         return true;
     } catch (const YAML::Exception& e) {
@@ -150,20 +278,47 @@ int main(int argc, char* argv[]) {
     std::cout << "Server Name: " << config.server_name << std::endl;
     std::cout << "Data Directory: " << config.data_directory << std::endl;
     std::cout << "Thread Pool Size: " << (config.thread_pool_size == 0 ? "Auto (Hardware Concurrency)" : std::to_string(config.thread_pool_size)) << std::endl;
-    if(config.tcp.enabled) std::cout << "TCP Server: Enabled on " << config.tcp.host << ":" << config.tcp.port << std::endl;
+    std::cout << "Execution Mode: " << config.execution_mode;
+    if (config.execution_mode == "sharded") {
+        std::cout << " (" << (config.shard_count == 0 ? "auto" : std::to_string(config.shard_count)) << " shards"
+                  << (config.pin_shard_threads ? ", pinned" : "") << ")";
+    }
+    std::cout << std::endl;
+    if(config.tcp.enabled) {
+        std::cout << "TCP Server: Enabled on " << config.tcp.host << ":" << config.tcp.port << " (compression:";
+        if (config.tcp.compression.codecs.empty()) std::cout << " off";
+        for (auto codec : config.tcp.compression.codecs) std::cout << " " << Compression::codec_name(codec);
+        std::cout << ")" << std::endl;
+    }
     if(config.http.enabled) {
         std::cout << "HTTP(S) Server: Enabled on " << config.http.host << ":" << config.http.port;
         if(!config.http.ssl_cert_path.empty()) std::cout << " (HTTPS)";
-        std::cout << std::endl;
+        std::cout << " (engine: " << config.http.engine << ", compression:";
+        if (config.http.compression.encodings.empty()) std::cout << " off";
+        for (auto encoding : config.http.compression.encodings) std::cout << " " << Compression::encoding_name(encoding);
+        std::cout << ")" << std::endl;
     }
-    if(config.websocket.enabled) std::cout << "WebSocket Server: Enabled on " << config.websocket.host << ":" << config.websocket.port << std::endl;
+    if(config.websocket.enabled) {
+        std::cout << "WebSocket Server: Enabled on " << config.websocket.host << ":" << config.websocket.port
+                  << " (permessage-deflate: ";
+        if (config.websocket.deflate.enabled) {
+            std::cout << "window_bits " << config.websocket.deflate.window_bits
+                      << ", mem_level " << config.websocket.deflate.mem_level
+                      << (config.websocket.deflate.context_takeover ? "" : ", no context takeover");
+        } else {
+            std::cout << "off";
+        }
+        std::cout << ")" << std::endl;
+    }
+    if(config.quotas.enabled) std::cout << "Quotas: Enabled (" << config.quotas.clients.size() << " client and "
+                                        << config.quotas.topics.size() << " topic overrides)" << std::endl;
     std::cout << "----------------------------" << std::endl;
 
 
     // --- Initialize Core Event Queue ---
     std::unique_ptr<EventQueue> event_queue;
     try {
-        event_queue = std::make_unique<EventQueue>(config.data_directory);
+        event_queue = std::make_unique<LocalEventQueue>(config.data_directory);
     } catch (const std::exception& e) {
         std::cerr << "FATAL: Failed to initialize EventQueue: " << e.what() << std::endl;
         return 1;
@@ -213,26 +368,73 @@ int main(int argc, char* argv[]) {
     });
 
 
+    // Must be set before any I/O thread borrows a buffer
+    BufferPool::configure(config.buffer_pool);
+
+    // --- Initialize Quotas (shared by all front ends) ---
+    std::unique_ptr<QuotaManager> quota_manager;
+    if (config.quotas.enabled) {
+        quota_manager = std::make_unique<QuotaManager>(config.quotas);
+    }
+
+    // --- Initialize Shards (thread-per-core mode) ---
+    std::unique_ptr<ShardPool> shard_pool;
+    if (config.execution_mode == "sharded") {
+        shard_pool = std::make_unique<ShardPool>(static_cast<size_t>(std::max(0, config.shard_count)), config.pin_shard_threads);
+        shard_pool->start();
+    } else if (config.execution_mode != "shared") {
+        std::cerr << "Unknown execution_mode '" << config.execution_mode << "', falling back to 'shared'." << std::endl;
+    }
+
     // --- Initialize and Start Servers ---
     std::unique_ptr<TcpServer> tcp_server; // TcpServer is simpler, doesn't need enable_shared_from_this for basic start/stop
-    std::unique_ptr<HttpServer> http_server; // HttpServer is also simple
+    std::unique_ptr<HttpServer> http_server; // cpp-httplib engine, on its own threads
+    std::shared_ptr<BeastHttpServer> beast_http_server; // Beast engine, on ioc
     std::shared_ptr<WebSocketServer> ws_server; // WebSocketServer uses enable_shared_from_this
 
     try {
         if (config.tcp.enabled) {
-            tcp_server = std::make_unique<TcpServer>(ioc, config.tcp.port, *event_queue);
+            size_t tcp_acceptors = config.tcp.acceptors > 0 ? static_cast<size_t>(config.tcp.acceptors)
+                                 : shard_pool ? shard_pool->size() : num_threads;
+            tcp_server = std::make_unique<TcpServer>(ioc, config.tcp.port, *event_queue, shard_pool.get(), quota_manager.get(),
+                                                     sub_manager.get(), tcp_acceptors, &config.tcp.compression);
             // TcpServer's constructor usually starts listening or has a run() method.
             // Assuming constructor starts it or we call a run method here.
             // For this example, assuming constructor of TcpServer starts listening.
              std::cout << "TCP Server setup initiated." << std::endl;
         }
 
-        if (config.http.enabled) {
+        bool https = !config.http.ssl_cert_path.empty() && !config.http.ssl_key_path.empty();
+        if (config.http.enabled && config.http.engine != "httplib" && config.http.engine != "beast") {
+            std::cerr << "Unknown http_server.engine '" << config.http.engine << "', falling back to 'beast'." << std::endl;
+            config.http.engine = "beast";
+        }
+        if (config.http.enabled && config.http.engine == "beast" && !https) {
+            beast_http_server = std::make_shared<BeastHttpServer>(ioc,
+                                                                  config.http.host,
+                                                                  config.http.port,
+                                                                  *event_queue,
+                                                                  quota_manager.get(),
+                                                                  sub_manager.get(),
+                                                                  config.http.acceptors > 0
+                                                                      ? static_cast<size_t>(config.http.acceptors)
+                                                                      : num_threads,
+                                                                  &config.http.compression);
+            if (!beast_http_server->run()) {
+                std::cerr << "Failed to start HTTP server. Check logs and config." << std::endl;
+            } else {
+                std::cout << "HTTP Server setup initiated." << std::endl;
+            }
+        } else if (config.http.enabled) {
             http_server = std::make_unique<HttpServer>(*event_queue,
                                                        config.http.host,
                                                        config.http.port,
                                                        config.http.ssl_cert_path,
-                                                       config.http.ssl_key_path);
+                                                       config.http.ssl_key_path,
+                                                       quota_manager.get(),
+                                                       sub_manager.get(),
+                                                       ioc.get_executor(),
+                                                       &config.http.compression);
             if (!http_server->start()) {
                 std::cerr << "Failed to start HTTP(S) server. Check logs and config." << std::endl;
                 // Potentially exit or disable this server
@@ -246,7 +448,13 @@ int main(int argc, char* argv[]) {
                                                           config.websocket.host,
                                                           config.websocket.port,
                                                           *sub_manager,
-                                                          *event_queue);
+                                                          *event_queue,
+                                                          quota_manager.get(),
+                                                          config.websocket.acceptors > 0
+                                                              ? static_cast<size_t>(config.websocket.acceptors)
+                                                              : num_threads,
+                                                          config.websocket.max_outbound_bytes,
+                                                          &config.websocket.deflate);
             if (!ws_server->run()) {
                  std::cerr << "Failed to start WebSocket server." << std::endl;
             } else {
@@ -274,6 +482,10 @@ int main(int argc, char* argv[]) {
         std::cout << "Stopping WebSocket server..." << std::endl;
         ws_server->stop(); // WebSocketServer::stop() should post to ioc to close acceptor
     }
+    if (beast_http_server) {
+        std::cout << "Stopping HTTP server..." << std::endl;
+        beast_http_server->stop();
+    }
     if (http_server && http_server->is_running()) {
         std::cout << "Stopping HTTP(S) server..." << std::endl;
         http_server->stop(); // HttpServer::stop() should stop its internal thread
@@ -306,6 +518,11 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (shard_pool) {
+        std::cout << "Stopping shard threads..." << std::endl;
+        shard_pool->stop();
+    }
+
     if (event_queue && sub_manager) { // Unregister listener during shutdown
         event_queue->remove_listener(sub_manager.get());
     }
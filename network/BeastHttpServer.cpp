@@ -0,0 +1,100 @@
+// network/BeastHttpServer.cpp
+#include "BeastHttpServer.h"
+#include "BeastHttpSession.h"
+#include "ListenSocket.h"
+#include <iostream>
+
+BeastHttpServer::BeastHttpServer(net::io_context& ioc,
+                                 const std::string& address,
+                                 unsigned short port,
+                                 EventQueue& queue,
+                                 QuotaManager* quotas,
+                                 SubscriptionManager* sub_manager,
+                                 size_t num_acceptors,
+                                 const Compression::HttpSettings* compression)
+    : ioc_(ioc),
+      num_acceptors_(usable_acceptor_count(num_acceptors, "BeastHttpServer")),
+      event_queue_(queue),
+      api_(queue, quotas, compression),
+      address_(address),
+      port_(port),
+      sub_manager_(sub_manager)
+{
+}
+
+BeastHttpServer::~BeastHttpServer() {
+    for (auto& acceptor : acceptors_) {
+        if (acceptor->is_open()) {
+            boost::beast::error_code ec;
+            acceptor->close(ec);
+        }
+    }
+}
+
+bool BeastHttpServer::run() {
+    try {
+        tcp::endpoint endpoint(net::ip::make_address(address_), port_);
+
+        bool reuse_port = num_acceptors_ > 1;
+        for (size_t i = 0; i < num_acceptors_; ++i) {
+            auto acceptor = std::make_unique<tcp::acceptor>(net::make_strand(ioc_));
+            boost::beast::error_code ec;
+            const char* failed_step = nullptr;
+            if (!open_listen_socket(*acceptor, endpoint, reuse_port, ec, failed_step)) {
+                std::cerr << "BeastHttpServer: Failed to " << failed_step << " acceptor on " << address_ << ":" << port_
+                          << " - " << ec.message() << std::endl;
+                acceptors_.clear();
+                return false;
+            }
+            acceptors_.push_back(std::move(acceptor));
+        }
+
+        std::cout << "BeastHttpServer: Listening on " << address_ << ":" << port_;
+        if (reuse_port) std::cout << " (" << num_acceptors_ << " SO_REUSEPORT acceptors)";
+        std::cout << std::endl;
+
+        for (auto& acceptor : acceptors_) {
+            net::post(acceptor->get_executor(),
+                boost::beast::bind_front_handler(&BeastHttpServer::do_accept, shared_from_this(), acceptor.get()));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "BeastHttpServer: Exception in run(): " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void BeastHttpServer::stop() {
+    for (auto& acceptor_ptr : acceptors_) {
+        tcp::acceptor* acceptor = acceptor_ptr.get();
+        net::post(acceptor->get_executor(), [self = shared_from_this(), acceptor]() {
+            if (acceptor->is_open()) {
+                std::cout << "BeastHttpServer: Stopping. Closing acceptor." << std::endl;
+                boost::beast::error_code ec;
+                acceptor->close(ec); // Completes the pending async_accept with an error
+            }
+        });
+    }
+}
+
+void BeastHttpServer::do_accept(tcp::acceptor* acceptor) {
+    // Each connection runs on its own strand of the shared io_context
+    acceptor->async_accept(
+        net::make_strand(ioc_),
+        boost::beast::bind_front_handler(&BeastHttpServer::on_accept, shared_from_this(), acceptor));
+}
+
+void BeastHttpServer::on_accept(tcp::acceptor* acceptor, boost::beast::error_code ec, tcp::socket socket) {
+    if (ec) {
+        if (ec != net::error::operation_aborted) {
+            std::cerr << "BeastHttpServer: Accept error: " << ec.message() << std::endl;
+        }
+        if (!acceptor->is_open()) return;
+    } else {
+        // The session keeps the server alive, since it serves requests through api_
+        std::make_shared<BeastHttpSession>(std::move(socket), shared_from_this(), api_, event_queue_, sub_manager_)->run();
+    }
+    if (acceptor->is_open()) {
+        do_accept(acceptor);
+    }
+}
@@ -0,0 +1,53 @@
+// network/BeastHttpServer.h
+#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../event_queue_core/EventQueue.h"
+#include "SubscriptionManager.h"
+#include "QuotaManager.h"
+#include "HttpApi.h"
+
+namespace net = boost::asio;    // from <boost/asio.hpp>
+using tcp = net::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+// HTTP/1.1 engine on Boost.Beast, serving the same API as HttpServer (see HttpApi) from the shared
+// io_context: keep-alive connections, long-poll consumes and SSE streams are all asynchronous, so
+// an idle connection or stream holds no thread. Plain HTTP only; HTTPS uses the cpp-httplib engine.
+class BeastHttpServer : public std::enable_shared_from_this<BeastHttpServer> {
+    net::io_context& ioc_;
+    // One listener, or several SO_REUSEPORT listeners on the same port, each on its own strand
+    std::vector<std::unique_ptr<tcp::acceptor>> acceptors_;
+    size_t num_acceptors_;
+    EventQueue& event_queue_;
+    HttpApi api_;
+    std::string address_;
+    unsigned short port_;
+    SubscriptionManager* sub_manager_; // Null disables SSE
+
+public:
+    BeastHttpServer(net::io_context& ioc,
+                    const std::string& address,
+                    unsigned short port,
+                    EventQueue& queue,
+                    QuotaManager* quotas = nullptr,
+                    SubscriptionManager* sub_manager = nullptr,
+                    size_t num_acceptors = 1,
+                    const Compression::HttpSettings* compression = nullptr);
+    ~BeastHttpServer();
+
+    // Start accepting connections
+    bool run();
+
+    // Stop accepting connections
+    void stop();
+
+private:
+    void do_accept(tcp::acceptor* acceptor);
+    void on_accept(tcp::acceptor* acceptor, boost::beast::error_code ec, tcp::socket socket);
+};
@@ -0,0 +1,406 @@
+// network/BeastHttpSession.cpp
+#include "BeastHttpSession.h"
+#include "BeastHttpServer.h"
+#include <atomic>
+#include <iostream>
+
+// Idle keep-alive connections, and requests trickling in, are closed after this long
+static const std::chrono::seconds HTTP_READ_TIMEOUT(30);
+// A response (or SSE chunk) the client doesn't take within this long closes the connection
+static const std::chrono::seconds HTTP_WRITE_TIMEOUT(30);
+// Largest request body accepted (produce payloads travel inside it)
+static const uint64_t HTTP_MAX_BODY_BYTES = 16 * 1024 * 1024;
+
+BeastHttpSession::BeastHttpSession(tcp::socket&& socket, std::shared_ptr<BeastHttpServer> server, HttpApi& api,
+                                   EventQueue& queue, SubscriptionManager* sub_manager)
+    : stream_(std::move(socket)),
+      server_(std::move(server)),
+      api_(api),
+      event_queue_(queue),
+      sub_manager_(sub_manager) {
+    beast::error_code ec;
+    auto endpoint = stream_.socket().remote_endpoint(ec);
+    peer_address_ = ec ? "unknown" : endpoint.address().to_string();
+}
+
+BeastHttpSession::~BeastHttpSession() {
+    if (sse_ && !sse_->closed && sub_manager_) {
+        sub_manager_->unsubscribe(sse_->topic, sse_->subscriber_id);
+    }
+}
+
+void BeastHttpSession::run() {
+    // The socket was accepted onto this connection's strand; start there
+    net::dispatch(stream_.get_executor(), beast::bind_front_handler(&BeastHttpSession::do_read, shared_from_this()));
+}
+
+void BeastHttpSession::do_read() {
+    parser_.emplace();
+    parser_->body_limit(HTTP_MAX_BODY_BYTES);
+    stream_.expires_after(HTTP_READ_TIMEOUT);
+    http::async_read_header(stream_, buffer_, *parser_,
+                            beast::bind_front_handler(&BeastHttpSession::on_read_header, shared_from_this()));
+}
+
+void BeastHttpSession::on_read_header(beast::error_code ec, std::size_t bytes_transferred) {
+    if (ec) return on_read(ec, bytes_transferred);
+    // Clients holding back a large body (curl does above 1 MiB) would otherwise wait a second for this
+    auto expect = parser_->get().find(http::field::expect);
+    if (expect != parser_->get().end() && beast::iequals(expect->value(), "100-continue")) {
+        continue_response_ = std::make_shared<http::response<http::empty_body>>(http::status::continue_, parser_->get().version());
+        return http::async_write(stream_, *continue_response_,
+            [this, self = shared_from_this()](beast::error_code write_ec, std::size_t n) {
+                continue_response_.reset();
+                if (write_ec) return on_read(write_ec, n);
+                read_body();
+            });
+    }
+    read_body();
+}
+
+void BeastHttpSession::read_body() {
+    http::async_read(stream_, buffer_, *parser_,
+                     beast::bind_front_handler(&BeastHttpSession::on_read, shared_from_this()));
+}
+
+void BeastHttpSession::on_read(beast::error_code ec, std::size_t /*bytes_transferred*/) {
+    if (ec == http::error::end_of_stream) {
+        return do_close();
+    }
+    if (ec == http::error::body_limit) {
+        keep_alive_ = false;
+        version_ = 11;
+        HttpApi::Response res;
+        HttpApi::error_response(res, 413, "Request body too large.");
+        return send_response(res);
+    }
+    if (ec) {
+        if (ec != beast::error::timeout && ec != net::error::operation_aborted) {
+            std::cerr << "HTTP session " << peer_address_ << ": Read error: " << ec.message() << std::endl;
+        }
+        return;
+    }
+    handle_request();
+}
+
+void BeastHttpSession::handle_request() {
+    http::request<http::string_body>& req = parser_->get();
+    version_ = req.version();
+    keep_alive_ = req.keep_alive();
+
+    request_ = HttpApi::Request();
+    request_.method = std::string(req.method_string());
+    HttpApi::parse_target(std::string(req.target()), request_.path, request_.params);
+    auto client_header = req.find("X-Client-Id");
+    request_.client_id = api_.client_identity(peer_address_, client_header != req.end() ? std::string(client_header->value()) : std::string());
+    auto last_event_header = req.find("Last-Event-ID");
+    if (last_event_header != req.end()) request_.last_event_id = std::string(last_event_header->value());
+    auto accept_encoding_header = req.find(http::field::accept_encoding);
+    if (accept_encoding_header != req.end()) request_.accept_encoding = std::string(accept_encoding_header->value());
+    request_.body = std::move(req.body());
+
+    std::string topic_name;
+    HttpApi::Route route = HttpApi::route(request_.method, request_.path, topic_name);
+    HttpApi::Response res;
+    switch (route) {
+        case HttpApi::Route::STREAM: {
+            if (!sub_manager_) {
+                HttpApi::error_response(res, 501, "Streaming is not available.");
+                break;
+            }
+            HttpApi::StreamParams params;
+            if (!api_.parse_stream(topic_name, request_, params, res)) break;
+            return start_stream(std::move(params));
+        }
+        case HttpApi::Route::CONSUME: {
+            HttpApi::ConsumeParams params;
+            if (!api_.parse_consume(topic_name, request_, params, res)) break;
+            if (params.wait_ms > 0) return start_long_poll(std::move(params));
+            if (params.format != HttpApi::ConsumeFormat::JSON) return start_consume_stream(params);
+            api_.finish_consume(params, request_.client_id, res);
+            break;
+        }
+        default:
+            api_.handle(route, topic_name, request_, res);
+            break;
+    }
+    send_response(res);
+}
+
+void BeastHttpSession::send_response(HttpApi::Response api_res) {
+    api_.encode_response(request_, api_res);
+    auto res = std::make_shared<http::response<http::string_body>>(static_cast<http::status>(api_res.status), version_);
+    res->set(http::field::server, "event-queue-server");
+    res->set(http::field::content_type, api_res.content_type);
+    for (const auto& [name, value] : api_res.headers) res->set(name, value);
+    res->body() = api_res.body;
+    res->keep_alive(keep_alive_);
+    res->prepare_payload();
+    response_ = res;
+
+    stream_.expires_after(HTTP_WRITE_TIMEOUT);
+    http::async_write(stream_, *res,
+                      beast::bind_front_handler(&BeastHttpSession::on_write, shared_from_this(), res->need_eof()));
+}
+
+void BeastHttpSession::on_write(bool close, beast::error_code ec, std::size_t /*bytes_transferred*/) {
+    response_.reset();
+    if (ec) {
+        std::cerr << "HTTP session " << peer_address_ << ": Write error: " << ec.message() << std::endl;
+        return;
+    }
+    if (close) {
+        return do_close();
+    }
+    do_read();
+}
+
+void BeastHttpSession::do_close() {
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+}
+
+void BeastHttpSession::start_long_poll(HttpApi::ConsumeParams params) {
+    struct LongPoll {
+        explicit LongPoll(const net::any_io_executor& executor) : timer(executor) {}
+        net::steady_timer timer;
+        uint64_t waiter_id = 0;
+    };
+    auto self = shared_from_this();
+    auto poll = std::make_shared<LongPoll>(stream_.get_executor());
+
+    // Either the timer expires or a waiter cuts it short; in both cases answer with whatever is available
+    poll->timer.expires_after(std::chrono::milliseconds(params.wait_ms));
+    poll->timer.async_wait([this, self, poll, params](beast::error_code /*ec*/) {
+        event_queue_.cancel_wait(params.topic, poll->waiter_id);
+        if (params.format != HttpApi::ConsumeFormat::JSON) return start_consume_stream(params);
+        HttpApi::Response res;
+        api_.finish_consume(params, request_.client_id, res);
+        send_response(res);
+    });
+
+    // The waiter fires on the producing thread; hop onto the strand to cancel the timer
+    std::weak_ptr<LongPoll> weak_poll = poll;
+    auto executor = stream_.get_executor();
+    auto wake = [weak_poll, executor]() {
+        net::post(executor, [weak_poll]() {
+            if (auto p = weak_poll.lock()) {
+                p->timer.cancel();
+            }
+        });
+    };
+    try {
+        poll->waiter_id = event_queue_.wait_for_messages_async(params.topic, params.start_offset, params.min_bytes, wake);
+    } catch (const std::exception& e) {
+        std::cerr << "HTTP session " << peer_address_ << ": Long-poll registration error: " << e.what() << std::endl;
+        poll->waiter_id = 0;
+    }
+    if (poll->waiter_id == 0) { // Data already there (or nothing to wait on)
+        wake();
+    }
+}
+
+void BeastHttpSession::start_consume_stream(const HttpApi::ConsumeParams& params) {
+    consume_ = std::make_unique<ConsumeStream>();
+    consume_->cursor = HttpApi::consume_cursor(params);
+    bool has_chunk = false;
+    // The first read happens before the headers go out, so a failing read is still a 500
+    try {
+        has_chunk = api_.next_consume_chunk(consume_->cursor, request_.client_id, consume_->chunk);
+    } catch (const std::exception& e) {
+        consume_.reset();
+        HttpApi::Response res;
+        HttpApi::error_response(res, 500, e.what());
+        return send_response(res);
+    }
+
+    consume_->header.version(version_);
+    consume_->header.result(http::status::ok);
+    consume_->header.set(http::field::server, "event-queue-server");
+    consume_->header.set(http::field::content_type, HttpApi::stream_content_type(params.format));
+    consume_->header.keep_alive(keep_alive_);
+    consume_->header.chunked(true);
+    HttpApi::Response headers;
+    consume_->encoder = api_.stream_encoder(request_, headers);
+    for (const auto& [name, value] : headers.headers) consume_->header.set(name, value);
+    consume_->serializer = std::make_unique<http::response_serializer<http::empty_body>>(consume_->header);
+
+    stream_.expires_after(HTTP_WRITE_TIMEOUT);
+    http::async_write_header(stream_, *consume_->serializer,
+        [this, self = shared_from_this(), has_chunk](beast::error_code ec, std::size_t /*bytes_transferred*/) {
+            if (ec) {
+                consume_.reset();
+                std::cerr << "HTTP session " << peer_address_ << ": Write error: " << ec.message() << std::endl;
+                return;
+            }
+            write_consume_chunk(has_chunk);
+        });
+}
+
+void BeastHttpSession::write_consume_chunk(bool has_chunk) {
+    stream_.expires_after(HTTP_WRITE_TIMEOUT);
+    bool trailer = false; // The encoder's end of stream, written as one more chunk before the last
+    if (!has_chunk && consume_->encoder) {
+        consume_->encoded.clear();
+        consume_->encoder->finish(consume_->encoded);
+        consume_->encoder.reset();
+        trailer = true;
+    } else if (!has_chunk) {
+        return net::async_write(stream_, http::make_chunk_last(),
+            [this, self = shared_from_this()](beast::error_code ec, std::size_t bytes_transferred) {
+                consume_.reset();
+                on_write(!keep_alive_, ec, bytes_transferred);
+            });
+    } else if (consume_->encoder) {
+        consume_->encoded.clear();
+        consume_->encoder->write(consume_->chunk.data(), consume_->chunk.size(), consume_->encoded);
+    }
+    const std::string& out = (trailer || consume_->encoder) ? consume_->encoded : consume_->chunk;
+    net::async_write(stream_, http::make_chunk(net::buffer(out)),
+        [this, self = shared_from_this(), trailer](beast::error_code ec, std::size_t /*bytes_transferred*/) {
+            if (ec) {
+                consume_.reset();
+                std::cerr << "HTTP session " << peer_address_ << ": Write error: " << ec.message() << std::endl;
+                return;
+            }
+            if (trailer) return write_consume_chunk(false);
+            bool more = false;
+            try {
+                more = api_.next_consume_chunk(consume_->cursor, request_.client_id, consume_->chunk);
+            } catch (const std::exception& e) {
+                std::cerr << "HTTP consume stream error for topic " << consume_->cursor.topic << ": " << e.what() << std::endl;
+                consume_.reset();
+                // Headers are out; closing without the last chunk shows the client a truncated response
+                beast::error_code close_ec;
+                stream_.socket().shutdown(tcp::socket::shutdown_both, close_ec);
+                stream_.socket().close(close_ec);
+                return;
+            }
+            write_consume_chunk(more);
+        });
+}
+
+void BeastHttpSession::start_stream(HttpApi::StreamParams params) {
+    static std::atomic<uint64_t> sse_client_id_counter{0};
+    sse_ = std::make_unique<Stream>(stream_.get_executor());
+    sse_->topic = params.topic;
+    sse_->offset = params.start_offset;
+    sse_->subscriber_id = "sse_client_" + params.topic + "_" + std::to_string(sse_client_id_counter++);
+
+    std::cout << "SSE stream [" << sse_->subscriber_id << "]: topic='" << sse_->topic
+              << "', start_offset=" << sse_->offset << std::endl;
+
+    // Wake-ups run on this connection's strand
+    std::weak_ptr<BeastHttpSession> weak_self = shared_from_this();
+    sub_manager_->subscribe(sse_->topic, sse_->subscriber_id, sse_->offset, stream_.get_executor(),
+        [weak_self](const NotificationBatchPtr& batch) {
+            batch->seal(); // The stream reads new messages from the log
+            if (auto self = weak_self.lock()) {
+                if (!self->sse_ || self->sse_->closed) return;
+                self->sse_->wake = true;
+                if (!self->sse_->pacing) self->pump_stream();
+            }
+        });
+
+    sse_->header.version(version_);
+    sse_->header.result(http::status::ok);
+    sse_->header.set(http::field::server, "event-queue-server");
+    sse_->header.set(http::field::content_type, "text/event-stream");
+    sse_->header.set(http::field::cache_control, "no-cache");
+    sse_->header.keep_alive(true);
+    sse_->header.chunked(true);
+    HttpApi::Response headers;
+    sse_->encoder = api_.stream_encoder(request_, headers);
+    for (const auto& [name, value] : headers.headers) sse_->header.set(name, value);
+    sse_->serializer = std::make_unique<http::response_serializer<http::empty_body>>(sse_->header);
+
+    sse_->writing = true;
+    stream_.expires_after(HTTP_WRITE_TIMEOUT);
+    http::async_write_header(stream_, *sse_->serializer,
+        [this, self = shared_from_this()](beast::error_code ec, std::size_t /*bytes_transferred*/) {
+            sse_->writing = false;
+            if (ec) return end_stream();
+            watch_for_disconnect();
+            pump_stream();
+        });
+}
+
+void BeastHttpSession::pump_stream() {
+    if (!sse_ || sse_->closed || sse_->writing || sse_->pacing) return;
+    if (!sse_->wake) {
+        return arm_stream_timer(HttpApi::SSE_KEEPALIVE_INTERVAL, false);
+    }
+    // A stream over its consume quota is paced rather than cut off
+    if (uint32_t throttle_ms = api_.admit_stream(request_.client_id, sse_->topic)) {
+        return arm_stream_timer(std::chrono::milliseconds(throttle_ms), true);
+    }
+
+    sse_->wake = false;
+    std::string chunk;
+    try {
+        chunk = api_.read_stream_events(sse_->topic, sse_->offset, request_.client_id);
+    } catch (const std::exception& e) {
+        std::cerr << "SSE consume error for topic " << sse_->topic << ": " << e.what() << std::endl;
+        return end_stream();
+    }
+    if (chunk.empty()) { // Woken for messages already sent
+        return arm_stream_timer(HttpApi::SSE_KEEPALIVE_INTERVAL, false);
+    }
+    sse_->wake = true; // The read may have stopped at the byte limit; an empty read ends the catch-up
+    write_stream_chunk(std::move(chunk));
+}
+
+void BeastHttpSession::write_stream_chunk(std::string chunk) {
+    sse_->writing = true;
+    if (sse_->encoder) {
+        // Each event is compressed and flushed on its own, against the context of the whole stream
+        sse_->chunk.clear();
+        sse_->encoder->write(chunk.data(), chunk.size(), sse_->chunk);
+    } else {
+        sse_->chunk = std::move(chunk);
+    }
+    stream_.expires_after(HTTP_WRITE_TIMEOUT); // Only the write: the disconnect watch is already pending
+    net::async_write(stream_, http::make_chunk(net::buffer(sse_->chunk)),
+        [this, self = shared_from_this()](beast::error_code ec, std::size_t /*bytes_transferred*/) {
+            sse_->writing = false;
+            if (ec) return end_stream();
+            pump_stream();
+        });
+}
+
+void BeastHttpSession::arm_stream_timer(std::chrono::milliseconds delay, bool pacing) {
+    sse_->pacing = pacing;
+    sse_->timer.expires_after(delay); // Cancels the previous wait
+    sse_->timer.async_wait([this, self = shared_from_this(), pacing](beast::error_code ec) {
+        if (ec == net::error::operation_aborted || !sse_ || sse_->closed) return;
+        if (pacing) {
+            sse_->pacing = false;
+            return pump_stream();
+        }
+        if (!sse_->writing) {
+            // No new messages; a comment line keeps proxies from closing the stream
+            write_stream_chunk(": keep-alive\n\n");
+        }
+    });
+}
+
+void BeastHttpSession::watch_for_disconnect() {
+    // Clients don't send on an event stream, so a read only completes when the connection goes away
+    stream_.expires_never();
+    stream_.async_read_some(net::buffer(sse_->discard),
+        [this, self = shared_from_this()](beast::error_code ec, std::size_t /*bytes_transferred*/) {
+            if (ec) return end_stream();
+            watch_for_disconnect();
+        });
+}
+
+void BeastHttpSession::end_stream() {
+    if (!sse_ || sse_->closed) return;
+    sse_->closed = true;
+    sse_->timer.cancel();
+    sub_manager_->unsubscribe(sse_->topic, sse_->subscriber_id);
+    std::cout << "SSE stream for topic '" << sse_->topic << "' with ID '" << sse_->subscriber_id << "' closed." << std::endl;
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+    stream_.socket().close(ec);
+}
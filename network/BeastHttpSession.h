@@ -0,0 +1,105 @@
+// network/BeastHttpSession.h
+#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "../event_queue_core/EventQueue.h"
+#include "SubscriptionManager.h"
+#include "HttpApi.h"
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace http = beast::http;           // from <boost/beast/http.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+class BeastHttpServer;
+
+// One HTTP/1.1 connection of the Beast engine. Requests are read and answered one at a time on the
+// connection's strand (keep-alive, no pipelining). Handlers that would block in the cpp-httplib
+// engine wait asynchronously instead: a long-poll consume parks on the topic's waiter list and a
+// timer, and an SSE stream turns the connection into a chunked event stream that is written to
+// whenever the SubscriptionManager reports new messages.
+class BeastHttpSession : public std::enable_shared_from_this<BeastHttpSession> {
+public:
+    BeastHttpSession(tcp::socket&& socket, std::shared_ptr<BeastHttpServer> server, HttpApi& api,
+                     EventQueue& queue, SubscriptionManager* sub_manager);
+    ~BeastHttpSession();
+
+    void run();
+
+private:
+    void do_read();
+    void on_read_header(beast::error_code ec, std::size_t bytes_transferred);
+    void read_body();
+    void on_read(beast::error_code ec, std::size_t bytes_transferred);
+    void handle_request();
+    void send_response(HttpApi::Response api_res);
+    void on_write(bool close, beast::error_code ec, std::size_t bytes_transferred);
+    void do_close();
+
+    // Long-poll CONSUME: answered when data arrives or wait_ms elapses, without holding a thread
+    void start_long_poll(HttpApi::ConsumeParams params);
+
+    // Streamed (NDJSON/binary) consume: a chunked response, read from the log one chunk per write
+    void start_consume_stream(const HttpApi::ConsumeParams& params);
+    void write_consume_chunk(bool has_chunk);
+
+    // SSE. Wake-ups mark the stream as having new messages; pump_stream() reads them from the log
+    // and writes them as one chunk, one write at a time, then keeps going until it is caught up.
+    void start_stream(HttpApi::StreamParams params);
+    void pump_stream();
+    void write_stream_chunk(std::string chunk);
+    void arm_stream_timer(std::chrono::milliseconds delay, bool pacing);
+    void watch_for_disconnect();
+    void end_stream();
+
+    beast::tcp_stream stream_;
+    beast::flat_buffer buffer_;
+    std::optional<http::request_parser<http::string_body>> parser_;
+    std::shared_ptr<BeastHttpServer> server_; // Keeps api_ alive
+    HttpApi& api_;
+    EventQueue& event_queue_;
+    SubscriptionManager* sub_manager_; // Null disables SSE
+    std::string peer_address_;
+
+    HttpApi::Request request_; // The request being served
+    unsigned version_ = 11;
+    bool keep_alive_ = false;
+    std::shared_ptr<http::response<http::string_body>> response_; // Owned by the write in flight
+    std::shared_ptr<http::response<http::empty_body>> continue_response_; // Interim 100 Continue in flight
+
+    struct ConsumeStream {
+        HttpApi::ConsumeCursor cursor;
+        std::unique_ptr<Compression::StreamEncoder> encoder; // Null: sent as is
+        http::response<http::empty_body> header;
+        std::unique_ptr<http::response_serializer<http::empty_body>> serializer;
+        std::string chunk;   // Records read from the log
+        std::string encoded; // What is written when compressing; owned by the write in flight
+    };
+    std::unique_ptr<ConsumeStream> consume_;
+
+    struct Stream {
+        explicit Stream(const net::any_io_executor& executor) : timer(executor) {}
+        std::string topic;
+        std::string subscriber_id;
+        uint64_t offset = 0;
+        bool wake = true;     // New messages may be in the log (starts set to catch up)
+        bool writing = false;
+        bool pacing = false;  // Over quota: the timer resumes the stream
+        bool closed = false;
+        net::steady_timer timer; // Keep-alive comment, or the end of a quota pause
+        std::unique_ptr<Compression::StreamEncoder> encoder; // Null: sent as is
+        http::response<http::empty_body> header;
+        std::unique_ptr<http::response_serializer<http::empty_body>> serializer;
+        std::string chunk;                // Owned by the write in flight
+        std::array<char, 512> discard;    // Reads only detect the client going away
+    };
+    std::unique_ptr<Stream> sse_;
+};
@@ -0,0 +1,67 @@
+// network/BufferPool.cpp
+#include "BufferPool.h"
+
+BufferPool::Limits BufferPool::limits_;
+std::atomic<size_t> BufferPool::pooled_bytes_{0};
+
+void BufferPool::configure(const Limits& limits) {
+    limits_ = limits;
+}
+
+BufferPool& BufferPool::local() {
+    thread_local BufferPool pool;
+    return pool;
+}
+
+BufferPool::~BufferPool() {
+    for (const auto& list : free_) {
+        for (const auto& buffer : list) {
+            pooled_bytes_.fetch_sub(buffer.capacity(), std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t BufferPool::class_for_request(size_t min_capacity) {
+    size_t cls = 0;
+    while (cls < NUM_CLASSES && class_size(cls) < min_capacity) ++cls;
+    return cls; // NUM_CLASSES when too large to pool
+}
+
+size_t BufferPool::class_for_capacity(size_t capacity) {
+    if (capacity < MIN_CLASS_SIZE || capacity > MAX_CLASS_SIZE) return NUM_CLASSES;
+    size_t cls = 0;
+    while (cls + 1 < NUM_CLASSES && class_size(cls + 1) <= capacity) ++cls;
+    return cls;
+}
+
+BufferPool::Buffer BufferPool::acquire(size_t min_capacity) {
+    size_t cls = class_for_request(min_capacity);
+    Buffer buffer;
+    if (cls == NUM_CLASSES) {
+        buffer.reserve(min_capacity);
+        return buffer;
+    }
+    auto& list = free_[cls];
+    if (!list.empty()) {
+        buffer = std::move(list.back());
+        list.pop_back();
+        pooled_bytes_.fetch_sub(buffer.capacity(), std::memory_order_relaxed);
+        return buffer;
+    }
+    buffer.reserve(class_size(cls));
+    return buffer;
+}
+
+void BufferPool::release(Buffer buffer) {
+    size_t capacity = buffer.capacity();
+    size_t cls = class_for_capacity(capacity);
+    if (cls == NUM_CLASSES) return; // Too small to matter or too large to keep
+    auto& list = free_[cls];
+    if (list.size() >= limits_.max_buffers_per_class) return;
+    if (pooled_bytes_.fetch_add(capacity, std::memory_order_relaxed) + capacity > limits_.max_pooled_bytes) {
+        pooled_bytes_.fetch_sub(capacity, std::memory_order_relaxed);
+        return;
+    }
+    buffer.clear();
+    list.push_back(std::move(buffer));
+}
@@ -0,0 +1,56 @@
+// network/BufferPool.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Recycles network buffers (std::vector<char>) by size class so steady-state request and response
+// traffic reuses capacity instead of going through malloc/free.
+//
+// Each I/O thread has its own pool (BufferPool::local()), so acquire/release take no locks. A buffer
+// may be released on a different thread than the one that acquired it (e.g. a request decoded on a
+// topic's shard); it then simply joins that thread's pool. Pooled memory is bounded two ways: each
+// size class keeps at most max_buffers_per_class free buffers per thread, and the free buffers of all
+// threads together never exceed max_pooled_bytes. Anything beyond that is freed on release, so a
+// connection storm can't leave an ever-growing cache behind.
+class BufferPool {
+public:
+    using Buffer = std::vector<char>;
+
+    // Capacities handed out: 256 B, 1 KiB, 4 KiB ... 4 MiB. Larger buffers are never pooled.
+    static constexpr size_t NUM_CLASSES = 8;
+    static constexpr size_t MIN_CLASS_SIZE = 256;
+    static constexpr size_t MAX_CLASS_SIZE = MIN_CLASS_SIZE << (2 * (NUM_CLASSES - 1));
+
+    struct Limits {
+        size_t max_pooled_bytes = 64 * 1024 * 1024; // Across all threads
+        size_t max_buffers_per_class = 256;         // Per thread
+    };
+    // Call before the I/O threads start
+    static void configure(const Limits& limits);
+
+    // The calling thread's pool
+    static BufferPool& local();
+
+    // Returns an empty buffer with capacity >= min_capacity (rounded up to its size class)
+    Buffer acquire(size_t min_capacity = 0);
+    // Takes the buffer back for reuse, or frees it if it is too large or the caps are reached
+    void release(Buffer buffer);
+
+    BufferPool() = default;
+    ~BufferPool();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+private:
+    static size_t class_for_request(size_t min_capacity); // Smallest class that holds min_capacity
+    static size_t class_for_capacity(size_t capacity);     // Largest class a buffer's capacity covers
+    static size_t class_size(size_t cls) { return MIN_CLASS_SIZE << (2 * cls); }
+
+    static Limits limits_;
+    static std::atomic<size_t> pooled_bytes_; // Capacity held in free lists, all threads
+
+    std::array<std::vector<Buffer>, NUM_CLASSES> free_;
+};
@@ -0,0 +1,331 @@
+// network/Compression.cpp
+#include "Compression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+#include <zlib.h>
+#ifdef EQ_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef EQ_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace Compression {
+
+std::vector<Codec> available_codecs() {
+    std::vector<Codec> codecs;
+#ifdef EQ_HAVE_LZ4
+    codecs.push_back(Codec::LZ4);
+#endif
+#ifdef EQ_HAVE_ZSTD
+    codecs.push_back(Codec::ZSTD);
+#endif
+    codecs.push_back(Codec::ZLIB);
+    return codecs;
+}
+
+bool is_available(Codec codec) {
+    switch (codec) {
+#ifdef EQ_HAVE_LZ4
+        case Codec::LZ4: return true;
+#endif
+#ifdef EQ_HAVE_ZSTD
+        case Codec::ZSTD: return true;
+#endif
+        case Codec::ZLIB: return true;
+        default: return false;
+    }
+}
+
+const char* codec_name(Codec codec) {
+    switch (codec) {
+        case Codec::LZ4: return "lz4";
+        case Codec::ZSTD: return "zstd";
+        case Codec::ZLIB: return "zlib";
+        default: return "none";
+    }
+}
+
+Codec codec_from_name(const std::string& name) {
+    if (name == "lz4") return Codec::LZ4;
+    if (name == "zstd") return Codec::ZSTD;
+    if (name == "zlib") return Codec::ZLIB;
+    return Codec::NONE;
+}
+
+Codec negotiate(const Settings& settings, const std::vector<Codec>& offered) {
+    for (Codec codec : settings.codecs) {
+        if (!is_available(codec)) continue;
+        for (Codec candidate : offered) {
+            if (candidate == codec) return codec;
+        }
+    }
+    return Codec::NONE;
+}
+
+namespace {
+
+// Upper bound on the codec's output for `len` input bytes
+size_t max_compressed_size(Codec codec, size_t len) {
+    switch (codec) {
+#ifdef EQ_HAVE_LZ4
+        case Codec::LZ4: return static_cast<size_t>(LZ4_compressBound(static_cast<int>(len)));
+#endif
+#ifdef EQ_HAVE_ZSTD
+        case Codec::ZSTD: return ZSTD_compressBound(len);
+#endif
+        case Codec::ZLIB: return compressBound(static_cast<uLong>(len));
+        default: throw std::runtime_error(std::string("Compression codec not available: ") + codec_name(codec));
+    }
+}
+
+// Compresses into [out, out + capacity); returns the compressed size, or 0 on failure
+size_t compress_raw(Codec codec, int level, const char* data, size_t len, char* out, size_t capacity) {
+    switch (codec) {
+#ifdef EQ_HAVE_LZ4
+        case Codec::LZ4: {
+            int n = LZ4_compress_default(data, out, static_cast<int>(len), static_cast<int>(capacity));
+            return n > 0 ? static_cast<size_t>(n) : 0;
+        }
+#endif
+#ifdef EQ_HAVE_ZSTD
+        case Codec::ZSTD: {
+            size_t n = ZSTD_compress(out, capacity, data, len, level);
+            return ZSTD_isError(n) ? 0 : n;
+        }
+#endif
+        case Codec::ZLIB: {
+            uLongf n = static_cast<uLongf>(capacity);
+            int rc = compress2(reinterpret_cast<Bytef*>(out), &n, reinterpret_cast<const Bytef*>(data),
+                               static_cast<uLong>(len), level > 0 ? level : Z_DEFAULT_COMPRESSION);
+            return rc == Z_OK ? static_cast<size_t>(n) : 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Decompresses exactly `expected` bytes into `out`; false on corrupt input
+bool decompress_raw(Codec codec, const char* data, size_t len, char* out, size_t expected) {
+    switch (codec) {
+#ifdef EQ_HAVE_LZ4
+        case Codec::LZ4:
+            return LZ4_decompress_safe(data, out, static_cast<int>(len), static_cast<int>(expected)) ==
+                   static_cast<int>(expected);
+#endif
+#ifdef EQ_HAVE_ZSTD
+        case Codec::ZSTD:
+            return ZSTD_decompress(out, expected, data, len) == expected;
+#endif
+        case Codec::ZLIB: {
+            uLongf n = static_cast<uLongf>(expected);
+            return uncompress(reinterpret_cast<Bytef*>(out), &n, reinterpret_cast<const Bytef*>(data),
+                              static_cast<uLong>(len)) == Z_OK && n == expected;
+        }
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+bool compress_payload(Codec codec, int level, const char* data, size_t len, std::vector<char>& out) {
+    const size_t start = out.size();
+    out.resize(start + sizeof(uint32_t) + max_compressed_size(codec, len));
+    NetworkProtocol::detail::store(out.data() + start, static_cast<uint32_t>(len));
+    size_t n = compress_raw(codec, level, data, len, out.data() + start + sizeof(uint32_t),
+                            out.size() - start - sizeof(uint32_t));
+    if (n == 0 || sizeof(uint32_t) + n >= len) {
+        out.resize(start);
+        return false;
+    }
+    out.resize(start + sizeof(uint32_t) + n);
+    return true;
+}
+
+void decompress_payload(Codec codec, const char* data, size_t len, std::vector<char>& out, uint32_t max_size) {
+    if (!is_available(codec)) {
+        throw std::runtime_error(std::string("Compression codec not available: ") + codec_name(codec));
+    }
+    if (len < sizeof(uint32_t)) {
+        throw std::runtime_error("Compressed payload: missing length prefix.");
+    }
+    uint32_t expected = NetworkProtocol::detail::load<uint32_t>(data);
+    if (expected > std::min(max_size, NetworkProtocol::MAX_PAYLOAD_SIZE)) {
+        throw std::runtime_error("Compressed payload: decoded size " + std::to_string(expected) + " exceeds the limit.");
+    }
+    out.resize(expected);
+    if (!decompress_raw(codec, data + sizeof(uint32_t), len - sizeof(uint32_t), out.data(), expected)) {
+        throw std::runtime_error(std::string("Compressed payload: corrupt ") + codec_name(codec) + " data.");
+    }
+}
+
+// --- HTTP content codings ---
+
+std::vector<ContentEncoding> available_encodings() {
+    std::vector<ContentEncoding> encodings;
+#ifdef EQ_HAVE_ZSTD
+    encodings.push_back(ContentEncoding::ZSTD);
+#endif
+    encodings.push_back(ContentEncoding::GZIP);
+    return encodings;
+}
+
+const char* encoding_name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::ZSTD: return "zstd";
+        case ContentEncoding::GZIP: return "gzip";
+        default: return "identity";
+    }
+}
+
+ContentEncoding encoding_from_name(const std::string& name) {
+    if (name == "zstd") return ContentEncoding::ZSTD;
+    if (name == "gzip") return ContentEncoding::GZIP;
+    return ContentEncoding::IDENTITY;
+}
+
+ContentEncoding negotiate_encoding(const HttpSettings& settings, const std::string& accept_encoding) {
+    if (settings.encodings.empty() || accept_encoding.empty()) return ContentEncoding::IDENTITY;
+
+    // Parse "gzip, zstd;q=0.5, *;q=0" into the accepted names and the wildcard's verdict
+    std::vector<std::pair<std::string, bool>> listed; // name -> accepted (q > 0)
+    int wildcard = -1;                                // -1 absent, 0 refused, 1 accepted
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t comma = accept_encoding.find(',', pos);
+        if (comma == std::string::npos) comma = accept_encoding.size();
+        std::string item = accept_encoding.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        size_t semi = item.find(';');
+        std::string name = item.substr(0, semi);
+        name.erase(std::remove_if(name.begin(), name.end(), [](unsigned char c) { return std::isspace(c); }), name.end());
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (name.empty()) continue;
+        bool accepted = true;
+        if (semi != std::string::npos) {
+            size_t q = item.find("q=", semi);
+            if (q != std::string::npos) accepted = std::strtod(item.c_str() + q + 2, nullptr) > 0.0;
+        }
+        if (name == "x-gzip") name = "gzip";
+        if (name == "*") wildcard = accepted ? 1 : 0;
+        else listed.emplace_back(name, accepted);
+    }
+
+    for (ContentEncoding encoding : settings.encodings) {
+        const std::string name = encoding_name(encoding);
+        auto it = std::find_if(listed.begin(), listed.end(), [&](const auto& entry) { return entry.first == name; });
+        if (it != listed.end() ? it->second : wildcard == 1) return encoding;
+    }
+    return ContentEncoding::IDENTITY;
+}
+
+struct StreamEncoder::State {
+    z_stream zs{};
+#ifdef EQ_HAVE_ZSTD
+    ZSTD_CCtx* zstd = nullptr;
+#endif
+};
+
+StreamEncoder::StreamEncoder(ContentEncoding encoding, int level) : encoding_(encoding), state_(std::make_unique<State>()) {
+    switch (encoding_) {
+        case ContentEncoding::GZIP:
+            // windowBits 15 + 16 selects the gzip wrapper
+            if (deflateInit2(&state_->zs, level > 0 ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("gzip: deflateInit2 failed.");
+            }
+            break;
+#ifdef EQ_HAVE_ZSTD
+        case ContentEncoding::ZSTD:
+            state_->zstd = ZSTD_createCCtx();
+            if (!state_->zstd) throw std::runtime_error("zstd: ZSTD_createCCtx failed.");
+            ZSTD_CCtx_setParameter(state_->zstd, ZSTD_c_compressionLevel, level);
+            break;
+#endif
+        default:
+            throw std::runtime_error(std::string("Content encoding not available: ") + encoding_name(encoding_));
+    }
+}
+
+StreamEncoder::~StreamEncoder() {
+    if (encoding_ == ContentEncoding::GZIP) deflateEnd(&state_->zs);
+#ifdef EQ_HAVE_ZSTD
+    if (state_->zstd) ZSTD_freeCCtx(state_->zstd);
+#endif
+}
+
+namespace {
+
+// Output is appended in steps of this size; the loops below run until the codec has nothing left
+const size_t ENCODE_STEP_BYTES = 16 * 1024;
+
+void deflate_into(z_stream& zs, const char* data, size_t len, std::string& out, int mode) {
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = static_cast<uInt>(len);
+    for (;;) {
+        size_t start = out.size();
+        size_t step = std::max(ENCODE_STEP_BYTES, len / 2);
+        out.resize(start + step);
+        zs.next_out = reinterpret_cast<Bytef*>(&out[start]);
+        zs.avail_out = static_cast<uInt>(step);
+        int rc = deflate(&zs, mode);
+        out.resize(start + step - zs.avail_out);
+        if (rc == Z_STREAM_ERROR) throw std::runtime_error("gzip: deflate failed.");
+        if (mode == Z_FINISH ? rc == Z_STREAM_END : (zs.avail_out != 0 && zs.avail_in == 0)) break;
+    }
+}
+
+#ifdef EQ_HAVE_ZSTD
+void zstd_into(ZSTD_CCtx* cctx, const char* data, size_t len, std::string& out, ZSTD_EndDirective mode) {
+    ZSTD_inBuffer in{data, len, 0};
+    for (;;) {
+        size_t start = out.size();
+        size_t step = std::max(ZSTD_CStreamOutSize(), len / 2);
+        out.resize(start + step);
+        ZSTD_outBuffer ob{&out[start], step, 0};
+        size_t remaining = ZSTD_compressStream2(cctx, &ob, &in, mode);
+        out.resize(start + ob.pos);
+        if (ZSTD_isError(remaining)) throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(remaining));
+        // With ZSTD_e_continue the input only has to be consumed; flush/end must also drain
+        if (mode == ZSTD_e_continue ? in.pos == in.size : remaining == 0) break;
+    }
+}
+#endif
+
+} // namespace
+
+void StreamEncoder::write(const char* data, size_t len, std::string& out, bool flush) {
+#ifdef EQ_HAVE_ZSTD
+    if (encoding_ == ContentEncoding::ZSTD) {
+        return zstd_into(state_->zstd, data, len, out, flush ? ZSTD_e_flush : ZSTD_e_continue);
+    }
+#endif
+    deflate_into(state_->zs, data, len, out, flush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+}
+
+void StreamEncoder::finish(std::string& out) {
+#ifdef EQ_HAVE_ZSTD
+    if (encoding_ == ContentEncoding::ZSTD) {
+        return zstd_into(state_->zstd, nullptr, 0, out, ZSTD_e_end);
+    }
+#endif
+    deflate_into(state_->zs, nullptr, 0, out, Z_FINISH);
+}
+
+bool encode_body(ContentEncoding encoding, int level, std::string& body) {
+    std::string encoded;
+    encoded.reserve(body.size() / 4 + 64);
+    StreamEncoder encoder(encoding, level);
+    encoder.write(body.data(), body.size(), encoded, false);
+    encoder.finish(encoded);
+    if (encoded.size() >= body.size()) return false;
+    body.swap(encoded);
+    return true;
+}
+
+} // namespace Compression
@@ -0,0 +1,108 @@
+// network/Compression.h
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "NetworkProtocol.h"
+
+// Payload codecs for the TCP protocol's negotiated wire compression (see HANDSHAKE_REQUEST), and
+// the HTTP content codings (Accept-Encoding) built on the same libraries.
+// zlib is always built in; LZ4 and Zstd are compiled in when the build finds them (EQ_HAVE_LZ4,
+// EQ_HAVE_ZSTD), so a codec is only ever offered or accepted when this binary can decode it.
+namespace Compression {
+
+    using Codec = NetworkProtocol::CompressionCodec;
+
+    // Codecs built into this binary, fastest first
+    std::vector<Codec> available_codecs();
+    bool is_available(Codec codec);
+
+    const char* codec_name(Codec codec); // "lz4", "zstd", "zlib" or "none"
+    Codec codec_from_name(const std::string& name); // NONE for unknown names
+
+    // Per-listener settings. A client gets the first codec in `codecs` that it also offers.
+    struct Settings {
+        std::vector<Codec> codecs;       // Empty (the default) disables compression
+        uint32_t threshold_bytes = 4096; // Payloads smaller than this are sent as is
+        int level = 0;                   // 0 = the codec's default; ignored by LZ4
+        // Largest decoded size a compressed request may claim. The decode buffer is sized from the
+        // claim before decoding, so this bounds what a few bytes of input can make the server allocate.
+        uint32_t max_decompressed_bytes = 4 * 1024 * 1024;
+    };
+
+    // Picks the codec for a client offering `offered` (most preferred first): the first entry of
+    // settings.codecs that the client offers, or NONE.
+    Codec negotiate(const Settings& settings, const std::vector<Codec>& offered);
+
+    // Appends the FLAG_COMPRESSED body for [data, data + len) to `out`: uncompressed length (u32),
+    // then the codec's output. Returns false, leaving `out` as it was, if that would not be smaller
+    // than `len`; the caller then sends the payload uncompressed.
+    bool compress_payload(Codec codec, int level, const char* data, size_t len, std::vector<char>& out);
+
+    // Replaces `out` with the decoded FLAG_COMPRESSED body [data, data + len). Throws
+    // std::runtime_error on corrupt input or a claimed decoded size above `max_size`, checked before
+    // anything is allocated.
+    void decompress_payload(Codec codec, const char* data, size_t len, std::vector<char>& out,
+                            uint32_t max_size = NetworkProtocol::MAX_PAYLOAD_SIZE);
+
+    // --- HTTP content codings ---
+
+    enum class ContentEncoding { IDENTITY, GZIP, ZSTD };
+
+    // Encodings built into this binary, preferred first (zstd when available, then gzip)
+    std::vector<ContentEncoding> available_encodings();
+    const char* encoding_name(ContentEncoding encoding); // "zstd", "gzip" or "identity"
+    ContentEncoding encoding_from_name(const std::string& name); // IDENTITY for unknown names
+
+    struct HttpSettings {
+        std::vector<ContentEncoding> encodings = available_encodings(); // Empty disables compression
+        uint32_t threshold_bytes = 1024; // Smaller response bodies are sent as is (streams always compress)
+        int level = 0;                   // 0 = the codec's default
+    };
+
+    // The first of settings.encodings that an Accept-Encoding header value accepts (q > 0, either
+    // by name or through "*"), or IDENTITY.
+    ContentEncoding negotiate_encoding(const HttpSettings& settings, const std::string& accept_encoding);
+
+    // Encodes one response body incrementally, keeping the compression context across writes so a
+    // stream of small events (SSE, NDJSON) still compresses against everything sent before it.
+    class StreamEncoder {
+    public:
+        StreamEncoder(ContentEncoding encoding, int level);
+        ~StreamEncoder();
+        StreamEncoder(const StreamEncoder&) = delete;
+        StreamEncoder& operator=(const StreamEncoder&) = delete;
+
+        ContentEncoding encoding() const { return encoding_; }
+
+        // Appends the encoding of [data, data + len) to `out`. With `flush`, everything written so
+        // far can be decoded from what has been appended (costs a few bytes per flush).
+        void write(const char* data, size_t len, std::string& out, bool flush = true);
+        // Appends the end of the encoded body; nothing may be written afterwards
+        void finish(std::string& out);
+
+    private:
+        struct State;
+        ContentEncoding encoding_;
+        std::unique_ptr<State> state_;
+    };
+
+    // Replaces `body` with its encoding, unless that would not be smaller (returns false then)
+    bool encode_body(ContentEncoding encoding, int level, std::string& body);
+
+    // --- WebSocket permessage-deflate ---
+
+    // Offered by the WebSocket server and negotiated by Beast during the handshake (RFC 7692). Beast
+    // does the compression itself, so this is only the configuration.
+    struct WebSocketSettings {
+        bool enabled = false;
+        int window_bits = 15;        // LZ77 window (9..15) offered for both directions
+        int mem_level = 4;           // zlib memLevel (1..9): higher is faster and uses more memory
+        int level = 0;               // 0 = Beast's default (8)
+        uint32_t threshold_bytes = 0; // Smaller messages are sent uncompressed, where Beast supports it
+        bool context_takeover = true; // false: every message is compressed on its own
+    };
+
+} // namespace Compression
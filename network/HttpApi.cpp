@@ -0,0 +1,531 @@
+// network/HttpApi.cpp
+#include "HttpApi.h"
+#include "NetworkProtocol.h"
+#include "JsonWriter.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <limits>
+
+using json = nlohmann::json;
+
+// Upper bound for the ?wait_ms= long-poll parameter
+static const uint32_t MAX_CONSUME_WAIT_MS = 60 * 1000;
+// Default and upper bound for the ?max_bytes= parameter of /consume
+static const uint64_t MAX_CONSUME_RESPONSE_BYTES = 16 * 1024 * 1024;
+// Upper bound on the log records an SSE stream reads per chunk
+static const uint64_t SSE_MAX_CHUNK_BYTES = 1024 * 1024;
+// Log records read per chunk of a streamed (NDJSON/binary) consume
+static const uint64_t CONSUME_STREAM_CHUNK_BYTES = 256 * 1024;
+
+namespace {
+
+// Parses an unsigned query parameter; false if present but not a number
+template <typename T>
+bool unsigned_param(const HttpApi::Request& req, const std::string& name, T& out) {
+    const std::string* value = req.param(name);
+    if (!value) return true;
+    try {
+        size_t used = 0;
+        unsigned long long parsed = std::stoull(*value, &used);
+        if (used != value->size() || parsed > std::numeric_limits<T>::max()) return false;
+        out = static_cast<T>(parsed);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Collects the payloads of a produce_batch body without building a DOM: each record is an object
+// whose "payload" string is moved straight into `payloads`, and every other member is skipped.
+// Records sit at `record_depth` (1 for an NDJSON line, 2 inside a top-level JSON array).
+class ProduceBatchSax : public nlohmann::json_sax<json> {
+public:
+    ProduceBatchSax(std::vector<std::string>& payloads, size_t record_depth)
+        : payloads_(payloads), record_depth_(record_depth) {}
+
+    const std::string& error() const { return error_; }
+
+    bool null() override { return scalar(); }
+    bool boolean(bool) override { return scalar(); }
+    bool number_integer(number_integer_t) override { return scalar(); }
+    bool number_unsigned(number_unsigned_t) override { return scalar(); }
+    bool number_float(number_float_t, const string_t&) override { return scalar(); }
+    bool binary(binary_t&) override { return scalar(); }
+
+    bool string(string_t& val) override {
+        if (depth_ == record_depth_ && in_payload_) {
+            in_payload_ = false;
+            if (has_payload_) {
+                payloads_.back() = std::move(val); // Duplicate key: the last one wins, as with json::parse
+            } else {
+                payloads_.push_back(std::move(val));
+                has_payload_ = true;
+            }
+            return true;
+        }
+        return scalar();
+    }
+
+    bool start_object(std::size_t) override {
+        if (!enter()) return false;
+        if (depth_ == record_depth_) has_payload_ = false;
+        return true;
+    }
+
+    bool key(string_t& val) override {
+        if (depth_ == record_depth_) in_payload_ = (val == "payload");
+        return true;
+    }
+
+    bool end_object() override {
+        if (depth_ == record_depth_ && !has_payload_) return fail("missing 'payload' string");
+        --depth_;
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        if (depth_ == 0 && record_depth_ > 1) { // The top-level array of records
+            ++depth_;
+            return true;
+        }
+        return enter() && (depth_ > record_depth_ || fail("expected an object"));
+    }
+
+    bool end_array() override {
+        --depth_;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string& /*last_token*/,
+                     const nlohmann::detail::exception& ex) override {
+        error_ = "Invalid JSON at byte " + std::to_string(position) + ": " + ex.what();
+        return false;
+    }
+
+private:
+    // A nested value starts; only values inside a record (other than its payload) are allowed
+    bool enter() {
+        if (depth_ == record_depth_ && in_payload_) return fail("'payload' must be a string");
+        ++depth_;
+        return depth_ >= record_depth_ || fail("expected an object");
+    }
+
+    bool scalar() {
+        if (depth_ < record_depth_) return fail("expected an object");
+        if (depth_ == record_depth_ && in_payload_) return fail("'payload' must be a string");
+        return true;
+    }
+
+    bool fail(const std::string& what) {
+        error_ = "Record " + std::to_string(payloads_.size()) + ": " + what + ".";
+        return false;
+    }
+
+    std::vector<std::string>& payloads_;
+    size_t record_depth_;
+    size_t depth_ = 0;
+    bool in_payload_ = false;  // The next value belongs to the record's "payload" key
+    bool has_payload_ = false;
+    std::string error_;
+};
+
+} // namespace
+
+bool HttpApi::parse_produce_batch(const std::string& body, std::vector<std::string>& payloads, std::string& error) {
+    size_t first = body.find_first_not_of(" \t\r\n");
+    if (first != std::string::npos && body[first] == '[') {
+        ProduceBatchSax sax(payloads, 2);
+        if (json::sax_parse(body.begin(), body.end(), &sax)) return true;
+        error = sax.error();
+        return false;
+    }
+
+    // NDJSON: a record can't span lines, since JSON strings escape their newlines
+    size_t line_start = 0;
+    for (size_t line_no = 1; line_start < body.size(); ++line_no) {
+        size_t line_end = body.find('\n', line_start);
+        if (line_end == std::string::npos) line_end = body.size();
+        size_t content_end = line_end;
+        if (content_end > line_start && body[content_end - 1] == '\r') --content_end;
+        bool blank = body.find_first_not_of(" \t", line_start) >= content_end;
+        if (!blank) {
+            ProduceBatchSax sax(payloads, 1);
+            if (!json::sax_parse(body.begin() + line_start, body.begin() + content_end, &sax)) {
+                error = "Line " + std::to_string(line_no) + ": " + sax.error();
+                return false;
+            }
+        }
+        line_start = line_end + 1;
+    }
+    return true;
+}
+
+HttpApi::HttpApi(EventQueue& queue, QuotaManager* quotas, const Compression::HttpSettings* compression)
+    : event_queue_(queue), quotas_(quotas), compression_(compression) {}
+
+HttpApi::Route HttpApi::route(const std::string& method, const std::string& path, std::string& topic) {
+    static const std::string prefix = "/topics";
+    if (path.compare(0, prefix.size(), prefix) != 0) return Route::NOT_FOUND;
+    if (path.size() == prefix.size()) {
+        return method == "GET" ? Route::LIST_TOPICS : Route::NOT_FOUND;
+    }
+    if (path[prefix.size()] != '/') return Route::NOT_FOUND;
+
+    size_t name_start = prefix.size() + 1;
+    size_t slash = path.find('/', name_start);
+    topic = path.substr(name_start, slash == std::string::npos ? std::string::npos : slash - name_start);
+    if (topic.empty()) return Route::NOT_FOUND;
+    if (slash == std::string::npos) {
+        return method == "POST" ? Route::CREATE_TOPIC : Route::NOT_FOUND;
+    }
+    std::string action = path.substr(slash + 1);
+    if (action == "produce" && method == "POST") return Route::PRODUCE;
+    if (action == "produce_batch" && method == "POST") return Route::PRODUCE_BATCH;
+    if (action == "consume" && method == "GET") return Route::CONSUME;
+    if (action == "stream" && method == "GET") return Route::STREAM;
+    return Route::NOT_FOUND;
+}
+
+void HttpApi::handle(Route route, const std::string& topic, const Request& req, Response& res) {
+    switch (route) {
+        case Route::PRODUCE:
+            handle_produce(topic, req, res);
+            break;
+        case Route::PRODUCE_BATCH:
+            handle_produce_batch(topic, req, res);
+            break;
+        case Route::CREATE_TOPIC:
+            handle_create_topic(topic, req, res);
+            break;
+        case Route::LIST_TOPICS:
+            handle_list_topics(req, res);
+            break;
+        default:
+            error_response(res, 404, "Resource not found or method not allowed (Status: 404)");
+            break;
+    }
+}
+
+uint32_t HttpApi::check_quota(const std::string& client_id, const std::string& topic_name,
+                              QuotaManager::Operation op, uint64_t bytes) {
+    return quotas_ ? quotas_->admit(client_id, topic_name, op, bytes) : 0;
+}
+
+void HttpApi::encode_response(const Request& req, Response& res) const {
+    if (!compression_ || compression_->encodings.empty()) return;
+    res.headers.emplace_back("Vary", "Accept-Encoding");
+    if (res.body.size() < compression_->threshold_bytes) return;
+    auto encoding = Compression::negotiate_encoding(*compression_, req.accept_encoding);
+    if (encoding == Compression::ContentEncoding::IDENTITY) return;
+    try {
+        if (Compression::encode_body(encoding, compression_->level, res.body)) {
+            res.headers.emplace_back("Content-Encoding", Compression::encoding_name(encoding));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "HTTP response compression failed, sending uncompressed: " << e.what() << std::endl;
+    }
+}
+
+std::unique_ptr<Compression::StreamEncoder> HttpApi::stream_encoder(const Request& req, Response& res) const {
+    if (!compression_ || compression_->encodings.empty()) return nullptr;
+    res.headers.emplace_back("Vary", "Accept-Encoding");
+    auto encoding = Compression::negotiate_encoding(*compression_, req.accept_encoding);
+    if (encoding == Compression::ContentEncoding::IDENTITY) return nullptr;
+    auto encoder = std::make_unique<Compression::StreamEncoder>(encoding, compression_->level);
+    res.headers.emplace_back("Content-Encoding", Compression::encoding_name(encoding));
+    return encoder;
+}
+
+void HttpApi::json_response(Response& res, int status_code, const json& body) {
+    res.status = status_code;
+    res.content_type = "application/json";
+    res.body = body.dump();
+}
+
+void HttpApi::json_text_response(Response& res, int status_code, std::string body) {
+    res.status = status_code;
+    res.content_type = "application/json";
+    res.body = std::move(body);
+}
+
+void HttpApi::error_response(Response& res, int status_code, const std::string& error_message) {
+    json err_json = {{"error", error_message}};
+    json_response(res, status_code, err_json);
+}
+
+void HttpApi::throttled_response(Response& res, uint32_t throttle_ms) {
+    res.headers.emplace_back("Retry-After", std::to_string((throttle_ms + 999) / 1000));
+    json_response(res, 429, {{"error", "Quota exceeded."}, {"throttle_ms", throttle_ms}});
+}
+
+std::string HttpApi::url_decode(const std::string& in, bool plus_as_space) {
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        char c = in[i];
+        if (c == '%' && i + 2 < in.size() && std::isxdigit(static_cast<unsigned char>(in[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(in[i + 2]))) {
+            out.push_back(static_cast<char>(std::stoi(in.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        } else if (c == '+' && plus_as_space) {
+            out.push_back(' ');
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+void HttpApi::parse_target(const std::string& target, std::string& path, std::map<std::string, std::string>& params) {
+    size_t query_start = target.find('?');
+    path = url_decode(target.substr(0, query_start), false);
+    if (query_start == std::string::npos) return;
+
+    std::string query = target.substr(query_start + 1);
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t amp = query.find('&', pos);
+        std::string pair = query.substr(pos, amp == std::string::npos ? std::string::npos : amp - pos);
+        if (!pair.empty()) {
+            size_t eq = pair.find('=');
+            std::string key = url_decode(pair.substr(0, eq), true);
+            std::string value = eq == std::string::npos ? std::string() : url_decode(pair.substr(eq + 1), true);
+            params.emplace(std::move(key), std::move(value)); // First occurrence wins
+        }
+        if (amp == std::string::npos) break;
+        pos = amp + 1;
+    }
+}
+
+// --- Route Handlers Implementation (REST & SSE) ---
+
+void HttpApi::handle_produce(const std::string& topic_name, const Request& req, Response& res) {
+    json req_body;
+    try {
+        req_body = json::parse(req.body);
+    } catch (json::parse_error& e) {
+        return error_response(res, 400, "Invalid JSON: " + std::string(e.what()));
+    }
+
+    if (!req_body.contains("payload") || !req_body["payload"].is_string()) {
+        return error_response(res, 400, "Missing 'payload' string in JSON.");
+    }
+    std::string message_payload = req_body["payload"];
+
+    if (uint32_t throttle_ms = check_quota(req.client_id, topic_name, QuotaManager::Operation::PRODUCE, message_payload.size())) {
+        return throttled_response(res, throttle_ms);
+    }
+
+    try {
+        uint64_t offset = event_queue_.produce(topic_name, message_payload);
+        std::string body;
+        JsonWriter(body).begin_object().key("offset").value(offset).key("topic").value(topic_name).end_object();
+        json_text_response(res, 201, std::move(body));
+    } catch (const std::exception& e) {
+        error_response(res, 500, e.what());
+    }
+}
+
+void HttpApi::handle_produce_batch(const std::string& topic_name, const Request& req, Response& res) {
+    std::vector<std::string> payloads;
+    std::string parse_error;
+    if (!parse_produce_batch(req.body, payloads, parse_error)) {
+        return error_response(res, 400, parse_error);
+    }
+    if (payloads.empty()) {
+        return error_response(res, 400, "Batch cannot be empty.");
+    }
+
+    uint64_t batch_bytes = 0;
+    for (const auto& p : payloads) batch_bytes += p.size();
+    if (uint32_t throttle_ms = check_quota(req.client_id, topic_name, QuotaManager::Operation::PRODUCE, batch_bytes)) {
+        return throttled_response(res, throttle_ms);
+    }
+
+    try {
+        // One append (one lock, one write to the log) for the whole batch
+        uint64_t base_offset = event_queue_.produce_batch(topic_name, std::vector<std::string_view>(payloads.begin(), payloads.end()));
+        std::string body;
+        JsonWriter(body).begin_object()
+            .key("base_offset").value(base_offset)
+            .key("count").value(static_cast<uint64_t>(payloads.size()))
+            .key("last_offset").value(base_offset + payloads.size() - 1)
+            .key("topic").value(topic_name)
+            .end_object();
+        json_text_response(res, 201, std::move(body));
+    } catch (const std::invalid_argument& e) {
+        error_response(res, 400, e.what());
+    } catch (const std::exception& e) {
+        error_response(res, 500, e.what());
+    }
+}
+
+bool HttpApi::parse_consume(const std::string& topic_name, const Request& req, ConsumeParams& params, Response& res) {
+    params.topic = topic_name;
+    params.max_bytes = MAX_CONSUME_RESPONSE_BYTES;
+    if (const std::string* format = req.param("format")) {
+        if (*format == "ndjson") params.format = ConsumeFormat::NDJSON;
+        else if (*format == "binary") params.format = ConsumeFormat::BINARY;
+        else if (*format != "json") { error_response(res, 400, "Invalid 'format'."); return false; }
+    }
+    bool streamed = params.format != ConsumeFormat::JSON;
+    if (streamed) { // Unbounded unless limited: a streamed consume reads to the log end
+        params.max_messages = std::numeric_limits<uint32_t>::max();
+        params.max_bytes = std::numeric_limits<uint64_t>::max();
+    }
+    if (!unsigned_param(req, "offset", params.start_offset)) { error_response(res, 400, "Invalid 'offset'."); return false; }
+    if (!unsigned_param(req, "max_messages", params.max_messages)) { error_response(res, 400, "Invalid 'max_messages'."); return false; }
+    if (!unsigned_param(req, "wait_ms", params.wait_ms)) { error_response(res, 400, "Invalid 'wait_ms'."); return false; }
+    if (!unsigned_param(req, "min_bytes", params.min_bytes)) { error_response(res, 400, "Invalid 'min_bytes'."); return false; }
+    if (!unsigned_param(req, "max_bytes", params.max_bytes)) { error_response(res, 400, "Invalid 'max_bytes'."); return false; }
+    params.wait_ms = std::min(params.wait_ms, MAX_CONSUME_WAIT_MS);
+    if (!streamed) {
+        params.max_messages = std::min(params.max_messages, (uint32_t)1000); // Cap max messages
+        // Bound the response by size as well as count, so large payloads can't build a huge response
+        params.max_bytes = std::min<uint64_t>(params.max_bytes == 0 ? MAX_CONSUME_RESPONSE_BYTES : params.max_bytes,
+                                              MAX_CONSUME_RESPONSE_BYTES);
+    } else if (params.max_bytes == 0) {
+        params.max_bytes = std::numeric_limits<uint64_t>::max();
+    }
+
+    if (uint32_t throttle_ms = check_quota(req.client_id, topic_name, QuotaManager::Operation::CONSUME)) {
+        throttled_response(res, throttle_ms);
+        return false;
+    }
+    return true;
+}
+
+void HttpApi::finish_consume(const ConsumeParams& params, const std::string& client_id, Response& res,
+                             std::chrono::milliseconds max_wait) {
+    try {
+        std::vector<Message> messages = event_queue_.consume(params.topic, params.start_offset, params.max_messages,
+                                                             max_wait, params.min_bytes, params.max_bytes);
+        std::string body;
+        body.reserve(JsonWriter::estimate(messages));
+        JsonWriter(body).value(messages);
+        json_text_response(res, 200, std::move(body));
+        if (quotas_) quotas_->record(client_id, params.topic, QuotaManager::Operation::CONSUME, res.body.size());
+    } catch (const std::exception& e) {
+        error_response(res, 500, e.what());
+    }
+}
+
+HttpApi::ConsumeCursor HttpApi::consume_cursor(const ConsumeParams& params, std::chrono::milliseconds max_wait) {
+    ConsumeCursor cursor;
+    cursor.topic = params.topic;
+    cursor.format = params.format;
+    cursor.next_offset = params.start_offset;
+    cursor.messages_left = params.max_messages;
+    cursor.bytes_left = params.max_bytes;
+    cursor.min_bytes = params.min_bytes;
+    cursor.first_wait = max_wait;
+    return cursor;
+}
+
+const char* HttpApi::stream_content_type(ConsumeFormat format) {
+    return format == ConsumeFormat::BINARY ? "application/octet-stream" : "application/x-ndjson";
+}
+
+bool HttpApi::next_consume_chunk(ConsumeCursor& cursor, const std::string& client_id, std::string& chunk) {
+    chunk.clear();
+    if (cursor.messages_left == 0 || cursor.bytes_left == 0) return false;
+
+    std::vector<Message> messages;
+    uint32_t max_messages = static_cast<uint32_t>(std::min<uint64_t>(cursor.messages_left, std::numeric_limits<uint32_t>::max()));
+    event_queue_.consume_into(cursor.topic, cursor.next_offset, max_messages,
+                              std::min(cursor.bytes_left, CONSUME_STREAM_CHUNK_BYTES), messages,
+                              cursor.first_wait, cursor.min_bytes);
+    cursor.first_wait = std::chrono::milliseconds::zero();
+    if (messages.empty()) return false; // Caught up with the log
+
+    JsonWriter writer(chunk);
+    for (const auto& msg : messages) {
+        if (cursor.format == ConsumeFormat::BINARY) {
+            // Same record layout as CONSUME_RESPONSE: offset, payload length, payload (big-endian)
+            uint64_t offset = NetworkProtocol::detail::to_network(msg.offset);
+            uint32_t length = NetworkProtocol::detail::to_network(static_cast<uint32_t>(msg.payload.size()));
+            chunk.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+            chunk.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            chunk.append(msg.payload);
+        } else {
+            writer.value(msg); // Top-level values get no separator, so lines stay independent
+            chunk.push_back('\n');
+        }
+        uint64_t record_bytes = sizeof(uint64_t) + sizeof(uint32_t) + msg.payload.size();
+        cursor.bytes_left -= std::min(cursor.bytes_left, record_bytes);
+        cursor.messages_left--;
+        cursor.next_offset = msg.offset + 1;
+    }
+    if (quotas_) quotas_->record(client_id, cursor.topic, QuotaManager::Operation::CONSUME, chunk.size());
+    return true;
+}
+
+void HttpApi::handle_create_topic(const std::string& topic_name, const Request& req, Response& res) {
+    if (uint32_t throttle_ms = check_quota(req.client_id, topic_name, QuotaManager::Operation::OTHER)) {
+        return throttled_response(res, throttle_ms);
+    }
+    try {
+        event_queue_.create_topic(topic_name);
+        json_response(res, 201, {{"topic", topic_name}, {"status", "created_or_exists"}});
+    } catch (const std::exception& e) {
+        error_response(res, 500, e.what());
+    }
+}
+
+void HttpApi::handle_list_topics(const Request& req, Response& res) {
+    if (uint32_t throttle_ms = check_quota(req.client_id, "", QuotaManager::Operation::OTHER)) {
+        return throttled_response(res, throttle_ms);
+    }
+    try {
+        json_response(res, 200, event_queue_.list_topics());
+    } catch (const std::exception& e) {
+        error_response(res, 500, e.what());
+    }
+}
+
+bool HttpApi::parse_stream(const std::string& topic_name, const Request& req, StreamParams& params, Response& res) {
+    params.topic = topic_name;
+    params.start_offset = 0;
+    if (req.param("offset")) {
+        if (!unsigned_param(req, "offset", params.start_offset)) {
+            error_response(res, 400, "Invalid 'offset'.");
+            return false;
+        }
+    } else if (!req.last_event_id.empty()) {
+        try { params.start_offset = std::stoull(req.last_event_id) + 1; }
+        catch (...) { /* use default */ }
+    }
+
+    if (uint32_t throttle_ms = check_quota(req.client_id, topic_name, QuotaManager::Operation::CONSUME)) {
+        throttled_response(res, throttle_ms);
+        return false;
+    }
+    return true;
+}
+
+std::string HttpApi::client_identity(const std::string& peer_address, const std::string& client_id_header) const {
+    return quotas_ ? quotas_->client_identity(peer_address, client_id_header) : peer_address;
+}
+
+uint32_t HttpApi::admit_stream(const std::string& client_id, const std::string& topic) {
+    return check_quota(client_id, topic, QuotaManager::Operation::CONSUME);
+}
+
+std::string HttpApi::read_stream_events(const std::string& topic, uint64_t& offset, const std::string& client_id) {
+    std::vector<Message> messages;
+    event_queue_.consume_into(topic, offset, std::numeric_limits<uint32_t>::max(), SSE_MAX_CHUNK_BYTES, messages);
+    if (messages.empty()) return std::string();
+
+    std::string data_chunk;
+    data_chunk.reserve(JsonWriter::estimate(messages) + messages.size() * 48);
+    JsonWriter writer(data_chunk);
+    for (const auto& msg : messages) {
+        data_chunk.append("id: ").append(std::to_string(msg.offset)).append("\nevent: message\ndata: ");
+        writer.value(msg);
+        data_chunk.append("\n\n");
+        offset = msg.offset + 1;
+    }
+    if (quotas_) quotas_->record(client_id, topic, QuotaManager::Operation::CONSUME, data_chunk.size());
+    return data_chunk;
+}
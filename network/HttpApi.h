@@ -0,0 +1,150 @@
+// network/HttpApi.h
+#pragma once
+
+#include "../event_queue_core/EventQueue.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "QuotaManager.h"
+#include "Compression.h"
+
+// The REST and SSE API shared by both HTTP engines (cpp-httplib's HttpServer and the Beast-based
+// BeastHttpServer): routing, parameter parsing, quota checks and response bodies. Engines only
+// translate requests and responses and decide how to wait (blocking a worker, or async).
+class HttpApi {
+public:
+    enum class Route { PRODUCE, PRODUCE_BATCH, CONSUME, CREATE_TOPIC, LIST_TOPICS, STREAM, NOT_FOUND };
+
+    struct Request {
+        std::string method;
+        std::string path;                          // URL-decoded, without the query
+        std::map<std::string, std::string> params; // URL-decoded query parameters
+        std::string client_id;                     // Quota identity, see client_identity()
+        std::string last_event_id;                 // Last-Event-ID header (SSE resume)
+        std::string accept_encoding;               // Accept-Encoding header
+        std::string body;
+
+        const std::string* param(const std::string& name) const {
+            auto it = params.find(name);
+            return it == params.end() ? nullptr : &it->second;
+        }
+    };
+
+    struct Response {
+        int status = 200;
+        std::string content_type = "application/json";
+        std::string body;
+        std::vector<std::pair<std::string, std::string>> headers;
+    };
+
+    // ?format= of /consume. JSON is one array; NDJSON (one compact message per line) and BINARY
+    // (CONSUME_RESPONSE-style records) are streamed as a chunked response while the log is read.
+    enum class ConsumeFormat { JSON, NDJSON, BINARY };
+
+    struct ConsumeParams {
+        std::string topic;
+        ConsumeFormat format = ConsumeFormat::JSON;
+        uint64_t start_offset = 0;
+        uint32_t max_messages = 100;
+        uint32_t wait_ms = 0;   // Long-poll: hold the request until data arrives or this elapses
+        uint32_t min_bytes = 0;
+        uint64_t max_bytes = 0;
+    };
+
+    // Position of a streamed consume. The stream ends at the log end, or when a limit runs out.
+    struct ConsumeCursor {
+        std::string topic;
+        ConsumeFormat format = ConsumeFormat::NDJSON;
+        uint64_t next_offset = 0;
+        uint64_t messages_left = 0;
+        uint64_t bytes_left = 0;
+        uint32_t min_bytes = 0;
+        std::chrono::milliseconds first_wait{0}; // Long-poll on the first read only
+    };
+
+    struct StreamParams {
+        std::string topic;
+        uint64_t start_offset = 0;
+    };
+
+    // How long an idle SSE stream waits for new messages before emitting a keep-alive comment
+    static constexpr std::chrono::milliseconds SSE_KEEPALIVE_INTERVAL{15 * 1000};
+
+    // `compression` null (or with no encodings) disables Content-Encoding
+    HttpApi(EventQueue& queue, QuotaManager* quotas, const Compression::HttpSettings* compression = nullptr);
+
+    // Quota identity of a request: the peer address, or its X-Client-Id header when the peer is a
+    // trusted proxy (quotas.trusted_proxies)
+    std::string client_identity(const std::string& peer_address, const std::string& client_id_header) const;
+
+    // Matches method and path; sets `topic` for the per-topic routes
+    static Route route(const std::string& method, const std::string& path, std::string& topic);
+
+    // PRODUCE, PRODUCE_BATCH, CREATE_TOPIC, LIST_TOPICS and NOT_FOUND
+    void handle(Route route, const std::string& topic, const Request& req, Response& res);
+
+    // CONSUME, split so event-loop engines can wait for data without blocking: parse_consume()
+    // validates and admits the request (false: `res` holds the error), then finish_consume() reads,
+    // blocking up to max_wait for data (zero once the engine has done the waiting itself).
+    bool parse_consume(const std::string& topic, const Request& req, ConsumeParams& params, Response& res);
+    void finish_consume(const ConsumeParams& params, const std::string& client_id, Response& res,
+                        std::chrono::milliseconds max_wait = std::chrono::milliseconds::zero());
+
+    // Streamed CONSUME (NDJSON/BINARY): instead of finish_consume(), the engine sends a chunked
+    // response with stream_content_type() and writes each chunk from next_consume_chunk() as soon as
+    // it is read, so memory stays bounded by one chunk whatever the size of the replay.
+    // next_consume_chunk() returns false once the stream is complete, records the quota for each
+    // chunk, and throws on read errors (the engine can only cut the response short then).
+    static ConsumeCursor consume_cursor(const ConsumeParams& params,
+                                        std::chrono::milliseconds max_wait = std::chrono::milliseconds::zero());
+    static const char* stream_content_type(ConsumeFormat format);
+    bool next_consume_chunk(ConsumeCursor& cursor, const std::string& client_id, std::string& chunk);
+
+    // SSE. parse_stream() validates and admits the stream; read_stream_events() formats the events
+    // for everything after `offset` (up to SSE_MAX_CHUNK_BYTES of records), advances `offset` and
+    // records the quota; it returns an empty string when the stream is caught up, and throws on
+    // read errors. admit_stream() returns how long an over-quota stream should pause, or 0.
+    bool parse_stream(const std::string& topic, const Request& req, StreamParams& params, Response& res);
+    std::string read_stream_events(const std::string& topic, uint64_t& offset, const std::string& client_id);
+    uint32_t admit_stream(const std::string& client_id, const std::string& topic);
+
+    // Content-Encoding, applied by the engine on its I/O thread right before sending.
+    // encode_response() compresses a finished body of at least threshold_bytes with the encoding the
+    // client accepts; stream_encoder() returns the encoder for a streamed body (SSE, NDJSON/binary
+    // consume), whose every chunk is compressed and flushed, or null to send the stream as is.
+    // Both add "Vary: Accept-Encoding" (and Content-Encoding when they compress).
+    void encode_response(const Request& req, Response& res) const;
+    std::unique_ptr<Compression::StreamEncoder> stream_encoder(const Request& req, Response& res) const;
+
+    static void json_response(Response& res, int status_code, const nlohmann::json& body);
+    // With a body already written as JSON (see JsonWriter)
+    static void json_text_response(Response& res, int status_code, std::string body);
+    static void error_response(Response& res, int status_code, const std::string& error_message);
+    // 429 + Retry-After (in whole seconds) and throttle_ms in the body
+    static void throttled_response(Response& res, uint32_t throttle_ms);
+
+    // Decodes %XX escapes (and '+' as space when `plus_as_space`)
+    static std::string url_decode(const std::string& in, bool plus_as_space);
+    // Splits a request target into its decoded path and query parameters
+    static void parse_target(const std::string& target, std::string& path, std::map<std::string, std::string>& params);
+    // Parses a produce_batch body, either a JSON array of records or newline-delimited records
+    // (NDJSON); the format is picked from the first non-whitespace byte. False: `error` says why.
+    static bool parse_produce_batch(const std::string& body, std::vector<std::string>& payloads, std::string& error);
+
+private:
+    void handle_produce(const std::string& topic, const Request& req, Response& res);
+    void handle_produce_batch(const std::string& topic, const Request& req, Response& res);
+    void handle_create_topic(const std::string& topic, const Request& req, Response& res);
+    void handle_list_topics(const Request& req, Response& res);
+
+    uint32_t check_quota(const std::string& client_id, const std::string& topic_name,
+                         QuotaManager::Operation op, uint64_t bytes = 0);
+
+    EventQueue& event_queue_;
+    QuotaManager* quotas_; // Null when quotas are disabled
+    const Compression::HttpSettings* compression_; // Null when responses are never compressed
+};
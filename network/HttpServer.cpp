@@ -1,27 +1,30 @@
 // network/HttpServer.cpp
 #include "HttpServer.h"
 #include <iostream>
-#include <sstream>
 #include <chrono>
 #include <vector>
 #include <httplib.h>
 #include <nlohmann/json.hpp> 
 
-// Helper to send JSON response
-void send_json_response(httplib::Response& res, int status_code, const json& body) {
-    res.status = status_code;
-    res.set_content(body.dump(2), "application/json"); // dump(2) for pretty print
+// Copies an engine-neutral response into cpp-httplib's
+static void apply_response(const HttpApi::Response& from, httplib::Response& res) {
+    res.status = from.status;
+    for (const auto& [name, value] : from.headers) res.set_header(name, value);
+    res.set_content(from.body, from.content_type);
 }
 
-// Helper to send error response
-void send_error_response(httplib::Response& res, int status_code, const std::string& error_message) {
-    json err_json = {{"error", error_message}};
-    send_json_response(res, status_code, err_json);
+static void send_error_response(httplib::Response& res, int status_code, const std::string& error_message) {
+    HttpApi::Response api_res;
+    HttpApi::error_response(api_res, status_code, error_message);
+    apply_response(api_res, res);
 }
 
 HttpServer::HttpServer(EventQueue& queue, const std::string& host, int port,
-                       const std::string& cert_path, const std::string& key_path)
-    : event_queue_(queue), host_(host), port_(port), cert_path_(cert_path), key_path_(key_path) {
+                       const std::string& cert_path, const std::string& key_path, QuotaManager* quotas,
+                       SubscriptionManager* sub_manager, boost::asio::any_io_executor notify_executor,
+                       const Compression::HttpSettings* compression)
+    : api_(queue, quotas, compression), host_(host), port_(port), cert_path_(cert_path), key_path_(key_path),
+      sub_manager_(sub_manager), notify_executor_(std::move(notify_executor)) {
     if (!cert_path_.empty() && !key_path_.empty()) {
 #ifdef CPPHTTPLIB_OPENSSL_SUPPORT
         try {
@@ -58,26 +61,19 @@ bool HttpServer::is_running() const {
 void HttpServer::setup_routes() {
     if (!server_) return;
 
-    // --- REST API Routes ---
-    server_->Post(R"(/topics/([^/]+)/produce)", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_produce(req, res);
-    });
-    server_->Get(R"(/topics/([^/]+)/consume)", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_consume(req, res);
-    });
-    server_->Post(R"(/topics/([^/]+))", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_create_topic(req, res);
-    });
-    server_->Get("/topics", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_list_topics(req, res);
-    });
+    // --- REST API Routes --- (routing proper is HttpApi::route; these patterns only pick the handler)
+    auto serve = [this](const httplib::Request& req, httplib::Response& res) { handle_request(req, res); };
+    server_->Post(R"(/topics/([^/]+)/produce)", serve);
+    server_->Post(R"(/topics/([^/]+)/produce_batch)", serve);
+    server_->Get(R"(/topics/([^/]+)/consume)", serve);
+    server_->Post(R"(/topics/([^/]+))", serve);
+    server_->Get("/topics", serve);
     // --- SSE Route ---
-    server_->Get(R"(/topics/([^/]+)/stream)", [this](const httplib::Request& req, httplib::Response& res) {
-        handle_stream_topic(req, res);
-    });
+    server_->Get(R"(/topics/([^/]+)/stream)", serve);
 
     // --- Error Handling ---
     server_->set_error_handler([](const httplib::Request& /*req*/, httplib::Response& res) {
+        if (!res.body.empty()) return; // Handlers that already built an error body (e.g. 429 with throttle_ms) keep it
         send_error_response(res, res.status, "Resource not found or method not allowed (Status: " + std::to_string(res.status) + ")");
     });
     server_->set_exception_handler([](const httplib::Request& /*req*/, httplib::Response& res, std::exception_ptr ep) {
@@ -116,6 +112,15 @@ bool HttpServer::start() {
 void HttpServer::stop() {
     if (server_ && running_.load()) {
         std::cout << "Stopping HTTP(S) server..." << std::endl;
+        {
+            // Streams waiting for messages would otherwise hold their worker until the next keep-alive
+            std::lock_guard<std::mutex> lock(streams_mutex_);
+            for (const auto& stream : streams_) {
+                std::lock_guard<std::mutex> stream_lock(stream->mutex);
+                stream->closed = true;
+                stream->cv.notify_all();
+            }
+        }
         server_->stop(); // Signal the server to stop listening
         // running_ will be set to false by the server_thread_ upon exit
     }
@@ -125,126 +130,189 @@ void HttpServer::stop() {
     std::cout << "HTTP(S) Server fully stopped." << std::endl;
 }
 
-// --- Route Handlers Implementation (REST & SSE) ---
-
-void HttpServer::handle_produce(const httplib::Request& req, httplib::Response& res) {
-    std::string topic_name = req.matches[1].str();
-    if (topic_name.empty()) return send_error_response(res, 400, "Topic name missing.");
-
-    json req_body;
-    try {
-        req_body = json::parse(req.body);
-    } catch (json::parse_error& e) {
-        return send_error_response(res, 400, "Invalid JSON: " + std::string(e.what()));
-    }
-
-    if (!req_body.contains("payload") || !req_body["payload"].is_string()) {
-        return send_error_response(res, 400, "Missing 'payload' string in JSON.");
-    }
-    std::string message_payload = req_body["payload"];
-
-    try {
-        uint64_t offset = event_queue_.produce(topic_name, message_payload);
-        send_json_response(res, 201, {{"topic", topic_name}, {"offset", offset}});
-    } catch (const std::exception& e) {
-        send_error_response(res, 500, e.what());
-    }
+HttpApi::Request HttpServer::to_api_request(const httplib::Request& req) const {
+    HttpApi::Request api_req;
+    api_req.method = req.method;
+    api_req.path = req.path;
+    for (const auto& [name, value] : req.params) api_req.params.emplace(name, value); // First occurrence wins
+    api_req.client_id = api_.client_identity(req.remote_addr, req.get_header_value("X-Client-Id"));
+    api_req.last_event_id = req.get_header_value("Last-Event-ID");
+    api_req.accept_encoding = req.get_header_value("Accept-Encoding");
+    api_req.body = req.body;
+    return api_req;
 }
 
-void HttpServer::handle_consume(const httplib::Request& req, httplib::Response& res) {
-    std::string topic_name = req.matches[1].str();
-    if (topic_name.empty()) return send_error_response(res, 400, "Topic name missing.");
-
-    uint64_t start_offset = req.has_param("offset") ? std::stoull(req.get_param_value("offset")) : 0;
-    uint32_t max_messages = req.has_param("max_messages") ? std::stoi(req.get_param_value("max_messages")) : 100;
-    max_messages = std::min(max_messages, (uint32_t)1000); // Cap max messages
+// --- Route Handlers Implementation (REST & SSE) ---
 
-    try {
-        std::vector<Message> messages = event_queue_.consume(topic_name, start_offset, max_messages);
-        send_json_response(res, 200, messages); // Uses Message's NLOHMANN_DEFINE
-    } catch (const std::exception& e) {
-        send_error_response(res, 500, e.what());
+void HttpServer::handle_request(const httplib::Request& req, httplib::Response& res) {
+    HttpApi::Request api_req = to_api_request(req);
+    std::string topic_name;
+    HttpApi::Route route = HttpApi::route(api_req.method, api_req.path, topic_name);
+    HttpApi::Response api_res;
+    if (route == HttpApi::Route::STREAM) {
+        return handle_stream_topic(topic_name, api_req, res);
     }
-}
-
-void HttpServer::handle_create_topic(const httplib::Request& req, httplib::Response& res) {
-    std::string topic_name = req.matches[1].str();
-    if (topic_name.empty()) return send_error_response(res, 400, "Topic name missing.");
-    try {
-        event_queue_.create_topic(topic_name);
-        send_json_response(res, 201, {{"topic", topic_name}, {"status", "created_or_exists"}});
-    } catch (const std::exception& e) {
-        send_error_response(res, 500, e.what());
+    if (route == HttpApi::Route::CONSUME) {
+        HttpApi::ConsumeParams params;
+        // This worker belongs to the request anyway, so a long-poll simply blocks in consume
+        if (api_.parse_consume(topic_name, api_req, params, api_res)) {
+            if (params.format != HttpApi::ConsumeFormat::JSON) {
+                return handle_consume_stream(params, api_req, res);
+            }
+            api_.finish_consume(params, api_req.client_id, api_res, std::chrono::milliseconds(params.wait_ms));
+        }
+    } else {
+        api_.handle(route, topic_name, api_req, api_res);
     }
+    api_.encode_response(api_req, api_res);
+    apply_response(api_res, res);
 }
 
-void HttpServer::handle_list_topics(const httplib::Request& req, httplib::Response& res) {
+void HttpServer::handle_consume_stream(const HttpApi::ConsumeParams& params, const HttpApi::Request& req,
+                                       httplib::Response& res) {
+    struct ConsumeStream {
+        HttpApi::ConsumeCursor cursor;
+        std::unique_ptr<Compression::StreamEncoder> encoder; // Null: sent as is
+        std::string chunk;
+        std::string encoded;
+        bool has_chunk = false;
+    };
+    auto stream = std::make_shared<ConsumeStream>();
+    stream->cursor = HttpApi::consume_cursor(params, std::chrono::milliseconds(params.wait_ms));
+    // The first read (and any long-poll) happens before the headers go out, so a failing read is still a 500
     try {
-        send_json_response(res, 200, event_queue_.list_topics());
+        stream->has_chunk = api_.next_consume_chunk(stream->cursor, req.client_id, stream->chunk);
     } catch (const std::exception& e) {
-        send_error_response(res, 500, e.what());
+        return send_error_response(res, 500, e.what());
     }
+    HttpApi::Response headers;
+    stream->encoder = api_.stream_encoder(req, headers);
+    for (const auto& [name, value] : headers.headers) res.set_header(name, value);
+
+    res.set_chunked_content_provider(
+        HttpApi::stream_content_type(params.format),
+        [this, stream, client_id = req.client_id](size_t /*offset*/, httplib::DataSink& sink) -> bool {
+            if (stream->has_chunk) {
+                const std::string* out = &stream->chunk;
+                if (stream->encoder) {
+                    stream->encoded.clear();
+                    stream->encoder->write(stream->chunk.data(), stream->chunk.size(), stream->encoded);
+                    out = &stream->encoded;
+                }
+                if (!sink.write(out->data(), out->size())) return false; // Client disconnected
+                try {
+                    stream->has_chunk = api_.next_consume_chunk(stream->cursor, client_id, stream->chunk);
+                } catch (const std::exception& e) {
+                    std::cerr << "HTTP consume stream error for topic " << stream->cursor.topic << ": " << e.what() << std::endl;
+                    return false; // Headers are out; the client sees a truncated response
+                }
+            }
+            if (!stream->has_chunk) {
+                if (stream->encoder) {
+                    stream->encoded.clear();
+                    stream->encoder->finish(stream->encoded);
+                    if (!sink.write(stream->encoded.data(), stream->encoded.size())) return false;
+                }
+                sink.done();
+            }
+            return true;
+        });
 }
 
-// SSE Handler (Simple Polling - needs improvement for production)
-void HttpServer::handle_stream_topic(const httplib::Request& req, httplib::Response& res) {
-    std::string topic_name = req.matches[1].str();
-    if (topic_name.empty()) return send_error_response(res, 400, "Topic name missing.");
+// SSE Handler (woken by the SubscriptionManager, so new messages are pushed as soon as they are appended)
+void HttpServer::handle_stream_topic(const std::string& topic_name, const HttpApi::Request& req, httplib::Response& res) {
+    if (!sub_manager_) return send_error_response(res, 501, "Streaming is not available.");
 
-    uint64_t current_offset = 0;
-    if (req.has_param("offset")) {
-        try { current_offset = std::stoull(req.get_param_value("offset")); }
-        catch (...) { return send_error_response(res, 400, "Invalid 'offset'."); }
-    } else if (req.has_header("Last-Event-ID")) {
-        try { current_offset = std::stoull(req.get_header_value("Last-Event-ID")) + 1; }
-        catch (...) { /* use default */ }
+    HttpApi::StreamParams params;
+    HttpApi::Response api_res;
+    if (!api_.parse_stream(topic_name, req, params, api_res)) {
+        return apply_response(api_res, res);
     }
+    uint64_t current_offset = params.start_offset;
+    std::string client_id = req.client_id;
 
-    // Generate a unique subscriber ID for this SSE stream
-    // This could be simpler for SSE as it's one request-response cycle potentially.
-    // Or could use a session cookie if you have HTTP sessions.
     static std::atomic<uint64_t> sse_client_id_counter{0};
     std::string sse_subscriber_id = "sse_client_" + topic_name + "_" + std::to_string(sse_client_id_counter++);
 
     std::cout << "SSE stream [" << sse_subscriber_id << "]: topic='" << topic_name
               << "', start_offset=" << current_offset << std::endl;
 
+    auto stream = std::make_shared<SseStream>();
+    HttpApi::Response headers;
+    std::shared_ptr<Compression::StreamEncoder> encoder = api_.stream_encoder(req, headers); // Null: sent as is
+    for (const auto& [name, value] : headers.headers) res.set_header(name, value);
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        streams_.insert(stream);
+    }
+    // Only a wake-up: the stream reads the messages from the log, in batches, on its own worker
+    std::weak_ptr<SseStream> weak_stream = stream;
+    sub_manager_->subscribe(topic_name, sse_subscriber_id, current_offset, notify_executor_,
+        [weak_stream](const NotificationBatchPtr& batch) {
+            batch->seal(); // The stream reads new messages from the log
+            if (auto locked = weak_stream.lock()) {
+                std::lock_guard<std::mutex> lock(locked->mutex);
+                locked->wake = true;
+                locked->cv.notify_one();
+            }
+        });
+
     res.set_chunked_content_provider(
         "text/event-stream",
         // on_producer lambda
-        [this, topic_name, initial_offset = current_offset, sse_subscriber_id ]
+        [this, topic_name, initial_offset = current_offset, stream, client_id, encoder]
         (size_t /*user_offset*/, httplib::DataSink& sink) mutable -> bool {
             uint64_t& stream_offset = initial_offset; // Effectively capture by reference
+            // Each event is compressed and flushed on its own, against the context of the whole stream
+            auto send = [&encoder, &sink](const std::string& text) {
+                if (!encoder) return sink.write(text.data(), text.size());
+                std::string encoded;
+                encoder->write(text.data(), text.size(), encoded);
+                return sink.write(encoded.data(), encoded.size());
+            };
+
+            // A stream over its consume quota is paced rather than cut off; this thread belongs to the stream anyway
+            if (uint32_t throttle_ms = api_.admit_stream(client_id, topic_name)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(throttle_ms));
+                return sink.is_writable();
+            }
 
-            std::vector<Message> messages;
+            {
+                std::unique_lock<std::mutex> lock(stream->mutex);
+                if (!stream->cv.wait_for(lock, HttpApi::SSE_KEEPALIVE_INTERVAL, [&stream]() { return stream->wake || stream->closed; })) {
+                    lock.unlock();
+                    // No new messages; a comment line keeps proxies from closing the stream
+                    if (!send(": keep-alive\n\n")) return false;
+                    return sink.is_writable();
+                }
+                if (stream->closed) return false;
+                stream->wake = false;
+            }
+
+            std::string data_chunk;
             try {
-                messages = event_queue_.consume(topic_name, stream_offset, 10); // Poll for up to 10 messages
+                data_chunk = api_.read_stream_events(topic_name, stream_offset, client_id);
             } catch (const std::exception& e) {
                 std::cerr << "SSE consume error for topic " << topic_name << ": " << e.what() << std::endl;
                 return false; // Stop streaming
             }
+            if (data_chunk.empty()) return sink.is_writable(); // Woken for messages already sent
 
-            if (!messages.empty()) {
-                std::stringstream ss;
-                for (const auto& msg : messages) {
-                    ss << "id: " << msg.offset << "\n";
-                    ss << "event: message\n";
-                    ss << "data: " << json(msg).dump() << "\n\n"; // Serialize Message to JSON
-                    stream_offset = msg.offset + 1;
-                }
-                std::string data_chunk = ss.str();
-                if (!sink.write(data_chunk.data(), data_chunk.length())) return false; // Client disconnected
-            } else {
-                // No new messages, wait a bit before polling again
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                // Optionally send a keep-alive comment:
-                // std::string keep_alive = ": keep-alive\n\n";
-                // if (!sink.write(keep_alive.data(), keep_alive.length())) return false;
+            {
+                // The read may have stopped at the byte limit; an empty read ends the catch-up
+                std::lock_guard<std::mutex> lock(stream->mutex);
+                stream->wake = true;
             }
+            if (!send(data_chunk)) return false; // Client disconnected
             return sink.is_writable(); // Continue if client is connected
         },
         // on_cleanup (optional)
-        [topic_name, sse_subscriber_id](bool success) {
+        [this, topic_name, sse_subscriber_id, stream](bool success) {
+            sub_manager_->unsubscribe(topic_name, sse_subscriber_id);
+            {
+                std::lock_guard<std::mutex> lock(streams_mutex_);
+                streams_.erase(stream);
+            }
             std::cout << "SSE stream for topic '" << topic_name << "' with ID '" << sse_subscriber_id
                       << (success ? "' completed/closed." : "' failed/aborted.") << std::endl;
         }
@@ -7,15 +7,23 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
 #include <nlohmann/json.hpp>
 #include "SubscriptionManager.h"
+#include "QuotaManager.h"
+#include "HttpApi.h"
 
 using json = nlohmann::json;
 
 class HttpServer {
 public:
     HttpServer(EventQueue& queue, const std::string& host, int port,
-               const std::string& cert_path = "", const std::string& key_path = "");
+               const std::string& cert_path = "", const std::string& key_path = "",
+               QuotaManager* quotas = nullptr, SubscriptionManager* sub_manager = nullptr,
+               boost::asio::any_io_executor notify_executor = {},
+               const Compression::HttpSettings* compression = nullptr);
     ~HttpServer();
 
     bool start();
@@ -24,20 +32,36 @@ public:
 
 private:
     void setup_routes();
-    // --- REST API Handlers ---
-    void handle_produce(const httplib::Request& req, httplib::Response& res);
-    void handle_consume(const httplib::Request& req, httplib::Response& res);
-    void handle_create_topic(const httplib::Request& req, httplib::Response& res);
-    void handle_list_topics(const httplib::Request& req, httplib::Response& res);
-    
+    // Every route goes through HttpApi; this engine only adapts requests and responses
+    HttpApi::Request to_api_request(const httplib::Request& req) const;
+    void handle_request(const httplib::Request& req, httplib::Response& res);
+    // Streamed (NDJSON/binary) consume, written chunk by chunk from this request's worker
+    void handle_consume_stream(const HttpApi::ConsumeParams& params, const HttpApi::Request& req,
+                               httplib::Response& res);
+
     // --- SSE Handler ---
-    void handle_stream_topic(const httplib::Request& req, httplib::Response& res);
+    // Streams are woken by the SubscriptionManager when messages are produced to their topic and
+    // then read everything new from the log, so they carry no polling delay or per-wake cap.
+    // cpp-httplib runs each stream on a worker thread, which waits on the stream's condition variable.
+    void handle_stream_topic(const std::string& topic_name, const HttpApi::Request& req, httplib::Response& res);
+
+    struct SseStream {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool wake = true;    // New messages may be in the log (starts set to catch up from the start offset)
+        bool closed = false; // Server stopping
+    };
 
-    EventQueue& event_queue_;
+    HttpApi api_;
     std::string host_;
     int port_;
     std::string cert_path_;
     std::string key_path_;
+    SubscriptionManager* sub_manager_; // Null disables SSE
+    boost::asio::any_io_executor notify_executor_; // Runs the SubscriptionManager's wake-up callbacks
+
+    std::mutex streams_mutex_;
+    std::set<std::shared_ptr<SseStream>> streams_; // Open SSE streams, closed by stop()
 
     std::unique_ptr<httplib::Server> server_;
     std::thread server_thread_;
@@ -0,0 +1,126 @@
+// network/JsonWriter.cpp
+#include "JsonWriter.h"
+#include <charconv>
+
+namespace {
+
+// Bytes that can be copied as-is: printable ASCII other than '"' and '\\'
+bool is_plain(unsigned char c) {
+    return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+}
+
+// Length of the UTF-8 sequence starting at s[i]; `complete` tells whether it is well formed. An
+// ill-formed one spans its lead byte and the continuation bytes that fit it (at least one byte),
+// which are replaced by a single U+FFFD, as nlohmann's error_handler_t::replace does.
+size_t utf8_sequence_length(std::string_view s, size_t i, bool& complete) {
+    auto continuation = [&](size_t k, unsigned char lo, unsigned char hi) {
+        return k < s.size() && static_cast<unsigned char>(s[k]) >= lo && static_cast<unsigned char>(s[k]) <= hi;
+    };
+    unsigned char c = static_cast<unsigned char>(s[i]);
+    size_t needed = 0;
+    unsigned char lo = 0x80, hi = 0xBF; // Range of the first continuation byte
+    if (c >= 0xC2 && c <= 0xDF) {
+        needed = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        // No overlong forms (E0 80..9F) and no UTF-16 surrogates (ED A0..BF)
+        needed = 3;
+        if (c == 0xE0) lo = 0xA0;
+        if (c == 0xED) hi = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        // Nothing overlong (F0 80..8F) and nothing above U+10FFFF (F4 90..)
+        needed = 4;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;
+    } else {
+        complete = false;
+        return 1;
+    }
+    size_t len = 1;
+    while (len < needed && continuation(i + len, len == 1 ? lo : 0x80, len == 1 ? hi : 0xBF)) ++len;
+    complete = len == needed;
+    return len;
+}
+
+} // namespace
+
+JsonWriter& JsonWriter::value(uint64_t n) {
+    separate();
+    char buf[20];
+    auto result = std::to_chars(buf, buf + sizeof(buf), n);
+    out_.append(buf, result.ptr - buf);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int64_t n) {
+    separate();
+    char buf[20];
+    auto result = std::to_chars(buf, buf + sizeof(buf), n);
+    out_.append(buf, result.ptr - buf);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const Message& msg) {
+    begin_object();
+    key("offset").value(msg.offset);
+    key("payload").value(msg.payload);
+    key("topic").value(msg.topic);
+    return end_object();
+}
+
+JsonWriter& JsonWriter::value(const std::vector<Message>& messages) {
+    begin_array();
+    for (const auto& msg : messages) value(msg);
+    return end_array();
+}
+
+size_t JsonWriter::estimate(const std::vector<Message>& messages) {
+    // Fixed keys and punctuation, a 20-digit offset, and a little slack for escapes
+    size_t bytes = 2;
+    for (const auto& msg : messages) {
+        bytes += 64 + msg.payload.size() + msg.payload.size() / 16 + msg.topic.size();
+    }
+    return bytes;
+}
+
+void JsonWriter::append_string(std::string_view str) {
+    static const char hex[] = "0123456789abcdef";
+    out_.push_back('"');
+    size_t i = 0;
+    while (i < str.size()) {
+        // Copy the longest run that needs no escaping in one go
+        size_t run = i;
+        while (run < str.size() && is_plain(static_cast<unsigned char>(str[run]))) ++run;
+        out_.append(str.data() + i, run - i);
+        i = run;
+        if (i == str.size()) break;
+
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x80) {
+            bool complete = false;
+            size_t len = utf8_sequence_length(str, i, complete);
+            if (complete) {
+                out_.append(str.data() + i, len);
+            } else {
+                out_.append("\xEF\xBF\xBD"); // U+FFFD REPLACEMENT CHARACTER
+            }
+            i += len;
+            continue;
+        }
+        switch (c) {
+            case '"': out_.append("\\\""); break;
+            case '\\': out_.append("\\\\"); break;
+            case '\b': out_.append("\\b"); break;
+            case '\f': out_.append("\\f"); break;
+            case '\n': out_.append("\\n"); break;
+            case '\r': out_.append("\\r"); break;
+            case '\t': out_.append("\\t"); break;
+            default: {
+                const char escape[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                out_.append(escape, sizeof(escape));
+                break;
+            }
+        }
+        ++i;
+    }
+    out_.push_back('"');
+}
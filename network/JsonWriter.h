@@ -0,0 +1,78 @@
+// network/JsonWriter.h
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../event_queue_core/Message.h"
+
+// Writes compact JSON straight into a caller-owned string, for the responses built per message
+// (message lists, produce acknowledgements, pushed batches). Building an nlohmann::json DOM for
+// those costs an allocation per node plus a std::map per object, which dominates the CPU spent on
+// large batches; here integers go through std::to_chars and strings are escaped in bulk. Admin and
+// error responses keep using nlohmann.
+//
+// Commas are inserted automatically: call key() before each object member and the value writers in
+// order. Output matches nlohmann's dump() for the same data, provided members are written in sorted
+// key order (nlohmann objects are sorted), except that invalid UTF-8 in strings is replaced with
+// U+FFFD instead of throwing.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    JsonWriter& begin_object() { separate(); out_.push_back('{'); push(); return *this; }
+    JsonWriter& end_object() { pop(); out_.push_back('}'); return *this; }
+    JsonWriter& begin_array() { separate(); out_.push_back('['); push(); return *this; }
+    JsonWriter& end_array() { pop(); out_.push_back(']'); return *this; }
+
+    JsonWriter& key(std::string_view name) {
+        separate();
+        append_string(name);
+        out_.push_back(':');
+        after_key_ = true;
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view str) { separate(); append_string(str); return *this; }
+    JsonWriter& value(const char* str) { return value(std::string_view(str)); }
+    JsonWriter& value(const std::string& str) { return value(std::string_view(str)); }
+    JsonWriter& value(bool b) { separate(); out_.append(b ? "true" : "false"); return *this; }
+    JsonWriter& value(uint64_t n);
+    JsonWriter& value(int64_t n);
+    JsonWriter& value(uint32_t n) { return value(static_cast<uint64_t>(n)); }
+    JsonWriter& value(int n) { return value(static_cast<int64_t>(n)); }
+    JsonWriter& null() { separate(); out_.append("null"); return *this; }
+    template <typename T>
+    JsonWriter& value(const std::optional<T>& opt) { return opt ? value(*opt) : null(); }
+
+    // {"offset":..,"payload":..,"topic":..}, the shape of Message's nlohmann mapping
+    JsonWriter& value(const Message& msg);
+    JsonWriter& value(const std::vector<Message>& messages);
+
+    // Appends `str` as a quoted, escaped JSON string
+    void append_string(std::string_view str);
+
+    // Rough upper bound on the output for `messages`, to reserve() before writing them
+    static size_t estimate(const std::vector<Message>& messages);
+
+private:
+    // Comma before every value except the first of its container, and never right after a key
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+        } else if (depth_ > 0 && (has_items_ & bit())) {
+            out_.push_back(',');
+        }
+        if (depth_ > 0) has_items_ |= bit();
+    }
+    void push() { ++depth_; has_items_ &= ~bit(); }
+    void pop() { has_items_ &= ~bit(); --depth_; }
+    uint64_t bit() const { return uint64_t(1) << ((depth_ - 1) & 63); }
+
+    std::string& out_;
+    unsigned depth_ = 0;
+    uint64_t has_items_ = 0; // One bit per open container (64 levels is plenty for our responses)
+    bool after_key_ = false;
+};
@@ -0,0 +1,70 @@
+// network/ListenSocket.h
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <cstddef>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h> // SO_REUSEPORT, where the platform has it
+#endif
+
+// SO_REUSEPORT lets several listening sockets bind the same address; the kernel then spreads incoming
+// connections across them, so a reconnect storm is accepted by several threads instead of one loop.
+// A minimal SettableSocketOption, since Asio has no public type for it.
+#ifdef SO_REUSEPORT
+class reuse_port_option {
+public:
+    explicit reuse_port_option(bool enabled) : value_(enabled ? 1 : 0) {}
+
+    template <typename Protocol> int level(const Protocol&) const { return SOL_SOCKET; }
+    template <typename Protocol> int name(const Protocol&) const { return SO_REUSEPORT; }
+    template <typename Protocol> const void* data(const Protocol&) const { return &value_; }
+    template <typename Protocol> std::size_t size(const Protocol&) const { return sizeof(value_); }
+
+private:
+    int value_;
+};
+#endif
+
+// The number of acceptors a server opens for a configured `requested` (0 counts as 1). Without
+// SO_REUSEPORT only one socket can bind the port, so the server falls back to one and says so.
+inline size_t usable_acceptor_count(size_t requested, const char* server_name) {
+    if (requested <= 1) return 1;
+#ifdef SO_REUSEPORT
+    (void)server_name;
+    return requested;
+#else
+    std::cerr << server_name << ": SO_REUSEPORT is not available on this platform; using 1 acceptor instead of "
+              << requested << "." << std::endl;
+    return 1;
+#endif
+}
+
+// Opens, binds and starts listening on `endpoint`. With reuse_port, every acceptor sharing the
+// endpoint must be opened this way. On failure `ec` is set and `failed_step` names the call.
+inline bool open_listen_socket(boost::asio::ip::tcp::acceptor& acceptor, const boost::asio::ip::tcp::endpoint& endpoint,
+                               bool reuse_port, boost::system::error_code& ec, const char*& failed_step) {
+    failed_step = "open";
+    acceptor.open(endpoint.protocol(), ec);
+    if (ec) return false;
+    boost::system::error_code ignored; // Only shortens TIME_WAIT rebinds, not fatal
+    acceptor.set_option(boost::asio::socket_base::reuse_address(true), ignored);
+    if (reuse_port) {
+        failed_step = "set SO_REUSEPORT";
+#ifdef SO_REUSEPORT
+        acceptor.set_option(reuse_port_option(true), ec);
+#else
+        // Servers ask usable_acceptor_count first; without the option only the first acceptor could bind
+        ec = boost::asio::error::operation_not_supported;
+#endif
+        if (ec) return false;
+    }
+    failed_step = "bind";
+    acceptor.bind(endpoint, ec);
+    if (ec) return false;
+    failed_step = "listen";
+    acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+    return !ec;
+}
@@ -2,7 +2,10 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 #include <stdexcept> // For runtime_error
 #include <iostream>  // For potential debug/error prints
@@ -18,18 +21,103 @@ namespace NetworkProtocol {
     // Max payload size for a single network message (e.g., 64MB)
     const uint32_t MAX_PAYLOAD_SIZE = 64 * 1024 * 1024;
 
+    // Upper bound the server applies to a long-poll CONSUME_REQUEST's max_wait_ms
+    const uint32_t MAX_CONSUME_WAIT_MS = 60 * 1000;
+
+    // Byte budget for a CONSUME_RESPONSE when the request sets none (or a larger one);
+    // keeps responses well under MAX_PAYLOAD_SIZE regardless of max_messages
+    const uint32_t MAX_CONSUME_RESPONSE_BYTES = 16 * 1024 * 1024;
+
+    // Largest MESSAGE_PUSH the server builds at once, whatever credit the subscriber has granted
+    const uint32_t MAX_PUSH_BATCH_BYTES = 1024 * 1024;
+
+    // --- Byte order ---
+    // Resolved at compile time: no runtime endianness probe and no dependency on the socket headers
+    // for htonl/ntohl. The wire format is big-endian (network order). EQ_BIG_ENDIAN can be defined
+    // (0 or 1) for a compiler that reports neither.
+#ifndef EQ_BIG_ENDIAN
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define EQ_BIG_ENDIAN 1
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define EQ_BIG_ENDIAN 0
+#elif defined(_MSC_VER) // Every target MSVC builds for is little-endian
+#define EQ_BIG_ENDIAN 0
+#else
+#error "Cannot determine the byte order; define EQ_BIG_ENDIAN to 0 or 1"
+#endif
+#endif
+
+    namespace detail {
+        template <typename T>
+        constexpr T byte_swap(T val) {
+            static_assert(std::is_unsigned<T>::value, "byte_swap expects an unsigned integer");
+            static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                          "Unsupported integer size");
+#if defined(__GNUC__) // GCC and Clang: one instruction even without optimization
+            if constexpr (sizeof(T) == 2) {
+                return static_cast<T>(__builtin_bswap16(val));
+            } else if constexpr (sizeof(T) == 4) {
+                return static_cast<T>(__builtin_bswap32(val));
+            } else if constexpr (sizeof(T) == 8) {
+                return static_cast<T>(__builtin_bswap64(val));
+            }
+#endif
+            // Portable version; optimizing compilers turn it into a single swap as well
+            T swapped = 0;
+            for (size_t i = 0; i < sizeof(T); ++i) {
+                swapped = static_cast<T>((swapped << 8) | ((val >> (8 * i)) & 0xFF));
+            }
+            return swapped;
+        }
+
+        template <typename T>
+        constexpr T to_network(T val) {
+#if EQ_BIG_ENDIAN
+            return val;
+#else
+            return byte_swap(val);
+#endif
+        }
+        template <typename T>
+        constexpr T from_network(T val) { return to_network(val); } // Swapping is its own inverse
+
+        template <typename T>
+        inline void store(char* out, T val) {
+            val = to_network(val);
+            std::memcpy(out, &val, sizeof(T));
+        }
+        template <typename T>
+        inline T load(const char* in) {
+            T val;
+            std::memcpy(&val, in, sizeof(T));
+            return from_network(val);
+        }
+    } // namespace detail
+
     enum class CommandType : uint8_t {
         PRODUCE_REQUEST = 0x01,
         CONSUME_REQUEST = 0x02,
         GET_TOPIC_OFFSET_REQUEST = 0x03,
         CREATE_TOPIC_REQUEST = 0x04,
         LIST_TOPICS_REQUEST = 0x05,
+        PRODUCE_BATCH_REQUEST = 0x06,
+        FETCH_REQUEST = 0x07,
+        SUBSCRIBE_REQUEST = 0x08,
+        UNSUBSCRIBE_REQUEST = 0x09,
+        SUBSCRIPTION_CREDIT = 0x0A, // Flow control; the server sends no response
+        HANDSHAKE_REQUEST = 0x0B,   // Feature negotiation (wire compression)
         // Responses will implicitly match request types or use a generic response type
         PRODUCE_RESPONSE = 0x81,
         CONSUME_RESPONSE = 0x82,
         GET_TOPIC_OFFSET_RESPONSE = 0x83,
         CREATE_TOPIC_RESPONSE = 0x84,
         LIST_TOPICS_RESPONSE = 0x85,
+        PRODUCE_BATCH_RESPONSE = 0x86,
+        FETCH_RESPONSE = 0x87,
+        SUBSCRIBE_RESPONSE = 0x88,
+        UNSUBSCRIBE_RESPONSE = 0x89,
+        MESSAGE_PUSH = 0x8A, // Unsolicited; carries the SUBSCRIBE request's correlation id
+        HANDSHAKE_RESPONSE = 0x8B,
         ERROR_RESPONSE = 0xFF
     };
 
@@ -42,54 +130,111 @@ namespace NetworkProtocol {
         ERROR_INTERNAL_SERVER = 0x05,
         ERROR_INVALID_REQUEST = 0x06,
         ERROR_PAYLOAD_TOO_LARGE = 0x07,
-        ERROR_UNKNOWN_COMMAND = 0x08
+        ERROR_UNKNOWN_COMMAND = 0x08,
+        ERROR_THROTTLED = 0x09 // Quota exceeded; ErrorResponsePayload carries throttle_ms
+    };
+
+    // A v2 request sets V2_TYPE_FLAG in the type byte and is followed by a header extension
+    // (flags u8, correlation_id u32). The response to a v2 request carries the same extension, so
+    // clients can pipeline many requests on one connection and match responses that complete out
+    // of order. v1 requests (flag clear) keep the one-request-at-a-time behaviour.
+    const uint8_t V2_TYPE_FLAG = 0x40;
+
+    // v2 extension flags. FLAG_COMPRESSED marks a payload encoded with the codec agreed by HANDSHAKE:
+    // uncompressed_length (u32) followed by the codec's output. Only v2 frames can carry it.
+    const uint8_t FLAG_COMPRESSED = 0x01;
+
+    enum class CompressionCodec : uint8_t {
+        NONE = 0x00,
+        LZ4 = 0x01,
+        ZSTD = 0x02,
+        ZLIB = 0x03
     };
 
     struct RequestHeader {
         CommandType type;
         uint32_t payload_length;
+        bool v2 = false;
+        uint8_t flags = 0; // FLAG_COMPRESSED or 0
+        uint32_t correlation_id = 0;
+
+        static const size_t SIZE = sizeof(CommandType) + sizeof(uint32_t); // v1 header / v2 prefix
+        static const size_t EXTENSION_SIZE = sizeof(uint8_t) + sizeof(uint32_t);
 
-        static const size_t SIZE = sizeof(CommandType) + sizeof(uint32_t);
+        size_t size() const { return v2 ? SIZE + EXTENSION_SIZE : SIZE; }
 
         std::vector<char> serialize() const {
-            std::vector<char> buffer(SIZE);
+            std::vector<char> buffer(size());
+            serialize_into(buffer.data());
+            return buffer;
+        }
+
+        // Writes size() bytes at `out`
+        void serialize_into(char* out) const {
             size_t offset = 0;
-            buffer[offset] = static_cast<uint8_t>(type);
+            out[offset] = static_cast<char>(static_cast<uint8_t>(type) | (v2 ? V2_TYPE_FLAG : 0));
             offset += sizeof(CommandType);
-            uint32_t net_payload_length = htonl(payload_length); // Network byte order
-            std::memcpy(buffer.data() + offset, &net_payload_length, sizeof(uint32_t));
-            return buffer;
+            detail::store(out + offset, payload_length); // Network byte order
+            offset += sizeof(uint32_t);
+            if (v2) {
+                out[offset] = static_cast<char>(flags);
+                offset += sizeof(uint8_t);
+                detail::store(out + offset, correlation_id);
+            }
         }
 
+        // Parses the first SIZE bytes; if v2 is set, the caller reads EXTENSION_SIZE more and
+        // passes them to deserialize_extension.
         static RequestHeader deserialize(const char* data) {
             RequestHeader header;
             size_t offset = 0;
-            header.type = static_cast<CommandType>(data[offset]);
+            uint8_t type_byte = static_cast<uint8_t>(data[offset]);
+            header.v2 = (type_byte & V2_TYPE_FLAG) != 0;
+            header.type = static_cast<CommandType>(type_byte & ~V2_TYPE_FLAG);
             offset += sizeof(CommandType);
-            uint32_t net_payload_length;
-            std::memcpy(&net_payload_length, data + offset, sizeof(uint32_t));
-            header.payload_length = ntohl(net_payload_length); // Host byte order
+            header.payload_length = detail::load<uint32_t>(data + offset); // Host byte order
             return header;
         }
+
+        void deserialize_extension(const char* data) {
+            flags = static_cast<uint8_t>(data[0]);
+            correlation_id = detail::load<uint32_t>(data + sizeof(uint8_t));
+        }
     };
 
     struct ResponseHeader {
         CommandType type; // Echo request type or specific response type
         StatusCode status;
         uint32_t payload_length;
+        bool v2 = false; // Set when answering a v2 request; the type byte carries no flag
+        uint8_t flags = 0;
+        uint32_t correlation_id = 0; // Echoed from the request
 
         static const size_t SIZE = sizeof(CommandType) + sizeof(StatusCode) + sizeof(uint32_t);
+        static const size_t EXTENSION_SIZE = sizeof(uint8_t) + sizeof(uint32_t);
+
+        size_t size() const { return v2 ? SIZE + EXTENSION_SIZE : SIZE; }
 
         std::vector<char> serialize() const {
-            std::vector<char> buffer(SIZE);
+            std::vector<char> buffer(size());
+            serialize_into(buffer.data());
+            return buffer;
+        }
+
+        // Writes size() bytes at `out` (used to patch a reserved header in place)
+        void serialize_into(char* out) const {
             size_t offset = 0;
-            buffer[offset] = static_cast<uint8_t>(type);
+            out[offset] = static_cast<uint8_t>(type);
             offset += sizeof(CommandType);
-            buffer[offset] = static_cast<uint8_t>(status);
+            out[offset] = static_cast<uint8_t>(status);
             offset += sizeof(StatusCode);
-            uint32_t net_payload_length = htonl(payload_length);
-            std::memcpy(buffer.data() + offset, &net_payload_length, sizeof(uint32_t));
-            return buffer;
+            detail::store(out + offset, payload_length);
+            offset += sizeof(uint32_t);
+            if (v2) {
+                out[offset] = static_cast<char>(flags);
+                offset += sizeof(uint8_t);
+                detail::store(out + offset, correlation_id);
+            }
         }
 
         static ResponseHeader deserialize(const char* data) {
@@ -99,126 +244,203 @@ namespace NetworkProtocol {
             offset += sizeof(CommandType);
             header.status = static_cast<StatusCode>(data[offset]);
             offset += sizeof(StatusCode);
-            uint32_t net_payload_length;
-            std::memcpy(&net_payload_length, data + offset, sizeof(uint32_t));
-            header.payload_length = ntohl(net_payload_length);
+            header.payload_length = detail::load<uint32_t>(data + offset);
             return header;
         }
+
+        void deserialize_extension(const char* data) {
+            v2 = true;
+            flags = static_cast<uint8_t>(data[0]);
+            correlation_id = detail::load<uint32_t>(data + sizeof(uint8_t));
+        }
+    };
+
+    // --- Codec ---
+
+    // Appends big-endian fields to a caller-owned buffer. Reusing the buffer across messages (and
+    // calling reserve() with the encoded size first) means encoding stops allocating once it is warm.
+    // Works on any contiguous char container; TCP frames use std::vector<char>, WebSocket frames
+    // std::string.
+    template <typename Buffer>
+    class BasicBufferWriter {
+    public:
+        explicit BasicBufferWriter(Buffer& out) : out_(out) {}
+
+        void reserve(size_t additional) { out_.reserve(out_.size() + additional); }
+        size_t size() const { return out_.size(); }
+
+        void put_u8(uint8_t val) { out_.push_back(static_cast<char>(val)); }
+        void put_u16(uint16_t val) { detail::store(grow(sizeof(val)), val); }
+        void put_u32(uint32_t val) { detail::store(grow(sizeof(val)), val); }
+        void put_u64(uint64_t val) { detail::store(grow(sizeof(val)), val); }
+        void put_bytes(const char* data, size_t len) {
+            if (len > 0) std::memcpy(grow(len), data, len);
+        }
+        // Length-prefixed string; topic names use a uint16_t prefix, payloads a uint32_t one
+        void put_string(std::string_view str, bool use_uint16_len = true) {
+            if (use_uint16_len) {
+                if (str.length() > UINT16_MAX) throw std::runtime_error("String too long for uint16_t length.");
+                put_u16(static_cast<uint16_t>(str.length()));
+            } else {
+                if (str.length() > UINT32_MAX) throw std::runtime_error("String too long for uint32_t length.");
+                put_u32(static_cast<uint32_t>(str.length()));
+            }
+            put_bytes(str.data(), str.length());
+        }
+
+    private:
+        char* grow(size_t len) {
+            size_t old_size = out_.size();
+            out_.resize(old_size + len);
+            return out_.data() + old_size;
+        }
+
+        Buffer& out_;
+    };
+    using BufferWriter = BasicBufferWriter<std::vector<char>>;
+
+    // Bounds-checked cursor over a received payload. Strings come back as views into the payload,
+    // so decoding never allocates; the views are valid only while the payload buffer is.
+    class BufferReader {
+    public:
+        BufferReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+        size_t offset() const { return offset_; }
+        size_t remaining() const { return size_ - offset_; }
+        const char* data_at_offset() const { return data_ + offset_; }
+        bool at_end() const { return offset_ == size_; }
+
+        uint8_t get_u8() { return static_cast<uint8_t>(*take(sizeof(uint8_t))); }
+        uint16_t get_u16() { return detail::load<uint16_t>(take(sizeof(uint16_t))); }
+        uint32_t get_u32() { return detail::load<uint32_t>(take(sizeof(uint32_t))); }
+        uint64_t get_u64() { return detail::load<uint64_t>(take(sizeof(uint64_t))); }
+        std::string_view get_string(bool use_uint16_len = true) {
+            uint32_t len = use_uint16_len ? get_u16() : get_u32();
+            if (len > MAX_PAYLOAD_SIZE) {
+                throw std::runtime_error("Reported string length is too large.");
+            }
+            if (len > remaining()) {
+                throw std::runtime_error("String length exceeds payload boundary.");
+            }
+            std::string_view str(data_ + offset_, len);
+            offset_ += len;
+            return str;
+        }
+
+    private:
+        const char* take(size_t len) {
+            if (len > remaining()) {
+                throw std::runtime_error("Truncated payload: did not consume entire payload.");
+            }
+            const char* p = data_ + offset_;
+            offset_ += len;
+            return p;
+        }
+
+        const char* data_;
+        size_t size_;
+        size_t offset_ = 0;
     };
 
     // --- Serialization Helpers for common types ---
-    // (Could be moved to a separate NetworkBinaryUtils or extend BinaryUtils)
+    // Free-function forms used by the message structs below. The read_* helpers don't check
+    // bounds; callers check the remaining length first (or use BufferReader).
 
     inline void write_uint16_to_buffer(std::vector<char>& buffer, uint16_t val) {
-        uint16_t net_val = htons(val);
-        const char* p = reinterpret_cast<const char*>(&net_val);
-        buffer.insert(buffer.end(), p, p + sizeof(uint16_t));
+        BufferWriter(buffer).put_u16(val);
     }
 
     inline uint16_t read_uint16_from_buffer(const char* data, size_t& offset) {
-        uint16_t net_val;
-        std::memcpy(&net_val, data + offset, sizeof(uint16_t));
+        uint16_t val = detail::load<uint16_t>(data + offset);
         offset += sizeof(uint16_t);
-        return ntohs(net_val);
+        return val;
     }
     
     inline void write_uint32_to_buffer(std::vector<char>& buffer, uint32_t val) {
-        uint32_t net_val = htonl(val);
-        const char* p = reinterpret_cast<const char*>(&net_val);
-        buffer.insert(buffer.end(), p, p + sizeof(uint32_t));
+        BufferWriter(buffer).put_u32(val);
     }
 
     inline uint32_t read_uint32_from_buffer(const char* data, size_t& offset) {
-        uint32_t net_val;
-        std::memcpy(&net_val, data + offset, sizeof(uint32_t));
+        uint32_t val = detail::load<uint32_t>(data + offset);
         offset += sizeof(uint32_t);
-        return ntohl(net_val);
+        return val;
     }
 
     inline void write_uint64_to_buffer(std::vector<char>& buffer, uint64_t val) {
-        // Convert to network byte order (manual for 64-bit for portability if needed, or use htobe64/be64toh if available)
-        // For simplicity, assuming host and network might be same or using a library that handles it.
-        // Boost.Asio typically doesn't do this automatically for custom protocols.
-        // Let's do manual byte swapping for big-endian (network standard)
-        uint64_t net_val = 0;
-        if (htons(1) == 1) { // Host is big-endian
-            net_val = val;
-        } else { // Host is little-endian, swap
-            net_val = (((uint64_t)htonl(val & 0xFFFFFFFF)) << 32) | htonl(val >> 32);
-        }
-        const char* p = reinterpret_cast<const char*>(&net_val);
-        buffer.insert(buffer.end(), p, p + sizeof(uint64_t));
+        BufferWriter(buffer).put_u64(val);
     }
 
     inline uint64_t read_uint64_from_buffer(const char* data, size_t& offset) {
-        uint64_t net_val;
-        std::memcpy(&net_val, data + offset, sizeof(uint64_t));
+        uint64_t val = detail::load<uint64_t>(data + offset);
         offset += sizeof(uint64_t);
-        uint64_t host_val = 0;
-         if (htons(1) == 1) { // Host is big-endian
-            host_val = net_val;
-        } else { // Host is little-endian, swap
-            host_val = (((uint64_t)ntohl(net_val & 0xFFFFFFFF)) << 32) | ntohl(net_val >> 32);
-        }
-        return host_val;
+        return val;
     }
 
-    inline void write_string_to_buffer(std::vector<char>& buffer, const std::string& str, bool use_uint16_len = true) {
-        if (use_uint16_len) {
-            if (str.length() > UINT16_MAX) throw std::runtime_error("String too long for uint16_t length.");
-            write_uint16_to_buffer(buffer, static_cast<uint16_t>(str.length()));
-        } else {
-            if (str.length() > UINT32_MAX) throw std::runtime_error("String too long for uint32_t length.");
-            write_uint32_to_buffer(buffer, static_cast<uint32_t>(str.length()));
-        }
-        buffer.insert(buffer.end(), str.begin(), str.end());
+    inline void write_string_to_buffer(std::vector<char>& buffer, std::string_view str, bool use_uint16_len = true) {
+        BufferWriter(buffer).put_string(str, use_uint16_len);
     }
 
-    inline std::string read_string_from_buffer(const char* data, size_t& offset, size_t total_payload_size, bool use_uint16_len = true) {
-        uint32_t len; // Use uint32_t to hold length read from either uint16 or uint32
-        if (use_uint16_len) {
-            len = read_uint16_from_buffer(data, offset);
-        } else {
-            len = read_uint32_from_buffer(data, offset);
-        }
-        if (offset + len > total_payload_size) { // Boundary check
-             throw std::runtime_error("String length exceeds payload boundary.");
-        }
-        if (len > MAX_PAYLOAD_SIZE) { // Sanity check, though payload_length itself should be checked first
-            throw std::runtime_error("Reported string length is too large.");
-        }
-        std::string str(data + offset, len);
-        offset += len;
+    inline std::string_view read_string_view_from_buffer(const char* data, size_t& offset, size_t total_payload_size,
+                                                         bool use_uint16_len = true) {
+        if (offset > total_payload_size) throw std::runtime_error("String length exceeds payload boundary.");
+        BufferReader reader(data + offset, total_payload_size - offset);
+        std::string_view str = reader.get_string(use_uint16_len);
+        offset += reader.offset();
         return str;
     }
 
+    inline std::string read_string_from_buffer(const char* data, size_t& offset, size_t total_payload_size, bool use_uint16_len = true) {
+        return std::string(read_string_view_from_buffer(data, offset, total_payload_size, use_uint16_len));
+    }
+
     // Specific request/response structures (Payloads)
 
     // PRODUCE
+    // Zero-copy decode of a PRODUCE payload; the views point into the receive buffer
+    struct ProduceRequestView {
+        std::string_view topic_name;
+        std::string_view message_payload;
+
+        static ProduceRequestView parse(const char* data, size_t payload_len) {
+            BufferReader reader(data, payload_len);
+            ProduceRequestView req;
+            req.topic_name = reader.get_string(); // uint16_t length
+            req.message_payload = reader.get_string(false); // uint32_t length for payload
+            if (!reader.at_end()) throw std::runtime_error("ProduceRequest: Did not consume entire payload.");
+            return req;
+        }
+    };
     struct ProduceRequest {
         std::string topic_name;
         std::string message_payload;
 
+        size_t encoded_size() const {
+            return sizeof(uint16_t) + topic_name.size() + sizeof(uint32_t) + message_payload.size();
+        }
+        void serialize_into(std::vector<char>& out) const {
+            BufferWriter writer(out);
+            writer.reserve(encoded_size());
+            writer.put_string(topic_name);
+            writer.put_string(message_payload, false);
+        }
         std::vector<char> serialize() const {
             std::vector<char> payload_buffer;
-            write_string_to_buffer(payload_buffer, topic_name); // default uint16_t length
-            write_string_to_buffer(payload_buffer, message_payload, false); // uint32_t length for payload
+            serialize_into(payload_buffer);
             return payload_buffer;
         }
         static ProduceRequest deserialize(const char* data, size_t payload_len) {
-            ProduceRequest req;
-            size_t offset = 0;
-            req.topic_name = read_string_from_buffer(data, offset, payload_len);
-            req.message_payload = read_string_from_buffer(data, offset, payload_len, false);
-            if (offset != payload_len) throw std::runtime_error("ProduceRequest: Did not consume entire payload.");
-            return req;
+            ProduceRequestView view = ProduceRequestView::parse(data, payload_len);
+            return ProduceRequest{std::string(view.topic_name), std::string(view.message_payload)};
         }
     };
     struct ProduceResponse { // Payload for success
         uint64_t offset;
+        void serialize_into(std::vector<char>& out) const {
+            BufferWriter(out).put_u64(offset);
+        }
         std::vector<char> serialize() const {
             std::vector<char> payload_buffer;
-            write_uint64_to_buffer(payload_buffer, offset);
+            serialize_into(payload_buffer);
             return payload_buffer;
         }
         static ProduceResponse deserialize(const char* data, size_t payload_len) {
@@ -231,38 +453,96 @@ namespace NetworkProtocol {
     };
 
     // CONSUME
+    // max_wait_ms/min_bytes make the request a long-poll: the server holds the request until
+    // min_bytes (at least one message) are available or max_wait_ms elapses. max_bytes bounds the
+    // size of the returned records (0 = server default, MAX_CONSUME_RESPONSE_BYTES). They are
+    // trailing fields, so requests from older clients that omit them keep the old behaviour.
+    // Zero-copy decode of a CONSUME payload; topic_name points into the receive buffer
+    struct ConsumeRequestView {
+        std::string_view topic_name;
+        uint64_t start_offset = 0;
+        uint32_t max_messages = 0;
+        uint32_t max_wait_ms = 0;
+        uint32_t min_bytes = 0;
+        uint32_t max_bytes = 0;
+
+        static ConsumeRequestView parse(const char* data, size_t payload_len) {
+            BufferReader reader(data, payload_len);
+            ConsumeRequestView req;
+            req.topic_name = reader.get_string();
+            if (reader.remaining() < sizeof(uint64_t) + sizeof(uint32_t)) throw std::runtime_error("ConsumeRequest: Did not consume entire payload.");
+            req.start_offset = reader.get_u64();
+            req.max_messages = reader.get_u32();
+            if (reader.remaining() >= 2 * sizeof(uint32_t)) { // Long-poll fields (optional)
+                req.max_wait_ms = reader.get_u32();
+                req.min_bytes = reader.get_u32();
+            }
+            if (reader.remaining() >= sizeof(uint32_t)) { // Byte budget (optional)
+                req.max_bytes = reader.get_u32();
+            }
+            if (!reader.at_end()) throw std::runtime_error("ConsumeRequest: Did not consume entire payload.");
+            return req;
+        }
+    };
     struct ConsumeRequest {
         std::string topic_name;
         uint64_t start_offset;
         uint32_t max_messages;
+        uint32_t max_wait_ms = 0;
+        uint32_t min_bytes = 0;
+        uint32_t max_bytes = 0;
+
+        ConsumeRequestView view() const {
+            return ConsumeRequestView{topic_name, start_offset, max_messages, max_wait_ms, min_bytes, max_bytes};
+        }
+        static ConsumeRequest from_view(const ConsumeRequestView& v) {
+            return ConsumeRequest{std::string(v.topic_name), v.start_offset, v.max_messages, v.max_wait_ms, v.min_bytes, v.max_bytes};
+        }
+
+        void serialize_into(std::vector<char>& out) const {
+            BufferWriter writer(out);
+            writer.reserve(sizeof(uint16_t) + topic_name.size() + sizeof(uint64_t) + 4 * sizeof(uint32_t));
+            writer.put_string(topic_name);
+            writer.put_u64(start_offset);
+            writer.put_u32(max_messages);
+            writer.put_u32(max_wait_ms);
+            writer.put_u32(min_bytes);
+            writer.put_u32(max_bytes);
+        }
         std::vector<char> serialize() const {
             std::vector<char> payload_buffer;
-            write_string_to_buffer(payload_buffer, topic_name);
-            write_uint64_to_buffer(payload_buffer, start_offset);
-            write_uint32_to_buffer(payload_buffer, max_messages);
+            serialize_into(payload_buffer);
             return payload_buffer;
         }
         static ConsumeRequest deserialize(const char* data, size_t payload_len) {
-            ConsumeRequest req;
-            size_t offset = 0;
-            req.topic_name = read_string_from_buffer(data, offset, payload_len);
-            req.start_offset = read_uint64_from_buffer(data, offset);
-            req.max_messages = read_uint32_from_buffer(data, offset);
-            if (offset != payload_len) throw std::runtime_error("ConsumeRequest: Did not consume entire payload.");
-            return req;
+            return from_view(ConsumeRequestView::parse(data, payload_len));
         }
     };
     struct ConsumeResponse { // Payload for success
         std::vector<Message> messages; // Original Message struct from event_queue_core
         std::vector<char> serialize() const {
             std::vector<char> payload_buffer;
-            write_uint32_to_buffer(payload_buffer, static_cast<uint32_t>(messages.size()));
-            for (const auto& msg : messages) {
-                write_uint64_to_buffer(payload_buffer, msg.offset);
+            serialize_messages(payload_buffer, messages);
+            return payload_buffer;
+        }
+        // Appends the encoded message list to `buffer`, reserving the exact size up front.
+        // Lets the server encode straight from its reusable consume buffer without copying into `messages`.
+        static size_t encoded_size(const std::vector<Message>& msgs) {
+            size_t size = sizeof(uint32_t);
+            for (const auto& msg : msgs) {
+                size += sizeof(uint64_t) + sizeof(uint32_t) + msg.payload.size();
+            }
+            return size;
+        }
+        static void serialize_messages(std::vector<char>& buffer, const std::vector<Message>& msgs) {
+            BufferWriter writer(buffer);
+            writer.reserve(encoded_size(msgs));
+            writer.put_u32(static_cast<uint32_t>(msgs.size()));
+            for (const auto& msg : msgs) {
+                writer.put_u64(msg.offset);
                 // Topic name is context, not part of individual message payload in this response
-                write_string_to_buffer(payload_buffer, msg.payload, false); // uint32_t length for payload
+                writer.put_string(msg.payload, false); // uint32_t length for payload
             }
-            return payload_buffer;
         }
         static ConsumeResponse deserialize(const char* data, size_t payload_len, const std::string& topic_name_context) {
             ConsumeResponse res;
@@ -283,18 +563,396 @@ namespace NetworkProtocol {
         }
     };
 
+    // PRODUCE_BATCH
+    // Many payloads for one or more topics in one request. Each topic's messages are appended with a
+    // single write and get contiguous offsets; the response reports one entry per topic, in request order.
+    // Zero-copy decode: parse() checks the whole payload once, and for_each_topic() then walks it,
+    // handing out views into the receive buffer
+    class ProduceBatchRequestView {
+    public:
+        // One topic's messages, still length-prefixed as on the wire
+        struct TopicBatch {
+            std::string_view topic_name;
+            uint32_t message_count = 0;
+            std::string_view encoded_payloads;
+
+            // Payload bytes, without the length prefixes
+            uint64_t payload_bytes() const { return encoded_payloads.size() - uint64_t(message_count) * sizeof(uint32_t); }
+            // Calls f(std::string_view payload) for each message, in order
+            template <typename F>
+            void for_each_payload(F&& f) const {
+                BufferReader reader(encoded_payloads.data(), encoded_payloads.size());
+                for (uint32_t i = 0; i < message_count; ++i) f(reader.get_string(false));
+            }
+        };
+
+        uint32_t topic_count() const { return topic_count_; }
+
+        static ProduceBatchRequestView parse(const char* data, size_t payload_len) {
+            ProduceBatchRequestView req;
+            BufferReader reader(data, payload_len);
+            if (reader.remaining() < sizeof(uint32_t)) throw std::runtime_error("ProduceBatchRequest: Did not consume entire payload.");
+            req.topic_count_ = reader.get_u32();
+            req.topics_ = std::string_view(data + reader.offset(), reader.remaining());
+            for (uint32_t t = 0; t < req.topic_count_; ++t) {
+                next_topic(reader);
+            }
+            if (!reader.at_end()) throw std::runtime_error("ProduceBatchRequest: Did not consume entire payload.");
+            return req;
+        }
+
+        // Calls f(const TopicBatch&) for each topic, in request order
+        template <typename F>
+        void for_each_topic(F&& f) const {
+            BufferReader reader(topics_.data(), topics_.size());
+            for (uint32_t t = 0; t < topic_count_; ++t) f(next_topic(reader));
+        }
+
+    private:
+        static TopicBatch next_topic(BufferReader& reader) {
+            TopicBatch batch;
+            batch.topic_name = reader.get_string();
+            if (reader.remaining() < sizeof(uint32_t)) throw std::runtime_error("ProduceBatchRequest: Did not consume entire payload.");
+            batch.message_count = reader.get_u32();
+            const char* start = reader.data_at_offset();
+            for (uint32_t i = 0; i < batch.message_count; ++i) {
+                if (reader.remaining() < sizeof(uint32_t)) throw std::runtime_error("ProduceBatchRequest: Did not consume entire payload.");
+                reader.get_string(false);
+            }
+            batch.encoded_payloads = std::string_view(start, reader.data_at_offset() - start);
+            return batch;
+        }
+
+        uint32_t topic_count_ = 0;
+        std::string_view topics_; // Everything after the topic count
+    };
+    struct ProduceBatchRequest {
+        struct TopicBatch {
+            std::string topic_name;
+            std::vector<std::string> payloads;
+        };
+        std::vector<TopicBatch> topics;
+
+        std::vector<char> serialize() const {
+            std::vector<char> payload_buffer;
+            write_uint32_to_buffer(payload_buffer, static_cast<uint32_t>(topics.size()));
+            for (const auto& batch : topics) {
+                write_string_to_buffer(payload_buffer, batch.topic_name);
+                write_uint32_to_buffer(payload_buffer, static_cast<uint32_t>(batch.payloads.size()));
+                for (const auto& payload : batch.payloads) {
+                    write_string_to_buffer(payload_buffer, payload, false);
+                }
+            }
+            return payload_buffer;
+        }
+        static ProduceBatchRequest deserialize(const char* data, size_t payload_len) {
+            ProduceBatchRequestView view = ProduceBatchRequestView::parse(data, payload_len);
+            ProduceBatchRequest req;
+            req.topics.reserve(view.topic_count());
+            view.for_each_topic([&](const ProduceBatchRequestView::TopicBatch& batch_view) {
+                TopicBatch batch;
+                batch.topic_name = std::string(batch_view.topic_name);
+                batch.payloads.reserve(batch_view.message_count);
+                batch_view.for_each_payload([&](std::string_view payload) { batch.payloads.emplace_back(payload); });
+                req.topics.push_back(std::move(batch));
+            });
+            return req;
+        }
+    };
+    struct ProduceBatchResponse { // Payload for success; per-topic failures are reported in `status`
+        struct TopicResult {
+            std::string topic_name;
+            StatusCode status = StatusCode::SUCCESS;
+            uint64_t base_offset = 0;  // Offset of the first message; the batch occupies [base_offset, base_offset + count)
+            uint32_t count = 0;
+            uint32_t throttle_ms = 0;  // Set with ERROR_THROTTLED
+        };
+        std::vector<TopicResult> results;
+
+        std::vector<char> serialize() const {
+            std::vector<char> payload_buffer;
+            write_uint32_to_buffer(payload_buffer, static_cast<uint32_t>(results.size()));
+            for (const auto& r : results) {
+                write_string_to_buffer(payload_buffer, r.topic_name);
+                payload_buffer.push_back(static_cast<char>(r.status));
+                write_uint64_to_buffer(payload_buffer, r.base_offset);
+                write_uint32_to_buffer(payload_buffer, r.count);
+                write_uint32_to_buffer(payload_buffer, r.throttle_ms);
+            }
+            return payload_buffer;
+        }
+        static ProduceBatchResponse deserialize(const char* data, size_t payload_len) {
+            ProduceBatchResponse res;
+            size_t offset = 0;
+            uint32_t result_count = read_uint32_from_buffer(data, offset);
+            for (uint32_t i = 0; i < result_count; ++i) {
+                TopicResult r;
+                r.topic_name = read_string_from_buffer(data, offset, payload_len);
+                if (offset + 1 + sizeof(uint64_t) + 2 * sizeof(uint32_t) > payload_len) throw std::runtime_error("ProduceBatchResponse: Did not consume entire payload.");
+                r.status = static_cast<StatusCode>(data[offset++]);
+                r.base_offset = read_uint64_from_buffer(data, offset);
+                r.count = read_uint32_from_buffer(data, offset);
+                r.throttle_ms = read_uint32_from_buffer(data, offset);
+                res.results.push_back(std::move(r));
+            }
+            if (offset != payload_len) throw std::runtime_error("ProduceBatchResponse: Did not consume entire payload.");
+            return res;
+        }
+    };
+
+    // FETCH
+    // Reads several (topic, offset, max_bytes) tuples in one round trip. max_bytes of 0 means the
+    // server default; the whole response is additionally capped at MAX_CONSUME_RESPONSE_BYTES.
+    // Zero-copy decode, as for PRODUCE_BATCH: topic names are views into the receive buffer
+    class FetchRequestView {
+    public:
+        struct Entry {
+            std::string_view topic_name;
+            uint64_t start_offset = 0;
+            uint32_t max_bytes = 0;
+        };
+
+        uint32_t entry_count() const { return entry_count_; }
+
+        static FetchRequestView parse(const char* data, size_t payload_len) {
+            FetchRequestView req;
+            BufferReader reader(data, payload_len);
+            if (reader.remaining() < sizeof(uint32_t)) throw std::runtime_error("FetchRequest: Did not consume entire payload.");
+            req.entry_count_ = reader.get_u32();
+            req.entries_ = std::string_view(data + reader.offset(), reader.remaining());
+            for (uint32_t i = 0; i < req.entry_count_; ++i) {
+                next_entry(reader);
+            }
+            if (!reader.at_end()) throw std::runtime_error("FetchRequest: Did not consume entire payload.");
+            return req;
+        }
+
+        // Calls f(const Entry&) for each entry, in request order
+        template <typename F>
+        void for_each_entry(F&& f) const {
+            BufferReader reader(entries_.data(), entries_.size());
+            for (uint32_t i = 0; i < entry_count_; ++i) f(next_entry(reader));
+        }
+
+    private:
+        static Entry next_entry(BufferReader& reader) {
+            Entry e;
+            e.topic_name = reader.get_string();
+            if (reader.remaining() < sizeof(uint64_t) + sizeof(uint32_t)) throw std::runtime_error("FetchRequest: Did not consume entire payload.");
+            e.start_offset = reader.get_u64();
+            e.max_bytes = reader.get_u32();
+            return e;
+        }
+
+        uint32_t entry_count_ = 0;
+        std::string_view entries_; // Everything after the entry count
+    };
+    struct FetchRequest {
+        struct Entry {
+            std::string topic_name;
+            uint64_t start_offset = 0;
+            uint32_t max_bytes = 0;
+        };
+        std::vector<Entry> entries;
+
+        std::vector<char> serialize() const {
+            std::vector<char> payload_buffer;
+            write_uint32_to_buffer(payload_buffer, static_cast<uint32_t>(entries.size()));
+            for (const auto& e : entries) {
+                write_string_to_buffer(payload_buffer, e.topic_name);
+                write_uint64_to_buffer(payload_buffer, e.start_offset);
+                write_uint32_to_buffer(payload_buffer, e.max_bytes);
+            }
+            return payload_buffer;
+        }
+        static FetchRequest deserialize(const char* data, size_t payload_len) {
+            FetchRequestView view = FetchRequestView::parse(data, payload_len);
+            FetchRequest req;
+            req.entries.reserve(view.entry_count());
+            view.for_each_entry([&](const FetchRequestView::Entry& e) {
+                req.entries.push_back(Entry{std::string(e.topic_name), e.start_offset, e.max_bytes});
+            });
+            return req;
+        }
+    };
+    struct FetchResponse { // Payload for success; one entry per requested tuple, in request order
+        struct Entry {
+            std::string topic_name;
+            StatusCode status = StatusCode::SUCCESS;
+            uint64_t next_offset = 0; // Topic's next offset (high watermark), for lag tracking
+            std::vector<Message> messages;
+        };
+        std::vector<Entry> entries;
+
+        // Writes one entry; the server encodes entries directly into the response frame
+        static void serialize_entry(std::vector<char>& buffer, std::string_view topic_name, StatusCode status,
+                                    uint64_t next_offset, const std::vector<Message>& msgs) {
+            write_string_to_buffer(buffer, topic_name);
+            buffer.push_back(static_cast<char>(status));
+            write_uint64_to_buffer(buffer, next_offset);
+            ConsumeResponse::serialize_messages(buffer, msgs);
+        }
+        std::vector<char> serialize() const {
+            std::vector<char> payload_buffer;
+            write_uint32_to_buffer(payload_buffer, static_cast<uint32_t>(entries.size()));
+            for (const auto& e : entries) {
+                serialize_entry(payload_buffer, e.topic_name, e.status, e.next_offset, e.messages);
+            }
+            return payload_buffer;
+        }
+        static FetchResponse deserialize(const char* data, size_t payload_len) {
+            FetchResponse res;
+            size_t offset = 0;
+            uint32_t entry_count = read_uint32_from_buffer(data, offset);
+            for (uint32_t i = 0; i < entry_count; ++i) {
+                Entry e;
+                e.topic_name = read_string_from_buffer(data, offset, payload_len);
+                if (offset + 1 + sizeof(uint64_t) + sizeof(uint32_t) > payload_len) throw std::runtime_error("FetchResponse: Did not consume entire payload.");
+                e.status = static_cast<StatusCode>(data[offset++]);
+                e.next_offset = read_uint64_from_buffer(data, offset);
+                uint32_t message_count = read_uint32_from_buffer(data, offset);
+                for (uint32_t m = 0; m < message_count; ++m) {
+                    if (offset + sizeof(uint64_t) + sizeof(uint32_t) > payload_len) throw std::runtime_error("FetchResponse: Did not consume entire payload.");
+                    uint64_t msg_offset = read_uint64_from_buffer(data, offset);
+                    e.messages.emplace_back(msg_offset, e.topic_name, read_string_from_buffer(data, offset, payload_len, false));
+                }
+                res.entries.push_back(std::move(e));
+            }
+            if (offset != payload_len) throw std::runtime_error("FetchResponse: Did not consume entire payload.");
+            return res;
+        }
+    };
+
+    // SUBSCRIBE
+    // After a successful SUBSCRIBE_RESPONSE the server pushes MESSAGE_PUSH frames for the topic on the
+    // same connection. Pushes are bounded by credit: the subscriber grants bytes (12 bytes of record
+    // header plus payload per message) up front and tops them up with SUBSCRIPTION_CREDIT as it
+    // processes pushes. With no credit left the server stops pushing and later resumes from the log,
+    // so a slow subscriber costs no server memory.
+    struct SubscribeRequest {
+        std::string topic_name;
+        uint64_t start_offset = 0;
+        uint32_t credit_bytes = 0; // Initial credit
+
+        std::vector<char> serialize() const {
+            std::vector<char> payload_buffer;
+            write_string_to_buffer(payload_buffer, topic_name);
+            write_uint64_to_buffer(payload_buffer, start_offset);
+            write_uint32_to_buffer(payload_buffer, credit_bytes);
+            return payload_buffer;
+        }
+        static SubscribeRequest deserialize(const char* data, size_t payload_len) {
+            SubscribeRequest req;
+            size_t offset = 0;
+            req.topic_name = read_string_from_buffer(data, offset, payload_len);
+            if (offset + sizeof(uint64_t) + sizeof(uint32_t) != payload_len) throw std::runtime_error("SubscribeRequest: Did not consume entire payload.");
+            req.start_offset = read_uint64_from_buffer(data, offset);
+            req.credit_bytes = read_uint32_from_buffer(data, offset);
+            return req;
+        }
+    };
+    // SUBSCRIBE_RESPONSE payload: next_offset (uint64_t), the topic's next offset when subscribed.
+    // UNSUBSCRIBE_REQUEST payload: topic name only; UNSUBSCRIBE_RESPONSE has an empty payload.
+
+    // SUBSCRIPTION_CREDIT: adds credit_bytes to the connection's subscription on topic_name
+    struct SubscriptionCredit {
+        std::string topic_name;
+        uint32_t credit_bytes = 0;
+
+        std::vector<char> serialize() const {
+            std::vector<char> payload_buffer;
+            write_string_to_buffer(payload_buffer, topic_name);
+            write_uint32_to_buffer(payload_buffer, credit_bytes);
+            return payload_buffer;
+        }
+        static SubscriptionCredit deserialize(const char* data, size_t payload_len) {
+            SubscriptionCredit credit;
+            size_t offset = 0;
+            credit.topic_name = read_string_from_buffer(data, offset, payload_len);
+            if (offset + sizeof(uint32_t) != payload_len) throw std::runtime_error("SubscriptionCredit: Did not consume entire payload.");
+            credit.credit_bytes = read_uint32_from_buffer(data, offset);
+            return credit;
+        }
+    };
+
+    // HANDSHAKE_REQUEST: the codecs the client can decode, most preferred first
+    struct HandshakeRequest {
+        std::vector<CompressionCodec> codecs;
+
+        std::vector<char> serialize() const {
+            std::vector<char> payload_buffer;
+            BufferWriter writer(payload_buffer);
+            writer.put_u8(static_cast<uint8_t>(codecs.size()));
+            for (CompressionCodec codec : codecs) writer.put_u8(static_cast<uint8_t>(codec));
+            return payload_buffer;
+        }
+        static HandshakeRequest deserialize(const char* data, size_t payload_len) {
+            HandshakeRequest req;
+            BufferReader reader(data, payload_len);
+            uint8_t count = reader.get_u8();
+            for (uint8_t i = 0; i < count; ++i) req.codecs.push_back(static_cast<CompressionCodec>(reader.get_u8()));
+            if (!reader.at_end()) throw std::runtime_error("HandshakeRequest: Did not consume entire payload.");
+            return req;
+        }
+    };
+    // HANDSHAKE_RESPONSE: the codec both sides will use from now on (NONE if there is no common one)
+    // and the payload size from which frames should be compressed
+    struct HandshakeResponse {
+        CompressionCodec codec = CompressionCodec::NONE;
+        uint32_t compression_threshold = 0;
+
+        void serialize_into(std::vector<char>& out) const {
+            BufferWriter writer(out);
+            writer.put_u8(static_cast<uint8_t>(codec));
+            writer.put_u32(compression_threshold);
+        }
+        static HandshakeResponse deserialize(const char* data, size_t payload_len) {
+            HandshakeResponse resp;
+            BufferReader reader(data, payload_len);
+            resp.codec = static_cast<CompressionCodec>(reader.get_u8());
+            resp.compression_threshold = reader.get_u32();
+            if (!reader.at_end()) throw std::runtime_error("HandshakeResponse: Did not consume entire payload.");
+            return resp;
+        }
+    };
+
+    // MESSAGE_PUSH: topic name, then the messages encoded as in CONSUME_RESPONSE
+    struct MessagePush {
+        std::string topic_name;
+        std::vector<Message> messages;
+
+        static MessagePush deserialize(const char* data, size_t payload_len) {
+            MessagePush push;
+            size_t offset = 0;
+            push.topic_name = read_string_from_buffer(data, offset, payload_len);
+            push.messages = ConsumeResponse::deserialize(data + offset, payload_len - offset, push.topic_name).messages;
+            return push;
+        }
+    };
+
     // Generic Error Response
     struct ErrorResponsePayload {
         std::string error_message;
+        uint32_t throttle_ms = 0; // Only sent with ERROR_THROTTLED: how long the client should back off
+        void serialize_into(std::vector<char>& out) const {
+            BufferWriter writer(out);
+            writer.put_string(error_message, false); // uint32_t for error message
+            if (throttle_ms > 0) {
+                writer.put_u32(throttle_ms);
+            }
+        }
         std::vector<char> serialize() const {
             std::vector<char> payload_buffer;
-            write_string_to_buffer(payload_buffer, error_message, false); // uint32_t for error message
+            serialize_into(payload_buffer);
             return payload_buffer;
         }
         static ErrorResponsePayload deserialize(const char* data, size_t payload_len) {
             ErrorResponsePayload err_res;
             size_t offset = 0;
             err_res.error_message = read_string_from_buffer(data, offset, payload_len, false);
+            if (offset + sizeof(uint32_t) <= payload_len) { // Throttle delay (optional)
+                err_res.throttle_ms = read_uint32_from_buffer(data, offset);
+            }
             if (offset != payload_len) throw std::runtime_error("ErrorResponse: Did not consume entire payload.");
             return err_res;
         }
@@ -0,0 +1,136 @@
+// network/QuotaManager.cpp
+#include "QuotaManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+QuotaManager::QuotaManager(QuotaConfig config) : config_(std::move(config)) {
+    if (config_.burst_seconds <= 0) config_.burst_seconds = 1.0;
+    next_sweep_ = std::chrono::steady_clock::now() + SWEEP_INTERVAL;
+}
+
+std::string QuotaManager::client_identity(std::string_view peer_address, std::string_view forwarded_client_id) const {
+    // Anyone can set the header, so it only counts when a configured proxy vouches for it
+    if (!forwarded_client_id.empty() && config_.trusted_proxies.find(peer_address) != config_.trusted_proxies.end()) {
+        return std::string(forwarded_client_id);
+    }
+    return std::string(peer_address);
+}
+
+void QuotaManager::TokenBucket::init(double r, double burst_seconds, std::chrono::steady_clock::time_point now,
+                                     double min_capacity) {
+    rate = r;
+    capacity = r > 0 ? std::max(min_capacity, r * burst_seconds) : 0;
+    tokens = capacity; // Start full so a fresh client gets its burst
+    last_refill = now;
+}
+
+void QuotaManager::TokenBucket::refill(std::chrono::steady_clock::time_point now) {
+    if (rate <= 0) return;
+    double elapsed = std::chrono::duration<double>(now - last_refill).count();
+    tokens = std::min(capacity, tokens + elapsed * rate);
+    last_refill = now;
+}
+
+uint32_t QuotaManager::TokenBucket::throttle_ms() const {
+    if (rate <= 0 || tokens >= 0) return 0;
+    return static_cast<uint32_t>(std::ceil(-tokens / rate * 1000.0));
+}
+
+QuotaManager::Buckets& QuotaManager::buckets_for(std::unordered_map<std::string, Buckets>& map, std::string_view key_view,
+                                                 const std::map<std::string, QuotaLimits>& overrides,
+                                                 const QuotaLimits& defaults,
+                                                 std::chrono::steady_clock::time_point now) {
+    // unordered_map can't look up by string_view in C++17; a per-thread scratch key stops allocating once warm
+    thread_local std::string key;
+    key.assign(key_view.data(), key_view.size());
+    auto it = map.find(key);
+    if (it != map.end()) return it->second;
+
+    auto override_it = overrides.find(key);
+    const QuotaLimits& limits = (override_it != overrides.end()) ? override_it->second : defaults;
+    Buckets& b = map[key];
+    b.produce_bytes.init(limits.produce_bytes_per_sec, config_.burst_seconds, now);
+    b.consume_bytes.init(limits.consume_bytes_per_sec, config_.burst_seconds, now);
+    // A request takes a whole token, so a smaller request bucket could never admit anything
+    b.requests.init(limits.requests_per_sec, config_.burst_seconds, now, 1.0);
+    return b;
+}
+
+void QuotaManager::maybe_sweep(std::chrono::steady_clock::time_point now) {
+    if (now < next_sweep_) return;
+    next_sweep_ = now + SWEEP_INTERVAL;
+    for (auto* map : {&client_buckets_, &topic_buckets_}) {
+        for (auto it = map->begin(); it != map->end();) {
+            Buckets& b = it->second;
+            b.produce_bytes.refill(now);
+            b.consume_bytes.refill(now);
+            b.requests.refill(now);
+            it = b.full() ? map->erase(it) : std::next(it);
+        }
+    }
+}
+
+QuotaManager::TokenBucket* QuotaManager::bytes_bucket(Buckets& b, Operation op) {
+    switch (op) {
+        case Operation::PRODUCE: return &b.produce_bytes;
+        case Operation::CONSUME: return &b.consume_bytes;
+        default: return nullptr;
+    }
+}
+
+uint32_t QuotaManager::admit(std::string_view client_id, std::string_view topic_name, Operation op, uint64_t bytes) {
+    if (!config_.enabled) return 0;
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    maybe_sweep(now);
+    Buckets* scopes[2] = {
+        &buckets_for(client_buckets_, client_id, config_.clients, config_.default_client, now),
+        topic_name.empty() ? nullptr : &buckets_for(topic_buckets_, topic_name, config_.topics, config_.default_topic, now)
+    };
+
+    uint32_t throttle = 0;
+    for (Buckets* b : scopes) {
+        if (!b) continue;
+        b->requests.refill(now);
+        // A request needs a whole token, so an empty request bucket throttles as well as a bucket in debt
+        if (b->requests.rate > 0 && b->requests.tokens < 1.0) {
+            throttle = std::max(throttle, static_cast<uint32_t>(std::ceil((1.0 - b->requests.tokens) / b->requests.rate * 1000.0)));
+        }
+        if (TokenBucket* bb = bytes_bucket(*b, op)) {
+            bb->refill(now);
+            throttle = std::max(throttle, bb->throttle_ms());
+        }
+    }
+    if (throttle > 0) {
+        return std::min(throttle, config_.max_throttle_ms);
+    }
+
+    for (Buckets* b : scopes) {
+        if (!b) continue;
+        if (b->requests.rate > 0) b->requests.tokens -= 1.0;
+        if (op == Operation::PRODUCE && b->produce_bytes.rate > 0) b->produce_bytes.tokens -= static_cast<double>(bytes);
+    }
+    return 0;
+}
+
+void QuotaManager::record(std::string_view client_id, std::string_view topic_name, Operation op, uint64_t bytes) {
+    if (!config_.enabled || bytes == 0) return;
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    maybe_sweep(now);
+    Buckets& client = buckets_for(client_buckets_, client_id, config_.clients, config_.default_client, now);
+    if (TokenBucket* bb = bytes_bucket(client, op)) {
+        bb->refill(now);
+        if (bb->rate > 0) bb->tokens -= static_cast<double>(bytes);
+    }
+    if (topic_name.empty()) return;
+    Buckets& topic = buckets_for(topic_buckets_, topic_name, config_.topics, config_.default_topic, now);
+    if (TokenBucket* bb = bytes_bucket(topic, op)) {
+        bb->refill(now);
+        if (bb->rate > 0) bb->tokens -= static_cast<double>(bytes);
+    }
+}
@@ -0,0 +1,91 @@
+// network/QuotaManager.h
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Rates enforced for one client identity or one topic. 0 means unlimited.
+struct QuotaLimits {
+    double produce_bytes_per_sec = 0;
+    double consume_bytes_per_sec = 0;
+    double requests_per_sec = 0;
+};
+
+struct QuotaConfig {
+    bool enabled = false;
+    QuotaLimits default_client; // Applied to clients without an entry in `clients`
+    QuotaLimits default_topic;  // Applied to topics without an entry in `topics`
+    std::map<std::string, QuotaLimits> clients;
+    std::map<std::string, QuotaLimits> topics;
+    // Peer addresses (e.g. a reverse proxy) whose X-Client-Id header is taken as the client identity.
+    // From any other peer the header is ignored and the client is its address.
+    std::set<std::string, std::less<>> trusted_proxies;
+    double burst_seconds = 1.0;       // Bucket capacity, in seconds worth of the rate
+    uint32_t max_throttle_ms = 30000; // Upper bound on the delay handed back to a client
+};
+
+// Token-bucket admission control shared by the TCP, HTTP and WebSocket front ends.
+// Requests are never queued: a client whose bucket is in debt is told how long to back off,
+// and a request that is admitted may push its buckets into debt (so one large produce is
+// accepted, and the client then pays for it with a proportional delay).
+class QuotaManager {
+public:
+    enum class Operation { PRODUCE, CONSUME, OTHER };
+
+    explicit QuotaManager(QuotaConfig config);
+
+    bool enabled() const { return config_.enabled; }
+
+    // The identity quotas are keyed on: the peer address, or the client id a trusted proxy forwarded
+    std::string client_identity(std::string_view peer_address, std::string_view forwarded_client_id) const;
+
+    // Idle buckets are dropped once they have refilled, which loses nothing (a new bucket starts full)
+    static constexpr std::chrono::seconds SWEEP_INTERVAL{60};
+
+    // Called before doing any work. Returns 0 if the request is admitted (one request, plus `bytes`
+    // for produce, are charged to the client's and the topic's buckets), otherwise the number of
+    // milliseconds the client should wait before retrying; nothing is charged in that case.
+    uint32_t admit(std::string_view client_id, std::string_view topic_name, Operation op, uint64_t bytes = 0);
+
+    // Charges bytes that are only known after the fact (e.g. the size of a consume response).
+    void record(std::string_view client_id, std::string_view topic_name, Operation op, uint64_t bytes);
+
+private:
+    struct TokenBucket {
+        double rate = 0; // Tokens per second; 0 = unlimited
+        double capacity = 0;
+        double tokens = 0;
+        std::chrono::steady_clock::time_point last_refill;
+
+        void init(double r, double burst_seconds, std::chrono::steady_clock::time_point now, double min_capacity = 0);
+        void refill(std::chrono::steady_clock::time_point now);
+        bool full() const { return rate <= 0 || tokens >= capacity; }
+        uint32_t throttle_ms() const; // Time until the bucket is out of debt
+    };
+
+    struct Buckets {
+        TokenBucket produce_bytes;
+        TokenBucket consume_bytes;
+        TokenBucket requests;
+
+        bool full() const { return produce_bytes.full() && consume_bytes.full() && requests.full(); }
+    };
+
+    Buckets& buckets_for(std::unordered_map<std::string, Buckets>& map, std::string_view key,
+                         const std::map<std::string, QuotaLimits>& overrides, const QuotaLimits& defaults,
+                         std::chrono::steady_clock::time_point now);
+    static TokenBucket* bytes_bucket(Buckets& b, Operation op);
+    void maybe_sweep(std::chrono::steady_clock::time_point now); // Under mutex_
+
+    QuotaConfig config_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Buckets> client_buckets_;
+    std::unordered_map<std::string, Buckets> topic_buckets_;
+    std::chrono::steady_clock::time_point next_sweep_;
+};
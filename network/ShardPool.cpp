@@ -0,0 +1,170 @@
+// network/ShardPool.cpp
+#include "ShardPool.h"
+
+#include <boost/asio/post.hpp>
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+// Identifies the shard (if any) the current thread runs
+thread_local const ShardPool* tls_pool = nullptr;
+thread_local size_t tls_shard = ShardPool::NO_SHARD;
+}
+
+ShardPool::ShardPool(size_t num_shards, bool pin_threads, size_t queue_capacity)
+    : pin_threads_(pin_threads) {
+    if (num_shards == 0) {
+        num_shards = std::thread::hardware_concurrency();
+        if (num_shards == 0) num_shards = 1;
+    }
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+        auto shard = std::make_unique<Shard>();
+        shard->inbound.reserve(num_shards);
+        for (size_t src = 0; src < num_shards; ++src) {
+            // A shard never queues to itself (dispatch runs inline), so that slot stays empty
+            shard->inbound.push_back(src == i ? nullptr : std::make_unique<Inbound>(queue_capacity));
+        }
+        shards_.push_back(std::move(shard));
+    }
+}
+
+ShardPool::~ShardPool() {
+    stop();
+}
+
+void ShardPool::start() {
+    if (started_) return;
+    started_ = true;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i]->thread = std::thread([this, i]() { run_shard(i); });
+    }
+    std::cout << "ShardPool: Started " << shards_.size() << " shard thread(s)"
+              << (pin_threads_ ? " (pinned)." : ".") << std::endl;
+}
+
+void ShardPool::stop() {
+    for (auto& shard : shards_) {
+        shard->work.reset();
+        shard->ioc.stop();
+    }
+    for (auto& shard : shards_) {
+        if (shard->thread.joinable()) shard->thread.join();
+    }
+}
+
+size_t ShardPool::shard_for_topic(std::string_view topic_name) const {
+    return std::hash<std::string_view>{}(topic_name) % shards_.size();
+}
+
+size_t ShardPool::next_connection_shard() {
+    return next_connection_shard_.fetch_add(1, std::memory_order_relaxed) % shards_.size();
+}
+
+size_t ShardPool::current_shard() const {
+    return tls_pool == this ? tls_shard : NO_SHARD;
+}
+
+void ShardPool::dispatch(size_t target, Task task) {
+    const size_t source = current_shard();
+    if (source == target) {
+        task();
+        return;
+    }
+    Shard& dst = *shards_[target];
+    if (source == NO_SHARD) {
+        boost::asio::post(dst.ioc, std::move(task));
+        return;
+    }
+
+    Inbound& inbound = *dst.inbound[source];
+    if (!inbound.overflowing.load(std::memory_order_acquire) && inbound.ring.try_push(task)) {
+        return schedule_drain(target);
+    }
+    {
+        // The ring is (or was) full: queue behind everything already waiting, never around it
+        std::lock_guard<std::mutex> lock(inbound.overflow_mutex);
+        if (inbound.overflowing.load(std::memory_order_relaxed) || !inbound.ring.try_push(task)) {
+            inbound.overflowing.store(true, std::memory_order_release);
+            inbound.overflow.push_back(std::move(task));
+        }
+    }
+    schedule_drain(target);
+}
+
+void ShardPool::schedule_drain(size_t target) {
+    // Only one drain is kept in flight per shard; drain() clears the flag before popping,
+    // so anything pushed after that point schedules the next one.
+    Shard& dst = *shards_[target];
+    if (!dst.drain_scheduled.exchange(true)) {
+        boost::asio::post(dst.ioc, [this, target]() { drain(target); });
+    }
+}
+
+void ShardPool::run_shard(size_t index) {
+    tls_pool = this;
+    tls_shard = index;
+#ifdef __linux__
+    if (pin_threads_) {
+        unsigned int cpus = std::thread::hardware_concurrency();
+        if (cpus > 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(index % cpus, &cpuset);
+            int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+            if (rc != 0) {
+                std::cerr << "ShardPool: Failed to pin shard " << index << " to CPU " << (index % cpus)
+                          << " (error " << rc << ")" << std::endl;
+            }
+        }
+    }
+#endif
+    // A handler that throws must not take the shard down with it: every connection and topic it
+    // owns would hang. run() returns normally only once the pool is stopped.
+    for (;;) {
+        try {
+            shards_[index]->ioc.run();
+            return;
+        } catch (const std::exception& e) {
+            std::cerr << "ShardPool: Exception in shard " << index << ": " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "ShardPool: Unknown exception in shard " << index << std::endl;
+        }
+    }
+}
+
+void ShardPool::drain(size_t index) {
+    Shard& shard = *shards_[index];
+    shard.drain_scheduled.exchange(false);
+    auto run = [index](Task& task) {
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "ShardPool: Exception in forwarded task on shard " << index << ": " << e.what() << std::endl;
+        }
+        task = nullptr;
+    };
+    Task task;
+    for (auto& inbound : shard.inbound) {
+        if (!inbound) continue;
+        while (inbound->ring.try_pop(task)) run(task);
+        if (!inbound->overflowing.load(std::memory_order_acquire)) continue;
+
+        // While overflowing is set the source only adds to overflow, so what is left in the ring
+        // was dispatched before it. Clearing the flag under the lock sends the source back to the
+        // ring for tasks dispatched after these. The tasks run outside the lock.
+        std::deque<Task> pending;
+        {
+            std::lock_guard<std::mutex> lock(inbound->overflow_mutex);
+            while (inbound->ring.try_pop(task)) pending.push_back(std::move(task));
+            for (auto& overflow_task : inbound->overflow) pending.push_back(std::move(overflow_task));
+            inbound->overflow.clear();
+            inbound->overflowing.store(false, std::memory_order_release);
+        }
+        for (auto& pending_task : pending) run(pending_task);
+    }
+}
@@ -0,0 +1,78 @@
+// network/ShardPool.h
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "SpscQueue.h"
+
+// Thread-per-core execution: each shard owns one io_context run by exactly one (optionally pinned) thread,
+// plus a disjoint set of topics chosen by hashing the topic name. Work for a topic is forwarded to its
+// owning shard through per-(source, target) lock-free SPSC queues, so hot topics are only ever touched
+// by one thread and no cross-thread mutex handoff happens on the request path.
+class ShardPool {
+public:
+    using Task = std::function<void()>;
+    static constexpr size_t NO_SHARD = static_cast<size_t>(-1);
+
+    // num_shards == 0 means std::thread::hardware_concurrency()
+    explicit ShardPool(size_t num_shards, bool pin_threads = true, size_t queue_capacity = 4096);
+    ~ShardPool();
+
+    ShardPool(const ShardPool&) = delete;
+    ShardPool& operator=(const ShardPool&) = delete;
+
+    void start();
+    void stop(); // Stops all io_contexts and joins the shard threads
+
+    size_t size() const { return shards_.size(); }
+    boost::asio::io_context& io_context(size_t shard) { return shards_[shard]->ioc; }
+
+    size_t shard_for_topic(std::string_view topic_name) const;
+    // Round-robin shard for a newly accepted connection
+    size_t next_connection_shard();
+    // Shard whose thread is running the caller, or NO_SHARD for non-shard threads
+    size_t current_shard() const;
+
+    // Runs `task` on `target`: inline if the caller is already on that shard, through the
+    // (current -> target) queue from another shard thread, or via io_context::post from non-shard
+    // threads. Tasks from one shard to another run in the order they were dispatched.
+    void dispatch(size_t target, Task task);
+
+private:
+    // Tasks from one source shard. When the ring is full, tasks go to the overflow deque, and keep
+    // going there until the target has caught up on both, so the order is kept.
+    struct Inbound {
+        explicit Inbound(size_t capacity) : ring(capacity) {}
+        SpscQueue<Task> ring;
+        std::atomic<bool> overflowing{false};
+        std::mutex overflow_mutex; // Guards overflow; overflowing only changes under it
+        std::deque<Task> overflow;
+    };
+
+    struct Shard {
+        boost::asio::io_context ioc{1}; // Concurrency hint 1: only the shard thread runs it
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{ioc.get_executor()};
+        std::vector<std::unique_ptr<Inbound>> inbound; // Indexed by source shard
+        std::atomic<bool> drain_scheduled{false};
+        std::thread thread;
+    };
+
+    void run_shard(size_t index);
+    void drain(size_t index);
+    void schedule_drain(size_t target);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    bool pin_threads_;
+    std::atomic<size_t> next_connection_shard_{0};
+    bool started_ = false;
+};
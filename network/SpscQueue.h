@@ -0,0 +1,63 @@
+// network/SpscQueue.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded, lock-free single-producer/single-consumer ring buffer.
+// Exactly one thread may call try_push and exactly one (other) thread may call try_pop.
+// T must be default-constructible and move-assignable.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : capacity_(round_up_pow2(capacity < 2 ? 2 : capacity)),
+          mask_(capacity_ - 1),
+          slots_(new T[capacity_]) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Moves from `item` only on success; returns false if the queue is full.
+    bool try_push(T& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == capacity_) {
+            return false;
+        }
+        slots_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = std::move(slots_[head & mask_]);
+        slots_[head & mask_] = T(); // Release whatever the slot held (e.g. captured shared_ptrs)
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    static size_t round_up_pow2(size_t v) {
+        size_t p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> slots_;
+
+    // Producer and consumer indices live on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<size_t> head_{0}; // Next slot to pop (consumer-owned)
+    alignas(64) std::atomic<size_t> tail_{0}; // Next slot to push (producer-owned)
+};
@@ -6,6 +6,51 @@
 // If using direct WebSocketSession interaction
 // #include "WebSocketSession.h" // Include full header here
 
+// New messages stop being appended to a delivered batch at this size, so one frame stays bounded
+static const size_t MAX_BATCH_BYTES = 1024 * 1024;
+
+// What a message is assumed to add to a batch beyond its payload (offset, topic, framing)
+static const size_t BATCH_MESSAGE_OVERHEAD = 64;
+
+NotificationBatch::NotificationBatch(std::string topic, std::vector<Message> messages)
+    : topic_(std::move(topic)), messages_(std::move(messages)) {
+    for (const auto& msg : messages_) bytes_ += msg.payload.size() + BATCH_MESSAGE_OVERHEAD;
+}
+
+const std::vector<Message>& NotificationBatch::messages() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sealed_ = true;
+    return messages_;
+}
+
+std::shared_ptr<const std::string> NotificationBatch::frame(Encoder encode) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sealed_ = true;
+    for (const auto& [encoder, frame] : frames_) {
+        if (encoder == encode) return frame;
+    }
+    // Encoded under the lock: other subscribers asking for the same encoding wait for this one
+    auto frame = std::make_shared<std::string>();
+    encode(*frame, topic_, messages_);
+    frames_.emplace_back(encode, frame);
+    return frame;
+}
+
+size_t NotificationBatch::size_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+bool NotificationBatch::append(const Message& message, size_t max_bytes) {
+    if (sealed_) return false; // Checked first, so a producer doesn't wait behind an encode
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t bytes = message.payload.size() + BATCH_MESSAGE_OVERHEAD;
+    if (sealed_ || bytes_ + bytes > max_bytes) return false;
+    messages_.push_back(message);
+    bytes_ += bytes;
+    return true;
+}
+
 SubscriptionManager::SubscriptionManager() {
     std::cout << "SubscriptionManager: Initialized." << std::endl;
 }
@@ -26,6 +71,7 @@ bool SubscriptionManager::subscribe(const std::string& topic_name,
         std::move(delivery_callback),
         std::move(client_executor)
     };
+    open_batches_.erase(topic_name); // The new subscriber doesn't hold it
     return true;
 }
 
@@ -37,6 +83,7 @@ bool SubscriptionManager::unsubscribe(const std::string& topic_name, const std::
         auto& subscribers = topic_it->second;
         if (subscribers.erase(subscriber_id) > 0) {
             std::cout << "SubscriptionManager: Client '" << subscriber_id << "' unsubscribed from topic '" << topic_name << "'" << std::endl;
+            open_batches_.erase(topic_name);
             if (subscribers.empty()) {
                 topic_subscriptions_.erase(topic_it); // Clean up topic if no subscribers left
             }
@@ -54,6 +101,7 @@ void SubscriptionManager::unsubscribe_all(const std::string& subscriber_id) {
         auto& subscribers = it->second;
         if (subscribers.erase(subscriber_id) > 0) {
             std::cout << "  - Unsubscribed '" << subscriber_id << "' from '" << it->first << "'" << std::endl;
+            open_batches_.erase(it->first);
         }
         if (subscribers.empty()) {
             it = topic_subscriptions_.erase(it); // Erase topic and advance iterator
@@ -63,6 +111,15 @@ void SubscriptionManager::unsubscribe_all(const std::string& subscriber_id) {
     }
 }
 
+void SubscriptionManager::skip_to(const std::string& topic_name, const std::string& subscriber_id, uint64_t offset) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto topic_it = topic_subscriptions_.find(topic_name);
+    if (topic_it == topic_subscriptions_.end()) return;
+    auto sub_it = topic_it->second.find(subscriber_id);
+    if (sub_it == topic_it->second.end()) return;
+    sub_it->second.next_offset_needed = std::max(sub_it->second.next_offset_needed, offset);
+}
+
 // Implementation of the INewMessageListener interface
 void SubscriptionManager::on_new_message(const Message& new_message) {
     // This is the method called by EventQueue.
@@ -73,20 +130,45 @@ void SubscriptionManager::on_new_message(const Message& new_message) {
     auto topic_it = topic_subscriptions_.find(topic_name);
     if (topic_it == topic_subscriptions_.end()) return;
 
-    std::vector<Message> single_message_batch = {new_message};
+    auto& subscribers = topic_it->second;
+
+    // Append to the batch delivered last when exactly the subscribers that hold it want this message,
+    // and none of them has looked at it yet: they all see it there, and nothing new is posted.
+    size_t wanting = 0;
+    auto open_it = open_batches_.find(topic_name);
+    std::shared_ptr<NotificationBatch> open = open_it != open_batches_.end() ? open_it->second.batch.lock() : nullptr;
+    bool holders_want = static_cast<bool>(open);
+    for (const auto& sub_pair : subscribers) {
+        const SubscriberInfo& sub_info = sub_pair.second;
+        bool wants = new_message.offset >= sub_info.next_offset_needed;
+        if (wants) ++wanting;
+        if (open && wants != (sub_info.last_batch == open_it->second.seq)) holders_want = false;
+    }
+    if (wanting == 0) return;
+    if (holders_want && open->append(new_message, MAX_BATCH_BYTES)) {
+        for (auto& sub_pair : subscribers) {
+            SubscriberInfo& sub_info = sub_pair.second;
+            if (sub_info.last_batch == open_it->second.seq) sub_info.next_offset_needed = new_message.offset + 1;
+        }
+        return;
+    }
 
-    for (auto& sub_pair : topic_it->second) {
+    // A new batch, shared by every subscriber that wants the message
+    auto batch = std::make_shared<NotificationBatch>(topic_name, std::vector<Message>{new_message});
+    uint64_t seq = next_batch_seq_++;
+    NotificationBatchPtr shared_batch = batch;
+    for (auto& sub_pair : subscribers) {
         SubscriberInfo& sub_info = sub_pair.second;
         if (new_message.offset >= sub_info.next_offset_needed) {
             boost::asio::post(sub_info.client_executor, [
                 delivery_cb = sub_info.deliver_messages,
-                topic = topic_name,
-                messages_batch = single_message_batch,
-                subscriber_id = sub_info.subscriber_id
+                shared_batch
             ]() {
-                delivery_cb(topic, messages_batch);
+                delivery_cb(shared_batch);
             });
             sub_info.next_offset_needed = new_message.offset + 1;
+            sub_info.last_batch = seq;
         }
     }
+    open_batches_[topic_name] = {batch, seq};
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <mutex>
 #include <functional>
 #include <memory> // For std::weak_ptr
+#include <atomic>
 #include <boost/asio/post.hpp> // To post notifications to client's strand
 #include <boost/asio/any_io_executor.hpp>
 
@@ -20,15 +21,55 @@
 class WebSocketSession; // If directly interacting with WebSocketSession
                        // Alternatively, use a more generic callback mechanism
 
-// A generic callback type for delivering messages to a subscriber
-// Parameters: topic_name, vector_of_messages
-using MessageDeliveryCallback = std::function<void(const std::string&, const std::vector<Message>&)>;
+// New messages for one topic, shared by every subscriber they are delivered to. Until the first
+// subscriber looks at the batch, the SubscriptionManager may still append messages that arrive in
+// the meantime, so a burst reaches each subscriber as one batch. The first call to messages() or
+// frame() seals it, and it is immutable from then on.
+//
+// frame() encodes the batch once per encoder, no matter how many subscribers ask for it, and hands
+// them all the same buffer.
+class NotificationBatch {
+public:
+    // Appends the wire encoding of a batch to `out`. A plain function, so it can key the cache.
+    using Encoder = void (*)(std::string& out, const std::string& topic, const std::vector<Message>& messages);
+
+    NotificationBatch(std::string topic, std::vector<Message> messages);
+
+    const std::string& topic() const { return topic_; }
+    const std::vector<Message>& messages() const;
+    std::shared_ptr<const std::string> frame(Encoder encode) const;
+    // For subscribers that only take a delivery as a wake-up: nothing is appended after this
+    void seal() const { sealed_ = true; }
+
+    // Payload bytes plus an allowance per message for its offset, topic and framing
+    size_t size_bytes() const;
+
+private:
+    friend class SubscriptionManager;
+    // False once sealed, or when the message would take the batch past max_bytes
+    bool append(const Message& message, size_t max_bytes);
+
+    std::string topic_;
+    mutable std::mutex mutex_;
+    mutable std::atomic<bool> sealed_{false};
+    std::vector<Message> messages_;
+    size_t bytes_ = 0;
+    mutable std::vector<std::pair<Encoder, std::shared_ptr<const std::string>>> frames_;
+};
+
+using NotificationBatchPtr = std::shared_ptr<const NotificationBatch>;
+
+// A generic callback type for delivering messages to a subscriber. Messages appended to the batch
+// later are only seen by reading it again, so a callback that doesn't keep the batch must read or
+// seal it.
+using MessageDeliveryCallback = std::function<void(const NotificationBatchPtr&)>;
 
 struct SubscriberInfo {
     std::string subscriber_id; // Unique ID for the subscriber (e.g., WebSocket session ID)
     uint64_t next_offset_needed;
     MessageDeliveryCallback deliver_messages;
     boost::asio::any_io_executor client_executor; // Executor to post delivery task for thread safety
+    uint64_t last_batch = 0; // Sequence number of the last batch delivered
 
     // For direct WebSocketSession interaction (alternative to generic callback)
     // std::weak_ptr<WebSocketSession> ws_session_wptr;
@@ -48,6 +89,10 @@ public:
 
     void on_new_message(const Message& message) override;
 
+    // Raises the subscriber's next wanted offset to `offset`, e.g. past messages it has read from the
+    // log itself. Never lowers it.
+    void skip_to(const std::string& topic_name, const std::string& subscriber_id, uint64_t offset);
+
     // Called by WebSocketSession or SSE handler to unsubscribe
     bool unsubscribe(const std::string& topic_name, const std::string& subscriber_id);
     void unsubscribe_all(const std::string& subscriber_id); // When a client disconnects
@@ -58,6 +103,15 @@ private:
     // Value: map of <subscriber_id, SubscriberInfo>
     std::map<std::string, std::map<std::string, SubscriberInfo>> topic_subscriptions_;
 
+    // Per topic, the last batch delivered, which new messages are appended to while no subscriber
+    // has looked at it yet. Forgotten when the topic's subscribers change.
+    struct OpenBatch {
+        std::weak_ptr<NotificationBatch> batch; // Expired once every subscriber is done with it
+        uint64_t seq = 0;
+    };
+    std::map<std::string, OpenBatch> open_batches_;
+    uint64_t next_batch_seq_ = 1;
+
     // Optional: If you need to retrieve messages directly (alternative to notify_new_messages)
     // EventQueue& event_queue_; // Be careful with dependencies
 };
\ No newline at end of file
@@ -1,24 +1,64 @@
 // network/TcpServer.cpp
 #include "TcpServer.h"
 #include "TcpSession.h" // Include TcpSession
+#include "ListenSocket.h"
 #include <iostream>
+#include <stdexcept>
 
-TcpServer::TcpServer(boost::asio::io_context& io_context, short port, EventQueue& event_queue)
-    : acceptor_(io_context, tcp::endpoint(tcp::v4(), port)), event_queue_(event_queue) {
-    std::cout << "TCP Server listening on port " << port << std::endl;
-    do_accept();
+TcpServer::TcpServer(boost::asio::io_context& io_context, short port, EventQueue& event_queue, ShardPool* shards,
+                     QuotaManager* quotas, SubscriptionManager* sub_manager, size_t num_acceptors,
+                     const Compression::Settings* compression)
+    : event_queue_(event_queue), shards_(shards), quotas_(quotas), sub_manager_(sub_manager),
+      compression_(compression ? std::make_unique<Compression::Settings>(*compression) : nullptr) {
+    tcp::endpoint endpoint(tcp::v4(), port);
+    num_acceptors = usable_acceptor_count(num_acceptors, "TcpServer");
+    if (num_acceptors <= 1) {
+        acceptors_.push_back(std::make_unique<Acceptor>(Acceptor{tcp::acceptor(io_context, endpoint), 0}));
+    } else {
+        per_shard_acceptors_ = shards_ != nullptr;
+        for (size_t i = 0; i < num_acceptors; ++i) {
+            // In sharded mode the listener runs on the shard thread that will own its connections
+            size_t shard = per_shard_acceptors_ ? i % shards_->size() : 0;
+            auto& ioc = per_shard_acceptors_ ? shards_->io_context(shard) : io_context;
+            auto acceptor = std::make_unique<Acceptor>(Acceptor{tcp::acceptor(ioc), shard});
+            boost::system::error_code ec;
+            const char* failed_step = nullptr;
+            if (!open_listen_socket(acceptor->acceptor, endpoint, true, ec, failed_step)) {
+                throw std::runtime_error("TCP acceptor " + std::to_string(i) + ": " + failed_step + " failed: " + ec.message());
+            }
+            acceptors_.push_back(std::move(acceptor));
+        }
+    }
+    std::cout << "TCP Server listening on port " << port;
+    if (acceptors_.size() > 1) std::cout << " (" << acceptors_.size() << " SO_REUSEPORT acceptors)";
+    std::cout << std::endl;
+    for (auto& acceptor : acceptors_) {
+        do_accept(*acceptor);
+    }
 }
 
-void TcpServer::do_accept() {
-    acceptor_.async_accept(
-        [this](boost::system::error_code ec, tcp::socket socket) {
+void TcpServer::do_accept(Acceptor& acceptor) {
+    // Each session gets its own strand so its timers and async wake-ups never run concurrently.
+    // In sharded mode the strand sits on the session's home shard, whose single thread does all its I/O.
+    size_t shard = 0;
+    if (shards_) shard = per_shard_acceptors_ ? acceptor.shard : shards_->next_connection_shard();
+    boost::asio::any_io_executor executor = acceptor.acceptor.get_executor();
+    if (shards_) executor = shards_->io_context(shard).get_executor();
+    acceptor.acceptor.async_accept(boost::asio::make_strand(executor),
+        [this, &acceptor, shard](boost::system::error_code ec, tcp::socket socket) {
         if (!ec) {
             // Create a new session and start it
-            std::make_shared<TcpSession>(std::move(socket), event_queue_)->start();
+            auto session = std::make_shared<TcpSession>(std::move(socket), event_queue_, shards_, shard, quotas_, sub_manager_,
+                                                        compression_.get());
+            if (shards_) {
+                shards_->dispatch(shard, [session]() { session->start(); });
+            } else {
+                session->start();
+            }
         } else {
             std::cerr << "Server accept error: " << ec.message() << std::endl;
         }
         // Continue accepting new connections
-        do_accept();
+        do_accept(acceptor);
     });
 }
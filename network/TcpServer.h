@@ -2,17 +2,38 @@
 #pragma once
 #include <boost/asio.hpp>
 #include <memory>
+#include <vector>
 #include "../event_queue_core/EventQueue.h" // The actual queue
+#include "ShardPool.h"
+#include "QuotaManager.h"
+#include "SubscriptionManager.h"
+#include "Compression.h"
 
 using boost::asio::ip::tcp;
 
 class TcpServer {
 public:
-    TcpServer(boost::asio::io_context& io_context, short port, EventQueue& event_queue);
+    // With a ShardPool, accepted connections are spread round-robin over the shards' io_contexts.
+    // num_acceptors > 1 opens that many SO_REUSEPORT listeners on the port so the kernel balances
+    // accepts; in sharded mode listener i lives on shard i % shard count and keeps its connections there.
+    // `compression` (copied) enables HANDSHAKE wire compression; null refuses every codec.
+    TcpServer(boost::asio::io_context& io_context, short port, EventQueue& event_queue, ShardPool* shards = nullptr,
+              QuotaManager* quotas = nullptr, SubscriptionManager* sub_manager = nullptr, size_t num_acceptors = 1,
+              const Compression::Settings* compression = nullptr);
 
 private:
-    void do_accept();
+    struct Acceptor {
+        tcp::acceptor acceptor;
+        size_t shard; // Home shard of accepted connections (sharded, multi-acceptor mode)
+    };
 
-    tcp::acceptor acceptor_;
+    void do_accept(Acceptor& acceptor);
+
+    std::vector<std::unique_ptr<Acceptor>> acceptors_;
     EventQueue& event_queue_; // Reference to the shared event queue
+    ShardPool* shards_;
+    QuotaManager* quotas_;
+    SubscriptionManager* sub_manager_; // Serves SUBSCRIBE_REQUEST; null disables it
+    bool per_shard_acceptors_ = false; // Each acceptor feeds its own shard instead of round-robin
+    std::unique_ptr<Compression::Settings> compression_; // Shared by this listener's sessions
 };
@@ -3,212 +3,907 @@
 #include <iostream>
 #include <boost/asio/read.hpp> // For boost::asio::async_read
 #include <boost/asio/write.hpp> // For boost::asio::async_write
+#include <algorithm>
+#include <atomic>
+#include <limits>
 
-TcpSession::TcpSession(tcp::socket socket, EventQueue& event_queue)
-    : socket_(std::move(socket)), event_queue_(event_queue), read_buffer_(NetworkProtocol::RequestHeader::SIZE) {}
+TcpSession::TcpSession(tcp::socket socket, EventQueue& event_queue, ShardPool* shards, size_t home_shard,
+                       QuotaManager* quotas, SubscriptionManager* sub_manager, const Compression::Settings* compression)
+    : socket_(std::move(socket)), event_queue_(event_queue), shards_(shards), home_shard_(home_shard),
+      quotas_(quotas), sub_manager_(sub_manager), compression_(compression),
+      read_buffer_(NetworkProtocol::RequestHeader::SIZE + NetworkProtocol::RequestHeader::EXTENSION_SIZE) {
+    static std::atomic<uint64_t> next_session_id{1};
+    boost::system::error_code ec;
+    auto endpoint = socket_.remote_endpoint(ec);
+    client_id_ = ec ? "unknown" : endpoint.address().to_string();
+    peer_ = ec ? "unknown" : client_id_ + ":" + std::to_string(endpoint.port());
+    subscriber_id_ = "tcp-" + std::to_string(next_session_id.fetch_add(1, std::memory_order_relaxed));
+}
+
+TcpSession::~TcpSession() {
+    // Delivery callbacks only hold a weak reference, so the session can end while still subscribed
+    if (sub_manager_ && !subscriptions_.empty()) {
+        sub_manager_->unsubscribe_all(subscriber_id_);
+    }
+}
 
 void TcpSession::start() {
-    std::cout << "New session started with " << socket_.remote_endpoint() << std::endl;
+    std::cout << "New session started with " << peer_ << std::endl;
+    // Responses are coalesced by the outbound queue, so Nagle would only add latency
+    boost::system::error_code ec;
+    socket_.set_option(tcp::no_delay(true), ec);
+    if (ec) {
+        std::cerr << "Session " << peer_ << ": Failed to set TCP_NODELAY: " << ec.message() << std::endl;
+    }
     do_read_header();
 }
 
 void TcpSession::do_read_header() {
     auto self = shared_from_this();
-    boost::asio::async_read(socket_, boost::asio::buffer(read_buffer_),
+    boost::asio::async_read(socket_, boost::asio::buffer(read_buffer_.data(), NetworkProtocol::RequestHeader::SIZE),
         [this, self](boost::system::error_code ec, std::size_t length) {
         if (!ec) {
             if (length != NetworkProtocol::RequestHeader::SIZE) {
-                 std::cerr << "Session " << socket_.remote_endpoint() << ": Read incomplete header. Expected " 
+                 std::cerr << "Session " << peer_ << ": Read incomplete header. Expected " 
                            << NetworkProtocol::RequestHeader::SIZE << " got " << length << std::endl;
                 // Consider closing socket
                 return;
             }
             NetworkProtocol::RequestHeader req_header = NetworkProtocol::RequestHeader::deserialize(read_buffer_.data());
-            
-            if (req_header.payload_length > NetworkProtocol::MAX_PAYLOAD_SIZE) {
-                std::cerr << "Session " << socket_.remote_endpoint() << ": Payload too large: " << req_header.payload_length << std::endl;
-                send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_PAYLOAD_TOO_LARGE, "Request payload too large.");
-                // Optionally close connection or just wait for next request
-                // For now, let's try to read next header to be resilient if client sends bad data then recovers
-                // do_read_header(); 
-                // Or more robust: close the connection
-                return; // This will drop the session
-            }
-            
-            if (req_header.payload_length == 0) { // No payload to read
-                handle_request(req_header, {});
+            if (req_header.v2) {
+                do_read_header_extension(req_header);
             } else {
                 do_read_payload(req_header);
             }
         } else {
             if (ec == boost::asio::error::eof) {
-                std::cout << "Session " << socket_.remote_endpoint() << ": Client closed connection." << std::endl;
+                std::cout << "Session " << peer_ << ": Client closed connection." << std::endl;
             } else if (ec) {
-                std::cerr << "Session " << socket_.remote_endpoint() << ": Read header error: " << ec.message() << std::endl;
+                std::cerr << "Session " << peer_ << ": Read header error: " << ec.message() << std::endl;
             }
             // Connection closed or error, session ends.
         }
     });
 }
 
+void TcpSession::do_read_header_extension(NetworkProtocol::RequestHeader req_header) {
+    auto self = shared_from_this();
+    boost::asio::async_read(socket_,
+        boost::asio::buffer(read_buffer_.data() + NetworkProtocol::RequestHeader::SIZE, NetworkProtocol::RequestHeader::EXTENSION_SIZE),
+        [this, self, req_header](boost::system::error_code ec, std::size_t /*length*/) mutable {
+        if (ec) {
+            std::cerr << "Session " << peer_ << ": Read header extension error: " << ec.message() << std::endl;
+            return; // Connection error, session ends
+        }
+        req_header.deserialize_extension(read_buffer_.data() + NetworkProtocol::RequestHeader::SIZE);
+        do_read_payload(req_header);
+    });
+}
+
 void TcpSession::do_read_payload(NetworkProtocol::RequestHeader req_header) {
-    payload_read_buffer_.resize(req_header.payload_length); // Resize buffer for payload
+    if (req_header.payload_length > NetworkProtocol::MAX_PAYLOAD_SIZE) {
+        std::cerr << "Session " << peer_ << ": Payload too large: " << req_header.payload_length << std::endl;
+        // The unread payload leaves the stream out of sync, so flush this error and end the session
+        stop_reading_ = true;
+        ++in_flight_;
+        send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_PAYLOAD_TOO_LARGE, "Request payload too large.");
+        return;
+    }
+    if (req_header.payload_length == 0) { // No payload to read
+        route_request(req_header, {});
+        return;
+    }
+
+    // Only one payload is read at a time; once read, the request takes the buffer with it (with
+    // pipelining, earlier requests may still be executing) and the next read borrows a fresh one.
+    payload_buffer_ = BufferPool::local().acquire(req_header.payload_length);
+    payload_buffer_.resize(req_header.payload_length);
     auto self = shared_from_this();
-    boost::asio::async_read(socket_, boost::asio::buffer(payload_read_buffer_),
+    boost::asio::async_read(socket_, boost::asio::buffer(payload_buffer_),
         [this, self, req_header](boost::system::error_code ec, std::size_t length) {
         if (!ec) {
             if (length != req_header.payload_length) {
-                std::cerr << "Session " << socket_.remote_endpoint() << ": Read incomplete payload. Expected " 
+                std::cerr << "Session " << peer_ << ": Read incomplete payload. Expected " 
                           << req_header.payload_length << " got " << length << std::endl;
                 return; // Connection error, session ends
             }
-            handle_request(req_header, payload_read_buffer_);
+            route_request(req_header, std::move(payload_buffer_));
         } else {
              if (ec == boost::asio::error::eof) {
-                std::cout << "Session " << socket_.remote_endpoint() << ": Client closed connection during payload read." << std::endl;
+                std::cout << "Session " << peer_ << ": Client closed connection during payload read." << std::endl;
             } else {
-                std::cerr << "Session " << socket_.remote_endpoint() << ": Read payload error: " << ec.message() << std::endl;
+                std::cerr << "Session " << peer_ << ": Read payload error: " << ec.message() << std::endl;
             }
             // Connection closed or error, session ends.
         }
     });
 }
 
+void TcpSession::route_request(NetworkProtocol::RequestHeader req_header, std::vector<char> payload) {
+    uint64_t decompressed_bytes = 0;
+    if (req_header.flags & NetworkProtocol::FLAG_COMPRESSED) {
+        // Decoded here, before routing, since the shard is chosen from the payload's topic
+        auto codec = static_cast<NetworkProtocol::CompressionCodec>(codec_.load(std::memory_order_relaxed));
+        try {
+            if (codec == NetworkProtocol::CompressionCodec::NONE) {
+                throw std::runtime_error("Compressed request, but no codec was negotiated.");
+            }
+            BufferPool::Buffer plain = BufferPool::local().acquire();
+            Compression::decompress_payload(codec, payload.data(), payload.size(), plain,
+                                            compression_ ? compression_->max_decompressed_bytes : NetworkProtocol::MAX_PAYLOAD_SIZE);
+            BufferPool::local().release(std::move(payload));
+            payload = std::move(plain);
+            decompressed_bytes = payload.size();
+            req_header.flags &= static_cast<uint8_t>(~NetworkProtocol::FLAG_COMPRESSED);
+            req_header.payload_length = static_cast<uint32_t>(payload.size());
+        } catch (const std::exception& e) {
+            std::cerr << "Session " << peer_ << ": Invalid compressed request: " << e.what() << std::endl;
+            BufferPool::local().release(std::move(payload));
+            ++in_flight_;
+            send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_SERIALIZATION, e.what());
+            reading_paused_ = true;
+            serial_pending_ = !req_header.v2;
+            maybe_resume_reading();
+            return;
+        }
+    }
+
+    if (req_header.type == NetworkProtocol::CommandType::SUBSCRIPTION_CREDIT) {
+        // Flow control has no response, so it is applied here and reading simply continues
+        try {
+            add_subscription_credit(NetworkProtocol::SubscriptionCredit::deserialize(payload.data(), payload.size()));
+            BufferPool::local().release(std::move(payload));
+        } catch (const std::exception& e) {
+            std::cerr << "Session " << peer_ << ": Invalid subscription credit: " << e.what() << std::endl;
+            ++in_flight_;
+            send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_SERIALIZATION, e.what());
+            reading_paused_ = true;
+            serial_pending_ = !req_header.v2;
+            maybe_resume_reading();
+            return;
+        }
+        do_read_header();
+        return;
+    }
+
+    // Subscription state lives on the home shard, so SUBSCRIBE/UNSUBSCRIBE keep the default target
+    size_t target = home_shard_;
+    bool barrier = false; // Runs once every earlier request is done, and later ones wait for it
+    if (shards_) {
+        switch (req_header.type) {
+            // Every topic-keyed request payload starts with the topic name
+            case NetworkProtocol::CommandType::PRODUCE_REQUEST:
+            case NetworkProtocol::CommandType::CONSUME_REQUEST:
+            case NetworkProtocol::CommandType::GET_TOPIC_OFFSET_REQUEST:
+            case NetworkProtocol::CommandType::CREATE_TOPIC_REQUEST:
+                try {
+                    size_t offset = 0;
+                    target = topic_shard(NetworkProtocol::read_string_view_from_buffer(payload.data(), offset, payload.size()));
+                } catch (const std::exception&) {
+                    // Malformed payload; handle_request reports the decode error from the home shard
+                }
+                break;
+            // Batches naming a single topic run on its shard. Multi-topic batches run on the home shard,
+            // which is not ordered with the topics' shards, so they are run as a barrier instead.
+            case NetworkProtocol::CommandType::PRODUCE_BATCH_REQUEST:
+            case NetworkProtocol::CommandType::FETCH_REQUEST:
+                try {
+                    size_t offset = 0;
+                    if (payload.size() >= sizeof(uint32_t)) {
+                        if (NetworkProtocol::read_uint32_from_buffer(payload.data(), offset) == 1) {
+                            target = topic_shard(NetworkProtocol::read_string_view_from_buffer(payload.data(), offset, payload.size()));
+                        } else {
+                            barrier = true;
+                        }
+                    }
+                } catch (const std::exception&) {
+                    // Malformed payload; handle_request reports the decode error from the home shard
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Requests from one connection to one shard run in arrival order (the shard queues are FIFO), so
+    // produces to a topic keep their order even when pipelined; requests for different shards overlap.
+    // A barrier request keeps that order for every topic it names by waiting out earlier requests.
+    ++in_flight_;
+    decompressed_in_flight_ += decompressed_bytes;
+    auto self = shared_from_this();
+    ShardPool::Task task = [this, self, req_header, decompressed_bytes, payload = std::move(payload)]() mutable {
+        handle_request(req_header, payload);
+        BufferPool::local().release(std::move(payload));
+        if (decompressed_bytes > 0) {
+            post_home([this, self, decompressed_bytes]() {
+                decompressed_in_flight_ -= decompressed_bytes;
+                maybe_resume_reading();
+            });
+        }
+    };
+    if (barrier && in_flight_ > 1) {
+        deferred_request_ = std::move(task); // Dispatched by queue_response once it is the only one left
+    } else {
+        run_on_shard(target, std::move(task));
+    }
+
+    // v1 clients expect strict request/response alternation; v2 clients pipeline up to the cap.
+    // Nothing is read past a barrier until it has responded.
+    if (!req_header.v2 || barrier) {
+        serial_pending_ = true;
+    }
+    reading_paused_ = true;
+    maybe_resume_reading();
+}
+
+void TcpSession::maybe_resume_reading() {
+    if (!reading_paused_ || stop_reading_) return;
+    bool can_read = serial_pending_ ? (in_flight_ == 0)
+                                    : (in_flight_ < MAX_IN_FLIGHT_REQUESTS &&
+                                       decompressed_in_flight_ < MAX_IN_FLIGHT_DECOMPRESSED_BYTES);
+    if (can_read) {
+        reading_paused_ = false;
+        serial_pending_ = false;
+        do_read_header();
+    }
+}
+
 void TcpSession::handle_request(NetworkProtocol::RequestHeader req_header, const std::vector<char>& payload_data) {
     // Process the request based on req_header.type
     // Call event_queue_ methods, then send response
     // Example for PRODUCE:
     try {
         switch (req_header.type) {
+            // The hot requests are decoded as views into payload_data, so decoding doesn't allocate
             case NetworkProtocol::CommandType::PRODUCE_REQUEST: {
-                NetworkProtocol::ProduceRequest req = NetworkProtocol::ProduceRequest::deserialize(payload_data.data(), payload_data.size());
+                NetworkProtocol::ProduceRequestView req = NetworkProtocol::ProduceRequestView::parse(payload_data.data(), payload_data.size());
+                if (uint32_t throttle_ms = check_quota(req.topic_name, QuotaManager::Operation::PRODUCE, req.message_payload.size())) {
+                    send_throttled_response(req_header, throttle_ms);
+                    break;
+                }
                 uint64_t offset = event_queue_.produce(req.topic_name, req.message_payload);
-                
-                NetworkProtocol::ProduceResponse resp_payload_struct;
-                resp_payload_struct.offset = offset;
-                std::vector<char> resp_payload = resp_payload_struct.serialize();
-                
-                send_response(NetworkProtocol::CommandType::PRODUCE_RESPONSE, NetworkProtocol::StatusCode::SUCCESS, resp_payload);
+
+                std::vector<char> frame;
+                begin_response(frame, req_header);
+                NetworkProtocol::ProduceResponse{offset}.serialize_into(frame);
+                finish_response(std::move(frame), req_header, NetworkProtocol::CommandType::PRODUCE_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
                 break;
             }
             case NetworkProtocol::CommandType::CONSUME_REQUEST: {
-                NetworkProtocol::ConsumeRequest req = NetworkProtocol::ConsumeRequest::deserialize(payload_data.data(), payload_data.size());
-                std::vector<Message> messages = event_queue_.consume(req.topic_name, req.start_offset, req.max_messages);
-                
-                NetworkProtocol::ConsumeResponse resp_payload_struct;
-                resp_payload_struct.messages = std::move(messages); // Assuming Message struct is compatible
-                std::vector<char> resp_payload = resp_payload_struct.serialize();
-
-                send_response(NetworkProtocol::CommandType::CONSUME_RESPONSE, NetworkProtocol::StatusCode::SUCCESS, resp_payload);
+                NetworkProtocol::ConsumeRequestView req = NetworkProtocol::ConsumeRequestView::parse(payload_data.data(), payload_data.size());
+                // Response bytes are charged in finish_consume, once known
+                if (uint32_t throttle_ms = check_quota(req.topic_name, QuotaManager::Operation::CONSUME)) {
+                    send_throttled_response(req_header, throttle_ms);
+                    break;
+                }
+                if (req.max_wait_ms > 0) {
+                    // The timer belongs to the session, so the long-poll is armed from the home shard.
+                    // The request outlives payload_data here, so it takes its own copy of the topic name.
+                    auto self = shared_from_this();
+                    run_on_shard(home_shard_, [this, self, req_header, req = NetworkProtocol::ConsumeRequest::from_view(req)]() mutable {
+                        start_long_poll_consume(req_header, std::move(req)); // Responds asynchronously
+                    });
+                } else {
+                    finish_consume(req_header, req);
+                }
                 break;
             }
             case NetworkProtocol::CommandType::GET_TOPIC_OFFSET_REQUEST: {
                  // Similar deserialization for topic name
                  size_t offset = 0;
-                 std::string topic_name = NetworkProtocol::read_string_from_buffer(payload_data.data(), offset, payload_data.size());
+                 std::string_view topic_name = NetworkProtocol::read_string_view_from_buffer(payload_data.data(), offset, payload_data.size());
+                 if (uint32_t throttle_ms = check_quota(topic_name, QuotaManager::Operation::OTHER)) {
+                     send_throttled_response(req_header, throttle_ms);
+                     break;
+                 }
 
                  uint64_t next_offset = event_queue_.get_next_topic_offset(topic_name);
-                 std::vector<char> resp_payload;
-                 NetworkProtocol::write_uint64_to_buffer(resp_payload, next_offset);
-                 send_response(NetworkProtocol::CommandType::GET_TOPIC_OFFSET_RESPONSE, NetworkProtocol::StatusCode::SUCCESS, resp_payload);
+                 std::vector<char> frame;
+                 begin_response(frame, req_header);
+                 NetworkProtocol::write_uint64_to_buffer(frame, next_offset);
+                 finish_response(std::move(frame), req_header, NetworkProtocol::CommandType::GET_TOPIC_OFFSET_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
                 break;
             }
              case NetworkProtocol::CommandType::CREATE_TOPIC_REQUEST: {
                  size_t offset = 0;
-                 std::string topic_name = NetworkProtocol::read_string_from_buffer(payload_data.data(), offset, payload_data.size());
+                 std::string_view topic_name = NetworkProtocol::read_string_view_from_buffer(payload_data.data(), offset, payload_data.size());
+                 if (uint32_t throttle_ms = check_quota(topic_name, QuotaManager::Operation::OTHER)) {
+                     send_throttled_response(req_header, throttle_ms);
+                     break;
+                 }
                  bool success = event_queue_.create_topic(topic_name);
                  if(success) {
-                    send_response(NetworkProtocol::CommandType::CREATE_TOPIC_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
+                    send_response(req_header, NetworkProtocol::CommandType::CREATE_TOPIC_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
                  } else {
-                    send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER, "Failed to create topic.");
+                    send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER, "Failed to create topic.");
                  }
                 break;
             }
             case NetworkProtocol::CommandType::LIST_TOPICS_REQUEST: {
+                if (uint32_t throttle_ms = check_quota("", QuotaManager::Operation::OTHER)) {
+                    send_throttled_response(req_header, throttle_ms);
+                    break;
+                }
                 std::vector<std::string> topics = event_queue_.list_topics();
                 std::vector<char> resp_payload;
                 NetworkProtocol::write_uint32_to_buffer(resp_payload, static_cast<uint32_t>(topics.size()));
                 for(const auto& t_name : topics) {
                     NetworkProtocol::write_string_to_buffer(resp_payload, t_name);
                 }
-                send_response(NetworkProtocol::CommandType::LIST_TOPICS_RESPONSE, NetworkProtocol::StatusCode::SUCCESS, resp_payload);
+                send_response(req_header, NetworkProtocol::CommandType::LIST_TOPICS_RESPONSE, NetworkProtocol::StatusCode::SUCCESS, resp_payload);
+                break;
+            }
+            case NetworkProtocol::CommandType::HANDSHAKE_REQUEST: {
+                NetworkProtocol::HandshakeRequest req = NetworkProtocol::HandshakeRequest::deserialize(payload_data.data(), payload_data.size());
+                NetworkProtocol::HandshakeResponse resp;
+                if (compression_) {
+                    resp.codec = Compression::negotiate(*compression_, req.codecs);
+                    resp.compression_threshold = compression_->threshold_bytes;
+                }
+                // Applies to frames handled after this one; clients handshake before pipelining anything else
+                codec_.store(static_cast<uint8_t>(resp.codec), std::memory_order_relaxed);
+                std::vector<char> frame;
+                begin_response(frame, req_header);
+                resp.serialize_into(frame);
+                finish_response(std::move(frame), req_header, NetworkProtocol::CommandType::HANDSHAKE_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
+                std::cout << "Session " << peer_ << ": Negotiated compression '"
+                          << Compression::codec_name(resp.codec) << "'." << std::endl;
+                break;
+            }
+            case NetworkProtocol::CommandType::PRODUCE_BATCH_REQUEST: {
+                NetworkProtocol::ProduceBatchRequestView req = NetworkProtocol::ProduceBatchRequestView::parse(payload_data.data(), payload_data.size());
+                if (req.topic_count() == 0) {
+                    send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INVALID_REQUEST, "Batch cannot be empty.");
+                    break;
+                }
+                // Reused per thread, like the consume buffer, so the payload views stop allocating once warm
+                thread_local std::vector<std::string_view> payloads;
+                NetworkProtocol::ProduceBatchResponse resp;
+                resp.results.reserve(req.topic_count());
+                req.for_each_topic([&](const NetworkProtocol::ProduceBatchRequestView::TopicBatch& batch) {
+                    NetworkProtocol::ProduceBatchResponse::TopicResult result;
+                    result.topic_name = std::string(batch.topic_name);
+                    // Each topic is admitted, appended and reported on its own, so one bad topic doesn't fail the rest
+                    try {
+                        if (uint32_t throttle_ms = check_quota(batch.topic_name, QuotaManager::Operation::PRODUCE, batch.payload_bytes())) {
+                            result.status = NetworkProtocol::StatusCode::ERROR_THROTTLED;
+                            result.throttle_ms = throttle_ms;
+                        } else {
+                            payloads.clear();
+                            batch.for_each_payload([](std::string_view payload) { payloads.push_back(payload); });
+                            result.base_offset = event_queue_.produce_batch(batch.topic_name, payloads);
+                            result.count = batch.message_count;
+                        }
+                    } catch (const std::invalid_argument& e) {
+                        std::cerr << "Session " << peer_ << ": Invalid batch for topic '" << batch.topic_name << "': " << e.what() << std::endl;
+                        result.status = NetworkProtocol::StatusCode::ERROR_INVALID_REQUEST;
+                    } catch (const std::exception& e) {
+                        std::cerr << "Session " << peer_ << ": Batch produce to topic '" << batch.topic_name << "' failed: " << e.what() << std::endl;
+                        result.status = NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER;
+                    }
+                    resp.results.push_back(std::move(result));
+                });
+                payloads.clear(); // Don't keep views into payload_data past this request
+                send_response(req_header, NetworkProtocol::CommandType::PRODUCE_BATCH_RESPONSE, NetworkProtocol::StatusCode::SUCCESS, resp.serialize());
+                break;
+            }
+            case NetworkProtocol::CommandType::FETCH_REQUEST: {
+                NetworkProtocol::FetchRequestView req = NetworkProtocol::FetchRequestView::parse(payload_data.data(), payload_data.size());
+                finish_fetch(req_header, req);
+                break;
+            }
+            case NetworkProtocol::CommandType::SUBSCRIBE_REQUEST: {
+                NetworkProtocol::SubscribeRequest req = NetworkProtocol::SubscribeRequest::deserialize(payload_data.data(), payload_data.size());
+                handle_subscribe(req_header, req);
+                break;
+            }
+            case NetworkProtocol::CommandType::UNSUBSCRIBE_REQUEST: {
+                size_t offset = 0;
+                handle_unsubscribe(req_header, NetworkProtocol::read_string_view_from_buffer(payload_data.data(), offset, payload_data.size()));
                 break;
             }
             // ... other command types
             default:
-                std::cerr << "Session " << socket_.remote_endpoint() << ": Unknown command type: " << static_cast<int>(req_header.type) << std::endl;
-                send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_UNKNOWN_COMMAND, "Unknown command type.");
+                std::cerr << "Session " << peer_ << ": Unknown command type: " << static_cast<int>(req_header.type) << std::endl;
+                send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_UNKNOWN_COMMAND, "Unknown command type.");
                 break;
         }
     } catch (const std::invalid_argument& e) {
-        std::cerr << "Session " << socket_.remote_endpoint() << ": Invalid argument: " << e.what() << std::endl;
-        send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_INVALID_REQUEST, e.what());
+        std::cerr << "Session " << peer_ << ": Invalid argument: " << e.what() << std::endl;
+        send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INVALID_REQUEST, e.what());
     } catch (const std::runtime_error& e) { // Catch serialization/deserialization errors or other EQ errors
-        std::cerr << "Session " << socket_.remote_endpoint() << ": Runtime error: " << e.what() << std::endl;
+        std::cerr << "Session " << peer_ << ": Runtime error: " << e.what() << std::endl;
         // Determine if it's a client-side (serialization) or server-side error
         // For now, generic internal server error, or could be more specific.
         if (std::string(e.what()).find("consume entire payload") != std::string::npos ||
             std::string(e.what()).find("String length exceeds") != std::string::npos ||
             std::string(e.what()).find("Reported string length") != std::string::npos) {
-            send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_SERIALIZATION, e.what());
+            send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_SERIALIZATION, e.what());
         } else if (std::string(e.what()).find("Topic not found") != std::string::npos) {
-             send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_TOPIC_NOT_FOUND, e.what());
+             send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_TOPIC_NOT_FOUND, e.what());
         }
         else {
-            send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER, e.what());
+            send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER, e.what());
         }
     } catch (const std::exception& e) {
-        std::cerr << "Session " << socket_.remote_endpoint() << ": Unhandled exception: " << e.what() << std::endl;
-        send_error_response(req_header.type, NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER, "An unexpected error occurred.");
+        std::cerr << "Session " << peer_ << ": Unhandled exception: " << e.what() << std::endl;
+        send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER, "An unexpected error occurred.");
     }
-    // After handling, read the next header
-    // do_read_header(); // This is crucial to keep the session alive for more requests
+    // The next header is read by route_request (v2) or once this response is queued (v1)
 }
 
+void TcpSession::finish_consume(const NetworkProtocol::RequestHeader& req_header, const NetworkProtocol::ConsumeRequestView& req) {
+    // Reused per thread so message strings keep their capacity; requests of one session may run on several shards
+    thread_local std::vector<Message> consume_buffer;
+
+    uint32_t max_bytes = (req.max_bytes == 0) ? NetworkProtocol::MAX_CONSUME_RESPONSE_BYTES
+                                              : std::min(req.max_bytes, NetworkProtocol::MAX_CONSUME_RESPONSE_BYTES);
+    event_queue_.consume_into(req.topic_name, req.start_offset, req.max_messages, max_bytes, consume_buffer);
+
+    std::vector<char> frame;
+    begin_response(frame, req_header, NetworkProtocol::ConsumeResponse::encoded_size(consume_buffer));
+    size_t header_size = frame.size();
+    NetworkProtocol::ConsumeResponse::serialize_messages(frame, consume_buffer);
+    if (quotas_) {
+        quotas_->record(client_id_, req.topic_name, QuotaManager::Operation::CONSUME, frame.size() - header_size);
+    }
+    finish_response(std::move(frame), req_header, NetworkProtocol::CommandType::CONSUME_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
+}
+
+void TcpSession::finish_fetch(const NetworkProtocol::RequestHeader& req_header, const NetworkProtocol::FetchRequestView& req) {
+    thread_local std::vector<Message> fetch_buffer;
+
+    std::vector<char> frame;
+    begin_response(frame, req_header);
+    NetworkProtocol::write_uint32_to_buffer(frame, req.entry_count());
+    // Shared byte budget across entries; once spent, later entries come back empty (the client refetches them)
+    uint64_t remaining = NetworkProtocol::MAX_CONSUME_RESPONSE_BYTES;
+    req.for_each_entry([&](const NetworkProtocol::FetchRequestView::Entry& entry) {
+        NetworkProtocol::StatusCode status = NetworkProtocol::StatusCode::SUCCESS;
+        uint64_t next_offset = 0;
+        fetch_buffer.clear();
+        try {
+            if (check_quota(entry.topic_name, QuotaManager::Operation::CONSUME) > 0) {
+                // Per-entry status only; the client backs off and refetches
+                status = NetworkProtocol::StatusCode::ERROR_THROTTLED;
+            } else {
+                next_offset = event_queue_.get_next_topic_offset(entry.topic_name);
+                uint64_t budget = (entry.max_bytes == 0) ? remaining : std::min<uint64_t>(entry.max_bytes, remaining);
+                if (budget > 0) {
+                    event_queue_.consume_into(entry.topic_name, entry.start_offset, std::numeric_limits<uint32_t>::max(),
+                                              budget, fetch_buffer);
+                }
+            }
+        } catch (const std::invalid_argument&) {
+            status = NetworkProtocol::StatusCode::ERROR_INVALID_REQUEST;
+        } catch (const std::exception& e) {
+            std::cerr << "Session " << peer_ << ": Fetch from topic '" << entry.topic_name << "' failed: " << e.what() << std::endl;
+            status = NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER;
+            fetch_buffer.clear();
+        }
+
+        size_t entry_start = frame.size();
+        NetworkProtocol::FetchResponse::serialize_entry(frame, entry.topic_name, status, next_offset, fetch_buffer);
+        size_t entry_bytes = frame.size() - entry_start;
+        remaining -= std::min<uint64_t>(remaining, entry_bytes);
+        if (quotas_ && status == NetworkProtocol::StatusCode::SUCCESS) {
+            quotas_->record(client_id_, entry.topic_name, QuotaManager::Operation::CONSUME, entry_bytes);
+        }
+    });
+    finish_response(std::move(frame), req_header, NetworkProtocol::CommandType::FETCH_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
+}
+
+void TcpSession::handle_subscribe(const NetworkProtocol::RequestHeader& req_header, const NetworkProtocol::SubscribeRequest& req) {
+    if (!sub_manager_) {
+        send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INVALID_REQUEST, "Subscriptions are not available.");
+        return;
+    }
+    if (req.topic_name.empty()) {
+        throw std::invalid_argument("Topic name cannot be empty.");
+    }
+    if (uint32_t throttle_ms = check_quota(req.topic_name, QuotaManager::Operation::CONSUME)) {
+        send_throttled_response(req_header, throttle_ms);
+        return;
+    }
+
+    // A repeated SUBSCRIBE for the topic replaces the previous subscription
+    Subscription& sub = subscriptions_[req.topic_name];
+    sub.push_header = req_header;
+    sub.generation = ++subscription_generation_;
+    sub.next_offset = req.start_offset;
+    sub.credit = req.credit_bytes;
+    sub.reading = false;
+    sub.behind = true; // Catch up on whatever is already in the log
+
+    std::weak_ptr<TcpSession> weak_self = shared_from_this();
+    MessageDeliveryCallback delivery_cb = [weak_self](const NotificationBatchPtr& batch) {
+        if (auto self = weak_self.lock()) {
+            self->on_subscribed_messages(batch->topic(), batch->messages());
+        }
+    };
+    // The socket's executor is the session strand (on the home shard when sharded)
+    sub_manager_->subscribe(req.topic_name, subscriber_id_, req.start_offset, socket_.get_executor(), std::move(delivery_cb));
+
+    std::vector<char> resp_payload;
+    NetworkProtocol::write_uint64_to_buffer(resp_payload, event_queue_.get_next_topic_offset(req.topic_name));
+    send_response(req_header, NetworkProtocol::CommandType::SUBSCRIBE_RESPONSE, NetworkProtocol::StatusCode::SUCCESS, resp_payload);
+    pump_subscription(req.topic_name);
+}
+
+void TcpSession::handle_unsubscribe(const NetworkProtocol::RequestHeader& req_header, std::string_view topic_name) {
+    auto it = subscriptions_.find(topic_name);
+    if (!sub_manager_ || it == subscriptions_.end()) {
+        send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INVALID_REQUEST, "Not subscribed to topic.");
+        return;
+    }
+    subscriptions_.erase(it);
+    sub_manager_->unsubscribe(std::string(topic_name), subscriber_id_);
+    send_response(req_header, NetworkProtocol::CommandType::UNSUBSCRIBE_RESPONSE, NetworkProtocol::StatusCode::SUCCESS);
+}
+
+void TcpSession::add_subscription_credit(const NetworkProtocol::SubscriptionCredit& credit) {
+    auto it = subscriptions_.find(credit.topic_name);
+    if (it == subscriptions_.end()) return; // Credit racing an unsubscribe; nothing to do
+    it->second.credit += credit.credit_bytes;
+    pump_subscription(credit.topic_name);
+}
 
-void TcpSession::send_response(NetworkProtocol::CommandType response_cmd_type,
+void TcpSession::on_subscribed_messages(const std::string& topic_name, const std::vector<Message>& messages) {
+    auto it = subscriptions_.find(topic_name);
+    if (it == subscriptions_.end() || messages.empty()) return;
+    Subscription& sub = it->second;
+
+    // Fast path: caught up and within credit, so the live messages go out without touching the log.
+    // A batch of several messages must fit the credit; only a single message may overdraw it.
+    if (!sub.reading && !sub.behind && sub.credit > 0 && messages.front().offset == sub.next_offset &&
+        (messages.size() == 1 || NetworkProtocol::ConsumeResponse::encoded_size(messages) <= sub.credit)) {
+        push_messages(topic_name, messages);
+        return;
+    }
+    if (messages.back().offset >= sub.next_offset) {
+        sub.behind = true; // Picked up from the log once credit (or the pending read) allows
+        pump_subscription(topic_name);
+    }
+}
+
+void TcpSession::pump_subscription(const std::string& topic_name) {
+    auto it = subscriptions_.find(topic_name);
+    if (it == subscriptions_.end()) return;
+    Subscription& sub = it->second;
+    if (sub.reading || !sub.behind || sub.credit == 0) return;
+
+    sub.reading = true;
+    sub.behind = false;
+    uint64_t generation = sub.generation;
+    uint64_t start_offset = sub.next_offset;
+    uint64_t budget = std::min<uint64_t>(sub.credit, NetworkProtocol::MAX_PUSH_BATCH_BYTES);
+
+    auto self = shared_from_this();
+    run_on_shard(topic_shard(topic_name), [this, self, topic_name, generation, start_offset, budget]() {
+        std::vector<Message> messages;
+        bool failed = false;
+        try {
+            event_queue_.consume_into(topic_name, start_offset, std::numeric_limits<uint32_t>::max(), budget, messages);
+        } catch (const std::exception& e) {
+            std::cerr << "Session " << peer_ << ": Subscription read from topic '" << topic_name << "' failed: " << e.what() << std::endl;
+            failed = true;
+        }
+        post_home([this, self, topic_name, generation, start_offset, failed, messages = std::move(messages)]() {
+            auto found = subscriptions_.find(topic_name);
+            if (found == subscriptions_.end() || found->second.generation != generation) return; // Unsubscribed meanwhile
+            Subscription& current = found->second;
+            if (failed) {
+                retry_subscription(topic_name);
+                return;
+            }
+            current.reading = false;
+            current.retry_delay = std::chrono::milliseconds(0);
+            if (!messages.empty() && start_offset == current.next_offset) {
+                push_messages(topic_name, messages);
+                current.behind = true; // The read may have stopped at the budget; an empty read ends the catch-up
+            }
+            pump_subscription(topic_name);
+        });
+    });
+}
+
+void TcpSession::retry_subscription(const std::string& topic_name) {
+    Subscription& sub = subscriptions_.at(topic_name);
+    // Still behind, and `reading` stays set so nothing else reads the log until the timer fires
+    sub.behind = true;
+    sub.retry_delay = std::clamp(sub.retry_delay * 2, SUBSCRIPTION_RETRY_MIN, SUBSCRIPTION_RETRY_MAX);
+    uint64_t generation = sub.generation;
+
+    auto timer = std::make_shared<boost::asio::steady_timer>(socket_.get_executor(), sub.retry_delay);
+    std::weak_ptr<TcpSession> weak_self = shared_from_this();
+    timer->async_wait([weak_self, timer, topic_name, generation](boost::system::error_code /*ec*/) {
+        auto self = weak_self.lock();
+        if (!self) return;
+        auto it = self->subscriptions_.find(topic_name);
+        if (it == self->subscriptions_.end() || it->second.generation != generation) return;
+        it->second.reading = false;
+        self->pump_subscription(topic_name);
+    });
+}
+
+void TcpSession::push_messages(const std::string& topic_name, const std::vector<Message>& messages) {
+    Subscription& sub = subscriptions_.at(topic_name);
+
+    std::vector<char> frame;
+    begin_response(frame, sub.push_header,
+                   sizeof(uint16_t) + topic_name.size() + NetworkProtocol::ConsumeResponse::encoded_size(messages));
+    NetworkProtocol::write_string_to_buffer(frame, topic_name);
+    size_t messages_start = frame.size();
+    NetworkProtocol::ConsumeResponse::serialize_messages(frame, messages);
+    uint64_t bytes = frame.size() - messages_start - sizeof(uint32_t); // Record bytes, as the credit counts them (uncompressed)
+
+    // The first message always goes out, so a message larger than the remaining credit can't stall the subscription
+    sub.credit -= std::min(sub.credit, bytes);
+    sub.next_offset = messages.back().offset + 1;
+    if (quotas_) {
+        quotas_->record(client_id_, topic_name, QuotaManager::Operation::CONSUME, bytes);
+    }
+
+    uint8_t flags = compress_frame(frame, sub.push_header);
+    patch_response_header(frame, sub.push_header, NetworkProtocol::CommandType::MESSAGE_PUSH, NetworkProtocol::StatusCode::SUCCESS, flags);
+    queue_frame(std::move(frame));
+}
+
+void TcpSession::start_long_poll_consume(NetworkProtocol::RequestHeader req_header, NetworkProtocol::ConsumeRequest req) {
+    auto self = shared_from_this();
+    auto poll = std::make_shared<LongPoll>(socket_.get_executor());
+    const size_t owner = topic_shard(req.topic_name);
+
+    // Arm the timer first so a wake-up arriving before the waiter id is known can still cut it short.
+    poll->timer.expires_after(std::chrono::milliseconds(std::min(req.max_wait_ms, NetworkProtocol::MAX_CONSUME_WAIT_MS)));
+    poll->timer.async_wait([this, self, poll, req_header, req, owner](boost::system::error_code /*ec*/) {
+        // Either the timer expired or a waiter cancelled it; in both cases answer with whatever is available.
+        run_on_shard(owner, [this, self, poll, req_header, req]() {
+            event_queue_.cancel_wait(req.topic_name, poll->waiter_id);
+            try {
+                finish_consume(req_header, req.view());
+            } catch (const std::exception& e) {
+                std::cerr << "Session " << peer_ << ": Long-poll consume error: " << e.what() << std::endl;
+                send_error_response(req_header, NetworkProtocol::StatusCode::ERROR_INTERNAL_SERVER, e.what());
+            }
+        });
+    });
+
+    // Hops back onto the home shard (or strand) and cuts the timer short, unless the poll has already finished.
+    std::weak_ptr<TcpSession> weak_self = self;
+    std::weak_ptr<LongPoll> weak_poll = poll;
+    auto wake = [weak_self, weak_poll]() {
+        if (auto s = weak_self.lock()) {
+            s->post_home([weak_poll]() {
+                if (auto p = weak_poll.lock()) {
+                    p->timer.cancel();
+                }
+            });
+        }
+    };
+    run_on_shard(owner, [this, self, poll, req = std::move(req), wake]() {
+        try {
+            // The waiter fires on the producing thread
+            poll->waiter_id = event_queue_.wait_for_messages_async(req.topic_name, req.start_offset, req.min_bytes, wake);
+        } catch (const std::exception& e) {
+            std::cerr << "Session " << peer_ << ": Long-poll registration error: " << e.what() << std::endl;
+            poll->waiter_id = 0;
+        }
+        if (poll->waiter_id == 0) { // Data already there (or nothing to wait on)
+            wake();
+        }
+    });
+}
+
+void TcpSession::send_response(const NetworkProtocol::RequestHeader& req_header,
+                               NetworkProtocol::CommandType response_cmd_type,
                                NetworkProtocol::StatusCode status,
                                const std::vector<char>& payload) {
+    std::vector<char> frame;
+    begin_response(frame, req_header, payload.size());
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    finish_response(std::move(frame), req_header, response_cmd_type, status);
+}
+
+void TcpSession::begin_response(std::vector<char>& frame, const NetworkProtocol::RequestHeader& req_header,
+                                size_t payload_size_hint) {
+    size_t header_size = req_header.v2 ? NetworkProtocol::ResponseHeader::SIZE + NetworkProtocol::ResponseHeader::EXTENSION_SIZE
+                                       : NetworkProtocol::ResponseHeader::SIZE;
+    // Frames come from the pool and go back to it once written (see do_write)
+    frame = BufferPool::local().acquire(header_size + payload_size_hint);
+    // Placeholder for the header; finish_response patches it once the payload length is known
+    frame.assign(header_size, 0);
+}
+
+void TcpSession::patch_response_header(std::vector<char>& frame, const NetworkProtocol::RequestHeader& req_header,
+                                       NetworkProtocol::CommandType response_cmd_type,
+                                       NetworkProtocol::StatusCode status, uint8_t flags) {
     NetworkProtocol::ResponseHeader resp_header;
     resp_header.type = response_cmd_type;
     resp_header.status = status;
-    resp_header.payload_length = static_cast<uint32_t>(payload.size());
+    resp_header.v2 = req_header.v2;
+    resp_header.flags = flags;
+    resp_header.correlation_id = req_header.correlation_id;
+    resp_header.payload_length = static_cast<uint32_t>(frame.size() - resp_header.size());
+    resp_header.serialize_into(frame.data());
+}
+
+void TcpSession::finish_response(std::vector<char> frame, const NetworkProtocol::RequestHeader& req_header,
+                                 NetworkProtocol::CommandType response_cmd_type,
+                                 NetworkProtocol::StatusCode status) {
+    uint8_t flags = compress_frame(frame, req_header);
+    patch_response_header(frame, req_header, response_cmd_type, status, flags);
 
-    std::vector<char> header_bytes = resp_header.serialize();
-    
-    std::vector<boost::asio::const_buffer> buffers_to_send;
-    buffers_to_send.push_back(boost::asio::buffer(header_bytes));
-    if (!payload.empty()) {
-        buffers_to_send.push_back(boost::asio::buffer(payload));
+    if (status == NetworkProtocol::StatusCode::SUCCESS) {
+        std::cout << "Session " << peer_ << ": Queued response type " << static_cast<int>(response_cmd_type) << ", status SUCCESS." << std::endl;
+    } else {
+        std::cout << "Session " << peer_ << ": Queued response type " << static_cast<int>(response_cmd_type) << ", status ERROR " << static_cast<int>(status) << "." << std::endl;
     }
+    queue_response(std::move(frame));
+}
+
+uint8_t TcpSession::compress_frame(std::vector<char>& frame, const NetworkProtocol::RequestHeader& req_header) {
+    if (!req_header.v2 || !compression_) return 0; // v1 headers have no flags byte
+    auto codec = static_cast<NetworkProtocol::CompressionCodec>(codec_.load(std::memory_order_relaxed));
+    if (codec == NetworkProtocol::CompressionCodec::NONE) return 0;
+    const size_t header_size = NetworkProtocol::ResponseHeader::SIZE + NetworkProtocol::ResponseHeader::EXTENSION_SIZE;
+    const size_t payload_size = frame.size() - header_size;
+    if (payload_size < compression_->threshold_bytes) return 0;
+
+    BufferPool::Buffer compressed = BufferPool::local().acquire(frame.size());
+    compressed.assign(header_size, 0);
+    if (!Compression::compress_payload(codec, compression_->level, frame.data() + header_size, payload_size, compressed)) {
+        BufferPool::local().release(std::move(compressed));
+        return 0; // Incompressible; sent as is
+    }
+    BufferPool::local().release(std::move(frame));
+    frame = std::move(compressed);
+    return NetworkProtocol::FLAG_COMPRESSED;
+}
 
+void TcpSession::queue_response(std::vector<char> frame) {
+    // The reply may have been built on the topic's shard; the socket is only written from its home shard
     auto self = shared_from_this();
-    boost::asio::async_write(socket_, buffers_to_send,
-        [this, self, response_cmd_type, status](boost::system::error_code ec, std::size_t /*length*/) {
+    run_on_shard(home_shard_, [this, self, frame = std::move(frame)]() mutable {
+        --in_flight_;
+        queue_frame(std::move(frame));
+        if (deferred_request_ && in_flight_ == 1) {
+            ShardPool::Task deferred = std::move(deferred_request_);
+            deferred_request_ = nullptr;
+            run_on_shard(home_shard_, std::move(deferred));
+        }
+        maybe_resume_reading();
+    });
+}
+
+void TcpSession::queue_frame(std::vector<char> frame) {
+    if (!socket_.is_open()) { // Closed after a write error; replies still in flight are dropped
+        BufferPool::local().release(std::move(frame));
+        return;
+    }
+    // Small frames are appended to the last queued one (never to frames already being written)
+    if (frame.size() <= COALESCE_FRAME_BYTES && !outbound_.empty()) {
+        auto& last = outbound_.back();
+        size_t merged_size = last.size() + frame.size();
+        if (merged_size <= COALESCE_MAX_BYTES) {
+            if (merged_size > last.capacity()) {
+                auto merged = BufferPool::local().acquire(COALESCE_MAX_BYTES);
+                merged.assign(last.begin(), last.end());
+                BufferPool::local().release(std::move(last));
+                last = std::move(merged);
+            }
+            last.insert(last.end(), frame.begin(), frame.end());
+            BufferPool::local().release(std::move(frame));
+            return;
+        }
+    }
+    outbound_.push_back(std::move(frame));
+    if (writing_.empty() && !flush_pending_) {
+        // Cork: the socket's strand runs the flush after the current handler, once it has queued everything
+        flush_pending_ = true;
+        auto self = shared_from_this();
+        boost::asio::post(socket_.get_executor(), [this, self]() { flush_outbound(); });
+    }
+}
+
+void TcpSession::flush_outbound() {
+    flush_pending_ = false;
+    if (writing_.empty() && !outbound_.empty()) {
+        do_write();
+    }
+}
+
+void TcpSession::do_write() {
+    // Take everything queued so far and send it with one gathered write
+    while (!outbound_.empty()) {
+        writing_.push_back(std::move(outbound_.front()));
+        outbound_.pop_front();
+    }
+    write_buffers_.clear();
+    for (const auto& frame : writing_) {
+        write_buffers_.push_back(boost::asio::buffer(frame));
+    }
+
+    auto self = shared_from_this();
+    // writing_ is a member, so the frames outlive the async write
+    boost::asio::async_write(socket_, write_buffers_,
+        [this, self](boost::system::error_code ec, std::size_t /*length*/) {
         if (!ec) {
-            // Successfully sent response, now wait for the next request from the client
-            if (status == NetworkProtocol::StatusCode::SUCCESS) {
-                 std::cout << "Session " << socket_.remote_endpoint() << ": Sent response type " << static_cast<int>(response_cmd_type) << ", status SUCCESS." << std::endl;
-            } else {
-                 std::cout << "Session " << socket_.remote_endpoint() << ": Sent response type " << static_cast<int>(response_cmd_type) << ", status ERROR " << static_cast<int>(status) << "." << std::endl;
+            for (auto& frame : writing_) {
+                BufferPool::local().release(std::move(frame));
+            }
+            writing_.clear();
+            if (!outbound_.empty()) {
+                do_write();
             }
-            do_read_header();
         } else {
-            std::cerr << "Session " << socket_.remote_endpoint() << ": Write response error: " << ec.message() << std::endl;
-            // Connection error, session ends.
+            std::cerr << "Session " << peer_ << ": Write response error: " << ec.message() << std::endl;
+            // Connection error, session ends: nothing queued can be delivered any more
+            stop_reading_ = true;
+            close_session();
         }
     });
 }
 
-void TcpSession::send_error_response(NetworkProtocol::CommandType original_request_type,
+void TcpSession::close_session() {
+    for (auto& frame : writing_) {
+        BufferPool::local().release(std::move(frame));
+    }
+    writing_.clear();
+    for (auto& frame : outbound_) {
+        BufferPool::local().release(std::move(frame));
+    }
+    outbound_.clear();
+    deferred_request_ = nullptr;
+    if (sub_manager_ && !subscriptions_.empty()) {
+        sub_manager_->unsubscribe_all(subscriber_id_);
+    }
+    subscriptions_.clear();
+    boost::system::error_code ec;
+    socket_.close(ec); // Fails the pending read, which lets the session end
+}
+
+void TcpSession::send_error_response(const NetworkProtocol::RequestHeader& req_header,
                                      NetworkProtocol::StatusCode status_code,
                                      const std::string& error_message) {
     NetworkProtocol::ErrorResponsePayload err_payload_struct;
     err_payload_struct.error_message = error_message;
     std::vector<char> err_payload_bytes = err_payload_struct.serialize();
 
-    send_response(NetworkProtocol::CommandType::ERROR_RESPONSE, status_code, err_payload_bytes);
-    // Note: The send_response itself will call do_read_header() if successful,
-    // so the session might continue or close depending on the error severity and client behavior.
-    // If the error is critical (e.g., payload too large, unknown command), you might want to explicitly close the socket.
+    send_response(req_header, NetworkProtocol::CommandType::ERROR_RESPONSE, status_code, err_payload_bytes);
+    // Note: the session keeps reading after an error response (unless the stream is out of sync),
+    // so the client may recover and send further requests.
+}
+
+uint32_t TcpSession::check_quota(std::string_view topic_name, QuotaManager::Operation op, uint64_t bytes) {
+    return quotas_ ? quotas_->admit(client_id_, topic_name, op, bytes) : 0;
+}
+
+void TcpSession::send_throttled_response(const NetworkProtocol::RequestHeader& req_header, uint32_t throttle_ms) {
+    // The request is rejected rather than queued; the client is expected to retry after throttle_ms
+    NetworkProtocol::ErrorResponsePayload err_payload_struct;
+    err_payload_struct.error_message = "Quota exceeded, retry after " + std::to_string(throttle_ms) + " ms.";
+    err_payload_struct.throttle_ms = throttle_ms;
+    send_response(req_header, NetworkProtocol::CommandType::ERROR_RESPONSE, NetworkProtocol::StatusCode::ERROR_THROTTLED,
+                  err_payload_struct.serialize());
+}
+
+size_t TcpSession::topic_shard(std::string_view topic_name) const {
+    return shards_ ? shards_->shard_for_topic(topic_name) : home_shard_;
+}
+
+void TcpSession::run_on_shard(size_t shard, ShardPool::Task task) {
+    if (shards_) {
+        shards_->dispatch(shard, std::move(task));
+    } else {
+        task(); // Shared mode: the caller is already on this session's strand
+    }
+}
+
+void TcpSession::post_home(ShardPool::Task task) {
+    if (shards_) {
+        shards_->dispatch(home_shard_, std::move(task));
+    } else {
+        boost::asio::post(socket_.get_executor(), std::move(task));
+    }
 }
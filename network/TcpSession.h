@@ -1,33 +1,151 @@
 // network/TcpSession.h
 #pragma once
 #include <boost/asio.hpp>
+#include <atomic>
+#include <deque>
+#include <map>
 #include <memory>
 #include <vector>
 #include "../event_queue_core/EventQueue.h" // The actual queue
 #include "NetworkProtocol.h"
+#include "ShardPool.h"
+#include "QuotaManager.h"
+#include "SubscriptionManager.h"
+#include "BufferPool.h"
+#include "Compression.h"
 
 using boost::asio::ip::tcp;
 
 class TcpSession : public std::enable_shared_from_this<TcpSession> {
 public:
-    TcpSession(tcp::socket socket, EventQueue& event_queue);
+    // With a ShardPool, the socket must live on shard `home_shard`'s io_context; topic-keyed requests
+    // are then executed on the topic's owning shard and the reply is written back from the home shard.
+    TcpSession(tcp::socket socket, EventQueue& event_queue, ShardPool* shards = nullptr, size_t home_shard = 0,
+               QuotaManager* quotas = nullptr, SubscriptionManager* sub_manager = nullptr,
+               const Compression::Settings* compression = nullptr);
+    ~TcpSession();
     void start();
 
+    // Upper bound on pipelined v2 requests awaiting a response; reading pauses at the limit
+    static constexpr size_t MAX_IN_FLIGHT_REQUESTS = 128;
+    // Reading also pauses while decompressed requests awaiting a response hold this many bytes
+    static constexpr uint64_t MAX_IN_FLIGHT_DECOMPRESSED_BYTES = 16 * 1024 * 1024;
+    // Queued frames up to this size are copied into the preceding queued frame instead of taking
+    // their own iovec, up to COALESCE_MAX_BYTES per merged frame
+    static constexpr size_t COALESCE_FRAME_BYTES = 4 * 1024;
+    static constexpr size_t COALESCE_MAX_BYTES = 64 * 1024;
+
 private:
     void do_read_header();
+    void do_read_header_extension(NetworkProtocol::RequestHeader req_header);
     void do_read_payload(NetworkProtocol::RequestHeader req_header);
+    // Runs handle_request on the shard owning the request's topic (inline when not sharded), then
+    // keeps reading if the request is a pipelined (v2) one
+    void route_request(NetworkProtocol::RequestHeader req_header, std::vector<char> payload);
     void handle_request(NetworkProtocol::RequestHeader req_header, const std::vector<char>& payload_buffer);
-    
-    void send_response(NetworkProtocol::CommandType response_type,
+    void maybe_resume_reading();
+
+    // Long-poll CONSUME: parks the request on the topic's waiter list and a timer instead of blocking the I/O thread
+    void start_long_poll_consume(NetworkProtocol::RequestHeader req_header, NetworkProtocol::ConsumeRequest req);
+    void finish_consume(const NetworkProtocol::RequestHeader& req_header, const NetworkProtocol::ConsumeRequestView& req);
+    // FETCH: reads every entry into one response under a shared byte budget
+    void finish_fetch(const NetworkProtocol::RequestHeader& req_header, const NetworkProtocol::FetchRequestView& req);
+
+    // Subscriptions (home shard only). Live messages from the SubscriptionManager are pushed straight
+    // through while the subscriber is caught up and has credit; otherwise the subscription is marked
+    // behind and pump_subscription() catches up from the log once credit allows.
+    void handle_subscribe(const NetworkProtocol::RequestHeader& req_header, const NetworkProtocol::SubscribeRequest& req);
+    void handle_unsubscribe(const NetworkProtocol::RequestHeader& req_header, std::string_view topic_name);
+    void add_subscription_credit(const NetworkProtocol::SubscriptionCredit& credit);
+    void on_subscribed_messages(const std::string& topic_name, const std::vector<Message>& messages);
+    void pump_subscription(const std::string& topic_name);
+    void retry_subscription(const std::string& topic_name); // After a failed log read, with backoff
+    void push_messages(const std::string& topic_name, const std::vector<Message>& messages);
+
+    void send_response(const NetworkProtocol::RequestHeader& req_header,
+                       NetworkProtocol::CommandType response_type,
                        NetworkProtocol::StatusCode status,
                        const std::vector<char>& payload = {});
-    void send_error_response(NetworkProtocol::CommandType original_request_type,
+    // Two-step variant for large replies: callers append the payload straight into `frame`
+    // between begin_response() and finish_response(), avoiding an intermediate payload vector.
+    static void begin_response(std::vector<char>& frame, const NetworkProtocol::RequestHeader& req_header,
+                               size_t payload_size_hint = 0);
+    void finish_response(std::vector<char> frame, const NetworkProtocol::RequestHeader& req_header,
+                         NetworkProtocol::CommandType response_type, NetworkProtocol::StatusCode status);
+    static void patch_response_header(std::vector<char>& frame, const NetworkProtocol::RequestHeader& req_header,
+                                      NetworkProtocol::CommandType response_type, NetworkProtocol::StatusCode status,
+                                      uint8_t flags = 0);
+    // Swaps a built frame's payload for its compressed form when a codec is negotiated, the reply is
+    // v2 and the payload reaches the threshold (and shrinks); returns the header flags to set
+    uint8_t compress_frame(std::vector<char>& frame, const NetworkProtocol::RequestHeader& req_header);
+    void send_error_response(const NetworkProtocol::RequestHeader& req_header,
                              NetworkProtocol::StatusCode status_code,
                              const std::string& error_message);
+    // Quota admission for this client (the peer address); returns the throttle delay, 0 if admitted
+    uint32_t check_quota(std::string_view topic_name, QuotaManager::Operation op, uint64_t bytes = 0);
+    void send_throttled_response(const NetworkProtocol::RequestHeader& req_header, uint32_t throttle_ms);
 
+    // Outbound queue (home shard only): completed responses are appended in completion order and
+    // everything queued while a write is in flight goes out in the next single gathered write.
+    // The socket runs with TCP_NODELAY; batching is done here instead. When no write is in flight the
+    // queue is corked until the current handler returns, so every frame produced in one turn of the
+    // strand (a pipelined burst, a subscription fan-out) shares the first syscall too.
+    void queue_response(std::vector<char> frame);
+    void queue_frame(std::vector<char> frame); // Home shard; also used for unsolicited pushes
+    void flush_outbound();
+    void do_write();
+    void close_session(); // After a write error: drops queued frames and subscriptions, closes the socket
+
+    // Shard helpers; without a ShardPool, run_on_shard runs inline and post_home posts to the session strand.
+    size_t topic_shard(std::string_view topic_name) const;
+    void run_on_shard(size_t shard, ShardPool::Task task);
+    void post_home(ShardPool::Task task);
+
+    // One parked long-poll; several can be outstanding on a pipelined connection
+    struct LongPoll {
+        explicit LongPoll(const tcp::socket::executor_type& executor) : timer(executor) {}
+        boost::asio::steady_timer timer; // Home shard only
+        uint64_t waiter_id = 0;          // Topic's shard only
+    };
 
     tcp::socket socket_;
     EventQueue& event_queue_; // Reference to the shared event queue
-    std::vector<char> read_buffer_; // For header
-    std::vector<char> payload_read_buffer_; // For payload
+    ShardPool* shards_; // Null in shared (non-sharded) execution mode
+    size_t home_shard_; // Shard running this session's socket and timers
+    QuotaManager* quotas_; // Null when quotas are disabled
+    SubscriptionManager* sub_manager_; // Null disables SUBSCRIBE
+    const Compression::Settings* compression_; // Null disables HANDSHAKE compression
+    std::atomic<uint8_t> codec_{0}; // Negotiated CompressionCodec; read on whichever shard builds a reply
+    std::string client_id_; // Quota identity: the peer's IP address
+    std::string peer_;      // "address:port" for logging; remote_endpoint() throws once the peer is gone
+    std::string subscriber_id_; // Unique per session, for the SubscriptionManager
+    std::vector<char> read_buffer_; // For header (and v2 extension)
+    BufferPool::Buffer payload_buffer_; // Payload being read; handed to the request once complete
+
+    // Reader/writer state, home shard only
+    size_t in_flight_ = 0;       // Requests dispatched whose response hasn't been queued yet
+    uint64_t decompressed_in_flight_ = 0; // Decoded payload bytes held by those requests
+    bool reading_paused_ = false; // Waiting on a v1 response or for in-flight requests to drain
+    bool serial_pending_ = false; // The paused read is behind a v1 request (resume at in_flight_ == 0)
+    bool stop_reading_ = false;   // Protocol error: flush queued responses, then let the session end
+    bool flush_pending_ = false;  // The outbound queue is corked and a flush is posted
+    ShardPool::Task deferred_request_; // A multi-topic batch waiting for earlier requests (sharded only)
+    std::deque<std::vector<char>> outbound_;     // Responses waiting for the next write
+    std::vector<std::vector<char>> writing_;     // Responses owned by the write in flight
+    std::vector<boost::asio::const_buffer> write_buffers_;
+
+    // Subscription state, home shard only
+    struct Subscription {
+        NetworkProtocol::RequestHeader push_header; // The SUBSCRIBE request; pushes echo its correlation id
+        uint64_t generation = 0;  // Distinguishes a re-subscribe from the one a pending log read was for
+        uint64_t next_offset = 0; // Next offset to push
+        uint64_t credit = 0;      // Bytes the subscriber will still accept
+        bool reading = false;     // A catch-up read from the log is in flight (or waiting to retry)
+        bool behind = false;      // Messages may exist at next_offset that haven't been pushed
+        std::chrono::milliseconds retry_delay{0}; // Backoff after a failed log read, reset by a good one
+    };
+    static constexpr std::chrono::milliseconds SUBSCRIPTION_RETRY_MIN{100};
+    static constexpr std::chrono::milliseconds SUBSCRIPTION_RETRY_MAX{5000};
+    std::map<std::string, Subscription, std::less<>> subscriptions_;
+    uint64_t subscription_generation_ = 0;
 };
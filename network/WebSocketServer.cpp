@@ -1,6 +1,7 @@
 // network/WebSocketServer.cpp
 #include "WebSocketServer.h"
 #include "WebSocketSession.h" // Include the session handler
+#include "ListenSocket.h"
 #include <iostream>
 
 WebSocketServer::WebSocketServer(
@@ -8,13 +9,20 @@ WebSocketServer::WebSocketServer(
     const std::string& address,
     unsigned short port,
     SubscriptionManager & sub_mgr,
-    EventQueue& queue)
+    EventQueue& queue,
+    QuotaManager* quotas,
+    size_t num_acceptors,
+    size_t max_outbound_bytes,
+    const Compression::WebSocketSettings* deflate)
     : ioc_(ioc),
-      acceptor_(net::make_strand(ioc)), // Create acceptor on a strand of the provided io_context
+      num_acceptors_(usable_acceptor_count(num_acceptors, "WebSocketServer")),
       event_queue_(queue),
       address_(address),
       sub_manager_(sub_mgr),
-      port_(port)
+      port_(port),
+      quotas_(quotas),
+      max_outbound_bytes_(max_outbound_bytes),
+      deflate_(deflate)
 {
     std::cout << "WebSocketServer: Initializing on io_context " << &ioc_ << std::endl;
 }
@@ -50,12 +58,14 @@ WebSocketServer::WebSocketServer(
 WebSocketServer::~WebSocketServer() {
     std::cout << "WebSocketServer: Destructor called." << std::endl;
     // `stop()` should ideally be called before destruction,
-    // but as a fallback, ensure acceptor is closed.
-    if (acceptor_.is_open()) {
-        beast::error_code ec;
-        acceptor_.close(ec); // Close synchronously
-        if (ec) {
-            std::cerr << "WebSocketServer: Error closing acceptor in destructor: " << ec.message() << std::endl;
+    // but as a fallback, ensure the acceptors are closed.
+    for (auto& acceptor : acceptors_) {
+        if (acceptor->is_open()) {
+            beast::error_code ec;
+            acceptor->close(ec); // Close synchronously
+            if (ec) {
+                std::cerr << "WebSocketServer: Error closing acceptor in destructor: " << ec.message() << std::endl;
+            }
         }
     }
 
@@ -80,46 +90,41 @@ bool WebSocketServer::run() {
         auto const ep_address = net::ip::make_address(address_);
         tcp::endpoint endpoint(ep_address, port_);
 
-        // Open the acceptor
-        beast::error_code ec;
-        acceptor_.open(endpoint.protocol(), ec);
-        if (ec) {
-            std::cerr << "WebSocketServer: Failed to open acceptor: " << ec.message() << std::endl;
-            return false;
-        }
-
-        // Allow address reuse
-        acceptor_.set_option(net::socket_base::reuse_address(true), ec);
-        if (ec) {
-            std::cerr << "WebSocketServer: Failed to set reuse_address: " << ec.message() << std::endl;
-            // Not necessarily fatal, but log it
-        }
-
-        // Bind to the server address
-        acceptor_.bind(endpoint, ec);
-        if (ec) {
-            std::cerr << "WebSocketServer: Failed to bind to " << address_ << ":" << port_ << " - " << ec.message() << std::endl;
-            return false;
+        // Open the acceptors (each on a strand of the provided io_context). Several listeners
+        // need SO_REUSEPORT to share the port; the kernel then load-balances accepts between them.
+        bool reuse_port = num_acceptors_ > 1;
+        for (size_t i = 0; i < num_acceptors_; ++i) {
+            auto acceptor = std::make_unique<tcp::acceptor>(net::make_strand(ioc_));
+            beast::error_code ec;
+            const char* failed_step = nullptr;
+            if (!open_listen_socket(*acceptor, endpoint, reuse_port, ec, failed_step)) {
+                std::cerr << "WebSocketServer: Failed to " << failed_step << " acceptor on " << address_ << ":" << port_
+                          << " - " << ec.message() << std::endl;
+                acceptors_.clear();
+                return false;
+            }
+            acceptors_.push_back(std::move(acceptor));
         }
 
-        // Start listening for connections
-        acceptor_.listen(net::socket_base::max_listen_connections, ec);
-        if (ec) {
-            std::cerr << "WebSocketServer: Failed to listen: " << ec.message() << std::endl;
-            return false;
+        std::cout << "WebSocketServer: Listening on " << address_ << ":" << port_;
+        if (reuse_port) std::cout << " (" << num_acceptors_ << " SO_REUSEPORT acceptors)";
+        if (deflate_ && deflate_->enabled) std::cout << " (permessage-deflate offered)";
+        std::cout << std::endl;
+        if (deflate_ && deflate_->enabled && deflate_->threshold_bytes > 0 &&
+            !WebSocketSession::deflate_threshold_supported()) {
+            std::cerr << "WebSocketServer: permessage_deflate.threshold_bytes needs Boost 1.81 or newer;"
+                      << " every message will be compressed." << std::endl;
         }
 
-        std::cout << "WebSocketServer: Listening on " << address_ << ":" << port_ << std::endl;
-        
         // Start accepting connections
         // We post this to ensure it runs on the acceptor's strand.
-        net::post(acceptor_.get_executor(),
-            beast::bind_front_handler(
-                &WebSocketServer::do_accept,
-                shared_from_this())); // Use shared_from_this if server itself is managed by shared_ptr
-                                     // Or `this` if server lifetime is managed otherwise and outlives async ops.
-                                     // For a top-level server object, `this` is often okay, but shared_from_this is safer for general components.
-                                     // Here, assuming WebSocketServer might be managed by a shared_ptr if it's part of a larger system.
+        for (auto& acceptor : acceptors_) {
+            net::post(acceptor->get_executor(),
+                beast::bind_front_handler(
+                    &WebSocketServer::do_accept,
+                    shared_from_this(), // The server is managed by a shared_ptr and must outlive the accepts
+                    acceptor.get()));
+        }
 
     } catch (const std::exception& e) {
         std::cerr << "WebSocketServer: Exception in run(): " << e.what() << std::endl;
@@ -130,19 +135,22 @@ bool WebSocketServer::run() {
 
 void WebSocketServer::stop() {
     // Post the stop logic to the io_context to ensure thread safety with acceptor operations.
-    // The strand of the acceptor is appropriate here.
-    net::post(acceptor_.get_executor(), [self = shared_from_this()]() { // Or `this`
-        if (self->acceptor_.is_open()) {
-            std::cout << "WebSocketServer: Stopping. Closing acceptor." << std::endl;
-            beast::error_code ec;
-            self->acceptor_.close(ec); // This will cause any pending async_accept to complete with an error.
-            if (ec) {
-                std::cerr << "WebSocketServer: Error closing acceptor: " << ec.message() << std::endl;
+    // The strand of each acceptor is appropriate here.
+    for (auto& acceptor_ptr : acceptors_) {
+        tcp::acceptor* acceptor = acceptor_ptr.get();
+        net::post(acceptor->get_executor(), [self = shared_from_this(), acceptor]() {
+            if (acceptor->is_open()) {
+                std::cout << "WebSocketServer: Stopping. Closing acceptor." << std::endl;
+                beast::error_code ec;
+                acceptor->close(ec); // This will cause any pending async_accept to complete with an error.
+                if (ec) {
+                    std::cerr << "WebSocketServer: Error closing acceptor: " << ec.message() << std::endl;
+                }
+            } else {
+                std::cout << "WebSocketServer: Stop called, but acceptor was not open." << std::endl;
             }
-        } else {
-            std::cout << "WebSocketServer: Stop called, but acceptor was not open." << std::endl;
-        }
-    });
+        });
+    }
 
     // If this server manages its own io_context and threads, you would stop the io_context here.
     // However, the provided constructor uses an external io_context.
@@ -155,16 +163,17 @@ void WebSocketServer::stop() {
 }
 
 
-void WebSocketServer::do_accept() {
+void WebSocketServer::do_accept(tcp::acceptor* acceptor) {
     // The new connection gets its own strand
-    acceptor_.async_accept(
+    acceptor->async_accept(
         net::make_strand(ioc_), // Each session will run on its own strand, but share the ioc_
         beast::bind_front_handler(
             &WebSocketServer::on_accept,
-            shared_from_this())); // Or `this`
+            shared_from_this(),
+            acceptor));
 }
 
-void WebSocketServer::on_accept(beast::error_code ec, tcp::socket socket) {
+void WebSocketServer::on_accept(tcp::acceptor* acceptor, beast::error_code ec, tcp::socket socket) {
     if (ec) {
         // operation_aborted typically means the acceptor was closed (e.g., server stopping)
         if (ec == net::error::operation_aborted) {
@@ -181,11 +190,12 @@ void WebSocketServer::on_accept(beast::error_code ec, tcp::socket socket) {
     // The session will take ownership of the socket
     std::cout << "WebSocketServer: New connection from " << socket.remote_endpoint() << std::endl;
     // std::make_shared<WebSocketSession>(std::move(socket), event_queue_)->run();
-    std::make_shared<WebSocketSession>(std::move(socket), event_queue_, sub_manager_, ioc_)->run();
+    std::make_shared<WebSocketSession>(std::move(socket), event_queue_, sub_manager_, ioc_, quotas_,
+                                       max_outbound_bytes_, deflate_)->run();
 
     // Continue accepting new connections if acceptor is still open
-    if (acceptor_.is_open()) {
-        do_accept();
+    if (acceptor->is_open()) {
+        do_accept(acceptor);
     } else {
         std::cout << "WebSocketServer: Acceptor closed, not accepting more connections." << std::endl;
     }
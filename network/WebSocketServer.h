@@ -11,6 +11,8 @@
 
 #include "../../event_queue_core/EventQueue.h" // The core queue logic
 #include "SubscriptionManager.h"
+#include "QuotaManager.h"
+#include "Compression.h"
 // WebSocketSession is included in the .cpp file to avoid circular dependencies if WebSocketSession
 // were to ever need something from WebSocketServer (not typical for this structure).
 
@@ -19,11 +21,16 @@ using tcp = net::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
 class WebSocketServer : public std::enable_shared_from_this<WebSocketServer> {
     net::io_context& ioc_; // Reference to an external io_context
-    tcp::acceptor acceptor_;
+    // One listener, or several SO_REUSEPORT listeners on the same port, each on its own strand
+    std::vector<std::unique_ptr<tcp::acceptor>> acceptors_;
+    size_t num_acceptors_;
     EventQueue& event_queue_;
     std::string address_;
     SubscriptionManager& sub_manager_;
     unsigned short port_;
+    QuotaManager* quotas_; // Null when quotas are disabled
+    size_t max_outbound_bytes_; // Per-session slow-consumer cap (0 = none)
+    const Compression::WebSocketSettings* deflate_; // permessage-deflate offer (null: none)
     
     // If the server manages its own io_context threads (optional)
     // std::vector<std::thread> io_threads_;
@@ -37,7 +44,11 @@ public:
                     const std::string& address,
                     unsigned short port,
                     SubscriptionManager& sub_mgr,
-                    EventQueue& queue);
+                    EventQueue& queue,
+                    QuotaManager* quotas = nullptr,
+                    size_t num_acceptors = 1,
+                    size_t max_outbound_bytes = 16 * 1024 * 1024,
+                    const Compression::WebSocketSettings* deflate = nullptr);
     
     // Alternative constructor if the server is to manage its own io_context and threads
     // WebSocketServer(const std::string& address,
@@ -55,6 +66,6 @@ public:
     void stop();
 
 private:
-    void do_accept();
-    void on_accept(boost::beast::error_code ec, tcp::socket socket);
+    void do_accept(tcp::acceptor* acceptor);
+    void on_accept(tcp::acceptor* acceptor, boost::beast::error_code ec, tcp::socket socket);
 };
\ No newline at end of file
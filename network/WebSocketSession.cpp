@@ -1,11 +1,58 @@
 // network/WebSocketSession.cpp
 #include "WebSocketSession.h"
 #include <boost/asio/bind_executor.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <sstream>      // For stringstream in session_id
 #include <iomanip>      // For setfill, setw
 #include <random>       // For session_id
 #include <chrono>       // For chrono::seconds
+#include <algorithm>    // For std::min
+#include <ctime>        // For clock_gettime in the traffic meter
+#include <type_traits>  // For the msg_size_threshold check
 
+// Default and upper bound for the size of each catch-up batch sent after a subscribe
+static const uint64_t CATCH_UP_MAX_BYTES = 4 * 1024 * 1024;
+
+// Wait before reading the log again after a failed catch-up read
+static const std::chrono::milliseconds CATCH_UP_RETRY_DELAY(1000);
+
+uint64_t WsTrafficMeter::thread_cpu_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+namespace {
+
+// permessage_deflate::msg_size_threshold only exists in newer Boost versions (1.81+)
+template <typename T, typename = void>
+struct has_msg_size_threshold : std::false_type {};
+template <typename T>
+struct has_msg_size_threshold<T, std::void_t<decltype(std::declval<T&>().msg_size_threshold)>> : std::true_type {};
+
+template <typename T>
+void set_msg_size_threshold(T& pmd, uint32_t threshold_bytes) {
+    if constexpr (has_msg_size_threshold<T>::value) {
+        pmd.msg_size_threshold = threshold_bytes;
+    } else {
+        boost::ignore_unused(pmd, threshold_bytes);
+    }
+}
+
+// Notification encoders, so a batch shared by many sessions is encoded once per subprotocol
+void encode_json_notification(std::string& out, const std::string& topic, const std::vector<Message>& messages) {
+    WebSocketProtocol::write_message_batch(out, std::nullopt, topic, messages);
+}
+
+void encode_binary_notification(std::string& out, const std::string& topic, const std::vector<Message>& messages) {
+    WebSocketProtocol::write_binary_message_batch(out, std::nullopt, topic, messages);
+}
+
+} // namespace
+
+bool WebSocketSession::deflate_threshold_supported() {
+    return has_msg_size_threshold<websocket::permessage_deflate>::value;
+}
 
 // Helper function to generate a somewhat unique session ID
 std::string WebSocketSession::generate_session_id() {
@@ -16,22 +63,51 @@ std::string WebSocketSession::generate_session_id() {
     return ss.str();
 }
 
+// The strand the socket was accepted on. Beast runs the stream's own handlers (timeouts, pings,
+// suspended reads and writes) on the stream's executor, so the session's handlers must use the same
+// strand or the two race on the stream.
+net::strand<net::io_context::executor_type> WebSocketSession::session_strand(const net::any_io_executor& executor,
+                                                                            net::io_context& ioc) {
+    if (auto* strand = executor.target<net::strand<net::io_context::executor_type>>()) return *strand;
+    return net::make_strand(ioc.get_executor());
+}
 
 WebSocketSession::WebSocketSession( tcp::socket&& socket,
                                     EventQueue& queue,
                                     SubscriptionManager& sub_mgr,
-                                    net::io_context& ioc)
+                                    net::io_context& ioc,
+                                    QuotaManager* quotas,
+                                    size_t max_outbound_bytes,
+                                    const Compression::WebSocketSettings* deflate)
     : ws_(std::move(socket)), // Takes ownership of the raw TCP socket
       event_queue_(queue),
       sub_manager_(sub_mgr), // <<< STORE THIS
-      strand_(net::make_strand(ioc.get_executor())), // <<< MODIFIED HERE: Use ioc.get_executor()
-      session_id_(generate_session_id())
+      strand_(session_strand(ws_.get_executor(), ioc)),
+      quotas_(quotas),
+      session_id_(generate_session_id()),
+      deflate_(deflate),
+      max_outbound_bytes_(max_outbound_bytes)
 {
+    beast::error_code ec;
+    auto endpoint = beast::get_lowest_layer(ws_).socket().remote_endpoint(ec);
+    client_id_ = ec ? "unknown" : endpoint.address().to_string();
     std::cout << "WS Session [" << session_id_ << "]: Created." << std::endl;
 }
 
 WebSocketSession::~WebSocketSession() {
     std::cout << "WS Session [" << session_id_ << "]: Destroyed." << std::endl;
+    if (frames_sent_ > 0) {
+        // Bandwidth against CPU: what the messages were, what went over the wire, and what it cost
+        const auto& meter = beast::get_lowest_layer(ws_).rate_policy();
+        uint64_t wire_bytes = meter.bytes_written();
+        double saved = message_bytes_sent_ > 0 && wire_bytes < message_bytes_sent_
+                       ? 100.0 * (message_bytes_sent_ - wire_bytes) / message_bytes_sent_ : 0.0;
+        std::cout << "WS Session [" << session_id_ << "]: Sent " << frames_sent_ << " frames, "
+                  << message_bytes_sent_ << " message bytes as " << wire_bytes << " wire bytes ("
+                  << std::fixed << std::setprecision(1) << saved << "% saved, permessage-deflate "
+                  << (deflate_negotiated_ ? "on" : "off") << "), write CPU "
+                  << std::setprecision(2) << meter.write_cpu_ns() / 1e6 << " ms." << std::endl;
+    }
     // Unsubscribe from all topics if not already done by do_close
     // Posting to strand ensures thread safety if destructor called from different thread
     // However, this might be tricky if io_context is stopping.
@@ -57,15 +133,59 @@ void WebSocketSession::on_run_start() {
     // Set suggested timeout settings for the websocket
     ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
 
-    // Set a decorator to change the Server of the handshake
+    // Read the upgrade request ourselves, so the subprotocol can be chosen before accepting
+    beast::get_lowest_layer(ws_).expires_after(std::chrono::seconds(30));
+    http::async_read(
+        beast::get_lowest_layer(ws_), buffer_, upgrade_request_,
+        net::bind_executor(
+            strand_,
+            beast::bind_front_handler(
+                &WebSocketSession::on_upgrade_request,
+                shared_from_this())));
+}
+
+void WebSocketSession::on_upgrade_request(beast::error_code ec, std::size_t bytes_transferred) {
+    boost::ignore_unused(bytes_transferred);
+    if (ec) {
+        std::cerr << "WS Session [" << session_id_ << "]: Handshake read error: " << ec.message() << std::endl;
+        return;
+    }
+    // The websocket stream applies its own handshake and idle timeouts from here on
+    beast::get_lowest_layer(ws_).expires_never();
+
+    auto offer = upgrade_request_[http::field::sec_websocket_protocol];
+    std::string subprotocol(WebSocketProtocol::select_subprotocol(
+        std::string_view(offer.data(), offer.size()), encoding_));
+
+    // Offer permessage-deflate with the configured parameters. Beast accepts a client's offer that
+    // fits them, and then compresses and decompresses every message itself.
+    if (deflate_ && deflate_->enabled) {
+        websocket::permessage_deflate pmd;
+        pmd.server_enable = true;
+        pmd.server_max_window_bits = deflate_->window_bits;
+        pmd.client_max_window_bits = deflate_->window_bits;
+        pmd.memLevel = deflate_->mem_level;
+        if (deflate_->level > 0) pmd.compLevel = deflate_->level;
+        pmd.server_no_context_takeover = !deflate_->context_takeover;
+        pmd.client_no_context_takeover = !deflate_->context_takeover;
+        set_msg_size_threshold(pmd, deflate_->threshold_bytes);
+        ws_.set_option(pmd);
+    }
+
+    // Set a decorator to change the Server of the handshake, and echo the chosen subprotocol. It
+    // runs after Beast has negotiated permessage-deflate into the response.
     ws_.set_option(websocket::stream_base::decorator(
-        [](websocket::response_type& res) {
+        [this, subprotocol](websocket::response_type& res) {
             res.set(http::field::server,
                 std::string(BOOST_BEAST_VERSION_STRING) + " websocket-event-queue-server");
+            if (!subprotocol.empty()) res.set(http::field::sec_websocket_protocol, subprotocol);
+            deflate_negotiated_ =
+                res[http::field::sec_websocket_extensions].find("permessage-deflate") != beast::string_view::npos;
         }));
 
-    // Accept the websocket handshake
+    // Accept the websocket handshake (a request that isn't an upgrade is answered with an error)
     ws_.async_accept(
+        upgrade_request_,
         net::bind_executor(
             strand_, // Ensure handler runs on the strand
             beast::bind_front_handler(
@@ -79,7 +199,10 @@ void WebSocketSession::on_accept(beast::error_code ec) {
         std::cerr << "WS Session [" << session_id_ << "]: Accept error: " << ec.message() << std::endl;
         return do_close(); // Or just let the session die
     }
-    std::cout << "WS Session [" << session_id_ << "]: Accepted connection." << std::endl;
+    std::cout << "WS Session [" << session_id_ << "]: Accepted connection ("
+              << (encoding_ == WebSocketProtocol::Encoding::BINARY ? "binary" : "JSON")
+              << (deflate_negotiated_ ? ", permessage-deflate" : "") << ")." << std::endl;
+    upgrade_request_ = {};
 
     // Start reading messages
     do_read();
@@ -109,19 +232,28 @@ void WebSocketSession::on_read(beast::error_code ec, std::size_t bytes_transferr
         return do_close();
     }
 
-    // Echo the message back for now, or process it
-    // For text messages:
-    if (ws_.got_text()) {
+    // Each session speaks the one protocol it negotiated: JSON text, or binary frames
+    bool binary = encoding_ == WebSocketProtocol::Encoding::BINARY;
+    if (ws_.got_text() && !binary) {
         std::string message_text = beast::buffers_to_string(buffer_.data());
         std::cout << "WS Session [" << session_id_ << "]: Received: " << message_text << std::endl;
         process_message(message_text);
         // Continue reading
         do_read();
+    } else if (ws_.got_binary() && binary) {
+        // The frame is a single contiguous buffer: flat_buffer
+        auto data = buffer_.data();
+        process_binary_message(static_cast<const char*>(data.data()), data.size());
+        do_read();
     } else if (ws_.got_binary()) {
-        // This server expects text (JSON) messages
         std::cerr << "WS Session [" << session_id_ << "]: Received binary message, expected text. Closing." << std::endl;
-        send_error_response(std::nullopt, "Binary messages not supported. Send JSON text.");
+        send_error_response(std::nullopt, std::string("Binary messages need the ") +
+                                          WebSocketProtocol::BINARY_SUBPROTOCOL + " subprotocol. Send JSON text.");
         return do_close(); // Or just ignore and do_read()
+    } else {
+        std::cerr << "WS Session [" << session_id_ << "]: Received text message on a binary session. Closing." << std::endl;
+        send_error_response(std::nullopt, "Text messages not supported on a binary session.");
+        return do_close();
     }
     // Note: Pings/Pongs are handled automatically by Beast unless `control_callback` is set.
 }
@@ -176,13 +308,144 @@ void WebSocketSession::process_message(const std::string& message_text) {
     }
 }
 
+void WebSocketSession::process_binary_message(const char* data, size_t size) {
+    NetworkProtocol::BufferReader reader(data, size);
+    WebSocketProtocol::BaseWsMessage base_msg;
+    try {
+        base_msg = WebSocketProtocol::read_binary_header(reader);
+
+        using namespace WebSocketProtocol;
+        switch (base_msg.command) {
+            case Command::PRODUCE_REQUEST:
+                handle_produce_request(read_binary_request<ProduceWsRequest>(reader, base_msg));
+                break;
+            case Command::SUBSCRIBE_TOPIC_REQUEST:
+                handle_subscribe_topic_request(read_binary_request<SubscribeTopicWsRequest>(reader, base_msg));
+                break;
+            case Command::UNSUBSCRIBE_TOPIC_REQUEST:
+                handle_unsubscribe_topic_request(read_binary_request<UnsubscribeTopicWsRequest>(reader, base_msg));
+                break;
+            case Command::CREATE_TOPIC_REQUEST:
+                handle_create_topic_request(read_binary_request<CreateTopicWsRequest>(reader, base_msg));
+                break;
+            case Command::LIST_TOPICS_REQUEST:
+                handle_list_topics_request(read_binary_request<BaseWsMessage>(reader, base_msg));
+                break;
+            case Command::GET_NEXT_OFFSET_REQUEST:
+                handle_get_next_offset_request(read_binary_request<GetNextOffsetWsRequest>(reader, base_msg));
+                break;
+            default:
+                std::cerr << "WS Session [" << session_id_ << "]: Unknown binary command: "
+                          << static_cast<int>(base_msg.command) << std::endl;
+                send_error_response(base_msg.req_id, "Unknown command received.", base_msg.command);
+                break;
+        }
+    } catch (const std::exception& e) {
+        // The reader throws on truncated or oversized fields; the req_id is kept if it was read
+        std::cerr << "WS Session [" << session_id_ << "]: Malformed binary message: " << e.what() << std::endl;
+        send_error_response(base_msg.req_id, "Malformed binary message: " + std::string(e.what()));
+    }
+}
+
+
+void WebSocketSession::queue_frame(std::string frame) {
+    if (closing_) return;
+    Outbound entry;
+    entry.bytes = frame.size();
+    entry.frame = std::make_shared<const std::string>(std::move(frame));
+    outbound_bytes_ += entry.bytes;
+    outbound_.push_back(std::move(entry));
+    if (max_outbound_bytes_ > 0 && outbound_bytes_ > max_outbound_bytes_) return on_slow_consumer();
+    write_next();
+}
+
+void WebSocketSession::queue_notification(const NotificationBatchPtr& batch, bool catch_up) {
+    if (closing_) return;
+    // A queued batch can still grow until it is written, and is counted at its size when queued.
+    // Once the next batch for the topic arrives it has stopped growing, so its count is brought
+    // up to date here.
+    for (auto it = outbound_.rbegin(); it != outbound_.rend(); ++it) {
+        if (!it->batch || it->batch->topic() != batch->topic()) continue;
+        size_t bytes = it->batch->size_bytes();
+        outbound_bytes_ += bytes - it->bytes;
+        it->bytes = bytes;
+        break;
+    }
+
+    Outbound entry;
+    entry.batch = batch;
+    entry.bytes = batch->size_bytes();
+    entry.catch_up = catch_up;
+    outbound_bytes_ += entry.bytes;
+    outbound_.push_back(std::move(entry));
+    if (max_outbound_bytes_ > 0 && outbound_bytes_ > max_outbound_bytes_) return on_slow_consumer();
+    write_next();
+}
+
+void WebSocketSession::write_next() {
+    if (write_in_flight_ || closing_) return;
+
+    while (!writing_ && !outbound_.empty()) {
+        Outbound entry = std::move(outbound_.front());
+        outbound_.pop_front();
+        if (!entry.batch) {
+            writing_ = std::move(entry.frame);
+            writing_bytes_ = entry.bytes;
+            break;
+        }
+
+        // Seals the batch: its messages and size are final from here on
+        const auto& messages = entry.batch->messages();
+        auto next = next_offsets_.find(entry.batch->topic());
+        auto first = messages.begin();
+        if (next != next_offsets_.end()) {
+            while (first != messages.end() && first->offset < next->second) ++first;
+        }
+        if (first == messages.end()) { // Everything in it has been sent already
+            outbound_bytes_ -= entry.bytes;
+            if (entry.catch_up) on_catch_up_sent(entry.batch->topic());
+            continue;
+        }
+        if (entry.catch_up) writing_catch_up_ = entry.batch->topic();
+
+        auto encode = encoding_ == WebSocketProtocol::Encoding::BINARY ? &encode_binary_notification
+                                                                       : &encode_json_notification;
+        size_t bytes = entry.batch->size_bytes();
+        if (first == messages.begin()) {
+            writing_ = entry.batch->frame(encode); // Shared with the batch's other subscribers
+        } else {
+            // Overlaps what was sent: only this session sees the rest, so it gets its own frame
+            auto frame = std::make_shared<std::string>();
+            encode(*frame, entry.batch->topic(), std::vector<Message>(first, messages.end()));
+            bytes = frame->size();
+            writing_ = std::move(frame);
+        }
+        outbound_bytes_ += bytes - entry.bytes;
+        writing_bytes_ = bytes;
+        if (next != next_offsets_.end()) next->second = messages.back().offset + 1;
+
+        // Pushed data can't be refused, but it is charged so the client's next request is throttled
+        if (quotas_) {
+            uint64_t payload_bytes = 0;
+            for (auto it = first; it != messages.end(); ++it) payload_bytes += it->payload.size();
+            quotas_->record(client_id_, entry.batch->topic(), QuotaManager::Operation::CONSUME, payload_bytes);
+        }
+        std::cout << "WS Session [" << session_id_ << "]: Delivering " << (messages.end() - first)
+                  << " msgs for subscribed topic '" << entry.batch->topic() << "'." << std::endl;
+    }
+    if (!writing_) return;
+
+    // Frames go out in the negotiated encoding
+    ws_.binary(encoding_ == WebSocketProtocol::Encoding::BINARY);
 
-void WebSocketSession::do_write(const std::string& message_text) {
-    // Ensure we are using text mode for sending JSON
-    ws_.text(true);
+    ++frames_sent_;
+    message_bytes_sent_ += writing_->size();
+    beast::get_lowest_layer(ws_).rate_policy().begin_message();
 
+    // The buffer is held by writing_ (and may be shared with other sessions) until on_write
+    write_in_flight_ = true;
     ws_.async_write(
-        net::buffer(message_text),
+        net::buffer(*writing_),
         net::bind_executor(
             strand_,
             beast::bind_front_handler(
@@ -192,30 +455,49 @@ void WebSocketSession::do_write(const std::string& message_text) {
 
 void WebSocketSession::on_write(beast::error_code ec, std::size_t bytes_transferred) {
     boost::ignore_unused(bytes_transferred);
+    beast::get_lowest_layer(ws_).rate_policy().end_message();
+    write_in_flight_ = false;
+    writing_.reset();
+    outbound_bytes_ -= writing_bytes_;
+    writing_bytes_ = 0;
 
     if (ec) {
         std::cerr << "WS Session [" << session_id_ << "]: Write error: " << ec.message() << std::endl;
         return do_close(); // Or let session die
     }
-    // std::cout << "WS Session [" << session_id_ << "]: Message sent (" << bytes_transferred << " bytes)." << std::endl;
-    // Buffer is not cleared here, it's managed by the caller or `do_read`
+    if (!writing_catch_up_.empty()) {
+        std::string topic_name = std::move(writing_catch_up_);
+        writing_catch_up_.clear();
+        on_catch_up_sent(topic_name);
+    }
+    write_next();
+}
+
+void WebSocketSession::on_slow_consumer() {
+    std::cerr << "WS Session [" << session_id_ << "]: Slow consumer: " << outbound_bytes_
+              << " bytes waiting to be sent (limit " << max_outbound_bytes_ << "). Closing." << std::endl;
+    for (const auto& entry : outbound_) outbound_bytes_ -= entry.bytes;
+    outbound_.clear();
+    do_close(websocket::close_reason(websocket::close_code::policy_error, "slow consumer"));
 }
 
-void WebSocketSession::do_close() {
+void WebSocketSession::do_close(websocket::close_reason reason) {
     // This function is not run on the strand, so post the close operation.
     // Or, if it's always called from a strand context, direct call is fine.
     // For safety, always operate on ws_ via its strand.
+    if (closing_) return; // Only one close may be in progress
     if (ws_.is_open()) {
          std::cout << "WS Session [" << session_id_ << "]: Initiating close." << std::endl;
+        closing_ = true; // Nothing more is queued or written; a write in flight completes first
         // Unsubscribe from all topics this session was part of
         sub_manager_.unsubscribe_all(session_id_); // <<< ADD THIS
 
         // Post a call to `websocket::stream::async_close`
         // No need to bind_executor if we're posting to the strand's context already
         // but explicit is safer.
-        net::post(strand_, [self = shared_from_this()]() {
+        net::post(strand_, [self = shared_from_this(), reason]() {
             if (self->ws_.is_open()) { // Re-check as it might be closed by another op
-                 self->ws_.async_close(websocket::close_code::normal,
+                 self->ws_.async_close(reason,
                     net::bind_executor(self->strand_,
                         [self_inner = self](beast::error_code ec_close) {
                             if (ec_close) {
@@ -241,6 +523,16 @@ void WebSocketSession::handle_produce_request(const WebSocketProtocol::ProduceWs
     resp.req_id = req.req_id;
     resp.topic = req.topic;
 
+    if (quotas_) {
+        if (uint32_t throttle_ms = quotas_->admit(client_id_, req.topic, QuotaManager::Operation::PRODUCE, req.message_payload.size())) {
+            resp.offset = 0;
+            resp.success = false;
+            resp.error_message = "Quota exceeded.";
+            resp.throttle_ms = throttle_ms;
+            return send_ws_message(resp);
+        }
+    }
+
     try {
         resp.offset = event_queue_.produce(req.topic, req.message_payload);
         resp.success = true;
@@ -258,17 +550,27 @@ void WebSocketSession::handle_subscribe_topic_request(const WebSocketProtocol::S
     resp.req_id = req.req_id;
     resp.topic = req.topic;
 
+    if (quotas_) {
+        if (uint32_t throttle_ms = quotas_->admit(client_id_, req.topic, QuotaManager::Operation::CONSUME)) {
+            resp.success = false;
+            resp.error_message = "Quota exceeded.";
+            resp.throttle_ms = throttle_ms;
+            return send_ws_message(resp);
+        }
+    }
+
     // The callback function that SubscriptionManager will use to send us messages
     MessageDeliveryCallback delivery_cb =
-        [self = weak_from_this()](const std::string& topic, const std::vector<Message>& msgs) {
+        [self = weak_from_this()](const NotificationBatchPtr& batch) {
         if (auto strong_self = self.lock()) { // Ensure session still exists
             // This callback will be invoked by SubscriptionManager on our client_executor (strand_)
-            strong_self->deliver_subscribed_messages(topic, msgs);
+            strong_self->deliver_subscribed_messages(batch);
         }
     };
 
-    // Get the executor for this session's strand
-    auto client_exec = net::get_associated_executor(strand_);
+    // Deliveries are posted to this session's strand. (get_associated_executor(strand_) would be the
+    // system executor: a strand has no associated executor of its own.)
+    net::any_io_executor client_exec = strand_;
 
     if (sub_manager_.subscribe(req.topic, req.subscriber_id, req.start_offset, client_exec, std::move(delivery_cb))) {
         resp.success = true;
@@ -281,30 +583,86 @@ void WebSocketSession::handle_subscribe_topic_request(const WebSocketProtocol::S
     }
     send_ws_message(resp);
 
-    // Optional: Implement "catch-up" logic here. After successful subscription,
-    // immediately try to fetch messages from req.start_offset up to current latest
-    // and send them via deliver_subscribed_messages.
-    // This would require a call to event_queue_.consume()
-    // Be careful with threading: post this task to the strand.
+    // Replay the log from start_offset before any live batch goes out (see CatchUp)
     if (resp.success) {
-        net::post(strand_, [self = shared_from_this(), topic_name = req.topic, start_offset = req.start_offset]() {
-            try {
-                // std::cout << "WS Session [" << self->session_id_ << "]: Catching up messages for " << topic_name << " from " << start_offset << std::endl;
-                std::vector<Message> initial_messages = self->event_queue_.consume(topic_name, start_offset, 100); // Consume a batch
-                if (!initial_messages.empty()) {
-                    self->deliver_subscribed_messages(topic_name, initial_messages);
-                    // The SubscriptionManager will be notified of subsequent messages from EventQueue::produce
-                    // The 'next_offset_needed' in SubscriberInfo for this client should be updated by this delivery
-                    // or by the first call from notify_new_message in SubscriptionManager.
-                    // For simplicity here, the SubscriptionManager's next_offset_needed will start from start_offset
-                    // and get updated on the first push.
-                    // A more robust catch-up would coordinate this offset update.
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "WS Session [" << self->session_id_ << "]: Error during catch-up for topic " << topic_name << ": " << e.what() << std::endl;
-            }
+        CatchUp& catch_up = catch_ups_[req.topic];
+        catch_up = CatchUp{};
+        catch_up.subscriber_id = req.subscriber_id;
+        catch_up.generation = ++catch_up_generation_;
+        catch_up.next_offset = req.start_offset;
+        catch_up.max_bytes = (req.max_bytes == 0) ? CATCH_UP_MAX_BYTES : std::min(req.max_bytes, CATCH_UP_MAX_BYTES);
+        next_offsets_[req.topic] = req.start_offset;
+        pump_catch_up(req.topic);
+    }
+}
+
+void WebSocketSession::pump_catch_up(const std::string& topic_name) {
+    auto it = catch_ups_.find(topic_name);
+    if (closing_ || it == catch_ups_.end()) return;
+    CatchUp& catch_up = it->second;
+    if (catch_up.reading || catch_up.chunk_unsent) return;
+
+    catch_up.reading = true;
+    catch_up.live_arrived = false;
+    // Read on the io_context rather than the strand, so a long replay doesn't hold up the session
+    net::post(strand_.get_inner_executor(), [self = shared_from_this(), topic_name, generation = catch_up.generation,
+                                              start_offset = catch_up.next_offset, max_bytes = catch_up.max_bytes]() {
+        std::vector<Message> messages;
+        bool failed = false;
+        try {
+            self->event_queue_.consume_into(topic_name, start_offset, std::numeric_limits<uint32_t>::max(), max_bytes, messages);
+        } catch (const std::exception& e) {
+            std::cerr << "WS Session [" << self->session_id_ << "]: Error during catch-up for topic " << topic_name << ": " << e.what() << std::endl;
+            failed = true;
+        }
+        net::post(self->strand_, [self, topic_name, generation, failed, messages = std::move(messages)]() mutable {
+            self->on_catch_up_read(topic_name, generation, failed, std::move(messages));
         });
+    });
+}
+
+void WebSocketSession::on_catch_up_read(const std::string& topic_name, uint64_t generation, bool failed,
+                                        std::vector<Message> messages) {
+    auto it = catch_ups_.find(topic_name);
+    if (closing_ || it == catch_ups_.end() || it->second.generation != generation) return; // Unsubscribed meanwhile
+    CatchUp& catch_up = it->second;
+
+    if (failed) {
+        // `reading` stays set, so nothing else reads the log until the timer fires
+        auto timer = std::make_shared<net::steady_timer>(strand_, CATCH_UP_RETRY_DELAY);
+        timer->async_wait([self = weak_from_this(), timer, topic_name, generation](beast::error_code) {
+            auto strong_self = self.lock();
+            if (!strong_self) return;
+            auto found = strong_self->catch_ups_.find(topic_name);
+            if (found == strong_self->catch_ups_.end() || found->second.generation != generation) return;
+            found->second.reading = false;
+            strong_self->pump_catch_up(topic_name);
+        });
+        return;
+    }
+
+    catch_up.reading = false;
+    if (messages.empty()) {
+        // At the end of the log. A live batch that arrived during the read may hold messages
+        // appended after it, so read again; otherwise live batches take over from here.
+        if (catch_up.live_arrived) return pump_catch_up(topic_name);
+        catch_ups_.erase(it);
+        return;
     }
+
+    catch_up.next_offset = messages.back().offset + 1;
+    catch_up.chunk_unsent = true;
+    // The manager needn't post what the replay has read; anything it still does is dropped in write_next
+    sub_manager_.skip_to(topic_name, catch_up.subscriber_id, catch_up.next_offset);
+    // This session's own batch, not shared with other subscribers
+    queue_notification(std::make_shared<const NotificationBatch>(topic_name, std::move(messages)), true);
+}
+
+void WebSocketSession::on_catch_up_sent(const std::string& topic_name) {
+    auto it = catch_ups_.find(topic_name);
+    if (it == catch_ups_.end()) return;
+    it->second.chunk_unsent = false;
+    pump_catch_up(topic_name);
 }
 
 void WebSocketSession::handle_unsubscribe_topic_request(const WebSocketProtocol::UnsubscribeTopicWsRequest& req) {
@@ -314,6 +672,8 @@ void WebSocketSession::handle_unsubscribe_topic_request(const WebSocketProtocol:
     resp.topic = req.topic;
 
     if (sub_manager_.unsubscribe(req.topic, req.subscriber_id)) {
+        next_offsets_.erase(req.topic);
+        catch_ups_.erase(req.topic);
         resp.success = true;
         std::cout << "WS Session [" << req.subscriber_id << "]: Unsubscribe from topic '" << req.topic << "' successful." << std::endl;
     } else {
@@ -324,19 +684,19 @@ void WebSocketSession::handle_unsubscribe_topic_request(const WebSocketProtocol:
 }
 
 // This is the callback method called by SubscriptionManager
-void WebSocketSession::deliver_subscribed_messages(const std::string& topic_name, const std::vector<Message>& messages) {
-    // This method is already posted to run on this session's strand by SubscriptionManager
-    if (messages.empty()) return;
-
-    WebSocketProtocol::MessageBatchWsNotification notification;
-    notification.command = WebSocketProtocol::Command::MESSAGE_BATCH_NOTIFICATION;
-    // notification.req_id might be a subscription ID if you implement that
-    notification.topic = topic_name;
-    notification.messages = messages; // Message struct should be JSON serializable
-
-    std::cout << "WS Session [" << session_id_ << "]: Delivering " << messages.size()
-              << " msgs for subscribed topic '" << topic_name << "'." << std::endl;
-    send_ws_message(notification);
+void WebSocketSession::deliver_subscribed_messages(const NotificationBatchPtr& batch) {
+    // This method is already posted to run on this session's strand by SubscriptionManager.
+    auto catch_up = catch_ups_.find(batch->topic());
+    if (catch_up != catch_ups_.end()) {
+        // Still replaying the log, which has these messages. Sealing the batch makes the manager put
+        // later messages in a new one, so each of them arrives here too and keeps the replay going.
+        batch->messages();
+        catch_up->second.live_arrived = true;
+        return;
+    }
+    // The batch isn't looked at here: until it is written it may still take more messages, which
+    // are charged to the quota then.
+    queue_notification(batch);
 }
 
 void WebSocketSession::handle_create_topic_request(const WebSocketProtocol::CreateTopicWsRequest& req) {
@@ -386,7 +746,7 @@ void WebSocketSession::handle_get_next_offset_request(const WebSocketProtocol::G
     send_ws_message(resp);
 }
 
-// --- Helper to send JSON messages ---
+// --- Helper to send responses ---
 template<typename T>
 void WebSocketSession::send_ws_message(const T& message_payload) {
     // This must be called from the strand or post to it.
@@ -399,8 +759,13 @@ void WebSocketSession::send_ws_message(const T& message_payload) {
     }
 
     try {
-        json j = message_payload; // Serialize to JSON
-        do_write(j.dump());
+        std::string frame;
+        if (encoding_ == WebSocketProtocol::Encoding::BINARY) {
+            WebSocketProtocol::write_binary(frame, message_payload);
+        } else {
+            WebSocketProtocol::write_json(frame, message_payload);
+        }
+        queue_frame(std::move(frame));
     } catch (const json::exception& e) {
         std::cerr << "WS Session [" << session_id_ << "]: JSON serialization error for outgoing message: " << e.what() << std::endl;
         // Cannot easily send an error back if serialization itself failed. Log and potentially close.
@@ -417,4 +782,4 @@ void WebSocketSession::send_error_response(std::optional<uint64_t> req_id, const
     err_resp.error_message = error_msg;
     err_resp.original_command_type = original_cmd;
     send_ws_message(err_resp);
-}
\ No newline at end of file
+}
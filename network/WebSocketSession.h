@@ -6,7 +6,9 @@
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/strand.hpp>
 #include <cstdlib>
+#include <deque>
 #include <functional>
+#include <limits>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -18,6 +20,8 @@
 #include "../../event_queue_core/EventQueue.h" // The core queue logic
 #include "WebSocketTypes.h"                 // Our WebSocket message protocol
 #include "SubscriptionManager.h"
+#include "QuotaManager.h"
+#include "Compression.h"
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
@@ -29,42 +33,149 @@ using json = nlohmann::json;
 // Forward declaration for a potential global subscription manager
 // class SubscriptionManager; (If you build a more advanced one)
 
+// Rate policy for the session's TCP stream that never limits anything. It only meters the stream:
+// bytes actually written to the socket, and the thread CPU time each message spends in Beast before
+// its bytes reach the socket. Most of that time is permessage-deflate. Beast asks the policy for a
+// write allowance right after it has framed (and compressed) the next chunk of a message, and
+// reports the bytes written right before it goes on to the next chunk. The time between those two
+// calls is what gets measured.
+class WsTrafficMeter {
+public:
+    uint64_t bytes_written() const { return bytes_written_; }
+    uint64_t write_cpu_ns() const { return write_cpu_ns_; }
+
+    // Bracket one message write (async_write call to completion)
+    void begin_message() { in_message_ = true; mark(); }
+    void end_message() { in_message_ = false; marked_ = false; }
+
+private:
+    friend class beast::rate_policy_access;
+
+    static uint64_t thread_cpu_ns();
+    void mark() { mark_ns_ = thread_cpu_ns(); marked_ = true; }
+
+    std::size_t available_read_bytes() const noexcept { return (std::numeric_limits<std::size_t>::max)(); }
+    std::size_t available_write_bytes() {
+        if (marked_) {
+            write_cpu_ns_ += thread_cpu_ns() - mark_ns_;
+            marked_ = false;
+        }
+        return (std::numeric_limits<std::size_t>::max)();
+    }
+    void transfer_read_bytes(std::size_t) noexcept {}
+    void transfer_write_bytes(std::size_t n) {
+        bytes_written_ += n;
+        if (in_message_) mark(); // The next chunk is prepared from here
+    }
+    void on_timer() noexcept {}
+
+    uint64_t bytes_written_ = 0;
+    uint64_t write_cpu_ns_ = 0;
+    uint64_t mark_ns_ = 0;
+    bool marked_ = false;
+    bool in_message_ = false;
+};
+
 // Represents a single WebSocket session (client connection)
 class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
-    websocket::stream<beast::tcp_stream> ws_;
+    websocket::stream<beast::basic_stream<tcp, net::any_io_executor, WsTrafficMeter>> ws_;
     beast::flat_buffer buffer_;
     EventQueue& event_queue_;
     SubscriptionManager& sub_manager_; // <<< ADD THIS
     net::strand<net::io_context::executor_type> strand_;
+    QuotaManager* quotas_; // Null when quotas are disabled
+    std::string client_id_; // Quota identity: the peer's IP address
 
     std::string session_id_; // For logging/debugging
 
+    http::request<http::string_body> upgrade_request_; // Read first, to negotiate the subprotocol
+    WebSocketProtocol::Encoding encoding_ = WebSocketProtocol::Encoding::JSON;
+    const Compression::WebSocketSettings* deflate_; // Null or disabled: no permessage-deflate
+    bool deflate_negotiated_ = false;
+
+    // Traffic counters, logged when the session ends (wire bytes and CPU are in the meter)
+    uint64_t frames_sent_ = 0;
+    uint64_t message_bytes_sent_ = 0; // Before compression and framing
+
+    // Outbound queue. Beast allows one write in flight, so frames wait here and go out one at a
+    // time. A notification is the batch the SubscriptionManager delivered to every subscriber of
+    // the topic. It keeps taking new messages until one of them writes it, so a burst becomes one
+    // message_batch_notification frame, and it is encoded once for all sessions of an encoding.
+    struct Outbound {
+        std::shared_ptr<const std::string> frame; // Encoded response; null for a notification
+        NotificationBatchPtr batch;               // Notification: encoded when the entry is written
+        size_t bytes = 0;                         // Counted against max_outbound_bytes_
+        bool catch_up = false;                    // A chunk read from the log after a subscribe
+    };
+    std::deque<Outbound> outbound_;
+    std::shared_ptr<const std::string> writing_; // The frame being written (may be shared)
+    size_t writing_bytes_ = 0;
+    bool write_in_flight_ = false;
+    size_t outbound_bytes_ = 0;      // Queued and in-flight bytes
+    size_t max_outbound_bytes_;      // Over this the client is a slow consumer (0 = no cap)
+    bool closing_ = false;
+    // Per subscribed topic, the offset the client is sent next. Notifications can overlap (the
+    // catch-up read and live batches queued behind it), so messages below it are dropped when written.
+    std::map<std::string, uint64_t, std::less<>> next_offsets_;
+
+    // A subscribe first replays the log from start_offset, one chunk of at most max_bytes at a time.
+    // Chunks are read off the strand, and the next one is read once the previous one is written.
+    // Live batches for the topic are dropped meanwhile, since the replay reads their messages too.
+    // The replay ends with an empty read during which no live batch arrived; live batches go out
+    // from then on.
+    struct CatchUp {
+        std::string subscriber_id;
+        uint64_t generation = 0;    // Tells a read for an earlier subscription to the topic apart
+        uint64_t next_offset = 0;
+        uint64_t max_bytes = 0;
+        bool reading = false;
+        bool chunk_unsent = false;  // The last chunk read is queued or being written
+        bool live_arrived = false;  // A live batch arrived during the read in progress
+    };
+    std::map<std::string, CatchUp, std::less<>> catch_ups_;
+    uint64_t catch_up_generation_ = 0;
+    std::string writing_catch_up_; // Topic of the catch-up chunk being written; empty if none
+
 public:
+    // Unsent bytes a session may queue before it is closed as a slow consumer
+    static constexpr size_t DEFAULT_MAX_OUTBOUND_BYTES = 16 * 1024 * 1024;
+
     // Takes ownership of the socket
     // WebSocketSession(tcp::socket&& socket, EventQueue& queue);
     WebSocketSession(
       tcp::socket&& socket,
       EventQueue& queue, 
       SubscriptionManager& sub_mgr, // <<< ADD THIS
-      net::io_context& ioc);
+      net::io_context& ioc,
+      QuotaManager* quotas = nullptr,
+      size_t max_outbound_bytes = DEFAULT_MAX_OUTBOUND_BYTES,
+      const Compression::WebSocketSettings* deflate = nullptr);
 
     ~WebSocketSession();
 
     // Start the session
     void run();
 
+    // Whether this Boost version lets permessage-deflate skip small messages (threshold_bytes)
+    static bool deflate_threshold_supported();
+
     void on_run_start();
 
   private:
+    void on_upgrade_request(beast::error_code ec, std::size_t bytes_transferred);
     void on_accept(beast::error_code ec);
     void do_read();
     void on_read(beast::error_code ec, std::size_t bytes_transferred);
     void process_message(const std::string& message_text);
+    void process_binary_message(const char* data, size_t size);
 
-    void do_write(const std::string& message_text);
+    void queue_frame(std::string frame);
+    void queue_notification(const NotificationBatchPtr& batch, bool catch_up = false);
+    void write_next();
     void on_write(beast::error_code ec, std::size_t bytes_transferred);
-    
-    void do_close();
+    void on_slow_consumer();
+
+    void do_close(websocket::close_reason reason = websocket::close_code::normal);
 
     // --- Request Handlers ---
     void handle_produce_request(const WebSocketProtocol::ProduceWsRequest& req);
@@ -74,14 +185,21 @@ public:
     void handle_list_topics_request(const WebSocketProtocol::BaseWsMessage& req); // Base is enough
     void handle_get_next_offset_request(const WebSocketProtocol::GetNextOffsetWsRequest& req);
 
+    // Catch-up after a subscribe (see CatchUp)
+    void pump_catch_up(const std::string& topic_name);
+    void on_catch_up_read(const std::string& topic_name, uint64_t generation, bool failed, std::vector<Message> messages);
+    void on_catch_up_sent(const std::string& topic_name);
+
     // Callback for SubscriptionManager to deliver messages
-    void deliver_subscribed_messages(const std::string& topic_name, const std::vector<Message>& messages);
+    void deliver_subscribed_messages(const NotificationBatchPtr& batch);
 
-    // Helper to send JSON messages
+    // Helper to send responses, as JSON or binary depending on the negotiated subprotocol
     template<typename T>
     void send_ws_message(const T& message_payload);
     void send_error_response(std::optional<uint64_t> req_id, const std::string& error_msg,
                              std::optional<WebSocketProtocol::Command> original_cmd = std::nullopt);
     
     static std::string generate_session_id();
+    static net::strand<net::io_context::executor_type> session_strand(const net::any_io_executor& executor,
+                                                                      net::io_context& ioc);
 };
\ No newline at end of file
@@ -5,8 +5,11 @@
 #include <vector>
 #include <cstdint>
 #include <optional>        // For optional fields
+#include <string_view>
 #include <nlohmann/json.hpp>
 #include "../event_queue_core/Message.h" // Assumes Message.h has NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE
+#include "JsonWriter.h"
+#include "NetworkProtocol.h" // BufferWriter/BufferReader for the binary subprotocol
 
 using json = nlohmann::json;
 
@@ -14,28 +17,29 @@ namespace WebSocketProtocol {
 
     // --- Command Enum ---
     // Defines the type of WebSocket message
-    enum class Command {
+    enum class Command : uint8_t {
         // Client to Server
-        PRODUCE_REQUEST,
-        SUBSCRIBE_TOPIC_REQUEST,
-        UNSUBSCRIBE_TOPIC_REQUEST,
-        CREATE_TOPIC_REQUEST,
-        LIST_TOPICS_REQUEST,
-        GET_NEXT_OFFSET_REQUEST,
+        PRODUCE_REQUEST = 0x01,
+        SUBSCRIBE_TOPIC_REQUEST = 0x02,
+        UNSUBSCRIBE_TOPIC_REQUEST = 0x03,
+        CREATE_TOPIC_REQUEST = 0x04,
+        LIST_TOPICS_REQUEST = 0x05,
+        GET_NEXT_OFFSET_REQUEST = 0x06,
 
         // Server to Client (Responses & Notifications)
-        PRODUCE_RESPONSE,
-        SUBSCRIBE_TOPIC_RESPONSE,   // Confirms subscription
-        UNSUBSCRIBE_TOPIC_RESPONSE, // Confirms unsubscription
-        CREATE_TOPIC_RESPONSE,
-        LIST_TOPICS_RESPONSE,
-        GET_NEXT_OFFSET_RESPONSE,
-        MESSAGE_BATCH_NOTIFICATION, // Pushed messages for a subscription
-        ERROR_RESPONSE,
+        PRODUCE_RESPONSE = 0x81,
+        SUBSCRIBE_TOPIC_RESPONSE = 0x82,   // Confirms subscription
+        UNSUBSCRIBE_TOPIC_RESPONSE = 0x83, // Confirms unsubscription
+        CREATE_TOPIC_RESPONSE = 0x84,
+        LIST_TOPICS_RESPONSE = 0x85,
+        GET_NEXT_OFFSET_RESPONSE = 0x86,
+        MESSAGE_BATCH_NOTIFICATION = 0x8A, // Pushed messages for a subscription
+        ERROR_RESPONSE = 0xFF,
 
         // Generic/Unknown
-        UNKNOWN
+        UNKNOWN = 0x00
     };
+    // The values are the command byte of the binary subprotocol; JSON uses the names below
 
     // Helper for JSON serialization of the Command enum
     NLOHMANN_JSON_SERIALIZE_ENUM(Command, {
@@ -117,6 +121,7 @@ namespace WebSocketProtocol {
         std::string topic;
         std::string subscriber_id; 
         uint64_t start_offset = 0; // Offset from which to start receiving messages
+        uint64_t max_bytes = 0; // Byte budget for each catch-up batch, not for the whole replay (0 = server default)
     };
     // NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(SubscribeTopicWsRequest, command, req_id, topic, start_offset)
 
@@ -128,6 +133,7 @@ namespace WebSocketProtocol {
         j["topic"] = p.topic;
         j["subscriber_id"] = p.subscriber_id;
         j["start_offset"] = p.start_offset;
+        j["max_bytes"] = p.max_bytes;
     }
 
     inline void from_json(const json& j, SubscribeTopicWsRequest& p) {
@@ -139,6 +145,9 @@ namespace WebSocketProtocol {
         j.at("topic").get_to(p.topic);
         j.at("start_offset").get_to(p.start_offset);
         j.at("subscriber_id").get_to(p.subscriber_id);
+        if (j.contains("max_bytes")) {
+            j.at("max_bytes").get_to(p.max_bytes);
+        }
         // Or, if "topic" might be optional in the JSON (though not in the struct here):
         // if (j.contains("topic")) {
         //     j.at("topic").get_to(p.topic);
@@ -233,16 +242,18 @@ namespace WebSocketProtocol {
         uint64_t offset; // Offset of the produced message
         bool success = true;
         std::optional<std::string> error_message;
+        std::optional<uint32_t> throttle_ms; // Set when rejected by a quota: back off this long before retrying
     };
-    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(ProduceWsResponse, command, req_id, topic, offset, success, error_message)
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(ProduceWsResponse, command, req_id, topic, offset, success, error_message, throttle_ms)
 
     struct SubscribeTopicWsResponse : BaseWsMessage {
         std::string topic;
         bool success = true;
         std::optional<std::string> error_message;
+        std::optional<uint32_t> throttle_ms; // Set when rejected by a quota
         // Optional: std::string subscription_id; // Server-generated ID for this subscription
     };
-    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(SubscribeTopicWsResponse, command, req_id, topic, success, error_message)
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(SubscribeTopicWsResponse, command, req_id, topic, success, error_message, throttle_ms)
 
     struct UnsubscribeTopicWsResponse : BaseWsMessage {
         std::string topic;
@@ -288,5 +299,216 @@ namespace WebSocketProtocol {
     NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(ErrorWsResponse, command, req_id, error_message, original_command_type)
 
 
+    // --- Outgoing Serialization ---
+    // Responses default to their nlohmann mapping. The ones sent per message (produce acks and pushed
+    // batches) are written directly with JsonWriter, members in nlohmann's sorted order so the text
+    // is the same either way.
+    template <typename T>
+    void write_json(std::string& out, const T& message) {
+        out = json(message).dump();
+    }
+
+    inline void write_json(std::string& out, const ProduceWsResponse& p) {
+        out.reserve(out.size() + 128 + p.topic.size());
+        JsonWriter w(out);
+        w.begin_object();
+        w.key("command").value("produce_response");
+        w.key("error_message").value(p.error_message);
+        w.key("offset").value(p.offset);
+        w.key("req_id").value(p.req_id);
+        w.key("success").value(p.success);
+        w.key("throttle_ms").value(p.throttle_ms);
+        w.key("topic").value(p.topic);
+        w.end_object();
+    }
+
+    // A MESSAGE_BATCH_NOTIFICATION straight from the delivered messages, without copying them into
+    // a MessageBatchWsNotification first
+    inline void write_message_batch(std::string& out, const std::optional<uint64_t>& req_id,
+                                    const std::string& topic, const std::vector<Message>& messages) {
+        out.reserve(out.size() + 96 + topic.size() + JsonWriter::estimate(messages));
+        JsonWriter w(out);
+        w.begin_object();
+        w.key("command").value("message_batch_notification");
+        w.key("messages").value(messages);
+        w.key("req_id").value(req_id);
+        w.key("topic").value(topic);
+        w.end_object();
+    }
+
+    inline void write_json(std::string& out, const MessageBatchWsNotification& p) {
+        write_message_batch(out, p.req_id, p.topic, p.messages);
+    }
+
+    // --- Binary Subprotocol ---
+    // Selected during the handshake with Sec-WebSocket-Protocol. A session that agrees on
+    // BINARY_SUBPROTOCOL exchanges binary frames only: the same commands as the JSON protocol, with
+    // big-endian fields as on the TCP protocol and message payloads carried as raw bytes, so they
+    // need no escaping on the way out and no JSON parse on the way in. Frame layout:
+    //   command (u8), flags (u8), req_id (u64, present when flags has BINARY_FLAG_REQ_ID), body
+    // Topics and subscriber ids are u16-length strings; payloads and error messages u32-length ones.
+    // Responses end with a status: success (u8), throttle_ms (u32, 0 = not throttled) and
+    // error_message (empty = none). DOC.md lists the body of each command.
+    const char JSON_SUBPROTOCOL[] = "eventqueue.json.v1";
+    const char BINARY_SUBPROTOCOL[] = "eventqueue.binary.v1";
+    const uint8_t BINARY_FLAG_REQ_ID = 0x01;
+
+    enum class Encoding { JSON, BINARY };
+
+    // Picks the first protocol of a Sec-WebSocket-Protocol offer that the server speaks, in the
+    // client's order of preference. Returns the name to echo back, or an empty view (JSON, and no
+    // header in the handshake response) when the client offered none of them.
+    inline std::string_view select_subprotocol(std::string_view offer, Encoding& encoding) {
+        encoding = Encoding::JSON;
+        while (!offer.empty()) {
+            size_t comma = offer.find(',');
+            std::string_view name = offer.substr(0, comma);
+            offer = comma == std::string_view::npos ? std::string_view() : offer.substr(comma + 1);
+            while (!name.empty() && (name.front() == ' ' || name.front() == '\t')) name.remove_prefix(1);
+            while (!name.empty() && (name.back() == ' ' || name.back() == '\t')) name.remove_suffix(1);
+            if (name == BINARY_SUBPROTOCOL) {
+                encoding = Encoding::BINARY;
+                return BINARY_SUBPROTOCOL;
+            }
+            if (name == JSON_SUBPROTOCOL) return JSON_SUBPROTOCOL;
+        }
+        return {};
+    }
+
+    using BinaryWriter = NetworkProtocol::BasicBufferWriter<std::string>;
+
+    inline void write_binary_header(BinaryWriter& w, Command command, const std::optional<uint64_t>& req_id) {
+        w.put_u8(static_cast<uint8_t>(command));
+        w.put_u8(req_id ? BINARY_FLAG_REQ_ID : 0);
+        if (req_id) w.put_u64(*req_id);
+    }
+
+    inline void write_binary_status(BinaryWriter& w, bool success, const std::optional<uint32_t>& throttle_ms,
+                                    const std::optional<std::string>& error_message) {
+        w.put_u8(success ? 1 : 0);
+        w.put_u32(throttle_ms.value_or(0));
+        w.put_string(error_message ? std::string_view(*error_message) : std::string_view(), false);
+    }
+
+    inline void write_binary(std::string& out, const ProduceWsResponse& p) {
+        BinaryWriter w(out);
+        w.reserve(32 + p.topic.size() + (p.error_message ? p.error_message->size() : 0));
+        write_binary_header(w, Command::PRODUCE_RESPONSE, p.req_id);
+        w.put_string(p.topic);
+        w.put_u64(p.offset);
+        write_binary_status(w, p.success, p.throttle_ms, p.error_message);
+    }
+
+    inline void write_binary(std::string& out, const SubscribeTopicWsResponse& p) {
+        BinaryWriter w(out);
+        write_binary_header(w, Command::SUBSCRIBE_TOPIC_RESPONSE, p.req_id);
+        w.put_string(p.topic);
+        write_binary_status(w, p.success, p.throttle_ms, p.error_message);
+    }
+
+    inline void write_binary(std::string& out, const UnsubscribeTopicWsResponse& p) {
+        BinaryWriter w(out);
+        write_binary_header(w, Command::UNSUBSCRIBE_TOPIC_RESPONSE, p.req_id);
+        w.put_string(p.topic);
+        write_binary_status(w, p.success, std::nullopt, p.error_message);
+    }
+
+    inline void write_binary(std::string& out, const CreateTopicWsResponse& p) {
+        BinaryWriter w(out);
+        write_binary_header(w, Command::CREATE_TOPIC_RESPONSE, p.req_id);
+        w.put_string(p.topic);
+        write_binary_status(w, p.success, std::nullopt, p.error_message);
+    }
+
+    inline void write_binary(std::string& out, const ListTopicsWsResponse& p) {
+        BinaryWriter w(out);
+        write_binary_header(w, Command::LIST_TOPICS_RESPONSE, p.req_id);
+        w.put_u32(static_cast<uint32_t>(p.topics.size()));
+        for (const auto& topic : p.topics) w.put_string(topic);
+        write_binary_status(w, p.success, std::nullopt, p.error_message);
+    }
+
+    inline void write_binary(std::string& out, const GetNextOffsetWsResponse& p) {
+        BinaryWriter w(out);
+        write_binary_header(w, Command::GET_NEXT_OFFSET_RESPONSE, p.req_id);
+        w.put_string(p.topic);
+        w.put_u64(p.next_offset);
+        write_binary_status(w, p.success, std::nullopt, p.error_message);
+    }
+
+    inline void write_binary(std::string& out, const ErrorWsResponse& p) {
+        BinaryWriter w(out);
+        write_binary_header(w, Command::ERROR_RESPONSE, p.req_id);
+        w.put_u8(static_cast<uint8_t>(p.original_command_type.value_or(Command::UNKNOWN)));
+        w.put_string(p.error_message, false);
+    }
+
+    // MESSAGE_BATCH_NOTIFICATION: topic, count (u32), then offset (u64) and raw payload per message.
+    // The topic is sent once for the batch rather than with every message.
+    inline void write_binary_message_batch(std::string& out, const std::optional<uint64_t>& req_id,
+                                           const std::string& topic, const std::vector<Message>& messages) {
+        BinaryWriter w(out);
+        size_t bytes = 16 + sizeof(uint16_t) + topic.size() + sizeof(uint32_t);
+        for (const auto& msg : messages) bytes += sizeof(uint64_t) + sizeof(uint32_t) + msg.payload.size();
+        w.reserve(bytes);
+        write_binary_header(w, Command::MESSAGE_BATCH_NOTIFICATION, req_id);
+        w.put_string(topic);
+        w.put_u32(static_cast<uint32_t>(messages.size()));
+        for (const auto& msg : messages) {
+            w.put_u64(msg.offset);
+            w.put_string(msg.payload, false);
+        }
+    }
+
+    inline void write_binary(std::string& out, const MessageBatchWsNotification& p) {
+        write_binary_message_batch(out, p.req_id, p.topic, p.messages);
+    }
+
+    // Decodes the command, flags and req_id, leaving `r` at the body. The command byte is not
+    // validated here; unknown values fall through to the dispatcher's default case.
+    inline BaseWsMessage read_binary_header(NetworkProtocol::BufferReader& r) {
+        BaseWsMessage base;
+        base.command = static_cast<Command>(r.get_u8());
+        uint8_t flags = r.get_u8();
+        if (flags & BINARY_FLAG_REQ_ID) base.req_id = r.get_u64();
+        return base;
+    }
+
+    inline void read_binary(NetworkProtocol::BufferReader&, BaseWsMessage&) {} // LIST_TOPICS_REQUEST has no body
+
+    inline void read_binary(NetworkProtocol::BufferReader& r, ProduceWsRequest& p) {
+        p.topic = r.get_string();
+        p.message_payload = r.get_string(false);
+    }
+
+    inline void read_binary(NetworkProtocol::BufferReader& r, SubscribeTopicWsRequest& p) {
+        p.topic = r.get_string();
+        p.subscriber_id = r.get_string();
+        p.start_offset = r.get_u64();
+        p.max_bytes = r.get_u64();
+    }
+
+    inline void read_binary(NetworkProtocol::BufferReader& r, UnsubscribeTopicWsRequest& p) {
+        p.topic = r.get_string();
+        p.subscriber_id = r.get_string();
+    }
+
+    inline void read_binary(NetworkProtocol::BufferReader& r, CreateTopicWsRequest& p) {
+        p.topic = r.get_string();
+    }
+
+    inline void read_binary(NetworkProtocol::BufferReader& r, GetNextOffsetWsRequest& p) {
+        p.topic = r.get_string();
+    }
+
+    // Decodes the body of a request whose header has been read into `base`
+    template <typename T>
+    T read_binary_request(NetworkProtocol::BufferReader& r, const BaseWsMessage& base) {
+        T req;
+        static_cast<BaseWsMessage&>(req) = base;
+        read_binary(r, req);
+        if (!r.at_end()) throw std::runtime_error("Trailing bytes after the request body.");
+        return req;
+    }
 
 } // namespace WebSocketProtocol
\ No newline at end of file
@@ -0,0 +1,110 @@
+// tests/BufferPoolTest.cpp
+// BufferPool size classes and caps. A buffer reserved with an odd capacity shows whether acquire()
+// handed back a pooled buffer (that capacity) or a fresh one (the class size).
+#include "BufferPool.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+int failures = 0;
+
+void expect(const std::string& name, bool ok) {
+    if (ok) return;
+    ++failures;
+    std::cerr << "FAIL " << name << std::endl;
+}
+
+BufferPool::Buffer with_capacity(size_t capacity) {
+    BufferPool::Buffer buffer;
+    buffer.reserve(capacity);
+    return buffer;
+}
+
+void test_size_classes() {
+    BufferPool& pool = BufferPool::local();
+    expect("default request gets the smallest class", pool.acquire().capacity() >= BufferPool::MIN_CLASS_SIZE);
+    expect("rounded up to 1 KiB", pool.acquire(257).capacity() >= 1024);
+    expect("largest class", pool.acquire(BufferPool::MAX_CLASS_SIZE).capacity() >= BufferPool::MAX_CLASS_SIZE);
+    expect("acquired buffers are empty", pool.acquire(100).empty());
+
+    // A 1500-byte buffer belongs to the 1 KiB class: it serves requests up to 1 KiB, not 4 KiB
+    pool.release(with_capacity(1500));
+    expect("4 KiB request doesn't get a 1 KiB-class buffer", pool.acquire(2000).capacity() != 1500);
+    expect("1 KiB request reuses it", pool.acquire(1000).capacity() == 1500);
+    expect("class is empty again", pool.acquire(1000).capacity() != 1500);
+
+    // Released contents are cleared
+    BufferPool::Buffer used = with_capacity(1500);
+    used.assign(10, 'x');
+    pool.release(std::move(used));
+    BufferPool::Buffer reused = pool.acquire(1000);
+    expect("reused buffer is empty", reused.capacity() == 1500 && reused.empty());
+
+    // Too small or too large to pool
+    pool.release(with_capacity(100));
+    expect("tiny buffers aren't pooled", pool.acquire(0).capacity() != 100);
+    pool.release(with_capacity(BufferPool::MAX_CLASS_SIZE + 4096));
+    expect("oversized buffers aren't pooled",
+           pool.acquire(BufferPool::MAX_CLASS_SIZE).capacity() != BufferPool::MAX_CLASS_SIZE + 4096);
+}
+
+void test_per_class_cap() {
+    BufferPool::Limits limits;
+    limits.max_buffers_per_class = 2;
+    BufferPool::configure(limits);
+    std::thread([]() { // A fresh thread, so a fresh pool
+        BufferPool& pool = BufferPool::local();
+        pool.release(with_capacity(1100));
+        pool.release(with_capacity(1200));
+        pool.release(with_capacity(1300)); // Over the per-class cap: freed
+        size_t first = pool.acquire(1024).capacity();
+        size_t second = pool.acquire(1024).capacity();
+        size_t third = pool.acquire(1024).capacity();
+        expect("two buffers kept", first == 1200 && second == 1100);
+        expect("third buffer freed", third != 1300);
+    }).join();
+    BufferPool::configure(BufferPool::Limits{});
+}
+
+void test_total_cap() {
+    BufferPool::Limits limits;
+    limits.max_pooled_bytes = 4000; // Across all threads
+    BufferPool::configure(limits);
+
+    std::atomic<int> step{0};
+    std::thread other([&]() {
+        BufferPool::local().release(with_capacity(3000));
+        step = 1;
+        while (step != 2) std::this_thread::yield();
+    }); // Its pool, and the 3000 bytes it holds, go away when the thread exits
+    while (step != 1) std::this_thread::yield();
+
+    std::thread([&]() {
+        BufferPool& pool = BufferPool::local();
+        pool.release(with_capacity(1500)); // 3000 + 1500 is over the cap
+        expect("total cap counts other threads' buffers", pool.acquire(1024).capacity() != 1500);
+        step = 2;
+        other.join();
+        pool.release(with_capacity(1500));
+        expect("room again once the other pool is gone", pool.acquire(1024).capacity() == 1500);
+    }).join();
+    BufferPool::configure(BufferPool::Limits{});
+}
+
+} // namespace
+
+int main() {
+    test_size_classes();
+    test_per_class_cap();
+    test_total_cap();
+
+    if (failures) {
+        std::cerr << failures << " case(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "BufferPoolTest: all cases passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+// tests/CompressionTest.cpp
+// FLAG_COMPRESSED payloads with every codec built into this binary: round trips, the fallback for
+// data that doesn't shrink, and rejection of corrupt bodies and of decoded sizes over the limit.
+#include "Compression.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(const std::string& name, bool ok) {
+    if (ok) return;
+    ++failures;
+    std::cerr << "FAIL " << name << std::endl;
+}
+
+void expect_throws(const std::string& name, const std::function<void()>& decode) {
+    try {
+        decode();
+    } catch (const std::runtime_error&) {
+        return;
+    }
+    ++failures;
+    std::cerr << "FAIL " << name << ": no exception" << std::endl;
+}
+
+std::vector<char> compressible(size_t size) {
+    std::vector<char> data;
+    const std::string line = "{\"offset\":12345,\"topic\":\"orders\",\"payload\":\"status=shipped\"}\n";
+    while (data.size() < size) data.insert(data.end(), line.begin(), line.end());
+    data.resize(size);
+    return data;
+}
+
+void test_codec(Compression::Codec codec) {
+    const std::string name = Compression::codec_name(codec);
+    std::vector<char> data = compressible(64 * 1024);
+
+    // Appends after what the buffer already holds
+    std::vector<char> body{'h', 'd', 'r'};
+    expect(name + " compresses", Compression::compress_payload(codec, 0, data.data(), data.size(), body));
+    expect(name + " keeps the prefix", body[0] == 'h' && body[2] == 'r');
+    expect(name + " is smaller", body.size() < data.size());
+
+    const char* encoded = body.data() + 3;
+    size_t encoded_len = body.size() - 3;
+    std::vector<char> decoded{'x'}; // Replaced, not appended to
+    Compression::decompress_payload(codec, encoded, encoded_len, decoded);
+    expect(name + " round trip", decoded == data);
+
+    // Data that doesn't shrink is left for the caller to send as is
+    std::vector<char> noise(4096);
+    std::mt19937 rng(7);
+    for (auto& c : noise) c = static_cast<char>(rng());
+    std::vector<char> untouched{'a'};
+    expect(name + " declines incompressible data",
+           !Compression::compress_payload(codec, 0, noise.data(), noise.size(), untouched));
+    expect(name + " leaves the buffer as it was", untouched == std::vector<char>{'a'});
+
+    // The claimed size is checked against the caller's limit before decoding
+    expect_throws(name + " claim over max_size", [&]() {
+        Compression::decompress_payload(codec, encoded, encoded_len, decoded, static_cast<uint32_t>(data.size() - 1));
+    });
+    std::vector<char> huge_claim(body.begin() + 3, body.end());
+    NetworkProtocol::detail::store(huge_claim.data(), uint32_t(0xFFFFFFF0));
+    expect_throws(name + " claim over MAX_PAYLOAD_SIZE", [&]() {
+        Compression::decompress_payload(codec, huge_claim.data(), huge_claim.size(), decoded, UINT32_MAX);
+    });
+
+    // A claim that doesn't match the data, truncated data, and no length prefix at all
+    std::vector<char> wrong_claim(body.begin() + 3, body.end());
+    NetworkProtocol::detail::store(wrong_claim.data(), static_cast<uint32_t>(data.size() + 1));
+    expect_throws(name + " claim larger than the data", [&]() {
+        Compression::decompress_payload(codec, wrong_claim.data(), wrong_claim.size(), decoded);
+    });
+    NetworkProtocol::detail::store(wrong_claim.data(), static_cast<uint32_t>(data.size() - 1));
+    expect_throws(name + " claim smaller than the data", [&]() {
+        Compression::decompress_payload(codec, wrong_claim.data(), wrong_claim.size(), decoded);
+    });
+    expect_throws(name + " truncated", [&]() {
+        Compression::decompress_payload(codec, encoded, encoded_len / 2, decoded);
+    });
+    expect_throws(name + " without a length prefix", [&]() {
+        Compression::decompress_payload(codec, encoded, 3, decoded);
+    });
+}
+
+void test_negotiate() {
+    using Codec = Compression::Codec;
+    Compression::Settings settings;
+    expect("no codecs configured: off", Compression::negotiate(settings, {Codec::ZLIB}) == Codec::NONE);
+    settings.codecs = {Codec::ZLIB};
+    expect("common codec", Compression::negotiate(settings, {Codec::LZ4, Codec::ZLIB}) == Codec::ZLIB);
+    expect("no common codec", Compression::negotiate(settings, {Codec::LZ4}) == Codec::NONE);
+}
+
+} // namespace
+
+int main() {
+    for (Compression::Codec codec : Compression::available_codecs()) {
+        test_codec(codec);
+    }
+    test_negotiate();
+
+    if (failures) {
+        std::cerr << failures << " case(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "CompressionTest: all cases passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,91 @@
+// tests/HttpBatchParseTest.cpp
+// Bodies of POST /topics/{topic}/produce_batch: NDJSON and JSON-array records yield their payloads
+// in order, and malformed bodies are rejected with an error naming the record or line at fault.
+#include "HttpApi.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(const std::string& name, bool ok) {
+    if (ok) return;
+    ++failures;
+    std::cerr << "FAIL " << name << std::endl;
+}
+
+void expect_payloads(const std::string& name, const std::string& body, const std::vector<std::string>& expected) {
+    std::vector<std::string> payloads;
+    std::string error;
+    if (!HttpApi::parse_produce_batch(body, payloads, error)) {
+        ++failures;
+        std::cerr << "FAIL " << name << ": " << error << std::endl;
+        return;
+    }
+    expect(name, payloads == expected);
+}
+
+// Rejected, with an error that contains `error_part`
+void expect_rejected(const std::string& name, const std::string& body, const std::string& error_part) {
+    std::vector<std::string> payloads;
+    std::string error;
+    if (HttpApi::parse_produce_batch(body, payloads, error)) {
+        ++failures;
+        std::cerr << "FAIL " << name << ": accepted" << std::endl;
+        return;
+    }
+    if (error.find(error_part) == std::string::npos) {
+        ++failures;
+        std::cerr << "FAIL " << name << ": error \"" << error << "\" lacks \"" << error_part << "\"" << std::endl;
+    }
+}
+
+void test_ndjson() {
+    expect_payloads("one record", "{\"payload\":\"a\"}", {"a"});
+    expect_payloads("trailing newline", "{\"payload\":\"a\"}\n{\"payload\":\"b\"}\n", {"a", "b"});
+    expect_payloads("CRLF and blank lines", "{\"payload\":\"a\"}\r\n\r\n  \t\n{\"payload\":\"b\"}\r\n", {"a", "b"});
+    expect_payloads("other members are skipped",
+                    "{\"key\":{\"nested\":[1,null,true]},\"payload\":\"a\",\"ts\":1.5}", {"a"});
+    expect_payloads("escapes decoded", "{\"payload\":\"line\\nbreak \\u00e9\"}", {"line\nbreak \xC3\xA9"});
+    expect_payloads("duplicate key: last wins", "{\"payload\":\"a\",\"payload\":\"b\"}", {"b"});
+    expect_payloads("empty body", "", {});
+    expect_payloads("whitespace only", " \n\r\n", {});
+}
+
+void test_json_array() {
+    expect_payloads("array", "[{\"payload\":\"a\"},{\"payload\":\"b\"}]", {"a", "b"});
+    expect_payloads("array across lines", "\n  [\n {\"payload\":\"a\"},\n {\"id\":[2],\"payload\":\"b\"}\n]\n",
+                    {"a", "b"});
+    expect_payloads("empty array", "[]", {});
+}
+
+void test_malformed() {
+    expect_rejected("NDJSON bad line", "{\"payload\":\"a\"}\n{\"payload\":\n", "Line 2");
+    expect_rejected("NDJSON two records on a line", "{\"payload\":\"a\"} {\"payload\":\"b\"}", "Line 1");
+    expect_rejected("NDJSON record without payload", "{\"payload\":\"a\"}\n{\"value\":\"b\"}", "missing 'payload'");
+    expect_rejected("NDJSON scalar record", "\"a\"", "expected an object");
+    expect_rejected("payload not a string", "{\"payload\":1}", "'payload' must be a string");
+    expect_rejected("payload an object", "{\"payload\":{\"a\":\"b\"}}", "'payload' must be a string");
+    expect_rejected("array record without payload", "[{\"payload\":\"a\"},{}]", "Record 1");
+    expect_rejected("array of scalars", "[\"a\"]", "expected an object");
+    expect_rejected("nested arrays", "[[{\"payload\":\"a\"}]]", "expected an object");
+    expect_rejected("unterminated array", "[{\"payload\":\"a\"}", "Invalid JSON");
+    expect_rejected("trailing garbage after the array", "[{\"payload\":\"a\"}] x", "Invalid JSON");
+}
+
+} // namespace
+
+int main() {
+    test_ndjson();
+    test_json_array();
+    test_malformed();
+
+    if (failures) {
+        std::cerr << failures << " case(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "HttpBatchParseTest: all cases passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,77 @@
+// tests/JsonWriterTest.cpp
+// JsonWriter promises byte-for-byte the output of nlohmann's dump() for the same data; these cases
+// compare the two on the strings that need escaping or UTF-8 handling.
+#include "JsonWriter.h"
+#include <nlohmann/json.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+int failures = 0;
+
+void expect_equal(const std::string& name, const std::string& actual, const std::string& expected) {
+    if (actual == expected) return;
+    ++failures;
+    std::cerr << "FAIL " << name << "\n  JsonWriter: " << actual << "\n  nlohmann:   " << expected << std::endl;
+}
+
+// Invalid UTF-8 is replaced with U+FFFD, which nlohmann does when asked to
+std::string dump(const json& j) {
+    return j.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+void check_string(const std::string& name, const std::string& str) {
+    std::string out;
+    JsonWriter(out).value(str);
+    expect_equal(name, out, dump(json(str)));
+}
+
+void check_messages(const std::string& name, const std::vector<Message>& messages) {
+    std::string out;
+    JsonWriter(out).value(messages);
+    expect_equal(name, out, dump(json(messages)));
+}
+
+} // namespace
+
+int main() {
+    std::string control;
+    for (int c = 0; c < 0x20; ++c) control.push_back(static_cast<char>(c));
+    control.push_back('\x7F');
+    check_string("control characters", control);
+    check_string("quotes and backslashes", "say \"hi\" \\ \"bye\\\"");
+    check_string("multi-byte UTF-8", "caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80 \xE4\xB8\xAD");
+    check_string("empty string", "");
+
+    check_string("stray continuation byte", "a\x80z");
+    check_string("invalid lead byte", "a\xFFz");
+    check_string("overlong encoding", "\xC0\xAF");
+    check_string("UTF-16 surrogate", "\xED\xA0\x80");
+    check_string("above U+10FFFF", "\xF4\x90\x80\x80");
+    check_string("truncated at the end", "ab\xE2\x82");
+    check_string("truncated before ASCII", "\xF0\x9F\x98z");
+
+    check_messages("empty array", {});
+    check_messages("messages", {Message(0, "t\"opic", "line\nbreak"), Message(UINT64_MAX, "x", "\xC3\xA9")});
+
+    std::string out;
+    JsonWriter w(out);
+    w.begin_object();
+    w.key("empty").begin_array().end_array();
+    w.key("nested").begin_array().begin_array().end_array().value(true).null().end_array();
+    w.key("number").value(int64_t(-42));
+    w.end_object();
+    expect_equal("containers", out,
+                 dump(json{{"empty", json::array()}, {"nested", {json::array(), true, nullptr}}, {"number", -42}}));
+
+    if (failures) {
+        std::cerr << failures << " case(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "JsonWriterTest: all cases passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,196 @@
+// tests/NetworkProtocolTest.cpp
+// The binary TCP codec: fields round-trip in network byte order, request views decode what the
+// owning structs encode, and truncated or inconsistent payloads throw instead of reading past the end.
+#include "NetworkProtocol.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace NetworkProtocol;
+
+namespace {
+
+int failures = 0;
+
+void expect(const std::string& name, bool ok) {
+    if (ok) return;
+    ++failures;
+    std::cerr << "FAIL " << name << std::endl;
+}
+
+void expect_throws(const std::string& name, const std::function<void()>& decode) {
+    try {
+        decode();
+    } catch (const std::runtime_error&) {
+        return;
+    }
+    ++failures;
+    std::cerr << "FAIL " << name << ": no exception" << std::endl;
+}
+
+void test_buffer_round_trip() {
+    std::vector<char> buffer;
+    BufferWriter writer(buffer);
+    writer.put_u8(0xAB);
+    writer.put_u16(0x1234);
+    writer.put_u32(0xDEADBEEF);
+    writer.put_u64(0x0102030405060708ull);
+    writer.put_string("topic");
+    writer.put_string(std::string("pay\0load", 8), false);
+    writer.put_string("");
+
+    expect("u16 is big-endian", buffer[1] == 0x12 && buffer[2] == 0x34);
+    expect("u64 is big-endian", buffer[7] == 0x01 && buffer[14] == 0x08);
+
+    BufferReader reader(buffer.data(), buffer.size());
+    expect("u8", reader.get_u8() == 0xAB);
+    expect("u16", reader.get_u16() == 0x1234);
+    expect("u32", reader.get_u32() == 0xDEADBEEF);
+    expect("u64", reader.get_u64() == 0x0102030405060708ull);
+    expect("u16-prefixed string", reader.get_string() == "topic");
+    expect("u32-prefixed string with a NUL", reader.get_string(false) == std::string_view("pay\0load", 8));
+    expect("empty string", reader.get_string().empty());
+    expect("everything read", reader.at_end());
+}
+
+void test_buffer_truncation() {
+    std::vector<char> buffer;
+    BufferWriter writer(buffer);
+    writer.put_u64(42);
+    writer.put_string("topic");
+    for (size_t len = 0; len < buffer.size(); ++len) {
+        expect_throws("u64 truncated to " + std::to_string(len), [&]() {
+            BufferReader reader(buffer.data(), len);
+            reader.get_u64();
+            reader.get_string();
+        });
+    }
+    // A length prefix claiming more than the payload holds
+    std::vector<char> lying;
+    BufferWriter(lying).put_u32(1000);
+    lying.push_back('x');
+    expect_throws("string longer than the payload", [&]() {
+        BufferReader(lying.data(), lying.size()).get_string(false);
+    });
+}
+
+void test_produce_request() {
+    std::vector<char> payload = ProduceRequest{"orders", "hello"}.serialize();
+    ProduceRequestView view = ProduceRequestView::parse(payload.data(), payload.size());
+    expect("produce topic", view.topic_name == "orders");
+    expect("produce payload", view.message_payload == "hello");
+    expect("produce view points into the payload",
+           view.topic_name.data() >= payload.data() && view.topic_name.data() < payload.data() + payload.size());
+    expect_throws("produce truncated", [&]() { ProduceRequestView::parse(payload.data(), payload.size() - 1); });
+    payload.push_back('x');
+    expect_throws("produce with trailing bytes", [&]() { ProduceRequestView::parse(payload.data(), payload.size()); });
+}
+
+void test_consume_request() {
+    ConsumeRequest full{"orders", 7, 100, 250, 16, 4096};
+    std::vector<char> payload = full.serialize();
+    ConsumeRequestView view = ConsumeRequestView::parse(payload.data(), payload.size());
+    expect("consume all fields", view.topic_name == "orders" && view.start_offset == 7 && view.max_messages == 100 &&
+                                 view.max_wait_ms == 250 && view.min_bytes == 16 && view.max_bytes == 4096);
+
+    // Older clients stop after max_messages, or after the long-poll fields
+    size_t base_size = payload.size() - 3 * sizeof(uint32_t);
+    view = ConsumeRequestView::parse(payload.data(), base_size);
+    expect("consume without trailing fields", view.start_offset == 7 && view.max_messages == 100 &&
+                                              view.max_wait_ms == 0 && view.min_bytes == 0 && view.max_bytes == 0);
+    view = ConsumeRequestView::parse(payload.data(), base_size + 2 * sizeof(uint32_t));
+    expect("consume with long-poll fields only", view.max_wait_ms == 250 && view.min_bytes == 16 && view.max_bytes == 0);
+
+    expect_throws("consume without max_messages", [&]() { ConsumeRequestView::parse(payload.data(), base_size - 1); });
+    expect_throws("consume with a partial trailing field", [&]() { ConsumeRequestView::parse(payload.data(), base_size + 2); });
+    payload.push_back('x');
+    expect_throws("consume with trailing bytes", [&]() { ConsumeRequestView::parse(payload.data(), payload.size()); });
+}
+
+void test_produce_batch_request() {
+    ProduceBatchRequest request;
+    request.topics.push_back({"a", {"1", "22", ""}});
+    request.topics.push_back({"b", {}});
+    request.topics.push_back({"c", {"333"}});
+    std::vector<char> payload = request.serialize();
+
+    ProduceBatchRequestView view = ProduceBatchRequestView::parse(payload.data(), payload.size());
+    expect("batch topic count", view.topic_count() == 3);
+    std::vector<std::string> decoded;
+    view.for_each_topic([&](const ProduceBatchRequestView::TopicBatch& batch) {
+        std::string line(batch.topic_name);
+        line += ":" + std::to_string(batch.message_count) + ":" + std::to_string(batch.payload_bytes());
+        batch.for_each_payload([&](std::string_view p) { line += "," + std::string(p); });
+        decoded.push_back(line);
+    });
+    expect("batch topics and payloads", decoded == std::vector<std::string>{"a:3:3,1,22,", "b:0:0", "c:1:3,333"});
+
+    ProduceBatchRequest copy = ProduceBatchRequest::deserialize(payload.data(), payload.size());
+    expect("batch owning decode", copy.topics.size() == 3 && copy.topics[0].payloads[1] == "22" &&
+                                  copy.topics[2].topic_name == "c");
+
+    for (size_t len = 0; len < payload.size(); ++len) {
+        expect_throws("batch truncated to " + std::to_string(len),
+                      [&]() { ProduceBatchRequestView::parse(payload.data(), len); });
+    }
+    // A message count the payload can't hold
+    std::vector<char> lying;
+    BufferWriter writer(lying);
+    writer.put_u32(1);
+    writer.put_string("a");
+    writer.put_u32(0xFFFFFFFF);
+    expect_throws("batch with an inflated message count", [&]() { ProduceBatchRequestView::parse(lying.data(), lying.size()); });
+}
+
+void test_fetch_request() {
+    FetchRequest request;
+    request.entries.push_back({"a", 1, 100});
+    request.entries.push_back({"bb", 2, 0});
+    std::vector<char> payload = request.serialize();
+
+    FetchRequestView view = FetchRequestView::parse(payload.data(), payload.size());
+    expect("fetch entry count", view.entry_count() == 2);
+    std::vector<FetchRequestView::Entry> entries;
+    view.for_each_entry([&](const FetchRequestView::Entry& e) { entries.push_back(e); });
+    expect("fetch entries", entries.size() == 2 && entries[0].topic_name == "a" && entries[0].start_offset == 1 &&
+                            entries[0].max_bytes == 100 && entries[1].topic_name == "bb" && entries[1].start_offset == 2);
+
+    FetchRequest copy = FetchRequest::deserialize(payload.data(), payload.size());
+    expect("fetch owning decode", copy.entries.size() == 2 && copy.entries[1].topic_name == "bb");
+
+    for (size_t len = 0; len < payload.size(); ++len) {
+        expect_throws("fetch truncated to " + std::to_string(len), [&]() { FetchRequestView::parse(payload.data(), len); });
+    }
+}
+
+void test_consume_response() {
+    std::vector<Message> messages{Message(5, "t", "x"), Message(6, "t", std::string(300, 'y'))};
+    std::vector<char> payload;
+    ConsumeResponse::serialize_messages(payload, messages);
+    expect("encoded_size matches", payload.size() == ConsumeResponse::encoded_size(messages));
+    ConsumeResponse decoded = ConsumeResponse::deserialize(payload.data(), payload.size(), "t");
+    expect("consume response round trip", decoded.messages.size() == 2 && decoded.messages[0].offset == 5 &&
+                                          decoded.messages[1].payload == messages[1].payload);
+}
+
+} // namespace
+
+int main() {
+    test_buffer_round_trip();
+    test_buffer_truncation();
+    test_produce_request();
+    test_consume_request();
+    test_produce_batch_request();
+    test_fetch_request();
+    test_consume_response();
+
+    if (failures) {
+        std::cerr << failures << " case(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "NetworkProtocolTest: all cases passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,120 @@
+// tests/QuotaManagerTest.cpp
+// Token-bucket quotas: what is admitted, how long a client in debt is told to wait, and refill.
+// Buckets run on the real clock, so delays are checked to within a few milliseconds.
+#include "QuotaManager.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+int failures = 0;
+
+void expect_between(const std::string& name, uint32_t actual, uint32_t low, uint32_t high) {
+    if (actual >= low && actual <= high) return;
+    ++failures;
+    std::cerr << "FAIL " << name << ": " << actual << " not in [" << low << ", " << high << "]" << std::endl;
+}
+
+void expect(const std::string& name, bool ok) {
+    if (ok) return;
+    ++failures;
+    std::cerr << "FAIL " << name << std::endl;
+}
+
+using Op = QuotaManager::Operation;
+
+QuotaConfig produce_limit(double bytes_per_sec) {
+    QuotaConfig config;
+    config.enabled = true;
+    config.default_client.produce_bytes_per_sec = bytes_per_sec;
+    return config;
+}
+
+void test_disabled() {
+    QuotaConfig config = produce_limit(1);
+    config.enabled = false;
+    QuotaManager quotas(config);
+    expect_between("disabled admits anything", quotas.admit("c", "t", Op::PRODUCE, 1u << 30), 0, 0);
+    expect_between("disabled admits again", quotas.admit("c", "t", Op::PRODUCE, 1u << 30), 0, 0);
+}
+
+void test_produce_debt() {
+    QuotaManager quotas(produce_limit(1000)); // Burst of one second: 1000 bytes
+    // A large produce is admitted on a full bucket and leaves it 2000 bytes in debt
+    expect_between("first produce admitted", quotas.admit("c", "t", Op::PRODUCE, 3000), 0, 0);
+    expect_between("in debt: wait two seconds", quotas.admit("c", "t", Op::PRODUCE, 1), 1950, 2000);
+    expect_between("throttled request is not charged", quotas.admit("c", "t", Op::PRODUCE, 1), 1950, 2000);
+    // Other clients and operations have their own buckets
+    expect_between("other client admitted", quotas.admit("d", "t", Op::PRODUCE, 10), 0, 0);
+    expect_between("consume unaffected", quotas.admit("c", "t", Op::CONSUME), 0, 0);
+}
+
+void test_refill() {
+    QuotaManager quotas(produce_limit(1000));
+    expect_between("produce admitted", quotas.admit("c", "t", Op::PRODUCE, 1050), 0, 0);
+    expect_between("50 bytes of debt", quotas.admit("c", "t", Op::PRODUCE, 1), 1, 50);
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    expect_between("refilled after the wait", quotas.admit("c", "t", Op::PRODUCE, 1), 0, 0);
+}
+
+void test_max_throttle() {
+    QuotaConfig config = produce_limit(100);
+    config.max_throttle_ms = 500;
+    QuotaManager quotas(config);
+    quotas.admit("c", "t", Op::PRODUCE, 100000);
+    expect_between("delay capped at max_throttle_ms", quotas.admit("c", "t", Op::PRODUCE, 1), 500, 500);
+}
+
+void test_requests_per_sec() {
+    QuotaConfig config;
+    config.enabled = true;
+    config.default_client.requests_per_sec = 0.5; // Bucket still holds one whole request
+    QuotaManager quotas(config);
+    expect_between("first request admitted", quotas.admit("c", "", Op::OTHER), 0, 0);
+    expect_between("next token in two seconds", quotas.admit("c", "", Op::OTHER), 1950, 2000);
+}
+
+void test_topic_quota_and_record() {
+    QuotaConfig config;
+    config.enabled = true;
+    config.default_topic.consume_bytes_per_sec = 1000;
+    config.topics["hot"].consume_bytes_per_sec = 10000;
+    QuotaManager quotas(config);
+    // Consumed bytes are only known afterwards and charged with record()
+    quotas.record("c", "t", Op::CONSUME, 1500);
+    expect_between("topic in debt after record", quotas.admit("other", "t", Op::CONSUME), 450, 500);
+    quotas.record("c", "hot", Op::CONSUME, 15000);
+    expect_between("per-topic override rate", quotas.admit("other", "hot", Op::CONSUME), 450, 500);
+    expect_between("untouched topic admitted", quotas.admit("other", "cold", Op::CONSUME), 0, 0);
+}
+
+void test_client_identity() {
+    QuotaConfig config;
+    config.trusted_proxies.insert("10.0.0.1");
+    QuotaManager quotas(config);
+    expect("trusted proxy forwards the client id", quotas.client_identity("10.0.0.1", "alice") == "alice");
+    expect("untrusted peer keeps its address", quotas.client_identity("10.0.0.2", "alice") == "10.0.0.2");
+    expect("no header keeps the proxy address", quotas.client_identity("10.0.0.1", "") == "10.0.0.1");
+}
+
+} // namespace
+
+int main() {
+    test_disabled();
+    test_produce_debt();
+    test_refill();
+    test_max_throttle();
+    test_requests_per_sec();
+    test_topic_quota_and_record();
+    test_client_identity();
+
+    if (failures) {
+        std::cerr << failures << " case(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "QuotaManagerTest: all cases passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,124 @@
+// tests/ShardPoolTest.cpp
+// Tasks from one shard to another must run in dispatch order, including when the SPSC ring between
+// them is full and tasks spill into the overflow deque.
+#include "ShardPool.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(const std::string& name, bool ok) {
+    if (ok) return;
+    ++failures;
+    std::cerr << "FAIL " << name << std::endl;
+}
+
+void wait_for(const std::atomic<bool>& flag) {
+    while (!flag.load()) std::this_thread::yield();
+}
+
+void test_spsc_queue() {
+    SpscQueue<int> queue(3); // Rounded up to 4
+    int value = 0;
+    expect("new queue is empty", queue.empty() && !queue.try_pop(value));
+    for (int i = 0; i < 4; ++i) {
+        int item = i;
+        expect("push within capacity", queue.try_push(item));
+    }
+    int extra = 4;
+    expect("push into a full queue fails", !queue.try_push(extra));
+    expect("failed push leaves the item", extra == 4);
+
+    // Wrap around the ring a few times
+    bool ordered = true;
+    for (int i = 0; i < 20; ++i) {
+        int item = i + 4;
+        ordered &= queue.try_pop(value) && value == i;
+        ordered &= queue.try_push(item);
+    }
+    for (int i = 20; i < 24; ++i) ordered &= queue.try_pop(value) && value == i;
+    expect("FIFO order across wrap-around", ordered);
+    expect("drained queue is empty", queue.empty());
+}
+
+void test_spsc_queue_threads() {
+    const int count = 200000;
+    SpscQueue<int> queue(64);
+    std::thread producer([&]() {
+        for (int i = 0; i < count; ++i) {
+            int item = i;
+            while (!queue.try_push(item)) std::this_thread::yield();
+        }
+    });
+    bool ordered = true;
+    for (int i = 0; i < count; ++i) {
+        int value;
+        while (!queue.try_pop(value)) std::this_thread::yield();
+        if (value != i) ordered = false;
+    }
+    producer.join();
+    expect("FIFO order between two threads", ordered);
+}
+
+void test_shard_pool_order_through_overflow() {
+    // A capacity of 4 makes most of the tasks go through the overflow deque
+    ShardPool pool(2, false, 4);
+    pool.start();
+
+    const int count = 100000;
+    std::vector<int> seen;
+    seen.reserve(count);
+    std::atomic<bool> done{false};
+    pool.dispatch(0, [&]() {
+        for (int i = 0; i < count; ++i) {
+            pool.dispatch(1, [&, i]() {
+                seen.push_back(i);
+                if (i == count - 1) done = true;
+            });
+        }
+    });
+    wait_for(done);
+
+    bool ordered = seen.size() == static_cast<size_t>(count);
+    for (int i = 0; ordered && i < count; ++i) ordered = seen[i] == i;
+    expect("cross-shard tasks run in dispatch order", ordered);
+
+    // Tasks dispatched from a non-shard thread run on the target shard
+    std::atomic<size_t> ran_on{ShardPool::NO_SHARD};
+    std::atomic<bool> posted{false};
+    pool.dispatch(1, [&]() {
+        ran_on = pool.current_shard();
+        posted = true;
+    });
+    wait_for(posted);
+    expect("posted task runs on its shard", ran_on == 1);
+
+    // A throwing task doesn't stop the shard
+    pool.dispatch(1, []() { throw std::runtime_error("task failure"); });
+    std::atomic<bool> alive{false};
+    pool.dispatch(1, [&]() { alive = true; });
+    wait_for(alive);
+    pool.stop();
+}
+
+} // namespace
+
+int main() {
+    test_spsc_queue();
+    test_spsc_queue_threads();
+    test_shard_pool_order_through_overflow();
+
+    if (failures) {
+        std::cerr << failures << " case(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "ShardPoolTest: all cases passed" << std::endl;
+    return 0;
+}